@@ -0,0 +1,566 @@
+#include "pch.h"
+#include "BatchProcessor.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <thread>
+
+// Everything one capture needs on its way through the stages. Frames are created once per recording
+// and cycle from write back to decode, so the registered color image and chunk buffers are reused.
+struct BatchProcessor::Frame
+{
+	int index = 0;
+	k4a_capture_t capture = nullptr;
+	k4a_image_t depthImage = nullptr;
+	k4a_image_t colorImage = nullptr;
+	k4a_image_t irImage = nullptr;
+	k4a_image_t transformedColorImage = nullptr;
+	bool hasTransformedColor = false;
+	PointCloudExporter::EncodedFrame encoded;
+	bool hasEncoded = false;
+};
+
+// Bounded by the frames of its recording, a push never waits. Pop waits until a frame arrives or the
+// queue is closed and drained.
+class BatchProcessor::FrameQueue
+{
+public:
+	void Push(Frame *frame)
+	{
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			frames.push_back(frame);
+		}
+		queueCondition.notify_one();
+	}
+
+	bool TryPop(Frame **frame)
+	{
+		std::unique_lock<std::mutex> lock(queueMutex);
+		queueCondition.wait(lock, [this]() { return !frames.empty() || closed; });
+		if (frames.empty())
+		{
+			return false;
+		}
+
+		*frame = frames.front();
+		frames.pop_front();
+		return true;
+	}
+
+	void Close()
+	{
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			closed = true;
+		}
+		queueCondition.notify_all();
+	}
+
+private:
+	std::mutex queueMutex;
+	std::condition_variable queueCondition;
+	std::deque<Frame*> frames;
+	bool closed = false;
+};
+
+struct BatchProcessor::RecordingStats
+{
+	uint64_t frameCount = 0;
+	uint64_t pointCount = 0;
+	uint64_t writtenBytes = 0;
+	double stageMilliseconds[StageCount] = {};
+	double wallMilliseconds = 0.0;
+	uint64_t unchangedFrameCount = 0;
+	uint64_t keyframeCount = 0;
+	uint64_t changeCopiedBytes = 0;
+	uint64_t changeFullFrameBytes = 0;
+	double changeDetectMilliseconds = 0.0;
+};
+
+// What the plugin keeps per device for change detection, here per recording and only used by the transform stage
+struct BatchProcessor::ChangeReference
+{
+	std::vector<uint16_t> depth;
+	std::vector<uint16_t> ir;
+	std::vector<uint8_t> mask;
+	bool hasReference = false;
+	int framesSinceKeyframe = 0;
+};
+
+static void release_capture_images(k4a_capture_t &capture, k4a_image_t &depthImage, k4a_image_t &colorImage, k4a_image_t &irImage)
+{
+	if (irImage != nullptr)
+	{
+		k4a_image_release(irImage);
+		irImage = nullptr;
+	}
+	if (colorImage != nullptr)
+	{
+		k4a_image_release(colorImage);
+		colorImage = nullptr;
+	}
+	if (depthImage != nullptr)
+	{
+		k4a_image_release(depthImage);
+		depthImage = nullptr;
+	}
+	if (capture != nullptr)
+	{
+		k4a_capture_release(capture);
+		capture = nullptr;
+	}
+}
+
+// Binary PPM from BGRA, rows are converted through one reusable buffer
+static bool write_ppm(const char *path, const uint8_t *bgra, int width, int height, std::vector<uint8_t> &row, uint64_t &writtenBytes)
+{
+	FILE *file = nullptr;
+	if (fopen_s(&file, path, "wb") != 0 || file == nullptr)
+	{
+		return false;
+	}
+
+	int headerSize = fprintf(file, "P6\n%d %d\n255\n", width, height);
+	bool result = headerSize > 0;
+	row.resize(static_cast<size_t>(width) * 3);
+	for (int y = 0; result && y < height; y++)
+	{
+		const uint8_t *src = bgra + static_cast<size_t>(y) * width * 4;
+		for (int x = 0; x < width; x++)
+		{
+			row[3 * x + 0] = src[4 * x + 2];
+			row[3 * x + 1] = src[4 * x + 1];
+			row[3 * x + 2] = src[4 * x + 0];
+		}
+		result = fwrite(row.data(), 1, row.size(), file) == row.size();
+	}
+
+	result = fclose(file) == 0 && result;
+	if (result)
+	{
+		writtenBytes += headerSize + static_cast<uint64_t>(row.size()) * height;
+	}
+	return result;
+}
+
+// 16 bit PGM, which is big endian by definition
+static bool write_pgm(const char *path, const uint16_t *depth, int width, int height, std::vector<uint8_t> &row, uint64_t &writtenBytes)
+{
+	FILE *file = nullptr;
+	if (fopen_s(&file, path, "wb") != 0 || file == nullptr)
+	{
+		return false;
+	}
+
+	int headerSize = fprintf(file, "P5\n%d %d\n65535\n", width, height);
+	bool result = headerSize > 0;
+	row.resize(static_cast<size_t>(width) * 2);
+	for (int y = 0; result && y < height; y++)
+	{
+		const uint16_t *src = depth + static_cast<size_t>(y) * width;
+		for (int x = 0; x < width; x++)
+		{
+			row[2 * x + 0] = static_cast<uint8_t>(src[x] >> 8);
+			row[2 * x + 1] = static_cast<uint8_t>(src[x] & 0xff);
+		}
+		result = fwrite(row.data(), 1, row.size(), file) == row.size();
+	}
+
+	result = fclose(file) == 0 && result;
+	if (result)
+	{
+		writtenBytes += headerSize + static_cast<uint64_t>(row.size()) * height;
+	}
+	return result;
+}
+
+static float get_saved_percent(uint64_t copiedBytes, uint64_t fullFrameBytes)
+{
+	return fullFrameBytes > 0 ? 100.0f * (1.0f - static_cast<float>(copiedBytes) / fullFrameBytes) : 0.0f;
+}
+
+BatchProcessor::BatchProcessor(const Options &options) :
+	options(options),
+	stats(),
+	pipelineMilliseconds(0.0)
+{
+	this->options.parallelRecordings = max(this->options.parallelRecordings, 1);
+	this->options.framesInFlight = max(this->options.framesInFlight, 2);
+}
+
+const char *BatchProcessor::GetStageName(Stage stage)
+{
+	switch (stage)
+	{
+	case StageDecode:
+		return "decode";
+	case StageTransform:
+		return "transform";
+	case StagePoints:
+		return "points";
+	case StageWrite:
+		return "write";
+	default:
+		return "unknown";
+	}
+}
+
+bool BatchProcessor::TryProcess(const std::vector<std::string> &recordingPaths)
+{
+	{
+		std::lock_guard<std::mutex> lock(statsMutex);
+		stats = Stats();
+		stats.recordingCount = static_cast<int>(recordingPaths.size());
+		pipelineMilliseconds = 0.0;
+	}
+
+	auto start = TimingHelper::GetTimestampMicroseconds();
+
+	// Each worker takes the next recording until none are left
+	std::atomic<size_t> nextRecording{ 0 };
+	auto worker = [&]()
+	{
+		size_t index;
+		while ((index = nextRecording.fetch_add(1)) < recordingPaths.size())
+		{
+			RecordingStats recordingStats;
+			bool result = TryProcessRecording(recordingPaths[index], recordingStats);
+			if (!result)
+			{
+				fprintf(stderr, "Failed to process %s\n", recordingPaths[index].c_str());
+			}
+
+			std::lock_guard<std::mutex> lock(statsMutex);
+			stats.failedRecordingCount += result ? 0 : 1;
+			stats.frameCount += recordingStats.frameCount;
+			stats.pointCount += recordingStats.pointCount;
+			stats.writtenBytes += recordingStats.writtenBytes;
+			for (int stage = 0; stage < StageCount; stage++)
+			{
+				stats.stageMilliseconds[stage] += static_cast<float>(recordingStats.stageMilliseconds[stage]);
+			}
+			pipelineMilliseconds += recordingStats.wallMilliseconds;
+
+			if (options.measureChanges)
+			{
+				stats.unchangedFrameCount += recordingStats.unchangedFrameCount;
+				stats.keyframeCount += recordingStats.keyframeCount;
+				stats.changeCopiedBytes += recordingStats.changeCopiedBytes;
+				stats.changeFullFrameBytes += recordingStats.changeFullFrameBytes;
+				stats.changeDetectMilliseconds += static_cast<float>(recordingStats.changeDetectMilliseconds);
+				printf("%s: %llu frames, %llu unchanged, %llu keyframes, %.1f%% of copied bytes saved, %.2f ms detection per frame\n",
+					recordingPaths[index].c_str(),
+					static_cast<unsigned long long>(recordingStats.frameCount),
+					static_cast<unsigned long long>(recordingStats.unchangedFrameCount),
+					static_cast<unsigned long long>(recordingStats.keyframeCount),
+					get_saved_percent(recordingStats.changeCopiedBytes, recordingStats.changeFullFrameBytes),
+					recordingStats.frameCount > 0 ? recordingStats.changeDetectMilliseconds / recordingStats.frameCount : 0.0);
+			}
+		}
+	};
+
+	int workerCount = min(options.parallelRecordings, static_cast<int>(recordingPaths.size()));
+	std::vector<std::thread> workers;
+	for (int i = 1; i < workerCount; i++)
+	{
+		workers.emplace_back(worker);
+	}
+	worker();
+	for (auto &thread : workers)
+	{
+		thread.join();
+	}
+
+	std::lock_guard<std::mutex> lock(statsMutex);
+	stats.wallMilliseconds = TimingHelper::GetElapsedMilliseconds(start);
+	stats.framesPerSecond = stats.wallMilliseconds > 0.0f ? stats.frameCount / (stats.wallMilliseconds / 1000.0f) : 0.0f;
+	for (int stage = 0; stage < StageCount; stage++)
+	{
+		stats.stageUtilization[stage] = pipelineMilliseconds > 0.0 ? static_cast<float>(stats.stageMilliseconds[stage] / pipelineMilliseconds) : 0.0f;
+	}
+	return stats.failedRecordingCount == 0;
+}
+
+BatchProcessor::Stats BatchProcessor::GetStats()
+{
+	std::lock_guard<std::mutex> lock(statsMutex);
+	return stats;
+}
+
+bool BatchProcessor::TryProcessRecording(const std::string &recordingPath, RecordingStats &recordingStats)
+{
+	auto start = TimingHelper::GetTimestampMicroseconds();
+
+	k4a_playback_t playback = nullptr;
+	if (K4A_RESULT_SUCCEEDED != k4a_playback_open(recordingPath.c_str(), &playback))
+	{
+		return false;
+	}
+
+	k4a_calibration_t calibration;
+	k4a_record_configuration_t configuration;
+	if (K4A_RESULT_SUCCEEDED != k4a_playback_get_calibration(playback, &calibration) ||
+		K4A_RESULT_SUCCEEDED != k4a_playback_get_record_configuration(playback, &configuration) ||
+		!configuration.depth_track_enabled)
+	{
+		k4a_playback_close(playback);
+		return false;
+	}
+
+	// Depth only recordings still get depth and uncolored points
+	bool hasColor = configuration.color_track_enabled &&
+		K4A_RESULT_SUCCEEDED == k4a_playback_set_color_conversion(playback, K4A_IMAGE_FORMAT_COLOR_BGRA32);
+	bool needsColor = hasColor && (options.writeColor || options.writePointClouds || options.measureChanges);
+
+	std::error_code error;
+	std::filesystem::path directory = std::filesystem::path(options.outputDirectory) / std::filesystem::path(recordingPath).stem();
+	std::filesystem::create_directories(directory, error);
+	if (error)
+	{
+		k4a_playback_close(playback);
+		return false;
+	}
+	const std::string directoryPrefix = directory.string() + "/";
+
+	int width = calibration.depth_camera_calibration.resolution_width;
+	int height = calibration.depth_camera_calibration.resolution_height;
+	k4a_transformation_t transformation = needsColor ? k4a_transformation_create(&calibration) : nullptr;
+
+	k4a_image_t xyTableImage = nullptr;
+	if (options.writePointClouds)
+	{
+		ImagePool::GetShared().TryCreateImage(K4A_IMAGE_FORMAT_CUSTOM,
+			width,
+			height,
+			width * (int)sizeof(k4a_float2_t),
+			&xyTableImage);
+		create_xy_table(&calibration, xyTableImage);
+	}
+	const k4a_float2_t *xyTableData = xyTableImage != nullptr ? (const k4a_float2_t *)(void *)k4a_image_get_buffer(xyTableImage) : nullptr;
+
+	std::vector<std::unique_ptr<Frame>> frames(options.framesInFlight);
+	FrameQueue freeFrames;
+	for (auto &frame : frames)
+	{
+		frame.reset(new Frame());
+		if (needsColor)
+		{
+			ImagePool::GetShared().TryCreateImage(K4A_IMAGE_FORMAT_COLOR_BGRA32,
+				width,
+				height,
+				width * 4 * (int)sizeof(uint8_t),
+				&frame->transformedColorImage);
+		}
+		freeFrames.Push(frame.get());
+	}
+
+	FrameQueue decodedFrames;
+	FrameQueue transformedFrames;
+	FrameQueue encodedFrames;
+	PointCloudExporter exporter;
+	ChangeReference changeReference;
+	std::atomic<bool> failed{ false };
+
+	std::thread transformThread([&]()
+	{
+		Frame *frame;
+		while (decodedFrames.TryPop(&frame))
+		{
+			auto stageStart = TimingHelper::GetTimestampMicroseconds();
+			frame->hasTransformedColor = frame->colorImage != nullptr && frame->transformedColorImage != nullptr &&
+				K4A_RESULT_SUCCEEDED == k4a_transformation_color_image_to_depth_camera(
+					transformation,
+					frame->depthImage,
+					frame->colorImage,
+					frame->transformedColorImage);
+			if (options.measureChanges)
+			{
+				MeasureChanges(*frame, width, height, changeReference, recordingStats);
+			}
+			recordingStats.stageMilliseconds[StageTransform] += TimingHelper::GetElapsedMilliseconds(stageStart);
+			transformedFrames.Push(frame);
+		}
+		transformedFrames.Close();
+	});
+
+	std::thread pointsThread([&]()
+	{
+		Frame *frame;
+		while (transformedFrames.TryPop(&frame))
+		{
+			auto stageStart = TimingHelper::GetTimestampMicroseconds();
+			frame->hasEncoded = options.writePointClouds && xyTableData != nullptr;
+			if (frame->hasEncoded)
+			{
+				PointCloudExporter::Frame exportFrame;
+				exportFrame.depthData = (const uint16_t *)(void *)k4a_image_get_buffer(frame->depthImage);
+				exportFrame.xyTableData = xyTableData;
+				exportFrame.colorData = frame->hasTransformedColor ? k4a_image_get_buffer(frame->transformedColorImage) : nullptr;
+				exportFrame.width = width;
+				exportFrame.height = height;
+				exporter.Encode(exportFrame, options.format, options.includeNormals, frame->encoded);
+			}
+			recordingStats.stageMilliseconds[StagePoints] += TimingHelper::GetElapsedMilliseconds(stageStart);
+			encodedFrames.Push(frame);
+		}
+		encodedFrames.Close();
+	});
+
+	std::thread writeThread([&]()
+	{
+		std::vector<uint8_t> row;
+		Frame *frame;
+		while (encodedFrames.TryPop(&frame))
+		{
+			auto stageStart = TimingHelper::GetTimestampMicroseconds();
+			if (!failed && TryWriteFrame(*frame, directoryPrefix, exporter, row, recordingStats.writtenBytes))
+			{
+				recordingStats.frameCount++;
+				recordingStats.pointCount += frame->hasEncoded ? frame->encoded.pointCount : 0;
+			}
+			else
+			{
+				failed = true;
+			}
+			release_capture_images(frame->capture, frame->depthImage, frame->colorImage, frame->irImage);
+			recordingStats.stageMilliseconds[StageWrite] += TimingHelper::GetElapsedMilliseconds(stageStart);
+			freeFrames.Push(frame);
+		}
+	});
+
+	// Decode runs on this thread and only waits when every frame is still somewhere downstream
+	int frameIndex = 0;
+	Frame *frame;
+	while (!failed && (options.maxFrames <= 0 || frameIndex < options.maxFrames) && freeFrames.TryPop(&frame))
+	{
+		auto stageStart = TimingHelper::GetTimestampMicroseconds();
+		k4a_stream_result_t streamResult = k4a_playback_get_next_capture(playback, &frame->capture);
+		if (streamResult != K4A_STREAM_RESULT_SUCCEEDED)
+		{
+			failed = streamResult != K4A_STREAM_RESULT_EOF;
+			recordingStats.stageMilliseconds[StageDecode] += TimingHelper::GetElapsedMilliseconds(stageStart);
+			break;
+		}
+
+		frame->depthImage = k4a_capture_get_depth_image(frame->capture);
+		frame->colorImage = needsColor ? k4a_capture_get_color_image(frame->capture) : nullptr;
+		frame->irImage = options.measureChanges && options.changeIRNoise >= 0 ? k4a_capture_get_ir_image(frame->capture) : nullptr;
+		recordingStats.stageMilliseconds[StageDecode] += TimingHelper::GetElapsedMilliseconds(stageStart);
+		if (frame->depthImage == nullptr)
+		{
+			release_capture_images(frame->capture, frame->depthImage, frame->colorImage, frame->irImage);
+			freeFrames.Push(frame);
+			continue;
+		}
+
+		frame->index = frameIndex++;
+		decodedFrames.Push(frame);
+	}
+
+	decodedFrames.Close();
+	transformThread.join();
+	pointsThread.join();
+	writeThread.join();
+
+	for (auto &frame : frames)
+	{
+		if (frame->transformedColorImage != nullptr)
+		{
+			k4a_image_release(frame->transformedColorImage);
+		}
+	}
+	if (xyTableImage != nullptr)
+	{
+		k4a_image_release(xyTableImage);
+	}
+	if (transformation != nullptr)
+	{
+		k4a_transformation_destroy(transformation);
+	}
+	k4a_playback_close(playback);
+
+	recordingStats.wallMilliseconds = TimingHelper::GetElapsedMilliseconds(start);
+	return !failed;
+}
+
+// Runs the same detect_changed_tiles as AzureKinectWrapper::DetectChanges and counts like its stats. A keyframe
+// copies the whole frame, any other the rect around the changed tiles and an unchanged one nothing. Frames
+// arrive in order, the transform stage is the only one touching the reference.
+void BatchProcessor::MeasureChanges(const Frame &frame, int width, int height, ChangeReference &reference, RecordingStats &recordingStats)
+{
+	auto start = TimingHelper::GetTimestampMicroseconds();
+	const uint16_t *depthData = (const uint16_t *)(void *)k4a_image_get_buffer(frame.depthImage);
+	const uint16_t *irData = frame.irImage != nullptr ? (const uint16_t *)(void *)k4a_image_get_buffer(frame.irImage) : nullptr;
+	const size_t pixelCount = static_cast<size_t>(width) * height;
+
+	bool missingReference = !reference.hasReference ||
+		(irData != nullptr && reference.ir.size() != pixelCount);
+	reference.depth.resize(pixelCount);
+	reference.ir.resize(irData != nullptr ? pixelCount : 0);
+	reference.mask.resize(static_cast<size_t>(change_tile_count(width)) * change_tile_count(height));
+
+	PixelRect changedRect;
+	int changedTileCount = 0;
+	bool detected = detect_changed_tiles(depthData,
+		irData,
+		width,
+		height,
+		static_cast<uint16_t>(min(options.changeDepthNoise, (int)UINT16_MAX)),
+		static_cast<uint16_t>(min(options.changeIRNoise, (int)UINT16_MAX)),
+		options.changeTileThreshold,
+		options.changeKeyframeInterval,
+		missingReference,
+		reference.depth.data(),
+		irData != nullptr ? reference.ir.data() : nullptr,
+		&reference.framesSinceKeyframe,
+		reference.mask.data(),
+		&changedRect,
+		&changedTileCount);
+	reference.hasReference = true;
+	recordingStats.changeDetectMilliseconds += TimingHelper::GetElapsedMilliseconds(start);
+
+	// Registered color is copied with depth, at four bytes a pixel
+	const uint64_t pixelBytes = sizeof(uint16_t) + (frame.hasTransformedColor ? 4 : 0);
+	recordingStats.unchangedFrameCount += changedRect.width == 0 ? 1 : 0;
+	recordingStats.keyframeCount += detected ? 0 : 1;
+	recordingStats.changeCopiedBytes += static_cast<uint64_t>(changedRect.width) * changedRect.height * pixelBytes;
+	recordingStats.changeFullFrameBytes += pixelCount * pixelBytes;
+}
+
+bool BatchProcessor::TryWriteFrame(
+	const Frame &frame,
+	const std::string &directory,
+	PointCloudExporter &exporter,
+	std::vector<uint8_t> &row,
+	uint64_t &writtenBytes)
+{
+	const int width = k4a_image_get_width_pixels(frame.depthImage);
+	const int height = k4a_image_get_height_pixels(frame.depthImage);
+	char fileName[48];
+	bool result = true;
+
+	if (options.writeDepth)
+	{
+		snprintf(fileName, sizeof(fileName), "frame_%06d_depth.pgm", frame.index);
+		result = result && write_pgm((directory + fileName).c_str(),
+			(const uint16_t *)(void *)k4a_image_get_buffer(frame.depthImage), width, height, row, writtenBytes);
+	}
+
+	if (options.writeColor && frame.hasTransformedColor)
+	{
+		snprintf(fileName, sizeof(fileName), "frame_%06d_color.ppm", frame.index);
+		result = result && write_ppm((directory + fileName).c_str(),
+			k4a_image_get_buffer(frame.transformedColorImage), width, height, row, writtenBytes);
+	}
+
+	if (frame.hasEncoded)
+	{
+		snprintf(fileName, sizeof(fileName), "frame_%06d.%s", frame.index, options.format == PointCloudFileFormatPly ? "ply" : "pcd");
+		result = result && exporter.TryWrite(frame.encoded, (directory + fileName).c_str(), options.format, options.includeNormals);
+		writtenBytes += result ? static_cast<uint64_t>(frame.encoded.pointCount) * frame.encoded.recordSize : 0;
+	}
+
+	return result;
+}
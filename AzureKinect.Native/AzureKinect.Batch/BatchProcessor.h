@@ -0,0 +1,89 @@
+#pragma once
+
+// Regenerates registered color, depth and point clouds from recordings without a device, d3d or unity.
+// Every recording runs through its own four stage pipeline, each stage on its own thread with a fixed
+// set of frames cycling between them: decode pulls captures from playback, transform registers color
+// to depth, points encodes the point cloud on the shared thread pool, and write puts it all on disk.
+// Several recordings are processed side by side.
+class BatchProcessor
+{
+public:
+	enum Stage
+	{
+		StageDecode = 0,
+		StageTransform = 1,
+		StagePoints = 2,
+		StageWrite = 3,
+		StageCount = 4
+	};
+
+	struct Options
+	{
+		std::string outputDirectory = ".";
+		PointCloudFileFormat format = PointCloudFileFormatPly;
+		bool includeNormals = false;
+		bool writeColor = true;
+		bool writeDepth = true;
+		bool writePointClouds = true;
+		int parallelRecordings = 2;
+		int framesInFlight = 4;
+		// Frames per recording, 0 for all of them
+		int maxFrames = 0;
+		// Runs the plugin's change detection over each recording and counts the copies and uploads it would
+		// have saved, outputs are not affected. IR is compared too when its noise threshold is not negative.
+		bool measureChanges = false;
+		int changeDepthNoise = 20;
+		int changeIRNoise = -1;
+		int changeTileThreshold = 4096;
+		int changeKeyframeInterval = 30;
+	};
+
+	// Stage times are busy time summed over recordings. Utilization is the share of its pipelines'
+	// running time a stage was busy, the bottleneck sits close to one.
+	struct Stats
+	{
+		int recordingCount;
+		int failedRecordingCount;
+		uint64_t frameCount;
+		uint64_t pointCount;
+		uint64_t writtenBytes;
+		float wallMilliseconds;
+		float framesPerSecond;
+		float stageMilliseconds[StageCount];
+		float stageUtilization[StageCount];
+		// Only counted with measureChanges, bytes are depth plus registered color
+		uint64_t unchangedFrameCount;
+		uint64_t keyframeCount;
+		uint64_t changeCopiedBytes;
+		uint64_t changeFullFrameBytes;
+		float changeDetectMilliseconds;
+	};
+
+	BatchProcessor(const Options &options);
+
+	// Returns false when any recording failed, the others are still processed
+	bool TryProcess(const std::vector<std::string> &recordingPaths);
+	Stats GetStats();
+
+	static const char *GetStageName(Stage stage);
+
+private:
+	struct Frame;
+	class FrameQueue;
+	struct RecordingStats;
+	struct ChangeReference;
+
+	bool TryProcessRecording(const std::string &recordingPath, RecordingStats &recordingStats);
+	void MeasureChanges(const Frame &frame, int width, int height, ChangeReference &reference, RecordingStats &recordingStats);
+	bool TryWriteFrame(
+		const Frame &frame,
+		const std::string &directory,
+		PointCloudExporter &exporter,
+		std::vector<uint8_t> &row,
+		uint64_t &writtenBytes);
+
+	Options options;
+	std::mutex statsMutex;
+	Stats stats;
+	double pipelineMilliseconds;
+};
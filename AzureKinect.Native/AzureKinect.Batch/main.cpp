@@ -0,0 +1,178 @@
+#include "pch.h"
+#include "BatchProcessor.h"
+
+static void print_usage()
+{
+	fprintf(stderr,
+		"Usage: AzureKinectBatch [options] <recording.mkv>...\n"
+		"\n"
+		"Writes registered color (PPM), depth (16 bit PGM) and point clouds for every frame of each\n"
+		"recording into <output>/<recording name>/.\n"
+		"\n"
+		"  -o, --output <dir>        Output directory, defaults to the current one\n"
+		"  -f, --format <ply|pcd>    Point cloud format, defaults to ply\n"
+		"  -n, --normals             Include normals in point clouds\n"
+		"  -j, --jobs <count>        Recordings processed in parallel, defaults to 2\n"
+		"      --frames-in-flight <count>\n"
+		"                            Frames per recording between stages, defaults to 4\n"
+		"      --max-frames <count>  Stop each recording after this many frames\n"
+		"      --no-color            Skip color images\n"
+		"      --no-depth            Skip depth images\n"
+		"      --no-points           Skip point clouds\n"
+		"      --change-detection    Report what the plugin's change detection would skip in each recording\n"
+		"      --change-depth-noise <mm>\n"
+		"                            Depth difference ignored per pixel, defaults to 20\n"
+		"      --change-ir-noise <level>\n"
+		"                            Compares IR too, ignoring this difference per pixel\n"
+		"      --change-tile-threshold <sum>\n"
+		"                            Summed difference that marks a tile changed, defaults to 4096\n"
+		"      --keyframe-interval <count>\n"
+		"                            Frames between full keyframes, 0 for none, defaults to 30\n");
+}
+
+static bool try_parse_count(const char *text, int &value)
+{
+	char *end = nullptr;
+	long parsed = strtol(text, &end, 10);
+	if (end == text || *end != '\0' || parsed < 0 || parsed > INT_MAX)
+	{
+		return false;
+	}
+
+	value = static_cast<int>(parsed);
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	BatchProcessor::Options options;
+	std::vector<std::string> recordingPaths;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		bool result = true;
+
+		if (arg == "-o" || arg == "--output")
+		{
+			result = hasValue;
+			options.outputDirectory = hasValue ? argv[++i] : "";
+		}
+		else if (arg == "-f" || arg == "--format")
+		{
+			std::string format = hasValue ? argv[++i] : "";
+			result = format == "ply" || format == "pcd";
+			options.format = format == "pcd" ? PointCloudFileFormatPcd : PointCloudFileFormatPly;
+		}
+		else if (arg == "-n" || arg == "--normals")
+		{
+			options.includeNormals = true;
+		}
+		else if (arg == "-j" || arg == "--jobs")
+		{
+			result = hasValue && try_parse_count(argv[++i], options.parallelRecordings);
+		}
+		else if (arg == "--frames-in-flight")
+		{
+			result = hasValue && try_parse_count(argv[++i], options.framesInFlight);
+		}
+		else if (arg == "--max-frames")
+		{
+			result = hasValue && try_parse_count(argv[++i], options.maxFrames);
+		}
+		else if (arg == "--no-color")
+		{
+			options.writeColor = false;
+		}
+		else if (arg == "--no-depth")
+		{
+			options.writeDepth = false;
+		}
+		else if (arg == "--no-points")
+		{
+			options.writePointClouds = false;
+		}
+		else if (arg == "--change-detection")
+		{
+			options.measureChanges = true;
+		}
+		else if (arg == "--change-depth-noise")
+		{
+			result = hasValue && try_parse_count(argv[++i], options.changeDepthNoise);
+		}
+		else if (arg == "--change-ir-noise")
+		{
+			result = hasValue && try_parse_count(argv[++i], options.changeIRNoise);
+		}
+		else if (arg == "--change-tile-threshold")
+		{
+			result = hasValue && try_parse_count(argv[++i], options.changeTileThreshold);
+		}
+		else if (arg == "--keyframe-interval")
+		{
+			result = hasValue && try_parse_count(argv[++i], options.changeKeyframeInterval);
+		}
+		else if (arg == "-h" || arg == "--help")
+		{
+			print_usage();
+			return 0;
+		}
+		else if (!arg.empty() && arg[0] == '-')
+		{
+			result = false;
+		}
+		else
+		{
+			recordingPaths.push_back(arg);
+		}
+
+		if (!result)
+		{
+			fprintf(stderr, "Invalid argument %s\n\n", arg.c_str());
+			print_usage();
+			return 2;
+		}
+	}
+
+	if (recordingPaths.empty())
+	{
+		print_usage();
+		return 2;
+	}
+
+	ImagePool::GetShared().TryInstallSdkAllocator();
+
+	BatchProcessor processor(options);
+	bool result = processor.TryProcess(recordingPaths);
+	BatchProcessor::Stats stats = processor.GetStats();
+
+	printf("%d recordings, %d failed\n", stats.recordingCount, stats.failedRecordingCount);
+	printf("%llu frames, %llu points, %.1f MB written\n",
+		static_cast<unsigned long long>(stats.frameCount),
+		static_cast<unsigned long long>(stats.pointCount),
+		stats.writtenBytes / 1048576.0);
+	printf("%.0f ms, %.1f frames/s\n", stats.wallMilliseconds, stats.framesPerSecond);
+	printf("\n%-10s %12s %12s\n", "stage", "busy ms", "utilization");
+	for (int stage = 0; stage < BatchProcessor::StageCount; stage++)
+	{
+		printf("%-10s %12.0f %11.0f%%\n",
+			BatchProcessor::GetStageName(static_cast<BatchProcessor::Stage>(stage)),
+			stats.stageMilliseconds[stage],
+			stats.stageUtilization[stage] * 100.0f);
+	}
+
+	if (options.measureChanges)
+	{
+		printf("\n%llu unchanged frames, %llu keyframes\n",
+			static_cast<unsigned long long>(stats.unchangedFrameCount),
+			static_cast<unsigned long long>(stats.keyframeCount));
+		printf("%.1f of %.1f MB copied, %.1f%% saved, %.2f ms detection per frame\n",
+			stats.changeCopiedBytes / 1048576.0,
+			stats.changeFullFrameBytes / 1048576.0,
+			stats.changeFullFrameBytes > 0 ? 100.0 * (1.0 - static_cast<double>(stats.changeCopiedBytes) / stats.changeFullFrameBytes) : 0.0,
+			stats.frameCount > 0 ? stats.changeDetectMilliseconds / stats.frameCount : 0.0);
+	}
+
+	return result ? 0 : 1;
+}
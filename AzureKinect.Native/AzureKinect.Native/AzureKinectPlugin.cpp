@@ -50,6 +50,9 @@ extern "C" void UNITY_INTERFACE_EXPORT __cdecl UnityPluginLoad(IUnityInterfaces
 extern "C" void UNITY_INTERFACE_EXPORT __cdecl UnityPluginUnload()
 {
     OutputDebugString(L"UnityPluginUnload Event called for AzureKinect.Unity.");
+    // Stops any device still streaming while the image and thread pools exist, as function local statics
+    // built after this global they would otherwise be destroyed before it
+    azureKinectWrapper.reset();
     s_graphics->UnregisterDeviceEventCallback(OnGraphicsDeviceEvent);
     OnGraphicsDeviceEvent(kUnityGfxDeviceEventShutdown);
     s_graphics = nullptr;
@@ -57,6 +60,20 @@ extern "C" void UNITY_INTERFACE_EXPORT __cdecl UnityPluginUnload()
     s_device = nullptr;
 }
 
+// Issued through GL.IssuePluginEvent so texture uploads happen on Unity's render thread
+static void UNITY_INTERFACE_API OnRenderEvent(int eventId)
+{
+    if (azureKinectWrapper != nullptr)
+    {
+        azureKinectWrapper->DrainUploads();
+    }
+}
+
+UNITYDLL UnityRenderingEvent GetRenderEventFunc()
+{
+    return OnRenderEvent;
+}
+
 UNITYDLL uint32_t GetDeviceCount()
 {
     return AzureKinectWrapper::GetDeviceCount();
@@ -98,6 +115,111 @@ UNITYDLL bool TryStartStreams(
     return false;
 }
 
+UNITYDLL bool TryStartStreamsAsync(
+	unsigned int index,
+	int colorFormat,
+	int colorResolution,
+	int depthMode,
+	int fps)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryStartStreamsAsync(
+			index,
+			(k4a_image_format_t) colorFormat,
+			(k4a_color_resolution_t) colorResolution,
+			(k4a_depth_mode_t) depthMode,
+			(k4a_fps_t) fps);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryReconfigureStreams(
+	unsigned int index,
+	int colorFormat,
+	int colorResolution,
+	int depthMode,
+	int fps,
+	float *reconfigureMilliseconds)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryReconfigureStreams(
+			index,
+			(k4a_image_format_t) colorFormat,
+			(k4a_color_resolution_t) colorResolution,
+			(k4a_depth_mode_t) depthMode,
+			(k4a_fps_t) fps,
+			reconfigureMilliseconds);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetReconfigureStats(
+	unsigned int index,
+	uint64_t *reconfigureCount,
+	float *lastMilliseconds,
+	float *cameraMilliseconds,
+	float *rebuildMilliseconds,
+	bool *calibrationChanged,
+	bool *resourcesRecreated)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetReconfigureStats(
+			index,
+			reconfigureCount,
+			lastMilliseconds,
+			cameraMilliseconds,
+			rebuildMilliseconds,
+			calibrationChanged,
+			resourcesRecreated);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetDeviceStartState(
+	unsigned int index,
+	int *state,
+	float *openMilliseconds,
+	float *startMilliseconds)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetDeviceStartState(index, state, openMilliseconds, startMilliseconds);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryWaitForDeviceStarts(unsigned int timeoutMilliseconds)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryWaitForDeviceStarts(timeoutMilliseconds);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetStartupStats(
+	int *deviceCount,
+	int *failedCount,
+	int *pendingCount,
+	float *wallMilliseconds,
+	float *summedMilliseconds)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetStartupStats(deviceCount, failedCount, pendingCount, wallMilliseconds, summedMilliseconds);
+	}
+
+	return false;
+}
+
 UNITYDLL bool TryUpdate()
 {
     if (azureKinectWrapper != nullptr)
@@ -190,6 +312,52 @@ UNITYDLL bool TryGetDeviceSerialNumber(uint32_t index, char *serialNum, uint32_t
     return false;
 }
 
+UNITYDLL bool TryGetDeviceInfo(unsigned int index, DeviceInfo *info)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetDeviceInfo(index, info);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetDeviceRawCalibration(
+	unsigned int index,
+	byte *data,
+	int capacity,
+	int *size)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetDeviceRawCalibration(index, data, capacity, size);
+	}
+
+	return false;
+}
+
+UNITYDLL int FindDeviceBySerialNumber(const char *serialNumber)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->FindDeviceBySerialNumber(serialNumber);
+	}
+
+	return -1;
+}
+
+UNITYDLL bool TryRefreshDeviceTable(
+	int *deviceCount,
+	float *refreshMilliseconds)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryRefreshDeviceTable(deviceCount, refreshMilliseconds);
+	}
+
+	return false;
+}
+
 UNITYDLL bool TryGetShaderResourceViews(
 	unsigned int index,
     ID3D11ShaderResourceView *&rgbSrv,
@@ -225,3 +393,1266 @@ UNITYDLL bool TryGetShaderResourceViews(
 
     return false;
 }
+
+UNITYDLL bool TryEnableSpatialIndex(unsigned int index, float cellSize, bool benchmark)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryEnableSpatialIndex(index, cellSize, benchmark);
+	}
+
+	return false;
+}
+
+UNITYDLL void DisableSpatialIndex(unsigned int index)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		azureKinectWrapper->DisableSpatialIndex(index);
+	}
+}
+
+UNITYDLL bool TryRaycastPointCloud(
+	unsigned int index,
+	float *origin,
+	float *direction,
+	float maxDistance,
+	float pickRadius,
+	float *hitPoint,
+	int *hitPixelIndex)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryRaycastPointCloud(
+			index,
+			origin,
+			direction,
+			maxDistance,
+			pickRadius,
+			hitPoint,
+			hitPixelIndex);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetNearestPoints(
+	unsigned int index,
+	float *point,
+	int k,
+	int *pixelIndices,
+	float *distances,
+	int *count)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetNearestPoints(
+			index,
+			point,
+			k,
+			pixelIndices,
+			distances,
+			count);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetPointsInRadius(
+	unsigned int index,
+	float *point,
+	float radius,
+	int *pixelIndices,
+	int capacity,
+	int *count)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetPointsInRadius(
+			index,
+			point,
+			radius,
+			pixelIndices,
+			capacity,
+			count);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetSpatialIndexStats(
+	unsigned int index,
+	int *pointCount,
+	float *cellSize,
+	float *buildMilliseconds,
+	float *queryMilliseconds,
+	float *bruteForceMilliseconds)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetSpatialIndexStats(
+			index,
+			pointCount,
+			cellSize,
+			buildMilliseconds,
+			queryMilliseconds,
+			bruteForceMilliseconds);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TrySetWorldTransform(unsigned int index, float *worldTransform)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TrySetWorldTransform(index, worldTransform);
+	}
+
+	return false;
+}
+
+UNITYDLL void ClearWorldTransform(unsigned int index)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		azureKinectWrapper->ClearWorldTransform(index);
+	}
+}
+
+UNITYDLL bool TrySetRegionOfInterest(
+	unsigned int index,
+	int x,
+	int y,
+	int width,
+	int height,
+	unsigned short minDepth,
+	unsigned short maxDepth,
+	float *boxMin,
+	float *boxMax)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TrySetRegionOfInterest(
+			index,
+			x,
+			y,
+			width,
+			height,
+			minDepth,
+			maxDepth,
+			boxMin,
+			boxMax);
+	}
+
+	return false;
+}
+
+UNITYDLL void ClearRegionOfInterest(unsigned int index)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		azureKinectWrapper->ClearRegionOfInterest(index);
+	}
+}
+
+UNITYDLL bool TryGetRegionOfInterestStats(
+	unsigned int index,
+	int *processedPixelCount,
+	int *keptPixelCount,
+	uint64_t *copiedBytes,
+	float *processMilliseconds)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetRegionOfInterestStats(
+			index,
+			processedPixelCount,
+			keptPixelCount,
+			copiedBytes,
+			processMilliseconds);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TrySetChangeDetection(
+	unsigned int index,
+	bool enabled,
+	int depthNoiseThreshold,
+	int irNoiseThreshold,
+	unsigned int tileThreshold,
+	int keyframeInterval)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TrySetChangeDetection(
+			index,
+			enabled,
+			depthNoiseThreshold,
+			irNoiseThreshold,
+			tileThreshold,
+			keyframeInterval);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetChangeMask(
+	unsigned int index,
+	byte *maskData,
+	int maskSize,
+	int *columns,
+	int *rows)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetChangeMask(index, maskData, maskSize, columns, rows);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetChangeDetectionStats(unsigned int index, ChangeDetectionStats *stats)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetChangeDetectionStats(index, stats);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TrySetOutlierFilter(
+	unsigned int index,
+	bool enabled,
+	int windowSize,
+	float sigma,
+	int mode)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TrySetOutlierFilter(index, enabled, windowSize, sigma, static_cast<OutlierFilterMode>(mode));
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetOutlierMask(
+	unsigned int index,
+	byte *maskData,
+	int maskSize,
+	int *width,
+	int *height)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetOutlierMask(index, maskData, maskSize, width, height);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetOutlierFilterStats(unsigned int index, OutlierFilterStats *stats)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetOutlierFilterStats(index, stats);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryStartSharedFrames(
+	unsigned int index,
+	const char *name,
+	int slotCount,
+	bool includeIR)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryStartSharedFrames(index, name, slotCount, includeIR);
+	}
+
+	return false;
+}
+
+UNITYDLL void StopSharedFrames(unsigned int index)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		azureKinectWrapper->StopSharedFrames(index);
+	}
+}
+
+UNITYDLL bool TryGetSharedFrameName(unsigned int index, char *name, unsigned int nameSize)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetSharedFrameName(index, name, nameSize);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetSharedFrameStats(unsigned int index, SharedFrameStats *stats)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetSharedFrameStats(index, stats);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryStartFrameServer(
+	unsigned int index,
+	int port,
+	int colorQuality,
+	int depthErrorMillimeters,
+	float maxFramesPerSecond,
+	int *boundPort)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryStartFrameServer(index, port, colorQuality, depthErrorMillimeters, maxFramesPerSecond, boundPort);
+	}
+
+	return false;
+}
+
+UNITYDLL void StopFrameServer(unsigned int index)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		azureKinectWrapper->StopFrameServer(index);
+	}
+}
+
+UNITYDLL bool TryGetFrameServerStats(unsigned int index, FrameServerStats *stats)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetFrameServerStats(index, stats);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryConnectFrameClient(const char *host, int port, uint64_t *clientId)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryConnectFrameClient(host, port, clientId);
+	}
+
+	return false;
+}
+
+UNITYDLL void DisconnectFrameClient(uint64_t clientId)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		azureKinectWrapper->DisconnectFrameClient(clientId);
+	}
+}
+
+UNITYDLL bool TryGetFrameClientFrame(
+	uint64_t clientId,
+	uint64_t *sequence,
+	FrameClientFrameInfo *info,
+	uint16_t *depthData,
+	byte *colorData,
+	int pixelCapacity)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetFrameClientFrame(clientId, sequence, info, depthData, colorData, pixelCapacity);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetFrameClientStats(uint64_t clientId, FrameClientStats *stats)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetFrameClientStats(clientId, stats);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryFusePointClouds(
+	float voxelSize,
+	float *positions,
+	unsigned int *colors,
+	int capacity,
+	int *count)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryFusePointClouds(
+			voxelSize,
+			positions,
+			colors,
+			capacity,
+			count);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetFusionStats(
+	int *deviceCount,
+	int *inputPointCount,
+	int *fusedPointCount,
+	float *transformMilliseconds,
+	float *mergeMilliseconds)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetFusionStats(
+			deviceCount,
+			inputPointCount,
+			fusedPointCount,
+			transformMilliseconds,
+			mergeMilliseconds);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryExportPointCloud(
+	unsigned int index,
+	const char *path,
+	int format,
+	bool includeNormals,
+	int *pointCount)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryExportPointCloud(
+			index,
+			path,
+			static_cast<PointCloudFileFormat>(format),
+			includeNormals,
+			pointCount);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryConvertRecording(
+	const char *recordingPath,
+	const char *outputDirectory,
+	int format,
+	bool includeNormals,
+	int *frameCount)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryConvertRecording(
+			recordingPath,
+			outputDirectory,
+			static_cast<PointCloudFileFormat>(format),
+			includeNormals,
+			frameCount);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetExportStats(
+	int *frameCount,
+	int *pointCount,
+	uint64_t *writtenBytes,
+	float *encodeMilliseconds,
+	float *writeMilliseconds,
+	float *megabytesPerSecond)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetExportStats(
+			frameCount,
+			pointCount,
+			writtenBytes,
+			encodeMilliseconds,
+			writeMilliseconds,
+			megabytesPerSecond);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryCreateTsdfVolume(unsigned int index, float voxelSize, float truncationDistance)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryCreateTsdfVolume(index, voxelSize, truncationDistance);
+	}
+
+	return false;
+}
+
+UNITYDLL void DestroyTsdfVolume(unsigned int index)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		azureKinectWrapper->DestroyTsdfVolume(index);
+	}
+}
+
+UNITYDLL bool TryIntegrateTsdfVolume(unsigned int index, float *cameraToWorld)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryIntegrateTsdfVolume(index, cameraToWorld);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryRaycastTsdfVolume(
+	unsigned int index,
+	float *cameraToWorld,
+	float *points,
+	int pointCapacity,
+	int *width,
+	int *height,
+	int *hitCount)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryRaycastTsdfVolume(
+			index,
+			cameraToWorld,
+			points,
+			pointCapacity,
+			width,
+			height,
+			hitCount);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetTsdfVolumeStats(
+	unsigned int index,
+	int *frameCount,
+	int *blockCount,
+	int *integratedBlockCount,
+	float *allocationMilliseconds,
+	float *integrationMilliseconds,
+	float *raycastMilliseconds)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetTsdfVolumeStats(
+			index,
+			frameCount,
+			blockCount,
+			integratedBlockCount,
+			allocationMilliseconds,
+			integrationMilliseconds,
+			raycastMilliseconds);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryStartImu(unsigned int index)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryStartImu(index);
+	}
+
+	return false;
+}
+
+UNITYDLL void StopImu(unsigned int index)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		azureKinectWrapper->StopImu(index);
+	}
+}
+
+UNITYDLL bool TryGetImuSamples(
+	unsigned int index,
+	uint64_t cursor,
+	k4a_imu_sample_t *samples,
+	int capacity,
+	int *count,
+	uint64_t *nextCursor,
+	uint64_t *depthTimestampUsec)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetImuSamples(
+			index,
+			cursor,
+			samples,
+			capacity,
+			count,
+			nextCursor,
+			depthTimestampUsec);
+	}
+
+	return false;
+}
+
+UNITYDLL void SubscribeIR(unsigned int index)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		azureKinectWrapper->SubscribeIR(index);
+	}
+}
+
+UNITYDLL void UnsubscribeIR(unsigned int index)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		azureKinectWrapper->UnsubscribeIR(index);
+	}
+}
+
+UNITYDLL bool TryGetIRShaderResourceView(
+	unsigned int index,
+	ID3D11ShaderResourceView *&irSrv,
+	unsigned int &irWidth,
+	unsigned int &irHeight,
+	unsigned int &irBpp)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetIRShaderResourceView(
+			index,
+			irSrv,
+			irWidth,
+			irHeight,
+			irBpp);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetIRImageBuffer(
+	unsigned int index,
+	byte *irImageData,
+	int irImageSize)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetIRImageBuffer(index, irImageData, irImageSize);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetToneMappedIRImage(
+	unsigned int index,
+	byte *toneMappedImageData,
+	int toneMappedImageSize,
+	int minValue,
+	int maxValue)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetToneMappedIRImage(
+			index,
+			toneMappedImageData,
+			toneMappedImageSize,
+			minValue,
+			maxValue);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryLeaseIRImage(
+	unsigned int index,
+	byte **irImageData,
+	int *width,
+	int *height,
+	int *stride,
+	uint64_t *leaseId)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryLeaseIRImage(
+			index,
+			irImageData,
+			width,
+			height,
+			stride,
+			leaseId);
+	}
+
+	return false;
+}
+
+UNITYDLL void ReleaseIRImageLease(uint64_t leaseId)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		azureKinectWrapper->ReleaseIRImageLease(leaseId);
+	}
+}
+
+UNITYDLL bool TrySetDeliveryPolicy(
+	unsigned int index,
+	int policy,
+	int queueCapacity)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TrySetDeliveryPolicy(
+			index,
+			static_cast<DeliveryPolicy>(policy),
+			queueCapacity);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetDeliveryStats(
+	unsigned int index,
+	int *policy,
+	int *queueCapacity,
+	int *queueDepth,
+	int *maxQueueDepth,
+	uint64_t *deliveredCount,
+	uint64_t *droppedCount,
+	float *lastAgeMilliseconds,
+	float *maxAgeMilliseconds,
+	float *averageAgeMilliseconds)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetDeliveryStats(
+			index,
+			policy,
+			queueCapacity,
+			queueDepth,
+			maxQueueDepth,
+			deliveredCount,
+			droppedCount,
+			lastAgeMilliseconds,
+			maxAgeMilliseconds,
+			averageAgeMilliseconds);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetDeviceMemoryStats(
+	unsigned int index,
+	DeviceMemoryStats *stats)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetDeviceMemoryStats(index, stats);
+	}
+
+	return false;
+}
+
+UNITYDLL uint64_t TrimMemory()
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TrimMemory();
+	}
+
+	return 0;
+}
+
+UNITYDLL bool TryGetAllocationStats(
+	uint64_t *acquireCount,
+	uint64_t *heapAllocationCount,
+	uint64_t *heapAllocatedBytes,
+	uint64_t *outstandingCount,
+	uint64_t *outstandingBytes,
+	uint64_t *pooledBytes)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetAllocationStats(
+			acquireCount,
+			heapAllocationCount,
+			heapAllocatedBytes,
+			outstandingCount,
+			outstandingBytes,
+			pooledBytes);
+	}
+
+	return false;
+}
+
+UNITYDLL int UpdateAndGetFrameDescriptors(
+	FrameDescriptor *descriptors,
+	int capacity,
+	int descriptorSize)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->UpdateAndGetFrameDescriptors(descriptors, capacity, descriptorSize);
+	}
+
+	return 0;
+}
+
+UNITYDLL bool TryGetCalibrationBlob(
+	unsigned int index,
+	CalibrationBlob *blob)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetCalibrationBlob(index, blob);
+	}
+
+	return false;
+}
+
+UNITYDLL void SubscribePyramidLevel(unsigned int index, int level)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		azureKinectWrapper->SubscribePyramidLevel(index, level);
+	}
+}
+
+UNITYDLL void UnsubscribePyramidLevel(unsigned int index, int level)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		azureKinectWrapper->UnsubscribePyramidLevel(index, level);
+	}
+}
+
+UNITYDLL bool TrySetPyramidDepthFilter(unsigned int index, int filter)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TrySetPyramidDepthFilter(index, static_cast<PyramidDepthFilter>(filter));
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetPyramidShaderResourceViews(
+	unsigned int index,
+	int level,
+	ID3D11ShaderResourceView *&rgbSrv,
+	unsigned int &rgbWidth,
+	unsigned int &rgbHeight,
+	ID3D11ShaderResourceView *&depthSrv,
+	unsigned int &depthWidth,
+	unsigned int &depthHeight)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetPyramidShaderResourceViews(
+			index,
+			level,
+			rgbSrv,
+			rgbWidth,
+			rgbHeight,
+			depthSrv,
+			depthWidth,
+			depthHeight);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetPyramidImageBuffers(
+	unsigned int index,
+	int level,
+	byte *colorImageData,
+	int colorImageSize,
+	byte *depthImageData,
+	int depthImageSize)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetPyramidImageBuffers(
+			index,
+			level,
+			colorImageData,
+			colorImageSize,
+			depthImageData,
+			depthImageSize);
+	}
+
+	return false;
+}
+
+UNITYDLL void SubscribeUndistortedStream(unsigned int index, int stream)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		azureKinectWrapper->SubscribeUndistortedStream(index, static_cast<UndistortedStream>(stream));
+	}
+}
+
+UNITYDLL void UnsubscribeUndistortedStream(unsigned int index, int stream)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		azureKinectWrapper->UnsubscribeUndistortedStream(index, static_cast<UndistortedStream>(stream));
+	}
+}
+
+UNITYDLL bool TrySetUndistortInterpolation(unsigned int index, int interpolation)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TrySetUndistortInterpolation(index, static_cast<interpolation_t>(interpolation));
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetUndistortedPinhole(
+	unsigned int index,
+	float *fx,
+	float *fy,
+	float *px,
+	float *py,
+	int *width,
+	int *height)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetUndistortedPinhole(index, fx, fy, px, py, width, height);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetUndistortedShaderResourceViews(
+	unsigned int index,
+	ID3D11ShaderResourceView *&depthSrv,
+	unsigned int &depthWidth,
+	unsigned int &depthHeight,
+	ID3D11ShaderResourceView *&irSrv,
+	unsigned int &irWidth,
+	unsigned int &irHeight)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetUndistortedShaderResourceViews(
+			index,
+			depthSrv,
+			depthWidth,
+			depthHeight,
+			irSrv,
+			irWidth,
+			irHeight);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetUndistortedImageBuffers(
+	unsigned int index,
+	byte *depthImageData,
+	int depthImageSize,
+	byte *irImageData,
+	int irImageSize)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetUndistortedImageBuffers(
+			index,
+			depthImageData,
+			depthImageSize,
+			irImageData,
+			irImageSize);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetUndistortStats(
+	unsigned int index,
+	int *interpolation,
+	uint64_t *lutBytes,
+	float *lutMilliseconds,
+	float *depthRemapMilliseconds,
+	float *irRemapMilliseconds)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetUndistortStats(
+			index,
+			interpolation,
+			lutBytes,
+			lutMilliseconds,
+			depthRemapMilliseconds,
+			irRemapMilliseconds);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryBenchmarkUndistort(
+	unsigned int index,
+	int iterations,
+	float *nearestNeighborMilliseconds,
+	float *bilinearMilliseconds,
+	float *bilinearDepthMilliseconds)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryBenchmarkUndistort(
+			index,
+			iterations,
+			nearestNeighborMilliseconds,
+			bilinearMilliseconds,
+			bilinearDepthMilliseconds);
+	}
+
+	return false;
+}
+
+UNITYDLL void SubscribeColorUvMap(unsigned int index)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		azureKinectWrapper->SubscribeColorUvMap(index);
+	}
+}
+
+UNITYDLL void UnsubscribeColorUvMap(unsigned int index)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		azureKinectWrapper->UnsubscribeColorUvMap(index);
+	}
+}
+
+UNITYDLL bool TrySetColorUvFormat(unsigned int index, int format, float occlusionTolerance)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TrySetColorUvFormat(index, static_cast<ColorUvFormat>(format), occlusionTolerance);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TrySetRegistrationEnabled(unsigned int index, bool enabled)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TrySetRegistrationEnabled(index, enabled);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetColorUvShaderResourceViews(
+	unsigned int index,
+	ID3D11ShaderResourceView *&colorSrv,
+	unsigned int &colorWidth,
+	unsigned int &colorHeight,
+	ID3D11ShaderResourceView *&uvSrv,
+	ID3D11ShaderResourceView *&flagsSrv,
+	unsigned int &uvWidth,
+	unsigned int &uvHeight)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetColorUvShaderResourceViews(
+			index,
+			colorSrv,
+			colorWidth,
+			colorHeight,
+			uvSrv,
+			flagsSrv,
+			uvWidth,
+			uvHeight);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetColorUvImageBuffers(
+	unsigned int index,
+	byte *uvImageData,
+	int uvImageSize,
+	byte *flagsImageData,
+	int flagsImageSize)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetColorUvImageBuffers(
+			index,
+			uvImageData,
+			uvImageSize,
+			flagsImageData,
+			flagsImageSize);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetColorUvStats(
+	unsigned int index,
+	int *validPixelCount,
+	int *occludedPixelCount,
+	float *projectMilliseconds,
+	uint64_t *uploadBytes,
+	float *registrationMilliseconds,
+	uint64_t *registrationUploadBytes)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetColorUvStats(
+			index,
+			validPixelCount,
+			occludedPixelCount,
+			projectMilliseconds,
+			uploadBytes,
+			registrationMilliseconds,
+			registrationUploadBytes);
+	}
+
+	return false;
+}
+
+UNITYDLL void SetRenderThreadUploads(bool enabled)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		azureKinectWrapper->SetRenderThreadUploads(enabled);
+	}
+}
+
+UNITYDLL bool TryGetUploadStats(
+	int *targetCount,
+	uint64_t *submittedCount,
+	uint64_t *uploadedCount,
+	uint64_t *coalescedCount,
+	uint64_t *uploadedBytes)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetUploadStats(
+			targetCount,
+			submittedCount,
+			uploadedCount,
+			coalescedCount,
+			uploadedBytes);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetFrameSequence(
+	unsigned int index,
+	uint64_t *sequence)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetFrameSequence(index, sequence);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryWaitForFrame(
+	unsigned int index,
+	uint64_t afterSequence,
+	unsigned int timeoutMilliseconds,
+	uint64_t *sequence)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryWaitForFrame(index, afterSequence, timeoutMilliseconds, sequence);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TrySetFrameCallback(
+	unsigned int index,
+	FrameCallback callback,
+	void *context)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TrySetFrameCallback(index, callback, context);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetFrameTimestamps(
+	unsigned int index,
+	FrameTimestamps *timestamps)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetFrameTimestamps(index, timestamps);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetClockMapping(
+	unsigned int index,
+	bool *hasFit,
+	int *sampleCount,
+	int *inlierCount,
+	int64_t *offsetMicroseconds,
+	double *driftPpm,
+	float *residualMicroseconds)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetClockMapping(
+			index,
+			hasFit,
+			sampleCount,
+			inlierCount,
+			offsetMicroseconds,
+			driftPpm,
+			residualMicroseconds);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryMapDeviceTimestamp(
+	unsigned int index,
+	uint64_t deviceTimestampUsec,
+	uint64_t *hostTimestampNsec)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryMapDeviceTimestamp(index, deviceTimestampUsec, hostTimestampNsec);
+	}
+
+	return false;
+}
+
+UNITYDLL bool TryGetLatencyStats(
+	unsigned int index,
+	uint64_t *frameCount,
+	float *lastMilliseconds,
+	float *averageMilliseconds,
+	float *maxMilliseconds)
+{
+	if (azureKinectWrapper != nullptr)
+	{
+		return azureKinectWrapper->TryGetLatencyStats(index, frameCount, lastMilliseconds, averageMilliseconds, maxMilliseconds);
+	}
+
+	return false;
+}
@@ -1,20 +1,67 @@
 #include "pch.h"
 #include "AzureKinectWrapper.h"
 #include "k4a/k4a.h"
+#include <wchar.h>
 
 std::shared_ptr<AzureKinectWrapper> AzureKinectWrapper::instance = nullptr;
 
-AzureKinectWrapper::AzureKinectWrapper(ID3D11Device *device)
+// Debug output with the device index appended as a number
+static void output_device_message(const wchar_t *message, unsigned int index)
 {
-    InitializeCriticalSection(&resourcesCritSec);
+	wchar_t formatted[256];
+	swprintf(formatted, sizeof(formatted) / sizeof(formatted[0]), L"%ls%u", message, index);
+	OutputDebugString(formatted);
+}
+
+AzureKinectWrapper::AzureKinectWrapper(ID3D11Device *device) :
+	AzureKinectWrapper(device, nullptr)
+{
+}
+
+AzureKinectWrapper::AzureKinectWrapper(ID3D11Device *device, std::unique_ptr<TextureUploadBackend> uploadBackend)
+{
+	for (auto &slot : deviceSlots)
+	{
+		InitializeCriticalSection(&slot.slotCritSec);
+		InitializeConditionVariable(&slot.frameAvailable);
+	}
+	InitializeCriticalSection(&irCritSec);
+	InitializeCriticalSection(&frameClientCritSec);
+	InitializeCriticalSection(&startCritSec);
+	InitializeConditionVariable(&startCompletedCondition);
     this->d3d11Device = device;
+
+	if (uploadBackend == nullptr &&
+		device != nullptr)
+	{
+		uploadBackend = std::make_unique<D3D11UploadBackend>(device);
+	}
+	else if (uploadBackend == nullptr)
+	{
+		uploadBackend = std::make_unique<CountingUploadBackend>();
+	}
+	uploadQueue = std::make_unique<TextureUploadQueue>(std::move(uploadBackend));
+
+	// Only possible while the sdk has nothing allocated, otherwise it keeps its default allocator
+	ImagePool::GetShared().TryInstallSdkAllocator();
 }
 
 AzureKinectWrapper::~AzureKinectWrapper()
 {
-    DeleteCriticalSection(&resourcesCritSec);
 	this->d3d11Device = nullptr;
 	StopStreamingAll();
+	for (auto &slot : deviceSlots)
+	{
+		slot.frameServer = nullptr;
+	}
+	frameClientMap.clear();
+	DeleteCriticalSection(&startCritSec);
+	DeleteCriticalSection(&frameClientCritSec);
+	DeleteCriticalSection(&irCritSec);
+	for (auto &slot : deviceSlots)
+	{
+		DeleteCriticalSection(&slot.slotCritSec);
+	}
 }
 
 unsigned int AzureKinectWrapper::GetDeviceCount()
@@ -24,41 +71,134 @@ unsigned int AzureKinectWrapper::GetDeviceCount()
 
 bool AzureKinectWrapper::TryGetDeviceSerialNumber(unsigned int index, char *serialNum, unsigned int serialNumSize)
 {
-    uint32_t device_count = k4a_device_get_installed_count();
-    if (index > device_count - 1)
-    {
-        return false;
-    }
+	if (serialNum == nullptr)
+	{
+		return false;
+	}
 
-    k4a_device_t device = NULL;
-    bool closeDevice = false;
-    if (deviceMap.count(index) > 0)
-    {
-        device = deviceMap[index];
-    }
-    else if (K4A_RESULT_SUCCEEDED == k4a_device_open(index, &device))
-    {
-        closeDevice = true;
-    }
-    else
-    {
-        k4a_device_close(device);
-        return false;
-    }
+	// Served from the device table, devices are only opened the first time it is read
+	EnsureDeviceTable(false);
+	DeviceTable::Entry entry;
+	if (!deviceTable.TryGetEntry(index, entry) ||
+		entry.serialNumber.size() + 1 > serialNumSize)
+	{
+		return false;
+	}
 
-    size_t serialNumLength = 0;
-    if (K4A_BUFFER_RESULT_TOO_SMALL != k4a_device_get_serialnum(device, serialNum, &serialNumLength) ||
-        serialNumLength > serialNumSize)
-    {
-        return false;
-    }
+	memcpy(serialNum, entry.serialNumber.c_str(), entry.serialNumber.size() + 1);
+	return true;
+}
 
-    if (closeDevice)
-    {
-        k4a_device_close(device);
-    }
-    device = NULL;
-    return true;
+bool AzureKinectWrapper::TryGetDeviceInfo(
+	unsigned int index,
+	DeviceInfo *info)
+{
+	if (info == nullptr)
+	{
+		return false;
+	}
+
+	EnsureDeviceTable(false);
+	DeviceTable::Entry entry;
+	if (!deviceTable.TryGetEntry(index, entry))
+	{
+		return false;
+	}
+
+	auto copyVersion = [](const k4a_version_t &version, uint32_t *target)
+	{
+		target[0] = version.major;
+		target[1] = version.minor;
+		target[2] = version.iteration;
+	};
+
+	*info = {};
+	info->index = index;
+	memcpy(info->serialNumber, entry.serialNumber.c_str(), min(entry.serialNumber.size(), sizeof(info->serialNumber) - 1));
+	copyVersion(entry.version.rgb, info->colorFirmwareVersion);
+	copyVersion(entry.version.depth, info->depthFirmwareVersion);
+	copyVersion(entry.version.audio, info->audioFirmwareVersion);
+	copyVersion(entry.version.depth_sensor, info->depthSensorVersion);
+	info->firmwareBuild = static_cast<int32_t>(entry.version.firmware_build);
+	info->firmwareSignature = static_cast<int32_t>(entry.version.firmware_signature);
+	info->rawCalibrationSize = static_cast<uint32_t>(entry.rawCalibration.size());
+	return true;
+}
+
+bool AzureKinectWrapper::TryGetDeviceRawCalibration(
+	unsigned int index,
+	byte *data,
+	int capacity,
+	int *size)
+{
+	if (size == nullptr)
+	{
+		return false;
+	}
+
+	EnsureDeviceTable(false);
+	DeviceTable::Entry entry;
+	if (!deviceTable.TryGetEntry(index, entry))
+	{
+		return false;
+	}
+
+	// The size is reported either way, so callers can ask with a null buffer first
+	*size = static_cast<int>(entry.rawCalibration.size());
+	if (data == nullptr ||
+		capacity < *size)
+	{
+		return false;
+	}
+
+	memcpy(data, entry.rawCalibration.data(), entry.rawCalibration.size());
+	return true;
+}
+
+int AzureKinectWrapper::FindDeviceBySerialNumber(const char *serialNumber)
+{
+	if (serialNumber == nullptr)
+	{
+		return -1;
+	}
+
+	EnsureDeviceTable(false);
+	return deviceTable.FindSerialNumber(serialNumber);
+}
+
+bool AzureKinectWrapper::TryRefreshDeviceTable(
+	int *deviceCount,
+	float *refreshMilliseconds)
+{
+	EnsureDeviceTable(true);
+	DeviceTable::Stats stats = deviceTable.GetStats();
+	if (deviceCount != nullptr)
+	{
+		*deviceCount = stats.validCount;
+	}
+	if (refreshMilliseconds != nullptr)
+	{
+		*refreshMilliseconds = stats.refreshMilliseconds;
+	}
+	return stats.validCount == stats.deviceCount;
+}
+
+void AzureKinectWrapper::EnsureDeviceTable(bool force)
+{
+	if (!force && deviceTable.IsCurrent())
+	{
+		return;
+	}
+
+	// Devices being started can't be opened for reading, they fill their own entries once open
+	CompleteDeviceStarts(true);
+
+	std::vector<k4a_device_t> openDevices(MaxDeviceCount);
+	for (unsigned int index = 0; index < MaxDeviceCount; index++)
+	{
+		openDevices[index] = deviceSlots[index].device;
+	}
+	deviceTable.Refresh(openDevices);
 }
 
 bool AzureKinectWrapper::TryGetShaderResourceViews(
@@ -76,30 +216,37 @@ bool AzureKinectWrapper::TryGetShaderResourceViews(
 	unsigned int &pointCloudTemplateHeight,
 	unsigned int &pointCloudTemplateBpp)
 {
-    EnterCriticalSection(&resourcesCritSec);
-    if (resourcesMap.count(index) == 0)
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return false;
+	}
+
+    EnterCriticalSection(&slot->slotCritSec);
+    if (!slot->hasResources)
     {
-        LeaveCriticalSection(&resourcesCritSec);
+        LeaveCriticalSection(&slot->slotCritSec);
         OutputDebugString(L"Resources not created for device: " + index);
         return false;
     }
 
-    rgbSrv = resourcesMap[index].rgbSrv;
-    rgbWidth = resourcesMap[index].rgbFrameDimensions.width;
-    rgbHeight = resourcesMap[index].rgbFrameDimensions.height;
-    rgbBpp = resourcesMap[index].rgbFrameDimensions.bpp;
+	const DeviceResources &resources = slot->resources;
+    rgbSrv = resources.rgbSrv;
+    rgbWidth = resources.rgbFrameDimensions.width;
+    rgbHeight = resources.rgbFrameDimensions.height;
+    rgbBpp = resources.rgbFrameDimensions.bpp;
 
-    depthSrv = resourcesMap[index].depthSrv;
-    depthWidth = resourcesMap[index].depthFrameDimensions.width;
-    depthHeight = resourcesMap[index].depthFrameDimensions.height;
-    depthBpp = resourcesMap[index].depthFrameDimensions.bpp;
+    depthSrv = resources.depthSrv;
+    depthWidth = resources.depthFrameDimensions.width;
+    depthHeight = resources.depthFrameDimensions.height;
+    depthBpp = resources.depthFrameDimensions.bpp;
 
-	pointCloudTemplateSrv = resourcesMap[index].pointCloudTemplateSrv;
-	pointCloudTemplateWidth = resourcesMap[index].pointCloudTemplateFrameDimensions.width;
-	pointCloudTemplateHeight = resourcesMap[index].pointCloudTemplateFrameDimensions.height;
-	pointCloudTemplateBpp = resourcesMap[index].pointCloudTemplateFrameDimensions.bpp;
+	pointCloudTemplateSrv = resources.pointCloudTemplateSrv;
+	pointCloudTemplateWidth = resources.pointCloudTemplateFrameDimensions.width;
+	pointCloudTemplateHeight = resources.pointCloudTemplateFrameDimensions.height;
+	pointCloudTemplateBpp = resources.pointCloudTemplateFrameDimensions.bpp;
 
-    LeaveCriticalSection(&resourcesCritSec);
+    LeaveCriticalSection(&slot->slotCritSec);
     return true;
 }
 
@@ -110,448 +257,4451 @@ bool AzureKinectWrapper::TryStartStreams(
 	k4a_depth_mode_t depthMode,
 	k4a_fps_t fps)
 {
-	if (deviceMap.count(index) > 0)
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
 	{
-		return true;
+		output_device_message(L"Provided index exceeds the supported device count: ", index);
+		return false;
 	}
 
-	k4a_device_t k4aDevice = NULL;
-	k4a_result_t result = K4A_RESULT_SUCCEEDED;
-	k4a_calibration_t calibration;
-	k4a_transformation_t transformation;
-	k4a_image_t transformedColorImage;
-	k4a_image_t xyTableImage;
-	int rgbSize = 0;
-	int depthSize = 0;
-	int pointCloudSize = 0;
+	// An asynchronous start of the same device is waited for rather than raced
+	if (slot->startThread.joinable())
+	{
+		FinishDeviceStart(index, true);
+	}
 
-	if (static_cast<unsigned int>(index) > GetDeviceCount() - 1)
+	if (slot->device != nullptr)
 	{
-		OutputDebugString(L"Provided index did not exist: " + index);
-		goto FailedExit;
+		return true;
 	}
 
-	if (K4A_RESULT_SUCCEEDED != k4a_device_open(index, &k4aDevice))
+	if (index >= GetDeviceCount())
 	{
-		OutputDebugString(L"Failed to open device: " + index);
-		goto FailedExit;
+		output_device_message(L"Provided index did not exist: ", index);
+		return false;
 	}
 
 	// Not all of the modes support 30fps, view k4a.c to determine a valid configuration
-	config.color_format = colorFormat; // K4A_IMAGE_FORMAT_COLOR_BGRA32;
-	config.color_resolution = colorResolution; // K4A_COLOR_RESOLUTION_2160P;
-	config.depth_mode = depthMode; // K4A_DEPTH_MODE_WFOV_2X2BINNED;
-	config.camera_fps = fps; // K4A_FRAMES_PER_SECOND_30;
+	k4a_device_configuration_t configuration = K4A_DEVICE_CONFIG_INIT_DISABLE_ALL;
+	configuration.color_format = colorFormat; // K4A_IMAGE_FORMAT_COLOR_BGRA32;
+	configuration.color_resolution = colorResolution; // K4A_COLOR_RESOLUTION_2160P;
+	configuration.depth_mode = depthMode; // K4A_DEPTH_MODE_WFOV_2X2BINNED;
+	configuration.camera_fps = fps; // K4A_FRAMES_PER_SECOND_30;
+
+	auto start = TimingHelper::GetTimestampMicroseconds();
+	OpenedDevice opened;
+	bool result = TryOpenDevice(index, configuration, opened);
+	slot->openMilliseconds = opened.openMilliseconds;
+	result = result && TryPublishDevice(index, opened);
+	slot->startState = result ? DeviceStartStateStarted : DeviceStartStateFailed;
+	slot->startMilliseconds = TimingHelper::GetElapsedMilliseconds(start);
+	return result;
+}
 
-	if (K4A_RESULT_SUCCEEDED != k4a_device_start_cameras(k4aDevice, &config))
+bool AzureKinectWrapper::TryStartStreamsAsync(
+	unsigned int index,
+	k4a_image_format_t colorFormat,
+	k4a_color_resolution_t colorResolution,
+	k4a_depth_mode_t depthMode,
+	k4a_fps_t fps)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
 	{
-		OutputDebugString(L"Failed to start cameras: " + index);
-		goto FailedExit;
+		output_device_message(L"Provided index exceeds the supported device count: ", index);
+		return false;
 	}
 
-	deviceMap[index] = k4aDevice;
-
-	k4a_device_get_calibration(k4aDevice, config.depth_mode, config.color_resolution, &calibration);
-	calibrationMap[index] = calibration;
-	transformation = k4a_transformation_create(&calibration);
-	transformationMap[index] = transformation;
+	if (slot->device != nullptr ||
+		slot->startThread.joinable())
+	{
+		return true;
+	}
 
-	k4a_image_create(K4A_IMAGE_FORMAT_COLOR_BGRA32,
-		calibration.depth_camera_calibration.resolution_width,
-		calibration.depth_camera_calibration.resolution_height,
-		calibration.depth_camera_calibration.resolution_width * 4 * (int)sizeof(uint8_t),
-		&transformedColorImage);
-	transformedColorMap[index] = transformedColorImage;
+	if (index >= GetDeviceCount())
+	{
+		output_device_message(L"Provided index did not exist: ", index);
+		return false;
+	}
 
-	k4a_image_create(K4A_IMAGE_FORMAT_CUSTOM,
-		calibration.depth_camera_calibration.resolution_width,
-		calibration.depth_camera_calibration.resolution_height,
-		calibration.depth_camera_calibration.resolution_width * (int)sizeof(k4a_float3_t),
-		&xyTableImage);
-	create_xy_table(&calibration, xyTableImage);
-	xyTableMap[index] = xyTableImage;
+	k4a_device_configuration_t configuration = K4A_DEVICE_CONFIG_INIT_DISABLE_ALL;
+	configuration.color_format = colorFormat;
+	configuration.color_resolution = colorResolution;
+	configuration.depth_mode = depthMode;
+	configuration.camera_fps = fps;
 
-	resourcesMap[index] = DeviceResources
+	// Starts launched while others are in flight are measured together
+	auto now = TimingHelper::GetTimestampMicroseconds();
+	if (startupStats.pendingCount == 0)
 	{
-		nullptr,
-		nullptr,
-		FrameDimensions{
-			static_cast<unsigned int>(calibration.depth_camera_calibration.resolution_width),
-			static_cast<unsigned int>(calibration.depth_camera_calibration.resolution_height),
-			static_cast<unsigned int>(4 * sizeof(uint8_t))},
-		nullptr,
-		nullptr,
-		FrameDimensions{
-			static_cast<unsigned int>(calibration.depth_camera_calibration.resolution_width),
-			static_cast<unsigned int>(calibration.depth_camera_calibration.resolution_height),
-			static_cast<unsigned int>(sizeof(uint16_t))},
-		nullptr,
-		nullptr,
-		FrameDimensions{
-			static_cast<unsigned int>(calibration.depth_camera_calibration.resolution_width),
-			static_cast<unsigned int>(calibration.depth_camera_calibration.resolution_height),
-			static_cast<unsigned int>(4 * sizeof(float))} };
+		startupStats = {};
+		startupStats.startTimestamp = now;
+	}
+	startupStats.deviceCount++;
+	startupStats.pendingCount++;
 
-	cachedTransformedColorImageBufferMap[index] = std::make_shared<ImageBuffer>(resourcesMap[index].rgbFrameDimensions);
-	cachedDepthImageBufferMap[index] = std::make_shared<ImageBuffer>(resourcesMap[index].depthFrameDimensions);
-	cachedPointCloudTemplateImageBufferMap[index] = std::make_shared<ImageBuffer>(resourcesMap[index].pointCloudTemplateFrameDimensions);
+	slot->startState = DeviceStartStateStarting;
+	slot->startTimestamp = now;
+	slot->openMilliseconds = 0.0f;
+	slot->startMilliseconds = 0.0f;
+	slot->startCompleted = false;
+	slot->startThread = std::thread([this, index, configuration, slot]()
+	{
+		TryOpenDevice(index, configuration, slot->openedDevice);
 
+		EnterCriticalSection(&startCritSec);
+		slot->startCompleted = true;
+		LeaveCriticalSection(&startCritSec);
+		WakeAllConditionVariable(&startCompletedCondition);
+	});
 	return true;
+}
+
+bool AzureKinectWrapper::TryOpenDevice(
+	unsigned int index,
+	const k4a_device_configuration_t &configuration,
+	OpenedDevice &opened)
+{
+	auto start = TimingHelper::GetTimestampMicroseconds();
+	opened = OpenedDevice{};
+
+	k4a_device_t k4aDevice = nullptr;
+	if (K4A_RESULT_SUCCEEDED != k4a_device_open(index, &k4aDevice))
+	{
+		output_device_message(L"Failed to open device: ", index);
+		return false;
+	}
 
-FailedExit:
-	if (k4aDevice != NULL)
+	if (K4A_RESULT_SUCCEEDED != k4a_device_start_cameras(k4aDevice, &configuration))
 	{
+		output_device_message(L"Failed to start cameras: ", index);
 		k4a_device_close(k4aDevice);
+		return false;
 	}
-	return false;
+
+	// The table is filled through this handle, so it never has to open the device for it later
+	deviceTable.Update(index, k4aDevice);
+
+	opened.device = k4aDevice;
+	opened.configuration = configuration;
+	k4a_device_get_calibration(k4aDevice, configuration.depth_mode, configuration.color_resolution, &opened.calibration);
+	opened.transformation = k4a_transformation_create(&opened.calibration);
+
+	const k4a_calibration_camera_t &depthCamera = opened.calibration.depth_camera_calibration;
+	ImagePool::GetShared().TryCreateImage(K4A_IMAGE_FORMAT_COLOR_BGRA32,
+		depthCamera.resolution_width,
+		depthCamera.resolution_height,
+		depthCamera.resolution_width * 4 * (int)sizeof(uint8_t),
+		&opened.transformedColorImage);
+
+	ImagePool::GetShared().TryCreateImage(K4A_IMAGE_FORMAT_CUSTOM,
+		depthCamera.resolution_width,
+		depthCamera.resolution_height,
+		depthCamera.resolution_width * (int)sizeof(k4a_float3_t),
+		&opened.xyTableImage);
+	create_xy_table(&opened.calibration, opened.xyTableImage);
+
+	opened.openMilliseconds = TimingHelper::GetElapsedMilliseconds(start);
+	return true;
 }
 
-bool AzureKinectWrapper::TryUpdate()
+void AzureKinectWrapper::ReleaseOpenedDevice(OpenedDevice &opened)
 {
-    if (deviceMap.size() == 0)
-    {
-        OutputDebugString(L"No devices created, update failed");
-        return false;
-    }
+	if (opened.transformation != nullptr)
+	{
+		k4a_transformation_destroy(opened.transformation);
+	}
 
-    k4a_capture_t capture = NULL;
-    bool observedFailure = false;
-	for (auto pair : deviceMap)
+	if (opened.transformedColorImage != nullptr)
+	{
+		k4a_image_release(opened.transformedColorImage);
+	}
+
+	if (opened.xyTableImage != nullptr)
+	{
+		k4a_image_release(opened.xyTableImage);
+	}
+
+	if (opened.device != nullptr)
+	{
+		k4a_device_close(opened.device);
+	}
+
+	opened = OpenedDevice{};
+}
+
+bool AzureKinectWrapper::TryPublishDevice(
+	unsigned int index,
+	OpenedDevice &opened)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	const k4a_calibration_t &calibration = opened.calibration;
+
+	slot->device = opened.device;
+	slot->configuration = opened.configuration;
+	slot->transformation = opened.transformation;
+	slot->transformedColorImage = opened.transformedColorImage;
+	slot->xyTableImage = opened.xyTableImage;
+	activeDeviceCount++;
+
+	EnterCriticalSection(&slot->slotCritSec);
+	slot->calibration = calibration;
+	slot->hasCalibration = true;
+	slot->calibrationVersion = nextCalibrationVersion++;
+	slot->streaming = true;
+	slot->regionOfInterestChanged = true;
+	slot->frameTimestamps = {};
+	slot->depthHostTimestampMapped = false;
+	slot->clockMapper.Reset();
+	slot->latencyStats = {};
+	slot->resources = CreateDeviceResources(calibration);
+	slot->hasResources = true;
+
+	slot->cachedTransformedColorImageBuffer = std::make_shared<ImageBuffer>(slot->resources.rgbFrameDimensions);
+	slot->cachedDepthImageBuffer = std::make_shared<ImageBuffer>(slot->resources.depthFrameDimensions);
+	slot->cachedPointCloudTemplateImageBuffer = std::make_shared<ImageBuffer>(slot->resources.pointCloudTemplateFrameDimensions);
+	LeaveCriticalSection(&slot->slotCritSec);
+
+	// Everything belongs to the slot now and is released with it
+	opened = OpenedDevice{};
+
+	slot->captureQueue = std::make_shared<CaptureQueue>(slot->device, slot->deliveryPolicy, slot->deliveryQueueCapacity);
+	if (!slot->captureQueue->TryStart(slot->configuration.camera_fps))
+	{
+		output_device_message(L"Failed to start capture queue: ", index);
+		StopStreaming(index);
+		return false;
+	}
+
+	return true;
+}
+
+void AzureKinectWrapper::CompleteDeviceStarts(bool wait)
+{
+	if (startupStats.pendingCount == 0)
 	{
-		auto device = pair.second;
+		return;
+	}
 
-		switch (k4a_device_get_capture(device, &capture, 0))
+	for (unsigned int index = 0; index < MaxDeviceCount; index++)
+	{
+		DeviceSlot &slot = deviceSlots[index];
+		if (!slot.startThread.joinable())
 		{
-		case K4A_WAIT_RESULT_SUCCEEDED:
-			break;
-		case K4A_WAIT_RESULT_TIMEOUT:
-			OutputDebugString(L"Timed out waiting for capture: " + pair.first);
-			observedFailure = true;
-			continue;
-		case K4A_WAIT_RESULT_FAILED:
-			OutputDebugString(L"Failed to capture: " + pair.first);
-			observedFailure = true;
 			continue;
 		}
 
-		EnterCriticalSection(&resourcesCritSec);
-		if (resourcesMap.count(pair.first) == 0)
+		EnterCriticalSection(&startCritSec);
+		bool completed = slot.startCompleted;
+		LeaveCriticalSection(&startCritSec);
+
+		if (completed || wait)
 		{
-			resourcesMap[pair.first] = DeviceResources{
-				nullptr, nullptr, {}, nullptr, nullptr, {}, nullptr, nullptr, {}
-			};
+			FinishDeviceStart(index, true);
 		}
+	}
+}
 
-		DeviceResources &resources = resourcesMap[pair.first];
-		LeaveCriticalSection(&resourcesCritSec);
+void AzureKinectWrapper::FinishDeviceStart(
+	unsigned int index,
+	bool publish)
+{
+	DeviceSlot &slot = deviceSlots[index];
+	slot.startThread.join();
+	slot.openMilliseconds = slot.openedDevice.openMilliseconds;
 
-		auto transformation = transformationMap[pair.first];
-		auto transformedColorImage = transformedColorMap[pair.first];
+	// Publishing moves everything out, a cancelled or failed start is released here
+	bool result = publish &&
+		slot.openedDevice.device != nullptr &&
+		TryPublishDevice(index, slot.openedDevice);
+	ReleaseOpenedDevice(slot.openedDevice);
 
-		auto colorImage = k4a_capture_get_color_image(capture);
-		auto depthImage = k4a_capture_get_depth_image(capture);
+	slot.startState = result ? DeviceStartStateStarted : (publish ? DeviceStartStateFailed : DeviceStartStateIdle);
+	slot.startMilliseconds = TimingHelper::GetElapsedMilliseconds(slot.startTimestamp);
 
-		if (colorImage &&
-			depthImage)
-		{
-			k4a_result_t result = k4a_transformation_color_image_to_depth_camera(
-				transformation,
-				depthImage,
-				colorImage,
-				transformedColorImage);
+	startupStats.pendingCount--;
+	startupStats.failedCount += publish && !result ? 1 : 0;
+	startupStats.summedMilliseconds += slot.openMilliseconds;
+	if (startupStats.pendingCount == 0)
+	{
+		startupStats.wallMilliseconds = TimingHelper::GetElapsedMilliseconds(startupStats.startTimestamp);
+	}
+}
 
-			if (result == K4A_RESULT_SUCCEEDED)
-			{
-				if (cachedTransformedColorImageBufferMap.count(pair.first) != 0)
-				{
-					auto transformedColorImageBuffer = k4a_image_get_buffer(transformedColorImage);
-					memcpy(cachedTransformedColorImageBufferMap[pair.first]->buffer->data(), transformedColorImageBuffer, cachedTransformedColorImageBufferMap[pair.first]->GetSize());
-				}
+bool AzureKinectWrapper::TryReconfigureStreams(
+	unsigned int index,
+	k4a_image_format_t colorFormat,
+	k4a_color_resolution_t colorResolution,
+	k4a_depth_mode_t depthMode,
+	k4a_fps_t fps,
+	float *reconfigureMilliseconds)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		output_device_message(L"Provided index exceeds the supported device count: ", index);
+		return false;
+	}
 
-				UpdateResources(transformedColorImage,
-					resources.rgbSrv,
-					resources.rgbTexture,
-					resources.rgbFrameDimensions,
-					DXGI_FORMAT_B8G8R8A8_UNORM);
-			}
-		}
+	if (slot->startThread.joinable())
+	{
+		FinishDeviceStart(index, true);
+	}
 
-		if (depthImage)
-		{
-			if (cachedDepthImageBufferMap.count(pair.first) != 0)
-			{
-				auto depthImageBuffer = k4a_image_get_buffer(depthImage);
-				memcpy(cachedDepthImageBufferMap[pair.first]->buffer->data(), depthImageBuffer, cachedDepthImageBufferMap[pair.first]->GetSize());
-			}
+	if (slot->device == nullptr)
+	{
+		output_device_message(L"Unable to reconfigure a device that is not streaming: ", index);
+		return false;
+	}
 
-			UpdateResources(depthImage,
-				resources.depthSrv,
-				resources.depthTexture,
-				resources.depthFrameDimensions,
-				DXGI_FORMAT_R16_UNORM);
-		}
+	auto start = TimingHelper::GetTimestampMicroseconds();
+	const k4a_device_configuration_t previous = slot->configuration;
+	k4a_device_configuration_t configuration = previous;
+	configuration.color_format = colorFormat;
+	configuration.color_resolution = colorResolution;
+	configuration.depth_mode = depthMode;
+	configuration.camera_fps = fps;
 
-		if (depthImage &&
-			pointCloudTemplateMap.count(pair.first) == 0)
+	bool depthModeChanged = configuration.depth_mode != previous.depth_mode;
+	bool calibrationChanged = depthModeChanged ||
+		configuration.color_resolution != previous.color_resolution;
+	if (!calibrationChanged &&
+		configuration.color_format == previous.color_format &&
+		configuration.camera_fps == previous.camera_fps)
+	{
+		if (reconfigureMilliseconds != nullptr)
 		{
-			auto xyTableImage = xyTableMap[pair.first];
-			auto calibration = calibrationMap[pair.first];
+			*reconfigureMilliseconds = 0.0f;
+		}
+		return true;
+	}
 
-			k4a_image_t pointCloudTemplateImage;
-			k4a_image_create(K4A_IMAGE_FORMAT_CUSTOM,
-				calibration.depth_camera_calibration.resolution_width,
-				calibration.depth_camera_calibration.resolution_height,
-				calibration.depth_camera_calibration.resolution_width * (int)sizeof(k4a_float3_t),
-				&pointCloudTemplateImage);
-			pointCloudTemplateMap[pair.first] = pointCloudTemplateImage;
+	// The readers go first and the imu only runs while the cameras do, the device stays open throughout
+	bool imuRunning = slot->imuStream != nullptr;
+	StopImu(index);
+	slot->captureQueue->Stop();
+	k4a_device_stop_cameras(slot->device);
 
-			k4a_image_t depthTemplateImage;
-			k4a_image_create(k4a_image_get_format(depthImage),
-				calibration.depth_camera_calibration.resolution_width,
-				calibration.depth_camera_calibration.resolution_height,
-				k4a_image_get_stride_bytes(depthImage),
-				&depthTemplateImage);
+	bool result = true;
+	if (K4A_RESULT_SUCCEEDED != k4a_device_start_cameras(slot->device, &configuration))
+	{
+		output_device_message(L"Failed to start cameras with the new configuration: ", index);
 
-			// Getting depth projection for 1m depth;
-			auto buffer = k4a_image_get_buffer(depthTemplateImage);
-			for (int i = 0; i < k4a_image_get_size(depthTemplateImage); i += 2)
-			{
-				*reinterpret_cast<uint16_t*>(&(buffer[i])) = 1000;
-			}
+		// Back to what was running, the device is only given up when that fails as well
+		configuration = previous;
+		if (K4A_RESULT_SUCCEEDED != k4a_device_start_cameras(slot->device, &configuration))
+		{
+			output_device_message(L"Failed to restart cameras: ", index);
+			StopStreaming(index);
+			return false;
+		}
 
-			int pointCount = 0;
+		depthModeChanged = false;
+		calibrationChanged = false;
+		result = false;
+	}
+	slot->configuration = configuration;
+	float cameraMilliseconds = TimingHelper::GetElapsedMilliseconds(start);
+
+	auto rebuildStart = TimingHelper::GetTimestampMicroseconds();
+	bool resourcesRecreated = false;
+	if (calibrationChanged)
+	{
+		k4a_calibration_t calibration;
+		k4a_device_get_calibration(slot->device, configuration.depth_mode, configuration.color_resolution, &calibration);
+		RebuildCalibration(*slot, calibration, depthModeChanged, &resourcesRecreated);
+	}
+	float rebuildMilliseconds = TimingHelper::GetElapsedMilliseconds(rebuildStart);
+
+	if (!slot->captureQueue->TryStart(slot->configuration.camera_fps))
+	{
+		output_device_message(L"Failed to restart capture queue: ", index);
+		StopStreaming(index);
+		return false;
+	}
+
+	if (imuRunning &&
+		!TryStartImu(index))
+	{
+		output_device_message(L"Failed to restart imu: ", index);
+	}
+
+	float milliseconds = TimingHelper::GetElapsedMilliseconds(start);
+	EnterCriticalSection(&slot->slotCritSec);
+	ReconfigureStats &reconfigureStats = slot->reconfigureStats;
+	reconfigureStats.reconfigureCount++;
+	reconfigureStats.lastMilliseconds = milliseconds;
+	reconfigureStats.cameraMilliseconds = cameraMilliseconds;
+	reconfigureStats.rebuildMilliseconds = rebuildMilliseconds;
+	reconfigureStats.calibrationChanged = calibrationChanged;
+	reconfigureStats.resourcesRecreated = resourcesRecreated;
+	LeaveCriticalSection(&slot->slotCritSec);
+
+	if (reconfigureMilliseconds != nullptr)
+	{
+		*reconfigureMilliseconds = milliseconds;
+	}
+	return result;
+}
+
+void AzureKinectWrapper::RebuildCalibration(
+	DeviceSlot &slot,
+	const k4a_calibration_t &calibration,
+	bool depthModeChanged,
+	bool *resourcesRecreated)
+{
+	const k4a_calibration_camera_t &depthCamera = calibration.depth_camera_calibration;
+	const k4a_calibration_camera_t &previousDepthCamera = slot.calibration.depth_camera_calibration;
+	const bool dimensionsChanged =
+		depthCamera.resolution_width != previousDepthCamera.resolution_width ||
+		depthCamera.resolution_height != previousDepthCamera.resolution_height;
+	*resourcesRecreated = dimensionsChanged;
+
+	// Everything is built into locals and swapped in under the lock together with the cached buffers, so
+	// fusion and export never pair a new xy table with a frame of the old size. What the slot held before
+	// is released once the lock is left, a reader's own reference keeps an old table alive until it is done.
+	// The transformation covers both cameras, any calibration change replaces it.
+	k4a_transformation_t transformation = k4a_transformation_create(&calibration);
+	k4a_image_t transformedColorImage = nullptr;
+	k4a_image_t xyTableImage = nullptr;
+	pinhole_t undistortPinhole = {};
+	if (depthModeChanged)
+	{
+		// The table is never refilled in place, since readers may still hold the current one
+		ImagePool::GetShared().TryCreateImage(K4A_IMAGE_FORMAT_CUSTOM,
+			depthCamera.resolution_width,
+			depthCamera.resolution_height,
+			depthCamera.resolution_width * (int)sizeof(k4a_float3_t),
+			&xyTableImage);
+		create_xy_table(&calibration, xyTableImage);
+
+		// The registered color image is only replaced when its size changes, same sized it is reused
+		if (dimensionsChanged)
+		{
+			ImagePool::GetShared().TryCreateImage(K4A_IMAGE_FORMAT_COLOR_BGRA32,
+				depthCamera.resolution_width,
+				depthCamera.resolution_height,
+				depthCamera.resolution_width * 4 * (int)sizeof(uint8_t),
+				&transformedColorImage);
+		}
+
+		undistortPinhole = create_pinhole_from_xy_range(&calibration, K4A_CALIBRATION_TYPE_DEPTH);
+	}
+
+	k4a_transformation_t previousTransformation = nullptr;
+	k4a_image_t previousImages[4] = {};
+	EnterCriticalSection(&slot.slotCritSec);
+	previousTransformation = slot.transformation;
+	slot.transformation = transformation;
+	if (depthModeChanged)
+	{
+		previousImages[0] = slot.xyTableImage;
+		slot.xyTableImage = xyTableImage;
+		if (dimensionsChanged)
+		{
+			previousImages[1] = slot.transformedColorImage;
+			slot.transformedColorImage = transformedColorImage;
+		}
+
+		// Both are rebuilt lazily by the next update that needs them
+		previousImages[2] = slot.pointCloudTemplateImage;
+		slot.pointCloudTemplateImage = nullptr;
+		previousImages[3] = slot.undistortLut;
+		slot.undistortLut = nullptr;
+	}
+
+	slot.calibration = calibration;
+	slot.calibrationVersion = nextCalibrationVersion++;
+	slot.frameTimestamps = {};
+	slot.depthHostTimestampMapped = false;
+	slot.clockMapper.Reset();
+	slot.latencyStats = {};
+
+	// The uv map depends on both cameras, its buffers are sized by both resolutions
+	if (slot.colorUvImageBuffer != nullptr ||
+		slot.colorUvResources.depthTexture != nullptr)
+	{
+		ReleaseColorUv(slot);
+		*resourcesRecreated = true;
+	}
+
+	if (depthModeChanged)
+	{
+		slot.regionOfInterestChanged = true;
+		if (slot.hasUndistortPinhole &&
+			(slot.undistortPinhole.width != undistortPinhole.width ||
+			slot.undistortPinhole.height != undistortPinhole.height))
+		{
+			ReleaseResources(slot.undistortResources);
+			slot.undistortedDepthImageBuffer = nullptr;
+			slot.undistortedIRImageBuffer = nullptr;
+			*resourcesRecreated = true;
+		}
+		slot.hasUndistortPinhole = false;
+
+		if (slot.tsdfVolume != nullptr)
+		{
+			slot.tsdfVolume->SetCalibration(calibration);
+		}
+	}
+
+	// Textures are created at their new size by the next update, subscribers have to fetch the views again
+	if (dimensionsChanged)
+	{
+		ReleaseResources(slot.resources);
+		slot.resources = CreateDeviceResources(calibration);
+		slot.cachedTransformedColorImageBuffer = std::make_shared<ImageBuffer>(slot.resources.rgbFrameDimensions);
+		slot.cachedDepthImageBuffer = std::make_shared<ImageBuffer>(slot.resources.depthFrameDimensions);
+		slot.cachedPointCloudTemplateImageBuffer = std::make_shared<ImageBuffer>(slot.resources.pointCloudTemplateFrameDimensions);
+
+		for (auto &pyramidLevel : slot.pyramidLevels)
+		{
+			ReleaseResources(pyramidLevel.resources);
+			pyramidLevel.hasColor = false;
+			pyramidLevel.colorImageBuffer = nullptr;
+			pyramidLevel.depthImageBuffer = nullptr;
+		}
+	}
+	LeaveCriticalSection(&slot.slotCritSec);
+
+	k4a_transformation_destroy(previousTransformation);
+	for (k4a_image_t image : previousImages)
+	{
+		if (image != nullptr)
+		{
+			k4a_image_release(image);
+		}
+	}
+}
+
+bool AzureKinectWrapper::TryGetReconfigureStats(
+	unsigned int index,
+	uint64_t *reconfigureCount,
+	float *lastMilliseconds,
+	float *cameraMilliseconds,
+	float *rebuildMilliseconds,
+	bool *calibrationChanged,
+	bool *resourcesRecreated)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr ||
+		reconfigureCount == nullptr ||
+		lastMilliseconds == nullptr ||
+		cameraMilliseconds == nullptr ||
+		rebuildMilliseconds == nullptr ||
+		calibrationChanged == nullptr ||
+		resourcesRecreated == nullptr)
+	{
+		return false;
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	ReconfigureStats reconfigureStats = slot->reconfigureStats;
+	LeaveCriticalSection(&slot->slotCritSec);
+
+	*reconfigureCount = reconfigureStats.reconfigureCount;
+	*lastMilliseconds = reconfigureStats.lastMilliseconds;
+	*cameraMilliseconds = reconfigureStats.cameraMilliseconds;
+	*rebuildMilliseconds = reconfigureStats.rebuildMilliseconds;
+	*calibrationChanged = reconfigureStats.calibrationChanged;
+	*resourcesRecreated = reconfigureStats.resourcesRecreated;
+	return reconfigureStats.reconfigureCount > 0;
+}
+
+bool AzureKinectWrapper::TryGetDeviceStartState(
+	unsigned int index,
+	int *state,
+	float *openMilliseconds,
+	float *startMilliseconds)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr ||
+		state == nullptr)
+	{
+		return false;
+	}
+
+	CompleteDeviceStarts(false);
+	*state = slot->startState;
+	if (openMilliseconds != nullptr)
+	{
+		*openMilliseconds = slot->openMilliseconds;
+	}
+	if (startMilliseconds != nullptr)
+	{
+		*startMilliseconds = slot->startMilliseconds;
+	}
+	return true;
+}
+
+bool AzureKinectWrapper::TryWaitForDeviceStarts(unsigned int timeoutMilliseconds)
+{
+	auto allCompleted = [this]()
+	{
+		for (auto &slot : deviceSlots)
+		{
+			if (slot.startThread.joinable() &&
+				!slot.startCompleted)
+			{
+				return false;
+			}
+		}
+		return true;
+	};
+
+	const ULONGLONG deadline = GetTickCount64() + timeoutMilliseconds;
+	EnterCriticalSection(&startCritSec);
+	while (!allCompleted())
+	{
+		DWORD remaining = INFINITE;
+		if (timeoutMilliseconds != INFINITE)
+		{
+			ULONGLONG now = GetTickCount64();
+			if (now >= deadline)
+			{
+				break;
+			}
+			remaining = static_cast<DWORD>(deadline - now);
+		}
+
+		SleepConditionVariableCS(&startCompletedCondition, &startCritSec, remaining);
+	}
+	LeaveCriticalSection(&startCritSec);
+
+	// Whatever finished is published, a timeout leaves the rest starting
+	CompleteDeviceStarts(false);
+	return startupStats.pendingCount == 0;
+}
+
+bool AzureKinectWrapper::TryGetStartupStats(
+	int *deviceCount,
+	int *failedCount,
+	int *pendingCount,
+	float *wallMilliseconds,
+	float *summedMilliseconds)
+{
+	if (deviceCount == nullptr ||
+		failedCount == nullptr ||
+		pendingCount == nullptr ||
+		wallMilliseconds == nullptr ||
+		summedMilliseconds == nullptr)
+	{
+		return false;
+	}
+
+	CompleteDeviceStarts(false);
+	*deviceCount = startupStats.deviceCount;
+	*failedCount = startupStats.failedCount;
+	*pendingCount = startupStats.pendingCount;
+	*wallMilliseconds = startupStats.pendingCount == 0 ?
+		startupStats.wallMilliseconds :
+		TimingHelper::GetElapsedMilliseconds(startupStats.startTimestamp);
+	*summedMilliseconds = startupStats.summedMilliseconds;
+	return startupStats.deviceCount > 0;
+}
+
+bool AzureKinectWrapper::TryUpdate()
+{
+	// Devices started asynchronously join in once they are open
+	CompleteDeviceStarts(false);
+
+    if (activeDeviceCount == 0)
+    {
+        OutputDebugString(L"No devices created, update failed");
+        return false;
+    }
+
+    k4a_capture_t capture = NULL;
+    bool observedFailure = false;
+	for (unsigned int index = 0; index < MaxDeviceCount; index++)
+	{
+		DeviceSlot &slot = deviceSlots[index];
+		if (slot.device == nullptr)
+		{
+			continue;
+		}
+
+		if (slot.captureQueue == nullptr)
+		{
+			observedFailure = true;
+			continue;
+		}
+
+		switch (slot.captureQueue->TryPop(capture))
+		{
+		case K4A_WAIT_RESULT_SUCCEEDED:
+			break;
+		case K4A_WAIT_RESULT_TIMEOUT:
+			output_device_message(L"Timed out waiting for capture: ", index);
+			observedFailure = true;
+			continue;
+		case K4A_WAIT_RESULT_FAILED:
+			output_device_message(L"Failed to capture: ", index);
+			observedFailure = true;
+			continue;
+		}
+
+		DeviceResources &resources = slot.resources;
+		auto transformedColorImage = slot.transformedColorImage;
+
+		auto colorImage = k4a_capture_get_color_image(capture);
+		auto depthImage = k4a_capture_get_depth_image(capture);
+
+		EnterCriticalSection(&slot.slotCritSec);
+		bool hasRegionOfInterest = slot.hasRegionOfInterest;
+		bool regionOfInterestChanged = slot.regionOfInterestChanged;
+		RegionOfInterest regionOfInterest = slot.regionOfInterest;
+		slot.regionOfInterestChanged = false;
+		bool undistortDepth = slot.undistortedDepthSubscriberCount > 0;
+		bool undistortIR = slot.undistortedIRSubscriberCount > 0;
+		interpolation_t undistortInterpolation = slot.undistortInterpolation;
+		bool colorUv = slot.colorUvSubscriberCount > 0;
+		bool registrationEnabled = slot.registrationEnabled;
+		ChangeDetectionSettings changeDetection = slot.changeDetection;
+		bool changeDetectionChanged = slot.changeDetectionChanged;
+		slot.changeDetectionChanged = false;
+		OutlierFilterSettings outlierFilter = slot.outlierFilter;
+		bool irSubscribed = slot.irSubscriberCount > 0;
+		LeaveCriticalSection(&slot.slotCritSec);
+
+		// Cropping happens first, so the color transform skips the zeroed pixels and only the rect is
+		// copied and uploaded. A new region gets one full frame to clear what used to be inside it.
+		auto processStart = TimingHelper::GetTimestampMicroseconds();
+		const PixelRect *copyRect = nullptr;
+		PixelRect regionRect = {};
+		int keptPixelCount = -1;
+		if (depthImage &&
+			hasRegionOfInterest)
+		{
+			int depthWidth = k4a_image_get_width_pixels(depthImage);
+			int depthHeight = k4a_image_get_height_pixels(depthImage);
+			regionRect = clamp_rect(regionOfInterest.rect, depthWidth, depthHeight);
+			keptPixelCount = crop_depth(
+				reinterpret_cast<uint16_t*>(k4a_image_get_buffer(depthImage)),
+				reinterpret_cast<k4a_float2_t*>(k4a_image_get_buffer(slot.xyTableImage)),
+				depthWidth,
+				depthHeight,
+				regionOfInterest,
+				regionRect);
+
+			if (!regionOfInterestChanged)
+			{
+				copyRect = &regionRect;
+			}
+		}
+
+		// Flying pixels are rejected before tiles are compared, so in place they never count as changes
+		OutlierFilterStats outlierStats = {};
+		if (depthImage &&
+			outlierFilter.enabled)
+		{
+			FilterOutliers(slot, depthImage, outlierFilter, outlierStats);
+		}
+
+		// The ir image is not even fetched from the capture unless someone subscribed to it
+		k4a_image_t irImage = nullptr;
+		if (irSubscribed)
+		{
+			irImage = k4a_capture_get_ir_image(capture);
+		}
+
+		FrameTimestamps frameTimestamps = {};
+		if (colorImage)
+		{
+			frameTimestamps.colorDeviceTimestampUsec = k4a_image_get_device_timestamp_usec(colorImage);
+			frameTimestamps.colorSystemTimestampNsec = k4a_image_get_system_timestamp_nsec(colorImage);
+		}
+
+		if (depthImage)
+		{
+			frameTimestamps.depthDeviceTimestampUsec = k4a_image_get_device_timestamp_usec(depthImage);
+			frameTimestamps.depthSystemTimestampNsec = k4a_image_get_system_timestamp_nsec(depthImage);
+		}
+
+		// Without ir subscribers the ir image is only held for its timestamps and the undistorted stream
+		k4a_image_t irSourceImage = irImage != nullptr ? irImage : k4a_capture_get_ir_image(capture);
+		if (irSourceImage)
+		{
+			frameTimestamps.irDeviceTimestampUsec = k4a_image_get_device_timestamp_usec(irSourceImage);
+			frameTimestamps.irSystemTimestampNsec = k4a_image_get_system_timestamp_nsec(irSourceImage);
+		}
+
+		// Tiles are compared after cropping, so what the region zeroed never counts as a change. A frame
+		// without changed tiles inside the copied rect leaves every buffer and view as it was.
+		bool compareIR = irSourceImage != nullptr && changeDetection.irNoiseThreshold >= 0;
+		bool detectedChanges = false;
+		bool unchangedFrame = false;
+		int changedTileCount = 0;
+		PixelRect tileRect = {};
+		PixelRect changedRect = {};
+		float detectMilliseconds = 0.0f;
+		if (depthImage &&
+			changeDetection.enabled)
+		{
+			auto detectStart = TimingHelper::GetTimestampMicroseconds();
+			detectedChanges = DetectChanges(slot,
+				depthImage,
+				compareIR ? irSourceImage : nullptr,
+				changeDetection,
+				regionOfInterestChanged || changeDetectionChanged,
+				tileRect,
+				changedTileCount);
+			detectMilliseconds = TimingHelper::GetElapsedMilliseconds(detectStart);
+
+			if (detectedChanges)
+			{
+				changedRect = copyRect != nullptr ? intersect_rect(*copyRect, tileRect) : tileRect;
+				copyRect = &changedRect;
+				unchangedFrame = changedRect.width == 0;
+			}
+		}
+		else if (!changeDetection.enabled &&
+			slot.hasChangeReference)
+		{
+			slot.hasChangeReference = false;
+			slot.changeDepthReference = nullptr;
+			slot.changeIRReference = nullptr;
+		}
+
+		// Ir only counts as unchanged when it was compared
+		const PixelRect *irRect = detectedChanges && compareIR ? &tileRect : nullptr;
+		bool irUnchanged = irRect != nullptr && tileRect.width == 0;
+
+		if (!depthImage ||
+			unchangedFrame)
+		{
+			undistortDepth = false;
+		}
+		if (!irSourceImage ||
+			irUnchanged)
+		{
+			undistortIR = false;
+		}
+		if (undistortDepth ||
+			undistortIR)
+		{
+			UpdateUndistortLut(slot, undistortInterpolation);
+		}
+
+		bool transformedColor = false;
+		float registrationMilliseconds = 0.0f;
+		if (colorImage &&
+			depthImage &&
+			registrationEnabled &&
+			!unchangedFrame)
+		{
+			auto registrationStart = TimingHelper::GetTimestampMicroseconds();
+			k4a_result_t result = k4a_transformation_color_image_to_depth_camera(
+				slot.transformation,
+				depthImage,
+				colorImage,
+				transformedColorImage);
+			transformedColor = result == K4A_RESULT_SUCCEEDED;
+			registrationMilliseconds = TimingHelper::GetElapsedMilliseconds(registrationStart);
+		}
+
+		uint64_t copiedBytes = 0;
+		EnterCriticalSection(&slot.slotCritSec);
+		slot.frameSequence++;
+		if (colorImage)
+		{
+			slot.colorTimestampUsec = frameTimestamps.colorDeviceTimestampUsec;
+		}
+
+		if (transformedColor)
+		{
+			if (slot.cachedTransformedColorImageBuffer != nullptr)
+			{
+				copiedBytes += CopyImageBuffer(transformedColorImage, *slot.cachedTransformedColorImageBuffer, copyRect);
+			}
+
+			UpdateResources(transformedColorImage,
+				resources.rgbSrv,
+				resources.rgbTexture,
+				resources.rgbFrameDimensions,
+				DXGI_FORMAT_B8G8R8A8_UNORM,
+				resources.rgbUploadTarget,
+				copyRect);
+		}
+
+		if (depthImage)
+		{
+			// Shares the device clock with the imu samples
+			slot.depthTimestampUsec = frameTimestamps.depthDeviceTimestampUsec;
+			slot.clockMapper.AddSample(frameTimestamps.depthDeviceTimestampUsec, frameTimestamps.depthSystemTimestampNsec);
+
+			if (slot.cachedDepthImageBuffer != nullptr &&
+				!unchangedFrame)
+			{
+				copiedBytes += CopyImageBuffer(depthImage, *slot.cachedDepthImageBuffer, copyRect);
+			}
+
+			if (!unchangedFrame)
+			{
+				UpdateResources(depthImage,
+					resources.depthSrv,
+					resources.depthTexture,
+					resources.depthFrameDimensions,
+					DXGI_FORMAT_R16_UNORM,
+					resources.depthUploadTarget,
+					copyRect);
+			}
+
+			slot.regionOfInterestStats.processedPixelCount = hasRegionOfInterest ?
+				regionRect.width * regionRect.height :
+				k4a_image_get_width_pixels(depthImage) * k4a_image_get_height_pixels(depthImage);
+			slot.regionOfInterestStats.keptPixelCount = keptPixelCount;
+
+			if ((slot.pyramidLevels[0].subscriberCount > 0 ||
+				slot.pyramidLevels[1].subscriberCount > 0) &&
+				!unchangedFrame)
+			{
+				UpdatePyramid(slot, depthImage, transformedColor ? transformedColorImage : nullptr);
+			}
+
+			if (colorUv &&
+				!unchangedFrame)
+			{
+				UpdateColorUv(slot, depthImage, colorImage);
+			}
+		}
+
+		slot.colorUvStats.registrationMilliseconds = registrationMilliseconds;
+		slot.colorUvStats.registrationUploadBytes = 0;
+		if (transformedColor)
+		{
+			slot.colorUvStats.registrationUploadBytes = copyRect != nullptr ?
+				(uint64_t)copyRect->width * copyRect->height * 4 :
+				(uint64_t)k4a_image_get_size(transformedColorImage);
+		}
+
+		if (undistortDepth ||
+			undistortIR)
+		{
+			UpdateUndistorted(slot,
+				undistortDepth ? depthImage : nullptr,
+				undistortIR ? irSourceImage : nullptr,
+				undistortInterpolation);
+		}
+
+		if (irImage)
+		{
+			if (!irUnchanged)
+			{
+				UpdateResources(irImage,
+					resources.irSrv,
+					resources.irTexture,
+					resources.irFrameDimensions,
+					DXGI_FORMAT_R16_UNORM,
+					resources.irUploadTarget,
+					irRect);
+			}
+
+			// Ownership moves to the slot, leases add their own reference to it. When the last subscriber
+			// left since the frame started, the image is released with the other frame images instead.
+			if (slot.irSubscriberCount > 0)
+			{
+				if (slot.latestIRImage != nullptr)
+				{
+					k4a_image_release(slot.latestIRImage);
+				}
+				slot.latestIRImage = irImage;
+			}
+			else
+			{
+				irImage = nullptr;
+			}
+		}
+
+		slot.regionOfInterestStats.copiedBytes = copiedBytes;
+
+		if (depthImage)
+		{
+			slot.frameUnchanged = unchangedFrame;
+			slot.changedRect = copyRect != nullptr ?
+				*copyRect :
+				PixelRect{ 0, 0, k4a_image_get_width_pixels(depthImage), k4a_image_get_height_pixels(depthImage) };
+
+			if (changeDetection.enabled)
+			{
+				ChangeDetectionStats &changeStats = slot.changeDetectionStats;
+				slot.changeMask = slot.changeMaskWork;
+				changeStats.frameCount++;
+				changeStats.unchangedFrameCount += unchangedFrame ? 1 : 0;
+				changeStats.keyframeCount += detectedChanges ? 0 : 1;
+				changeStats.copiedBytes += copiedBytes;
+				changeStats.fullFrameBytes += k4a_image_get_size(depthImage) +
+					(colorImage && registrationEnabled ? k4a_image_get_size(transformedColorImage) : 0);
+				changeStats.tileColumns = change_tile_count(k4a_image_get_width_pixels(depthImage));
+				changeStats.tileRows = change_tile_count(k4a_image_get_height_pixels(depthImage));
+				changeStats.changedTileCount = changedTileCount;
+				changeStats.detectMilliseconds = detectMilliseconds;
+			}
+
+			if (outlierFilter.enabled)
+			{
+				OutlierFilterStats &filterStats = slot.outlierFilterStats;
+				outlierStats.frameCount = filterStats.frameCount + 1;
+				outlierStats.rejectedTotal = filterStats.rejectedTotal + outlierStats.rejectedPixelCount;
+				filterStats = outlierStats;
+
+				// Settings changed since the frame started leave the mask to the next one
+				if (slot.outlierFilter.enabled &&
+					slot.outlierFilter.mode == OutlierFilterMask &&
+					outlierFilter.mode == OutlierFilterMask)
+				{
+					slot.outlierMask.swap(slot.outlierMaskWork);
+				}
+			}
+		}
+		slot.regionOfInterestStats.processMilliseconds = TimingHelper::GetElapsedMilliseconds(processStart);
+
+		// Published from here on, everything above is visible to readers once the lock is released
+		frameTimestamps.sequence = slot.frameSequence;
+		frameTimestamps.publishHostTimestampNsec = TimingHelper::GetTimestampNanoseconds();
+		if (depthImage)
+		{
+			slot.depthHostTimestampMapped = slot.clockMapper.TryMapToHost(frameTimestamps.depthDeviceTimestampUsec, &frameTimestamps.depthHostTimestampNsec);
+			if (!slot.depthHostTimestampMapped)
+			{
+				frameTimestamps.depthHostTimestampNsec = frameTimestamps.depthSystemTimestampNsec;
+			}
+
+			frameTimestamps.captureToPublishMilliseconds =
+				(int64_t)(frameTimestamps.publishHostTimestampNsec - frameTimestamps.depthHostTimestampNsec) / 1000000.0f;
+
+			LatencyStats &latencyStats = slot.latencyStats;
+			latencyStats.frameCount++;
+			latencyStats.lastMilliseconds = frameTimestamps.captureToPublishMilliseconds;
+			latencyStats.maxMilliseconds = max(latencyStats.maxMilliseconds, frameTimestamps.captureToPublishMilliseconds);
+			latencyStats.totalMilliseconds += frameTimestamps.captureToPublishMilliseconds;
+		}
+		slot.frameTimestamps = frameTimestamps;
+
+		auto spatialIndex = slot.spatialIndex;
+		uint64_t frameSequence = slot.frameSequence;
+		auto frameCallback = slot.frameCallback;
+		auto frameCallbackContext = slot.frameCallbackContext;
+		LeaveCriticalSection(&slot.slotCritSec);
+
+		// Everything consumers read for this frame is in place before anyone is woken
+		WakeAllConditionVariable(&slot.frameAvailable);
+		if (frameCallback != nullptr)
+		{
+			frameCallback(index, frameSequence, frameCallbackContext);
+		}
+
+		// Other processes come after the ones in this one, an unchanged frame republishes what the cached
+		// buffers kept, color included
+		if (slot.sharedFramesEnabled &&
+			(depthImage || irSourceImage))
+		{
+			PublishSharedFrame(index,
+				slot,
+				depthImage,
+				transformedColor || (unchangedFrame && registrationEnabled && colorImage),
+				slot.sharedFrameIR ? irSourceImage : nullptr,
+				frameTimestamps,
+				unchangedFrame ? SharedFrameUnchanged : 0);
+		}
+
+		// Network clients already have what an unchanged frame would repeat
+		if (slot.frameServer != nullptr &&
+			depthImage &&
+			!unchangedFrame)
+		{
+			SubmitFrameServerFrame(index,
+				slot,
+				transformedColor,
+				frameTimestamps);
+		}
+
+		if (irSourceImage &&
+			irSourceImage != irImage)
+		{
+			k4a_image_release(irSourceImage);
+		}
+
+		if (depthImage &&
+			spatialIndex != nullptr &&
+			!unchangedFrame)
+		{
+			spatialIndex->Build(
+				reinterpret_cast<uint16_t*>(k4a_image_get_buffer(depthImage)),
+				reinterpret_cast<k4a_float2_t*>(k4a_image_get_buffer(slot.xyTableImage)),
+				k4a_image_get_width_pixels(depthImage) * k4a_image_get_height_pixels(depthImage));
+		}
+
+		if (depthImage &&
+			slot.pointCloudTemplateImage == nullptr)
+		{
+			auto xyTableImage = slot.xyTableImage;
+			auto calibration = slot.calibration;
+
+			k4a_image_t pointCloudTemplateImage;
+			ImagePool::GetShared().TryCreateImage(K4A_IMAGE_FORMAT_CUSTOM,
+				calibration.depth_camera_calibration.resolution_width,
+				calibration.depth_camera_calibration.resolution_height,
+				calibration.depth_camera_calibration.resolution_width * (int)sizeof(k4a_float3_t),
+				&pointCloudTemplateImage);
+			slot.pointCloudTemplateImage = pointCloudTemplateImage;
+
+			k4a_image_t depthTemplateImage;
+			ImagePool::GetShared().TryCreateImage(k4a_image_get_format(depthImage),
+				calibration.depth_camera_calibration.resolution_width,
+				calibration.depth_camera_calibration.resolution_height,
+				k4a_image_get_stride_bytes(depthImage),
+				&depthTemplateImage);
+
+			// Getting depth projection for 1m depth;
+			auto buffer = k4a_image_get_buffer(depthTemplateImage);
+			for (int i = 0; i < k4a_image_get_size(depthTemplateImage); i += 2)
+			{
+				*reinterpret_cast<uint16_t*>(&(buffer[i])) = 1000;
+			}
+
+			int pointCount = 0;
 			generate_point_cloud(depthTemplateImage,
 				xyTableImage,
 				pointCloudTemplateImage,
 				&pointCount);
 
-			// Unity does not support DXGI_FORMAT_R32G32B32_FLOAT
-			// To work around this we convert to R32G32B32A32
-			k4a_image_t rgbaImage;
-			k4a_image_create(K4A_IMAGE_FORMAT_CUSTOM,
-				calibration.depth_camera_calibration.resolution_width,
-				calibration.depth_camera_calibration.resolution_height,
-				calibration.depth_camera_calibration.resolution_width * (int)sizeof(float) * 4,
-				&rgbaImage);
+			// Unity does not support DXGI_FORMAT_R32G32B32_FLOAT
+			// To work around this we convert to R32G32B32A32
+			k4a_image_t rgbaImage;
+			ImagePool::GetShared().TryCreateImage(K4A_IMAGE_FORMAT_CUSTOM,
+				calibration.depth_camera_calibration.resolution_width,
+				calibration.depth_camera_calibration.resolution_height,
+				calibration.depth_camera_calibration.resolution_width * (int)sizeof(float) * 4,
+				&rgbaImage);
+
+			buffer = k4a_image_get_buffer(pointCloudTemplateImage);
+			byte *tempBuffer = k4a_image_get_buffer(rgbaImage);
+			for (int i = 0; i < k4a_image_get_width_pixels(rgbaImage) * k4a_image_get_height_pixels(rgbaImage); i++)
+			{
+				*reinterpret_cast<float*>(&tempBuffer[sizeof(float) * (4 * i)]) = *reinterpret_cast<float*>(&buffer[sizeof(float) * (3 * i)]);
+				*reinterpret_cast<float*>(&tempBuffer[sizeof(float) * (4 * i + 1)]) = *reinterpret_cast<float*>(&buffer[sizeof(float) * (3 * i + 1)]);
+				*reinterpret_cast<float*>(&tempBuffer[sizeof(float) * (4 * i + 2)]) = *reinterpret_cast<float*>(&buffer[sizeof(float) * (3 * i + 2)]);
+				*reinterpret_cast<float*>(&tempBuffer[sizeof(float) * (4 * i + 3)]) = 1.0;
+			}
+
+			EnterCriticalSection(&slot.slotCritSec);
+			if (slot.cachedPointCloudTemplateImageBuffer != nullptr)
+			{
+				memcpy(slot.cachedPointCloudTemplateImageBuffer->buffer, tempBuffer, slot.cachedPointCloudTemplateImageBuffer->GetSize());
+			}
+
+			UpdateResources(rgbaImage,
+				resources.pointCloudTemplateSrv,
+				resources.pointCloudTemplateTexture,
+				resources.pointCloudTemplateFrameDimensions,
+				DXGI_FORMAT_R32G32B32A32_FLOAT,
+				resources.pointCloudTemplateUploadTarget,
+				nullptr);
+			LeaveCriticalSection(&slot.slotCritSec);
+
+			k4a_image_release(rgbaImage);
+			k4a_image_release(depthTemplateImage);
+		}
+
+		k4a_image_release(colorImage);
+		k4a_image_release(depthImage);
+		k4a_capture_release(capture);
+	}
+
+    return !observedFailure;
+}
+
+bool AzureKinectWrapper::TryGetCalibration(
+	int index,
+	int *colorWidth,
+	int *colorHeight,
+	float *colorRotation,
+	float *colorTranslation,
+	int *colorIntrinsicsCount,
+	int colorIntrinsicsLength,
+	float *colorIntrinsics,
+	int *depthWidth,
+	int *depthHeight,
+	float *depthRotation,
+	float *depthTranslation,
+	int *depthIntrinsicsCount,
+	int depthIntrinsicsLength,
+	float *depthIntrinsics)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return false;
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	bool hasCalibration = slot->hasCalibration;
+	auto calibration = slot->calibration;
+	LeaveCriticalSection(&slot->slotCritSec);
+
+	if (!hasCalibration)
+	{
+		return false;
+	}
+	
+	*colorWidth = calibration.color_camera_calibration.resolution_width;
+	*colorHeight = calibration.color_camera_calibration.resolution_height;
+	memcpy(colorRotation, calibration.color_camera_calibration.extrinsics.rotation, sizeof(float) * 9);
+	memcpy(depthTranslation, calibration.color_camera_calibration.extrinsics.translation, sizeof(float) * 3);
+	*colorIntrinsicsCount = calibration.color_camera_calibration.intrinsics.parameter_count;
+	if ((*colorIntrinsicsCount) > colorIntrinsicsLength)
+	{
+		return false;
+	}
+	memcpy(colorIntrinsics, calibration.color_camera_calibration.intrinsics.parameters.v, sizeof(float) * (*colorIntrinsicsCount));
+
+	*depthWidth = calibration.depth_camera_calibration.resolution_width;
+	*depthHeight = calibration.depth_camera_calibration.resolution_height;
+	memcpy(depthRotation, calibration.depth_camera_calibration.extrinsics.rotation, sizeof(float) * 9);
+	memcpy(depthTranslation, calibration.depth_camera_calibration.extrinsics.translation, sizeof(float) * 3);
+	*depthIntrinsicsCount = calibration.depth_camera_calibration.intrinsics.parameter_count;
+	if ((*depthIntrinsicsCount) > depthIntrinsicsLength)
+	{
+		return false;
+	}
+	memcpy(depthIntrinsics, calibration.depth_camera_calibration.intrinsics.parameters.v, sizeof(float) * (*depthIntrinsicsCount));
+
+	return true;
+}
+
+bool AzureKinectWrapper::TryGetImageBuffers(
+	int index,
+	byte *transformedColorImageData,
+	int transformedColorImageSize,
+	byte *depthImageData,
+	int depthImageSize,
+	byte *pointCloudTemplateImageData,
+	int pointCloudTemplateImageSize)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return false;
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	if (slot->cachedTransformedColorImageBuffer != nullptr &&
+		slot->cachedDepthImageBuffer != nullptr &&
+		slot->cachedPointCloudTemplateImageBuffer != nullptr)
+	{
+		int colorSize = slot->cachedTransformedColorImageBuffer->GetSize();
+		if (transformedColorImageSize == colorSize)
+		{
+			memcpy(transformedColorImageData, slot->cachedTransformedColorImageBuffer->buffer, transformedColorImageSize);
+		}
+
+		int depthSize = slot->cachedDepthImageBuffer->GetSize();
+		if (depthImageSize == depthSize)
+		{
+			memcpy(depthImageData, slot->cachedDepthImageBuffer->buffer, depthImageSize);
+		}
+
+		int pointCloudSize = slot->cachedPointCloudTemplateImageBuffer->GetSize();
+		if (pointCloudTemplateImageSize == pointCloudSize)
+		{
+			memcpy(pointCloudTemplateImageData, slot->cachedPointCloudTemplateImageBuffer->buffer, pointCloudTemplateImageSize);
+		}
+
+		LeaveCriticalSection(&slot->slotCritSec);
+		return true;
+	}
+
+	LeaveCriticalSection(&slot->slotCritSec);
+	return false;
+}
+
+void AzureKinectWrapper::StopStreamingAll()
+{
+	for (unsigned int index = 0; index < MaxDeviceCount; index++)
+	{
+		if (deviceSlots[index].device != nullptr ||
+			deviceSlots[index].startThread.joinable())
+		{
+			StopStreaming(index);
+		}
+	}
+}
+
+void AzureKinectWrapper::StopStreaming(unsigned int index)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		output_device_message(L"Asked to close unknown device: ", index);
+		return;
+	}
+
+	// A start still in flight is waited for and whatever it opened is closed again
+	if (slot->startThread.joinable())
+	{
+		FinishDeviceStart(index, false);
+	}
+
+	// The imu and capture readers have to be gone before the device is closed
+	StopImu(index);
+
+	if (slot->captureQueue != nullptr)
+	{
+		slot->captureQueue->Stop();
+		slot->captureQueue = nullptr;
+	}
+
+    if (slot->device != nullptr)
+    {
+        OutputDebugString(L"Closed device: " + index);
+        k4a_device_close(slot->device);
+		slot->device = nullptr;
+		activeDeviceCount--;
+    }
+    else
+    {
+        OutputDebugString(L"Asked to close unknown device: " + index);
+    }
+
+	// The handles are cleared under the lock together with the cached buffers, so fusion and export either
+	// see a whole frame or none, and released once it is left. Readers that took a reference keep theirs.
+	EnterCriticalSection(&slot->slotCritSec);
+	k4a_transformation_t transformation = slot->transformation;
+	k4a_image_t slotImages[] =
+	{
+		slot->transformedColorImage,
+		slot->xyTableImage,
+		slot->pointCloudTemplateImage,
+		slot->undistortLut
+	};
+	slot->transformation = nullptr;
+	slot->transformedColorImage = nullptr;
+	slot->xyTableImage = nullptr;
+	slot->pointCloudTemplateImage = nullptr;
+	slot->undistortLut = nullptr;
+	slot->streaming = false;
+	slot->startState = DeviceStartStateIdle;
+	slot->frameCallback = nullptr;
+	slot->frameCallbackContext = nullptr;
+	ReleaseResources(slot->resources);
+	slot->hasResources = false;
+
+	for (auto &pyramidLevel : slot->pyramidLevels)
+	{
+		ReleaseResources(pyramidLevel.resources);
+		pyramidLevel = PyramidLevel{};
+	}
+
+	ReleaseResources(slot->undistortResources);
+	slot->undistortedDepthSubscriberCount = 0;
+	slot->undistortedIRSubscriberCount = 0;
+	slot->hasUndistortPinhole = false;
+	slot->undistortedDepthImageBuffer = nullptr;
+	slot->undistortedIRImageBuffer = nullptr;
+	slot->undistortStats = {};
+
+	ReleaseColorUv(*slot);
+	slot->colorUvSubscriberCount = 0;
+	slot->colorUvStats = {};
+
+	// The settings stay for the next start, the references are rebuilt by its first frame
+	slot->hasChangeReference = false;
+	slot->framesSinceKeyframe = 0;
+	slot->changeDepthReference = nullptr;
+	slot->changeIRReference = nullptr;
+	slot->changeMaskWork.clear();
+	slot->changeMask.clear();
+	slot->changedRect = {};
+	slot->frameUnchanged = false;
+	slot->changeDetectionStats = {};
+
+	// The settings stay as well, the scratch is given back and sized again by the next frame
+	std::vector<float>().swap(slot->outlierRatios);
+	std::vector<double>().swap(slot->outlierScratch);
+	std::vector<double>().swap(slot->outlierBandSums);
+	std::vector<uint8_t>().swap(slot->outlierMaskWork);
+	std::vector<uint8_t>().swap(slot->outlierMask);
+	slot->outlierFilterStats = {};
+
+	// Readers see the ring closed, the next start creates a new one under the same name
+	slot->sharedFrameWriter = nullptr;
+	slot->sharedFrameCalibrationVersion = 0;
+	slot->sharedFrameStats = {};
+
+	slot->hasCalibration = false;
+	slot->cachedTransformedColorImageBuffer = nullptr;
+	slot->cachedDepthImageBuffer = nullptr;
+	slot->cachedPointCloudTemplateImageBuffer = nullptr;
+	slot->depthTimestampUsec = 0;
+	slot->frameTimestamps = {};
+	slot->depthHostTimestampMapped = false;
+	slot->clockMapper.Reset();
+	LeaveCriticalSection(&slot->slotCritSec);
+
+	if (transformation != nullptr)
+	{
+		k4a_transformation_destroy(transformation);
+	}
+	for (k4a_image_t image : slotImages)
+	{
+		if (image != nullptr)
+		{
+			k4a_image_release(image);
+		}
+	}
+
+	DisableSpatialIndex(index);
+	ClearWorldTransform(index);
+	DestroyTsdfVolume(index);
+
+	EnterCriticalSection(&slot->slotCritSec);
+	slot->irSubscriberCount = 0;
+	LeaveCriticalSection(&slot->slotCritSec);
+	ReleaseIRImages(index);
+
+	// Waiters see the device is gone and give up
+	WakeAllConditionVariable(&slot->frameAvailable);
+
+	// With nothing left running the pool's buffers would only sit there until the next start
+	if (activeDeviceCount == 0 &&
+		startupStats.pendingCount == 0)
+	{
+		TrimMemory();
+	}
+}
+
+bool AzureKinectWrapper::TryEnableSpatialIndex(
+	unsigned int index,
+	float cellSize,
+	bool benchmark)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr ||
+		slot->device == nullptr)
+	{
+		output_device_message(L"Unable to create spatial index for unknown device: ", index);
+		return false;
+	}
+
+	auto spatialIndex = std::make_shared<PointCloudSpatialIndex>(cellSize, benchmark);
+	EnterCriticalSection(&slot->slotCritSec);
+	slot->spatialIndex = spatialIndex;
+	LeaveCriticalSection(&slot->slotCritSec);
+	return true;
+}
+
+void AzureKinectWrapper::DisableSpatialIndex(unsigned int index)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot != nullptr)
+	{
+		EnterCriticalSection(&slot->slotCritSec);
+		slot->spatialIndex = nullptr;
+		LeaveCriticalSection(&slot->slotCritSec);
+	}
+}
+
+bool AzureKinectWrapper::TryRaycastPointCloud(
+	unsigned int index,
+	float *origin,
+	float *direction,
+	float maxDistance,
+	float pickRadius,
+	float *hitPoint,
+	int *hitPixelIndex)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	auto spatialIndex = slot != nullptr ? LoadSlotPointer(*slot, &DeviceSlot::spatialIndex) : nullptr;
+	if (spatialIndex == nullptr)
+	{
+		return false;
+	}
+
+	return spatialIndex->TryRaycast(origin, direction, maxDistance, pickRadius, hitPoint, *hitPixelIndex);
+}
+
+bool AzureKinectWrapper::TryGetNearestPoints(
+	unsigned int index,
+	float *point,
+	int k,
+	int *pixelIndices,
+	float *distances,
+	int *count)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	auto spatialIndex = slot != nullptr ? LoadSlotPointer(*slot, &DeviceSlot::spatialIndex) : nullptr;
+	if (spatialIndex == nullptr)
+	{
+		return false;
+	}
+
+	*count = spatialIndex->FindNearest(point, k, pixelIndices, distances);
+	return true;
+}
+
+bool AzureKinectWrapper::TryGetPointsInRadius(
+	unsigned int index,
+	float *point,
+	float radius,
+	int *pixelIndices,
+	int capacity,
+	int *count)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	auto spatialIndex = slot != nullptr ? LoadSlotPointer(*slot, &DeviceSlot::spatialIndex) : nullptr;
+	if (spatialIndex == nullptr)
+	{
+		return false;
+	}
+
+	*count = spatialIndex->FindInRadius(point, radius, pixelIndices, capacity);
+	return true;
+}
+
+bool AzureKinectWrapper::TryGetSpatialIndexStats(
+	unsigned int index,
+	int *pointCount,
+	float *cellSize,
+	float *buildMilliseconds,
+	float *queryMilliseconds,
+	float *bruteForceMilliseconds)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	auto spatialIndex = slot != nullptr ? LoadSlotPointer(*slot, &DeviceSlot::spatialIndex) : nullptr;
+	if (spatialIndex == nullptr)
+	{
+		return false;
+	}
+
+	auto stats = spatialIndex->GetStats();
+	*pointCount = stats.pointCount;
+	*cellSize = stats.cellSize;
+	*buildMilliseconds = stats.buildMilliseconds;
+	*queryMilliseconds = stats.queryMilliseconds;
+	*bruteForceMilliseconds = stats.bruteForceMilliseconds;
+	return true;
+}
+
+AzureKinectWrapper::DeviceResources AzureKinectWrapper::CreateDeviceResources(const k4a_calibration_t &calibration)
+{
+	const unsigned int width = static_cast<unsigned int>(calibration.depth_camera_calibration.resolution_width);
+	const unsigned int height = static_cast<unsigned int>(calibration.depth_camera_calibration.resolution_height);
+	return DeviceResources
+	{
+		nullptr,
+		nullptr,
+		FrameDimensions{ width, height, static_cast<unsigned int>(4 * sizeof(uint8_t)) },
+		nullptr,
+		nullptr,
+		FrameDimensions{ width, height, static_cast<unsigned int>(sizeof(uint16_t)) },
+		nullptr,
+		nullptr,
+		FrameDimensions{ width, height, static_cast<unsigned int>(4 * sizeof(float)) },
+		nullptr,
+		nullptr,
+		FrameDimensions{ width, height, static_cast<unsigned int>(sizeof(uint16_t)) } };
+}
+
+void AzureKinectWrapper::ReleaseResources(DeviceResources &resources)
+{
+	// Unregistering first, so a render thread drain never touches a released texture
+	for (int uploadTarget : {
+		resources.rgbUploadTarget,
+		resources.depthUploadTarget,
+		resources.pointCloudTemplateUploadTarget,
+		resources.irUploadTarget })
+	{
+		uploadQueue->UnregisterTarget(uploadTarget);
+	}
+
+	for (ID3D11ShaderResourceView *srv : { resources.rgbSrv, resources.depthSrv, resources.pointCloudTemplateSrv, resources.irSrv })
+	{
+		if (srv != nullptr)
+		{
+			srv->Release();
+		}
+	}
+
+	for (ID3D11Texture2D *tex : { resources.rgbTexture, resources.depthTexture, resources.pointCloudTemplateTexture, resources.irTexture })
+	{
+		if (tex != nullptr)
+		{
+			tex->Release();
+		}
+	}
+
+	resources = {};
+}
+
+void AzureKinectWrapper::AddResourceMemory(const DeviceResources &resources, DeviceMemoryStats &stats)
+{
+	struct TextureEntry
+	{
+		ID3D11Texture2D *texture;
+		const FrameDimensions &dimensions;
+		int uploadTarget;
+	};
+	const TextureEntry textures[] = {
+		{ resources.rgbTexture, resources.rgbFrameDimensions, resources.rgbUploadTarget },
+		{ resources.depthTexture, resources.depthFrameDimensions, resources.depthUploadTarget },
+		{ resources.pointCloudTemplateTexture, resources.pointCloudTemplateFrameDimensions, resources.pointCloudTemplateUploadTarget },
+		{ resources.irTexture, resources.irFrameDimensions, resources.irUploadTarget } };
+
+	for (auto &entry : textures)
+	{
+		if (entry.texture == nullptr)
+		{
+			continue;
+		}
+
+		stats.textureCount++;
+		stats.textureBytes += static_cast<uint64_t>(entry.dimensions.width) * entry.dimensions.height * entry.dimensions.bpp;
+
+		uint64_t uploadBytes = uploadQueue->GetTargetBytes(entry.uploadTarget);
+		if (uploadBytes > 0)
+		{
+			stats.uploadTargetCount++;
+			stats.uploadBytes += uploadBytes;
+		}
+	}
+}
+
+void AzureKinectWrapper::UpdateResources(k4a_image_t image,
+                                         ID3D11ShaderResourceView *&srv,
+                                         ID3D11Texture2D *&tex,
+                                         FrameDimensions &dim,
+                                         DXGI_FORMAT format,
+                                         int &uploadTarget,
+                                         const PixelRect *rect)
+{
+    UpdateResources(k4a_image_get_buffer(image),
+        k4a_image_get_width_pixels(image),
+        k4a_image_get_height_pixels(image),
+        k4a_image_get_stride_bytes(image),
+        srv,
+        tex,
+        dim,
+        format,
+        uploadTarget,
+        rect);
+}
+
+void AzureKinectWrapper::UpdateResources(const byte *buffer,
+                                         int width,
+                                         int height,
+                                         int stride,
+                                         ID3D11ShaderResourceView *&srv,
+                                         ID3D11Texture2D *&tex,
+                                         FrameDimensions &dim,
+                                         DXGI_FORMAT format,
+                                         int &uploadTarget,
+                                         const PixelRect *rect)
+{
+    dim.height = height;
+    dim.width = width;
+    dim.bpp = stride / dim.width;
+
+    if (tex == nullptr)
+    {
+        tex = DirectXHelper::CreateTexture(d3d11Device, buffer, dim.width, dim.height, dim.bpp, format);
+    }
+
+    if (srv == nullptr)
+    {
+        srv = DirectXHelper::CreateShaderResourceView(d3d11Device, tex, format);
+        return;
+    }
+
+	if (uploadTarget < 0)
+	{
+		uploadTarget = uploadQueue->RegisterTarget(tex, dim.width, dim.height, stride);
+	}
+
+	if (uploadTarget < 0)
+	{
+        DirectXHelper::UpdateShaderResourceView(d3d11Device, srv, buffer, stride);
+		return;
+	}
+
+	if (rect != nullptr)
+	{
+		uploadQueue->Submit(uploadTarget, buffer, *rect);
+	}
+	else
+	{
+		uploadQueue->Submit(uploadTarget, buffer);
+	}
+
+	if (!renderThreadUploads.load())
+	{
+		uploadQueue->Drain();
+	}
+}
+void AzureKinectWrapper::UpdatePyramid(DeviceSlot &slot, k4a_image_t depthImage, k4a_image_t colorImage)
+{
+	int levelCount = slot.pyramidLevels[PyramidLevelCount - 1].subscriberCount > 0 ? PyramidLevelCount : 1;
+	const uint16_t *depthSource = reinterpret_cast<uint16_t*>(k4a_image_get_buffer(depthImage));
+	const uint8_t *colorSource = colorImage != nullptr ? k4a_image_get_buffer(colorImage) : nullptr;
+	int width = k4a_image_get_width_pixels(depthImage);
+	int height = k4a_image_get_height_pixels(depthImage);
+
+	for (int level = 0; level < levelCount; level++)
+	{
+		PyramidLevel &pyramidLevel = slot.pyramidLevels[level];
+		FrameDimensions depthDimensions = {
+			static_cast<unsigned int>(width / 2),
+			static_cast<unsigned int>(height / 2),
+			static_cast<unsigned int>(sizeof(uint16_t)) };
+		FrameDimensions colorDimensions = {
+			depthDimensions.width,
+			depthDimensions.height,
+			static_cast<unsigned int>(4 * sizeof(uint8_t)) };
+		if (depthDimensions.width == 0 ||
+			depthDimensions.height == 0)
+		{
+			return;
+		}
+
+		if (pyramidLevel.depthImageBuffer == nullptr)
+		{
+			pyramidLevel.depthImageBuffer = std::make_shared<ImageBuffer>(depthDimensions);
+			pyramidLevel.colorImageBuffer = std::make_shared<ImageBuffer>(colorDimensions);
+		}
+
+		uint16_t *depthData = reinterpret_cast<uint16_t*>(pyramidLevel.depthImageBuffer->buffer);
+		uint8_t *colorData = pyramidLevel.colorImageBuffer->buffer;
+		downsample_depth_2x(depthSource, width, height, depthData, slot.pyramidDepthFilter);
+		if (colorSource != nullptr)
+		{
+			downsample_bgra_2x(colorSource, width, height, colorData);
+			pyramidLevel.hasColor = true;
+		}
+
+		// Levels only built on the way to a smaller one are not uploaded
+		if (pyramidLevel.subscriberCount > 0)
+		{
+			UpdateResources(reinterpret_cast<byte*>(depthData),
+				depthDimensions.width,
+				depthDimensions.height,
+				depthDimensions.width * depthDimensions.bpp,
+				pyramidLevel.resources.depthSrv,
+				pyramidLevel.resources.depthTexture,
+				pyramidLevel.resources.depthFrameDimensions,
+				DXGI_FORMAT_R16_UNORM,
+				pyramidLevel.resources.depthUploadTarget,
+				nullptr);
+
+			if (colorSource != nullptr)
+			{
+				UpdateResources(colorData,
+					colorDimensions.width,
+					colorDimensions.height,
+					colorDimensions.width * colorDimensions.bpp,
+					pyramidLevel.resources.rgbSrv,
+					pyramidLevel.resources.rgbTexture,
+					pyramidLevel.resources.rgbFrameDimensions,
+					DXGI_FORMAT_B8G8R8A8_UNORM,
+					pyramidLevel.resources.rgbUploadTarget,
+					nullptr);
+			}
+		}
+
+		depthSource = depthData;
+		colorSource = colorSource != nullptr ? colorData : nullptr;
+		width = depthDimensions.width;
+		height = depthDimensions.height;
+	}
+}
+
+void AzureKinectWrapper::SubscribePyramidLevel(unsigned int index, int level)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr ||
+		level < 1 ||
+		level > PyramidLevelCount)
+	{
+		return;
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	slot->pyramidLevels[level - 1].subscriberCount++;
+	LeaveCriticalSection(&slot->slotCritSec);
+}
+
+void AzureKinectWrapper::UnsubscribePyramidLevel(unsigned int index, int level)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr ||
+		level < 1 ||
+		level > PyramidLevelCount)
+	{
+		return;
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	if (slot->pyramidLevels[level - 1].subscriberCount > 0)
+	{
+		slot->pyramidLevels[level - 1].subscriberCount--;
+	}
+	LeaveCriticalSection(&slot->slotCritSec);
+}
+
+bool AzureKinectWrapper::TrySetPyramidDepthFilter(unsigned int index, PyramidDepthFilter filter)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr ||
+		(filter != PyramidDepthFilterMin && filter != PyramidDepthFilterMedian))
+	{
+		return false;
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	slot->pyramidDepthFilter = filter;
+	LeaveCriticalSection(&slot->slotCritSec);
+	return true;
+}
+
+bool AzureKinectWrapper::TryGetPyramidShaderResourceViews(
+	unsigned int index,
+	int level,
+	ID3D11ShaderResourceView *&rgbSrv,
+	unsigned int &rgbWidth,
+	unsigned int &rgbHeight,
+	ID3D11ShaderResourceView *&depthSrv,
+	unsigned int &depthWidth,
+	unsigned int &depthHeight)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr ||
+		level < 1 ||
+		level > PyramidLevelCount)
+	{
+		return false;
+	}
+
+	// The color view stays null until a frame with color arrived
+	EnterCriticalSection(&slot->slotCritSec);
+	const DeviceResources &resources = slot->pyramidLevels[level - 1].resources;
+	if (resources.depthSrv == nullptr)
+	{
+		LeaveCriticalSection(&slot->slotCritSec);
+		return false;
+	}
+
+	rgbSrv = resources.rgbSrv;
+	rgbWidth = resources.rgbFrameDimensions.width;
+	rgbHeight = resources.rgbFrameDimensions.height;
+	depthSrv = resources.depthSrv;
+	depthWidth = resources.depthFrameDimensions.width;
+	depthHeight = resources.depthFrameDimensions.height;
+	LeaveCriticalSection(&slot->slotCritSec);
+	return true;
+}
+
+bool AzureKinectWrapper::TryGetPyramidImageBuffers(
+	unsigned int index,
+	int level,
+	byte *colorImageData,
+	int colorImageSize,
+	byte *depthImageData,
+	int depthImageSize)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr ||
+		level < 1 ||
+		level > PyramidLevelCount)
+	{
+		return false;
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	const PyramidLevel &pyramidLevel = slot->pyramidLevels[level - 1];
+	if (pyramidLevel.subscriberCount == 0 ||
+		pyramidLevel.depthImageBuffer == nullptr ||
+		pyramidLevel.depthImageBuffer->GetSize() != depthImageSize ||
+		pyramidLevel.colorImageBuffer->GetSize() != colorImageSize)
+	{
+		LeaveCriticalSection(&slot->slotCritSec);
+		return false;
+	}
+
+	memcpy(depthImageData, pyramidLevel.depthImageBuffer->buffer, depthImageSize);
+	if (pyramidLevel.hasColor)
+	{
+		memcpy(colorImageData, pyramidLevel.colorImageBuffer->buffer, colorImageSize);
+	}
+	else
+	{
+		memset(colorImageData, 0, colorImageSize);
+	}
+	LeaveCriticalSection(&slot->slotCritSec);
+	return true;
+}
+
+void AzureKinectWrapper::UpdateUndistortLut(DeviceSlot &slot, interpolation_t interpolation)
+{
+	// Both bilinear modes share a layout, only the remap differs
+	bool bilinear = interpolation != INTERPOLATION_NEARESTNEIGHBOR;
+	if (slot.undistortLut != nullptr &&
+		slot.undistortLutBilinear == bilinear)
+	{
+		return;
+	}
+
+	auto start = TimingHelper::GetTimestampMicroseconds();
+	pinhole_t pinhole = create_pinhole_from_xy_range(&slot.calibration, K4A_CALIBRATION_TYPE_DEPTH);
+	if (slot.undistortLut == nullptr)
+	{
+		ImagePool::GetShared().TryCreateImage(K4A_IMAGE_FORMAT_CUSTOM,
+			pinhole.width,
+			pinhole.height,
+			pinhole.width * (int)sizeof(lut_entry_t),
+			&slot.undistortLut);
+	}
+
+	create_undistortion_lut(&slot.calibration, K4A_CALIBRATION_TYPE_DEPTH, &pinhole, slot.undistortLut, interpolation);
+	slot.undistortLutBilinear = bilinear;
+
+	EnterCriticalSection(&slot.slotCritSec);
+	slot.undistortPinhole = pinhole;
+	slot.hasUndistortPinhole = true;
+	slot.undistortStats.lutBytes = k4a_image_get_size(slot.undistortLut);
+	slot.undistortStats.lutMilliseconds = TimingHelper::GetElapsedMilliseconds(start);
+	LeaveCriticalSection(&slot.slotCritSec);
+}
+
+void AzureKinectWrapper::UpdateUndistorted(DeviceSlot &slot, k4a_image_t depthImage, k4a_image_t irImage, interpolation_t interpolation)
+{
+	const pinhole_t &pinhole = slot.undistortPinhole;
+	const lut_entry_t *lutData = reinterpret_cast<lut_entry_t*>(k4a_image_get_buffer(slot.undistortLut));
+	FrameDimensions dimensions = {
+		static_cast<unsigned int>(pinhole.width),
+		static_cast<unsigned int>(pinhole.height),
+		static_cast<unsigned int>(sizeof(uint16_t)) };
+
+	if (depthImage != nullptr)
+	{
+		if (slot.undistortedDepthImageBuffer == nullptr)
+		{
+			slot.undistortedDepthImageBuffer = std::make_shared<ImageBuffer>(dimensions);
+		}
+
+		auto start = TimingHelper::GetTimestampMicroseconds();
+		remap(reinterpret_cast<uint16_t*>(k4a_image_get_buffer(depthImage)),
+			k4a_image_get_width_pixels(depthImage),
+			lutData,
+			reinterpret_cast<uint16_t*>(slot.undistortedDepthImageBuffer->buffer),
+			pinhole.width,
+			pinhole.height,
+			interpolation);
+		slot.undistortStats.depthRemapMilliseconds = TimingHelper::GetElapsedMilliseconds(start);
+
+		UpdateResources(slot.undistortedDepthImageBuffer->buffer,
+			pinhole.width,
+			pinhole.height,
+			pinhole.width * (int)sizeof(uint16_t),
+			slot.undistortResources.depthSrv,
+			slot.undistortResources.depthTexture,
+			slot.undistortResources.depthFrameDimensions,
+			DXGI_FORMAT_R16_UNORM,
+			slot.undistortResources.depthUploadTarget,
+			nullptr);
+	}
+
+	if (irImage != nullptr)
+	{
+		if (slot.undistortedIRImageBuffer == nullptr)
+		{
+			slot.undistortedIRImageBuffer = std::make_shared<ImageBuffer>(dimensions);
+		}
+
+		// Zero is a valid ir value, the depth edge test does not apply
+		auto start = TimingHelper::GetTimestampMicroseconds();
+		remap(reinterpret_cast<uint16_t*>(k4a_image_get_buffer(irImage)),
+			k4a_image_get_width_pixels(irImage),
+			lutData,
+			reinterpret_cast<uint16_t*>(slot.undistortedIRImageBuffer->buffer),
+			pinhole.width,
+			pinhole.height,
+			interpolation == INTERPOLATION_BILINEAR_DEPTH ? INTERPOLATION_BILINEAR : interpolation);
+		slot.undistortStats.irRemapMilliseconds = TimingHelper::GetElapsedMilliseconds(start);
+
+		UpdateResources(slot.undistortedIRImageBuffer->buffer,
+			pinhole.width,
+			pinhole.height,
+			pinhole.width * (int)sizeof(uint16_t),
+			slot.undistortResources.irSrv,
+			slot.undistortResources.irTexture,
+			slot.undistortResources.irFrameDimensions,
+			DXGI_FORMAT_R16_UNORM,
+			slot.undistortResources.irUploadTarget,
+			nullptr);
+	}
+}
+
+void AzureKinectWrapper::SubscribeUndistortedStream(unsigned int index, UndistortedStream stream)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return;
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	if (stream == UndistortedStreamDepth)
+	{
+		slot->undistortedDepthSubscriberCount++;
+	}
+	else if (stream == UndistortedStreamIR)
+	{
+		slot->undistortedIRSubscriberCount++;
+	}
+	LeaveCriticalSection(&slot->slotCritSec);
+}
+
+void AzureKinectWrapper::UnsubscribeUndistortedStream(unsigned int index, UndistortedStream stream)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return;
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	int *subscriberCount =
+		stream == UndistortedStreamDepth ? &slot->undistortedDepthSubscriberCount :
+		stream == UndistortedStreamIR ? &slot->undistortedIRSubscriberCount :
+		nullptr;
+	if (subscriberCount != nullptr &&
+		*subscriberCount > 0)
+	{
+		(*subscriberCount)--;
+	}
+	LeaveCriticalSection(&slot->slotCritSec);
+}
+
+bool AzureKinectWrapper::TrySetUndistortInterpolation(unsigned int index, interpolation_t interpolation)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr ||
+		(interpolation != INTERPOLATION_NEARESTNEIGHBOR &&
+		interpolation != INTERPOLATION_BILINEAR &&
+		interpolation != INTERPOLATION_BILINEAR_DEPTH))
+	{
+		return false;
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	slot->undistortInterpolation = interpolation;
+	LeaveCriticalSection(&slot->slotCritSec);
+	return true;
+}
+
+bool AzureKinectWrapper::TryGetUndistortedPinhole(
+	unsigned int index,
+	float *fx,
+	float *fy,
+	float *px,
+	float *py,
+	int *width,
+	int *height)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return false;
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	bool hasPinhole = slot->hasUndistortPinhole;
+	pinhole_t pinhole = slot->undistortPinhole;
+	LeaveCriticalSection(&slot->slotCritSec);
+	if (!hasPinhole)
+	{
+		return false;
+	}
+
+	*fx = pinhole.fx;
+	*fy = pinhole.fy;
+	*px = pinhole.px;
+	*py = pinhole.py;
+	*width = pinhole.width;
+	*height = pinhole.height;
+	return true;
+}
+
+bool AzureKinectWrapper::TryGetUndistortedShaderResourceViews(
+	unsigned int index,
+	ID3D11ShaderResourceView *&depthSrv,
+	unsigned int &depthWidth,
+	unsigned int &depthHeight,
+	ID3D11ShaderResourceView *&irSrv,
+	unsigned int &irWidth,
+	unsigned int &irHeight)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return false;
+	}
+
+	// Each view stays null until its stream was subscribed and a frame arrived
+	EnterCriticalSection(&slot->slotCritSec);
+	const DeviceResources &resources = slot->undistortResources;
+	depthSrv = resources.depthSrv;
+	depthWidth = resources.depthFrameDimensions.width;
+	depthHeight = resources.depthFrameDimensions.height;
+	irSrv = resources.irSrv;
+	irWidth = resources.irFrameDimensions.width;
+	irHeight = resources.irFrameDimensions.height;
+	LeaveCriticalSection(&slot->slotCritSec);
+	return depthSrv != nullptr || irSrv != nullptr;
+}
+
+bool AzureKinectWrapper::TryGetUndistortedImageBuffers(
+	unsigned int index,
+	byte *depthImageData,
+	int depthImageSize,
+	byte *irImageData,
+	int irImageSize)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return false;
+	}
+
+	// Either buffer may be left out, what is passed has to match and be available
+	EnterCriticalSection(&slot->slotCritSec);
+	auto depthImageBuffer = slot->undistortedDepthImageBuffer;
+	auto irImageBuffer = slot->undistortedIRImageBuffer;
+	bool copied = false;
+	if (depthImageData != nullptr &&
+		depthImageBuffer != nullptr &&
+		depthImageBuffer->GetSize() == depthImageSize)
+	{
+		memcpy(depthImageData, depthImageBuffer->buffer, depthImageSize);
+		copied = true;
+	}
+
+	if (irImageData != nullptr &&
+		irImageBuffer != nullptr &&
+		irImageBuffer->GetSize() == irImageSize)
+	{
+		memcpy(irImageData, irImageBuffer->buffer, irImageSize);
+		copied = true;
+	}
+	LeaveCriticalSection(&slot->slotCritSec);
+	return copied;
+}
+
+bool AzureKinectWrapper::TryGetUndistortStats(
+	unsigned int index,
+	int *interpolation,
+	uint64_t *lutBytes,
+	float *lutMilliseconds,
+	float *depthRemapMilliseconds,
+	float *irRemapMilliseconds)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return false;
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	*interpolation = slot->undistortInterpolation;
+	UndistortStats stats = slot->undistortStats;
+	bool hasPinhole = slot->hasUndistortPinhole;
+	LeaveCriticalSection(&slot->slotCritSec);
+
+	*lutBytes = stats.lutBytes;
+	*lutMilliseconds = stats.lutMilliseconds;
+	*depthRemapMilliseconds = stats.depthRemapMilliseconds;
+	*irRemapMilliseconds = stats.irRemapMilliseconds;
+	return hasPinhole;
+}
+
+bool AzureKinectWrapper::TryBenchmarkUndistort(
+	unsigned int index,
+	int iterations,
+	float *nearestNeighborMilliseconds,
+	float *bilinearMilliseconds,
+	float *bilinearDepthMilliseconds)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr ||
+		iterations < 1)
+	{
+		return false;
+	}
+
+	// Runs on a copy of the latest depth frame with luts of its own, the streams are not disturbed
+	EnterCriticalSection(&slot->slotCritSec);
+	bool hasCalibration = slot->hasCalibration;
+	k4a_calibration_t calibration = slot->calibration;
+	std::vector<uint16_t> depthData;
+	if (hasCalibration &&
+		slot->cachedDepthImageBuffer != nullptr)
+	{
+		const uint16_t *cachedDepthData = reinterpret_cast<uint16_t*>(slot->cachedDepthImageBuffer->buffer);
+		depthData.assign(cachedDepthData, cachedDepthData + slot->cachedDepthImageBuffer->GetSize() / sizeof(uint16_t));
+	}
+	LeaveCriticalSection(&slot->slotCritSec);
+
+	if (depthData.empty())
+	{
+		return false;
+	}
+
+	pinhole_t pinhole = create_pinhole_from_xy_range(&calibration, K4A_CALIBRATION_TYPE_DEPTH);
+	k4a_image_t lut;
+	if (!ImagePool::GetShared().TryCreateImage(K4A_IMAGE_FORMAT_CUSTOM,
+		pinhole.width,
+		pinhole.height,
+		pinhole.width * (int)sizeof(lut_entry_t),
+		&lut))
+	{
+		return false;
+	}
+
+	const lut_entry_t *lutData = reinterpret_cast<lut_entry_t*>(k4a_image_get_buffer(lut));
+	std::vector<uint16_t> undistortedData((size_t)pinhole.width * pinhole.height);
+	float *results[] = { nearestNeighborMilliseconds, bilinearMilliseconds, bilinearDepthMilliseconds };
+	for (int type = INTERPOLATION_NEARESTNEIGHBOR; type <= INTERPOLATION_BILINEAR_DEPTH; type++)
+	{
+		// The depth mode reuses the bilinear lut
+		interpolation_t interpolation = static_cast<interpolation_t>(type);
+		if (interpolation != INTERPOLATION_BILINEAR_DEPTH)
+		{
+			create_undistortion_lut(&calibration, K4A_CALIBRATION_TYPE_DEPTH, &pinhole, lut, interpolation);
+		}
+
+		auto start = TimingHelper::GetTimestampMicroseconds();
+		for (int iteration = 0; iteration < iterations; iteration++)
+		{
+			remap(depthData.data(),
+				calibration.depth_camera_calibration.resolution_width,
+				lutData,
+				undistortedData.data(),
+				pinhole.width,
+				pinhole.height,
+				interpolation);
+		}
+		*results[type] = TimingHelper::GetElapsedMilliseconds(start) / iterations;
+	}
+
+	k4a_image_release(lut);
+	return true;
+}
+
+void AzureKinectWrapper::UpdateColorUv(DeviceSlot &slot, k4a_image_t depthImage, k4a_image_t colorImage)
+{
+	const color_projection_t projection = create_color_projection(&slot.calibration);
+	const int width = k4a_image_get_width_pixels(depthImage);
+	const int height = k4a_image_get_height_pixels(depthImage);
+	if (projection.width == 0 ||
+		projection.height == 0)
+	{
+		return;
+	}
+
+	// Released whenever the format or the calibration changes, so existing buffers always fit
+	const ColorUvFormat format = slot.colorUvFormat;
+	FrameDimensions uvDimensions = {
+		static_cast<unsigned int>(width),
+		static_cast<unsigned int>(height),
+		static_cast<unsigned int>(color_uv_pixel_size(format)) };
+	FrameDimensions flagsDimensions = {
+		static_cast<unsigned int>(width),
+		static_cast<unsigned int>(height),
+		static_cast<unsigned int>(sizeof(uint8_t)) };
+	if (slot.colorUvImageBuffer == nullptr)
+	{
+		slot.colorUvImageBuffer = std::make_shared<ImageBuffer>(uvDimensions);
+		slot.colorUvFlagsImageBuffer = std::make_shared<ImageBuffer>(flagsDimensions);
+		slot.colorUvScratchBuffer = std::make_shared<ImageBuffer>(FrameDimensions{
+			static_cast<unsigned int>(width),
+			static_cast<unsigned int>(height),
+			static_cast<unsigned int>(3 * sizeof(float)) });
+		slot.colorUvZBuffer = std::make_shared<ImageBuffer>(FrameDimensions{
+			static_cast<unsigned int>(color_uv_zbuffer_size(&projection, width)),
+			1,
+			static_cast<unsigned int>(sizeof(float)) });
+	}
+
+	auto start = TimingHelper::GetTimestampMicroseconds();
+	color_uv_counts_t counts = compute_color_uv(&projection,
+		reinterpret_cast<uint16_t*>(k4a_image_get_buffer(depthImage)),
+		reinterpret_cast<k4a_float2_t*>(k4a_image_get_buffer(slot.xyTableImage)),
+		width,
+		height,
+		slot.colorUvOcclusionTolerance,
+		format,
+		reinterpret_cast<float*>(slot.colorUvScratchBuffer->buffer),
+		reinterpret_cast<float*>(slot.colorUvZBuffer->buffer),
+		slot.colorUvImageBuffer->buffer,
+		slot.colorUvFlagsImageBuffer->buffer);
+	slot.colorUvStats.projectMilliseconds = TimingHelper::GetElapsedMilliseconds(start);
+	slot.colorUvStats.validPixelCount = counts.valid;
+	slot.colorUvStats.occludedPixelCount = counts.occluded;
+
+	UpdateResources(slot.colorUvImageBuffer->buffer,
+		width,
+		height,
+		width * uvDimensions.bpp,
+		slot.colorUvResources.depthSrv,
+		slot.colorUvResources.depthTexture,
+		slot.colorUvResources.depthFrameDimensions,
+		format == ColorUvFormatRG16 ? DXGI_FORMAT_R16G16_UNORM : DXGI_FORMAT_R32G32_FLOAT,
+		slot.colorUvResources.depthUploadTarget,
+		nullptr);
+	UpdateResources(slot.colorUvFlagsImageBuffer->buffer,
+		width,
+		height,
+		width * flagsDimensions.bpp,
+		slot.colorUvResources.irSrv,
+		slot.colorUvResources.irTexture,
+		slot.colorUvResources.irFrameDimensions,
+		DXGI_FORMAT_R8_UNORM,
+		slot.colorUvResources.irUploadTarget,
+		nullptr);
+	uint64_t uploadBytes = static_cast<uint64_t>(slot.colorUvImageBuffer->GetSize()) + slot.colorUvFlagsImageBuffer->GetSize();
+
+	// The map samples the color image as the camera delivered it, only bgra can go up as is
+	if (colorImage != nullptr &&
+		k4a_image_get_format(colorImage) == K4A_IMAGE_FORMAT_COLOR_BGRA32)
+	{
+		UpdateResources(colorImage,
+			slot.colorUvResources.rgbSrv,
+			slot.colorUvResources.rgbTexture,
+			slot.colorUvResources.rgbFrameDimensions,
+			DXGI_FORMAT_B8G8R8A8_UNORM,
+			slot.colorUvResources.rgbUploadTarget,
+			nullptr);
+		uploadBytes += k4a_image_get_size(colorImage);
+	}
+	slot.colorUvStats.uploadBytes = uploadBytes;
+}
+
+void AzureKinectWrapper::ReleaseColorUv(DeviceSlot &slot)
+{
+	ReleaseResources(slot.colorUvResources);
+	slot.colorUvImageBuffer = nullptr;
+	slot.colorUvFlagsImageBuffer = nullptr;
+	slot.colorUvScratchBuffer = nullptr;
+	slot.colorUvZBuffer = nullptr;
+}
+
+void AzureKinectWrapper::SubscribeColorUvMap(unsigned int index)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return;
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	slot->colorUvSubscriberCount++;
+	LeaveCriticalSection(&slot->slotCritSec);
+}
+
+void AzureKinectWrapper::UnsubscribeColorUvMap(unsigned int index)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return;
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	if (slot->colorUvSubscriberCount > 0)
+	{
+		slot->colorUvSubscriberCount--;
+	}
+	LeaveCriticalSection(&slot->slotCritSec);
+}
+
+bool AzureKinectWrapper::TrySetColorUvFormat(unsigned int index, ColorUvFormat format, float occlusionTolerance)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr ||
+		(format != ColorUvFormatRG16 &&
+		format != ColorUvFormatRG32F) ||
+		!(occlusionTolerance >= 0.0f))
+	{
+		return false;
+	}
+
+	// Another layout needs another texture format, the views have to be fetched again
+	EnterCriticalSection(&slot->slotCritSec);
+	if (slot->colorUvFormat != format)
+	{
+		ReleaseColorUv(*slot);
+		slot->colorUvFormat = format;
+	}
+	slot->colorUvOcclusionTolerance = occlusionTolerance;
+	LeaveCriticalSection(&slot->slotCritSec);
+	return true;
+}
+
+bool AzureKinectWrapper::TrySetRegistrationEnabled(unsigned int index, bool enabled)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return false;
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	slot->registrationEnabled = enabled;
+	LeaveCriticalSection(&slot->slotCritSec);
+	return true;
+}
+
+bool AzureKinectWrapper::TryGetColorUvShaderResourceViews(
+	unsigned int index,
+	ID3D11ShaderResourceView *&colorSrv,
+	unsigned int &colorWidth,
+	unsigned int &colorHeight,
+	ID3D11ShaderResourceView *&uvSrv,
+	ID3D11ShaderResourceView *&flagsSrv,
+	unsigned int &uvWidth,
+	unsigned int &uvHeight)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return false;
+	}
+
+	// The color view stays null unless the camera delivers bgra
+	EnterCriticalSection(&slot->slotCritSec);
+	const DeviceResources &resources = slot->colorUvResources;
+	colorSrv = resources.rgbSrv;
+	colorWidth = resources.rgbFrameDimensions.width;
+	colorHeight = resources.rgbFrameDimensions.height;
+	uvSrv = resources.depthSrv;
+	flagsSrv = resources.irSrv;
+	uvWidth = resources.depthFrameDimensions.width;
+	uvHeight = resources.depthFrameDimensions.height;
+	LeaveCriticalSection(&slot->slotCritSec);
+	return uvSrv != nullptr;
+}
+
+bool AzureKinectWrapper::TryGetColorUvImageBuffers(
+	unsigned int index,
+	byte *uvImageData,
+	int uvImageSize,
+	byte *flagsImageData,
+	int flagsImageSize)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return false;
+	}
+
+	// Either buffer may be left out, what is passed has to match and be available
+	EnterCriticalSection(&slot->slotCritSec);
+	auto uvImageBuffer = slot->colorUvImageBuffer;
+	auto flagsImageBuffer = slot->colorUvFlagsImageBuffer;
+	bool copied = false;
+	if (uvImageData != nullptr &&
+		uvImageBuffer != nullptr &&
+		uvImageBuffer->GetSize() == uvImageSize)
+	{
+		memcpy(uvImageData, uvImageBuffer->buffer, uvImageSize);
+		copied = true;
+	}
+
+	if (flagsImageData != nullptr &&
+		flagsImageBuffer != nullptr &&
+		flagsImageBuffer->GetSize() == flagsImageSize)
+	{
+		memcpy(flagsImageData, flagsImageBuffer->buffer, flagsImageSize);
+		copied = true;
+	}
+	LeaveCriticalSection(&slot->slotCritSec);
+	return copied;
+}
+
+bool AzureKinectWrapper::TryGetColorUvStats(
+	unsigned int index,
+	int *validPixelCount,
+	int *occludedPixelCount,
+	float *projectMilliseconds,
+	uint64_t *uploadBytes,
+	float *registrationMilliseconds,
+	uint64_t *registrationUploadBytes)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return false;
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	ColorUvStats stats = slot->colorUvStats;
+	bool hasColorUv = slot->colorUvImageBuffer != nullptr;
+	LeaveCriticalSection(&slot->slotCritSec);
+
+	*validPixelCount = stats.validPixelCount;
+	*occludedPixelCount = stats.occludedPixelCount;
+	*projectMilliseconds = stats.projectMilliseconds;
+	*uploadBytes = stats.uploadBytes;
+	*registrationMilliseconds = stats.registrationMilliseconds;
+	*registrationUploadBytes = stats.registrationUploadBytes;
+	return hasColorUv;
+}
+
+uint64_t AzureKinectWrapper::CopyImageBuffer(k4a_image_t image, ImageBuffer &imageBuffer, const PixelRect *rect)
+{
+	auto buffer = k4a_image_get_buffer(image);
+	if (rect == nullptr)
+	{
+		memcpy(imageBuffer.buffer, buffer, imageBuffer.GetSize());
+		return imageBuffer.GetSize();
+	}
+
+	copy_rect(buffer, imageBuffer.buffer, imageBuffer.dimensions.width * imageBuffer.dimensions.bpp, imageBuffer.dimensions.bpp, *rect);
+	return static_cast<uint64_t>(rect->width) * rect->height * imageBuffer.dimensions.bpp;
+}
+
+bool AzureKinectWrapper::TrySetRegionOfInterest(
+	unsigned int index,
+	int x,
+	int y,
+	int width,
+	int height,
+	unsigned short minDepth,
+	unsigned short maxDepth,
+	float *boxMin,
+	float *boxMax)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr ||
+		width <= 0 ||
+		height <= 0 ||
+		(maxDepth != 0 && maxDepth < minDepth))
+	{
+		return false;
+	}
+
+	RegionOfInterest regionOfInterest = {};
+	regionOfInterest.rect = PixelRect{ x, y, width, height };
+	regionOfInterest.minDepth = minDepth;
+	regionOfInterest.maxDepth = maxDepth;
+	regionOfInterest.hasBox = boxMin != nullptr && boxMax != nullptr;
+	if (regionOfInterest.hasBox)
+	{
+		memcpy(regionOfInterest.boxMin, boxMin, sizeof(regionOfInterest.boxMin));
+		memcpy(regionOfInterest.boxMax, boxMax, sizeof(regionOfInterest.boxMax));
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	slot->regionOfInterest = regionOfInterest;
+	slot->hasRegionOfInterest = true;
+	slot->regionOfInterestChanged = true;
+	LeaveCriticalSection(&slot->slotCritSec);
+	return true;
+}
+
+void AzureKinectWrapper::ClearRegionOfInterest(unsigned int index)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return;
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	slot->hasRegionOfInterest = false;
+	slot->regionOfInterestChanged = true;
+	LeaveCriticalSection(&slot->slotCritSec);
+}
+
+bool AzureKinectWrapper::TryGetRegionOfInterestStats(
+	unsigned int index,
+	int *processedPixelCount,
+	int *keptPixelCount,
+	uint64_t *copiedBytes,
+	float *processMilliseconds)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return false;
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	auto stats = slot->regionOfInterestStats;
+	LeaveCriticalSection(&slot->slotCritSec);
+
+	*processedPixelCount = stats.processedPixelCount;
+	*keptPixelCount = stats.keptPixelCount;
+	*copiedBytes = stats.copiedBytes;
+	*processMilliseconds = stats.processMilliseconds;
+	return true;
+}
+
+bool AzureKinectWrapper::DetectChanges(
+	DeviceSlot &slot,
+	k4a_image_t depthImage,
+	k4a_image_t irImage,
+	const ChangeDetectionSettings &settings,
+	bool forceKeyframe,
+	PixelRect &changedRect,
+	int &changedTileCount)
+{
+	const int width = k4a_image_get_width_pixels(depthImage);
+	const int height = k4a_image_get_height_pixels(depthImage);
+	const uint16_t *depthData = reinterpret_cast<uint16_t*>(k4a_image_get_buffer(depthImage));
+	const uint16_t *irData = irImage != nullptr ? reinterpret_cast<uint16_t*>(k4a_image_get_buffer(irImage)) : nullptr;
+	const int tileCount = change_tile_count(width) * change_tile_count(height);
+	FrameDimensions dimensions = {
+		static_cast<unsigned int>(width),
+		static_cast<unsigned int>(height),
+		static_cast<unsigned int>(sizeof(uint16_t)) };
+
+	// A reference of another size is left over from a different depth mode
+	if (slot.changeDepthReference != nullptr &&
+		slot.changeDepthReference->GetSize() != width * height * (int)sizeof(uint16_t))
+	{
+		slot.hasChangeReference = false;
+		slot.changeDepthReference = nullptr;
+		slot.changeIRReference = nullptr;
+	}
+
+	// A missing reference, or an IR one when IR comparison starts, makes this frame the keyframe
+	bool missingReference = !slot.hasChangeReference ||
+		(irData != nullptr && slot.changeIRReference == nullptr);
+	if (slot.changeDepthReference == nullptr)
+	{
+		slot.changeDepthReference = std::make_shared<ImageBuffer>(dimensions);
+	}
+	if (irData == nullptr)
+	{
+		slot.changeIRReference = nullptr;
+	}
+	else if (slot.changeIRReference == nullptr)
+	{
+		slot.changeIRReference = std::make_shared<ImageBuffer>(dimensions);
+	}
+
+	slot.changeMaskWork.resize(tileCount);
+	bool detected = detect_changed_tiles(depthData,
+		irData,
+		width,
+		height,
+		settings.depthNoiseThreshold,
+		static_cast<uint16_t>(min(settings.irNoiseThreshold, (int)UINT16_MAX)),
+		settings.tileThreshold,
+		settings.keyframeInterval,
+		forceKeyframe || missingReference,
+		reinterpret_cast<uint16_t*>(slot.changeDepthReference->buffer),
+		slot.changeIRReference != nullptr ? reinterpret_cast<uint16_t*>(slot.changeIRReference->buffer) : nullptr,
+		&slot.framesSinceKeyframe,
+		slot.changeMaskWork.data(),
+		&changedRect,
+		&changedTileCount);
+	slot.hasChangeReference = true;
+	return detected;
+}
+
+bool AzureKinectWrapper::TrySetChangeDetection(
+	unsigned int index,
+	bool enabled,
+	int depthNoiseThreshold,
+	int irNoiseThreshold,
+	unsigned int tileThreshold,
+	int keyframeInterval)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr ||
+		depthNoiseThreshold < 0 ||
+		depthNoiseThreshold > UINT16_MAX ||
+		keyframeInterval < 0)
+	{
+		return false;
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	if (enabled &&
+		!slot->changeDetection.enabled)
+	{
+		slot->changeDetectionStats = {};
+	}
+	slot->changeDetection.enabled = enabled;
+	slot->changeDetection.depthNoiseThreshold = static_cast<uint16_t>(depthNoiseThreshold);
+	slot->changeDetection.irNoiseThreshold = irNoiseThreshold;
+	slot->changeDetection.tileThreshold = tileThreshold;
+	slot->changeDetection.keyframeInterval = keyframeInterval;
+	slot->changeDetectionChanged = true;
+	if (!enabled)
+	{
+		slot->changeMask.clear();
+		slot->frameUnchanged = false;
+	}
+	LeaveCriticalSection(&slot->slotCritSec);
+	return true;
+}
+
+bool AzureKinectWrapper::TryGetChangeMask(
+	unsigned int index,
+	byte *maskData,
+	int maskSize,
+	int *columns,
+	int *rows)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return false;
+	}
+
+	// The sizes are filled in even when the buffer does not match, so callers can size theirs
+	EnterCriticalSection(&slot->slotCritSec);
+	bool copied = false;
+	*columns = slot->changeDetectionStats.tileColumns;
+	*rows = slot->changeDetectionStats.tileRows;
+	if (maskData != nullptr &&
+		!slot->changeMask.empty() &&
+		static_cast<int>(slot->changeMask.size()) == maskSize)
+	{
+		memcpy(maskData, slot->changeMask.data(), maskSize);
+		copied = true;
+	}
+	LeaveCriticalSection(&slot->slotCritSec);
+	return copied;
+}
+
+bool AzureKinectWrapper::TryGetChangeDetectionStats(
+	unsigned int index,
+	ChangeDetectionStats *stats)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr ||
+		stats == nullptr)
+	{
+		return false;
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	*stats = slot->changeDetectionStats;
+	bool enabled = slot->changeDetection.enabled;
+	LeaveCriticalSection(&slot->slotCritSec);
+	return enabled;
+}
+
+void AzureKinectWrapper::FilterOutliers(
+	DeviceSlot &slot,
+	k4a_image_t depthImage,
+	const OutlierFilterSettings &settings,
+	OutlierFilterStats &stats)
+{
+	auto filterStart = TimingHelper::GetTimestampMicroseconds();
+	int width = k4a_image_get_width_pixels(depthImage);
+	int height = k4a_image_get_height_pixels(depthImage);
+	size_t pixelCount = (size_t)width * height;
+	int bandCount = outlier_band_count(height);
+
+	// Sized by the first frame of a depth mode, later frames reuse the memory
+	slot.outlierRatios.resize(pixelCount);
+	slot.outlierScratch.resize(bandCount * outlier_band_scratch_size(width));
+	slot.outlierBandSums.resize(bandCount * 3);
+
+	uint16_t *depthData = reinterpret_cast<uint16_t*>(k4a_image_get_buffer(depthImage));
+	outlier_distance_ratios(depthData,
+		reinterpret_cast<k4a_float2_t*>(k4a_image_get_buffer(slot.xyTableImage)),
+		width,
+		height,
+		settings.windowSize,
+		slot.outlierScratch.data(),
+		slot.outlierRatios.data(),
+		slot.outlierBandSums.data());
+
+	double count = 0.0;
+	double sum = 0.0;
+	double sumSquares = 0.0;
+	for (int band = 0; band < bandCount; band++)
+	{
+		count += slot.outlierBandSums[band * 3];
+		sum += slot.outlierBandSums[band * 3 + 1];
+		sumSquares += slot.outlierBandSums[band * 3 + 2];
+	}
+	double mean = count > 0.0 ? sum / count : 0.0;
+	double deviation = count > 0.0 ? sqrt(max(sumSquares / count - mean * mean, 0.0)) : 0.0;
+	float threshold = (float)(mean + settings.sigma * deviation);
+
+	uint8_t *mask = nullptr;
+	if (settings.mode == OutlierFilterMask)
+	{
+		slot.outlierMaskWork.resize(pixelCount);
+		mask = slot.outlierMaskWork.data();
+	}
+
+	int keptCount = 0;
+	stats.rejectedPixelCount = reject_outliers(slot.outlierRatios.data(),
+		width,
+		height,
+		threshold,
+		settings.mode == OutlierFilterInPlace ? depthData : nullptr,
+		mask,
+		&keptCount);
+	stats.validPixelCount = keptCount + stats.rejectedPixelCount;
+	stats.width = width;
+	stats.height = height;
+	stats.meanRatio = (float)mean;
+	stats.ratioDeviation = (float)deviation;
+	stats.thresholdRatio = threshold;
+	stats.filterMilliseconds = TimingHelper::GetElapsedMilliseconds(filterStart);
+}
+
+bool AzureKinectWrapper::TrySetOutlierFilter(
+	unsigned int index,
+	bool enabled,
+	int windowSize,
+	float sigma,
+	OutlierFilterMode mode)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr ||
+		windowSize < 3 ||
+		windowSize > OUTLIER_MAX_WINDOW ||
+		windowSize % 2 == 0 ||
+		!(sigma > 0.0f) ||
+		(mode != OutlierFilterMask && mode != OutlierFilterInPlace))
+	{
+		return false;
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	if (enabled &&
+		!slot->outlierFilter.enabled)
+	{
+		slot->outlierFilterStats = {};
+	}
+	slot->outlierFilter.enabled = enabled;
+	slot->outlierFilter.windowSize = windowSize;
+	slot->outlierFilter.sigma = sigma;
+	slot->outlierFilter.mode = mode;
+	if (!enabled ||
+		mode != OutlierFilterMask)
+	{
+		slot->outlierMask.clear();
+	}
+	LeaveCriticalSection(&slot->slotCritSec);
+	return true;
+}
+
+bool AzureKinectWrapper::TryGetOutlierMask(
+	unsigned int index,
+	byte *maskData,
+	int maskSize,
+	int *width,
+	int *height)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return false;
+	}
+
+	// The sizes are filled in even when the buffer does not match, so callers can size theirs
+	EnterCriticalSection(&slot->slotCritSec);
+	bool copied = false;
+	*width = slot->outlierFilterStats.width;
+	*height = slot->outlierFilterStats.height;
+	if (maskData != nullptr &&
+		!slot->outlierMask.empty() &&
+		static_cast<int>(slot->outlierMask.size()) == maskSize)
+	{
+		memcpy(maskData, slot->outlierMask.data(), maskSize);
+		copied = true;
+	}
+	LeaveCriticalSection(&slot->slotCritSec);
+	return copied;
+}
+
+bool AzureKinectWrapper::TryGetOutlierFilterStats(
+	unsigned int index,
+	OutlierFilterStats *stats)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr ||
+		stats == nullptr)
+	{
+		return false;
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	*stats = slot->outlierFilterStats;
+	bool enabled = slot->outlierFilter.enabled;
+	LeaveCriticalSection(&slot->slotCritSec);
+	return enabled;
+}
+
+bool AzureKinectWrapper::TryStartSharedFrames(
+	unsigned int index,
+	const char *name,
+	int slotCount,
+	bool includeIR)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr ||
+		slotCount < 2 ||
+		slotCount > 64)
+	{
+		return false;
+	}
+
+	// Without a name the device's serial number makes one that stays the same from run to run
+	std::string sharedFrameName = name != nullptr ? name : "";
+	if (sharedFrameName.empty())
+	{
+		EnsureDeviceTable(false);
+		DeviceTable::Entry entry;
+		if (!deviceTable.TryGetEntry(index, entry))
+		{
+			return false;
+		}
+
+		sharedFrameName = "AzureKinect_" + entry.serialNumber;
+	}
+
+	if (sharedFrameName.size() >= 200 ||
+		sharedFrameName.find_first_of("/\\") != std::string::npos)
+	{
+		return false;
+	}
+
+	// A changed name or layout takes a new ring, the writer is only touched by the control thread
+	slot->sharedFrameWriter = nullptr;
+	slot->sharedFrameCalibrationVersion = 0;
+	slot->sharedFramesEnabled = true;
+	slot->sharedFrameSlotCount = slotCount;
+	slot->sharedFrameIR = includeIR;
+
+	EnterCriticalSection(&slot->slotCritSec);
+	slot->sharedFrameName = sharedFrameName;
+	slot->sharedFrameStats = {};
+	LeaveCriticalSection(&slot->slotCritSec);
+	return true;
+}
+
+void AzureKinectWrapper::StopSharedFrames(unsigned int index)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return;
+	}
+
+	slot->sharedFramesEnabled = false;
+	slot->sharedFrameWriter = nullptr;
+	slot->sharedFrameCalibrationVersion = 0;
+
+	EnterCriticalSection(&slot->slotCritSec);
+	slot->sharedFrameName.clear();
+	slot->sharedFrameStats = {};
+	LeaveCriticalSection(&slot->slotCritSec);
+}
+
+bool AzureKinectWrapper::TryGetSharedFrameName(
+	unsigned int index,
+	char *name,
+	unsigned int nameSize)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr ||
+		name == nullptr)
+	{
+		return false;
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	bool result = !slot->sharedFrameName.empty() &&
+		slot->sharedFrameName.size() + 1 <= nameSize;
+	if (result)
+	{
+		memcpy(name, slot->sharedFrameName.c_str(), slot->sharedFrameName.size() + 1);
+	}
+	LeaveCriticalSection(&slot->slotCritSec);
+	return result;
+}
+
+bool AzureKinectWrapper::TryGetSharedFrameStats(
+	unsigned int index,
+	SharedFrameStats *stats)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr ||
+		stats == nullptr)
+	{
+		return false;
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	*stats = slot->sharedFrameStats;
+	bool enabled = !slot->sharedFrameName.empty();
+	LeaveCriticalSection(&slot->slotCritSec);
+	return enabled;
+}
+
+void AzureKinectWrapper::PublishSharedFrame(
+	unsigned int index,
+	DeviceSlot &slot,
+	k4a_image_t depthImage,
+	bool hasColor,
+	k4a_image_t irImage,
+	const FrameTimestamps &frameTimestamps,
+	uint32_t flags)
+{
+	if (slot.sharedFrameWriter == nullptr)
+	{
+		EnterCriticalSection(&slot.slotCritSec);
+		std::string name = slot.sharedFrameName;
+		LeaveCriticalSection(&slot.slotCritSec);
+
+		auto writer = std::make_unique<SharedFrameWriter>();
+		if (!writer->TryCreate(name, slot.sharedFrameSlotCount, SharedFrameMaxWidth, SharedFrameMaxHeight))
+		{
+			// Out of shared memory or the name is held by something that is not a ring, retrying every
+			// frame would fail the same way
+			OutputDebugString(L"Failed to create the shared frame ring");
+			slot.sharedFramesEnabled = false;
+			EnterCriticalSection(&slot.slotCritSec);
+			slot.sharedFrameName.clear();
+			LeaveCriticalSection(&slot.slotCritSec);
+			return;
+		}
+
+		EnterCriticalSection(&slot.slotCritSec);
+		slot.sharedFrameStats = {};
+		slot.sharedFrameStats.mappingBytes = writer->GetMappingSize();
+		slot.sharedFrameStats.slotCount = writer->GetSlotCount();
+		LeaveCriticalSection(&slot.slotCritSec);
+		slot.sharedFrameWriter = std::move(writer);
+	}
+
+	// Readers build their own k4a_calibration_t from the raw calibration, rewritten when it changed
+	SharedFrameWriter &writer = *slot.sharedFrameWriter;
+	if (slot.sharedFrameCalibrationVersion != slot.calibrationVersion)
+	{
+		EnsureDeviceTable(false);
+		DeviceTable::Entry entry;
+		if (deviceTable.TryGetEntry(index, entry))
+		{
+			writer.SetCalibration(entry.rawCalibration.data(),
+				entry.rawCalibration.size(),
+				slot.configuration.depth_mode,
+				slot.configuration.color_resolution,
+				slot.calibrationVersion);
+		}
+		slot.sharedFrameCalibrationVersion = slot.calibrationVersion;
+	}
+
+	k4a_image_t sizeImage = depthImage != nullptr ? depthImage : irImage;
+	SharedFrameInfo info = {};
+	info.frameSequence = frameTimestamps.sequence;
+	info.flags = flags;
+	info.width = static_cast<uint32_t>(k4a_image_get_width_pixels(sizeImage));
+	info.height = static_cast<uint32_t>(k4a_image_get_height_pixels(sizeImage));
+	info.calibrationVersion = slot.calibrationVersion;
+	info.depthDeviceTimestampUsec = frameTimestamps.depthDeviceTimestampUsec;
+	info.colorDeviceTimestampUsec = frameTimestamps.colorDeviceTimestampUsec;
+	info.irDeviceTimestampUsec = frameTimestamps.irDeviceTimestampUsec;
+	info.depthHostTimestampNsec = frameTimestamps.depthHostTimestampNsec;
+	info.publishHostTimestampNsec = frameTimestamps.publishHostTimestampNsec;
+
+	auto publishStart = TimingHelper::GetTimestampMicroseconds();
+	uint64_t publishedBytes = writer.Publish(info,
+		depthImage != nullptr && slot.cachedDepthImageBuffer != nullptr ?
+			reinterpret_cast<const uint16_t*>(slot.cachedDepthImageBuffer->buffer) :
+			nullptr,
+		hasColor && slot.cachedTransformedColorImageBuffer != nullptr ?
+			slot.cachedTransformedColorImageBuffer->buffer :
+			nullptr,
+		irImage != nullptr ?
+			reinterpret_cast<const uint16_t*>(k4a_image_get_buffer(irImage)) :
+			nullptr);
+	float publishMilliseconds = TimingHelper::GetElapsedMilliseconds(publishStart);
+
+	EnterCriticalSection(&slot.slotCritSec);
+	SharedFrameStats &stats = slot.sharedFrameStats;
+	stats.publishedCount++;
+	stats.publishedBytes += publishedBytes;
+	stats.lastPublishMilliseconds = publishMilliseconds;
+	stats.maxPublishMilliseconds = max(stats.maxPublishMilliseconds, publishMilliseconds);
+	LeaveCriticalSection(&slot.slotCritSec);
+}
+
+bool AzureKinectWrapper::TryStartFrameServer(
+	unsigned int index,
+	int port,
+	int colorQuality,
+	int depthErrorMillimeters,
+	float maxFramesPerSecond,
+	int *boundPort)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return false;
+	}
+
+	// Restarting with other options takes a new listener, connected clients reconnect to it
+	slot->frameServer = nullptr;
+	slot->frameServerCalibrationVersion = 0;
+
+	FrameStreamServer::Options options = FrameStreamServer::GetDefaultOptions();
+	options.port = port;
+	options.colorQuality = colorQuality;
+	options.depthErrorMillimeters = depthErrorMillimeters;
+	options.maxFramesPerSecond = maxFramesPerSecond;
+
+	auto server = std::make_unique<FrameStreamServer>();
+	if (!server->TryStart(options))
+	{
+		return false;
+	}
+
+	if (boundPort != nullptr)
+	{
+		*boundPort = server->GetPort();
+	}
+	slot->frameServer = std::move(server);
+	return true;
+}
+
+void AzureKinectWrapper::StopFrameServer(unsigned int index)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return;
+	}
+
+	slot->frameServer = nullptr;
+	slot->frameServerCalibrationVersion = 0;
+}
+
+bool AzureKinectWrapper::TryGetFrameServerStats(
+	unsigned int index,
+	FrameServerStats *stats)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr ||
+		stats == nullptr ||
+		slot->frameServer == nullptr)
+	{
+		return false;
+	}
+
+	auto serverStats = slot->frameServer->GetStats();
+	stats->port = serverStats.port;
+	stats->clientCount = serverStats.clientCount;
+	stats->submittedCount = serverStats.submittedCount;
+	stats->skippedCount = serverStats.skippedCount;
+	stats->encodedCount = serverStats.encodedCount;
+	stats->sentCount = serverStats.sentCount;
+	stats->droppedCount = serverStats.droppedCount;
+	stats->rawBytes = serverStats.rawBytes;
+	stats->encodedBytes = serverStats.encodedBytes;
+	stats->sentBytes = serverStats.sentBytes;
+	stats->lastColorEncodeMilliseconds = serverStats.lastColorEncodeMilliseconds;
+	stats->lastDepthEncodeMilliseconds = serverStats.lastDepthEncodeMilliseconds;
+	stats->averageEncodeMilliseconds = serverStats.averageEncodeMilliseconds;
+	stats->lastSendMilliseconds = serverStats.lastSendMilliseconds;
+	stats->maxSendMilliseconds = serverStats.maxSendMilliseconds;
+	stats->compressionRatio = serverStats.compressionRatio;
+	stats->megabitsPerSecond = serverStats.megabitsPerSecond;
+	return true;
+}
+
+bool AzureKinectWrapper::TryConnectFrameClient(
+	const char *host,
+	int port,
+	uint64_t *clientId)
+{
+	if (host == nullptr ||
+		clientId == nullptr)
+	{
+		return false;
+	}
+
+	auto client = std::make_shared<FrameStreamClient>();
+	if (!client->TryConnect(host, port))
+	{
+		return false;
+	}
+
+	EnterCriticalSection(&frameClientCritSec);
+	*clientId = nextFrameClientId++;
+	frameClientMap[*clientId] = client;
+	LeaveCriticalSection(&frameClientCritSec);
+	return true;
+}
+
+void AzureKinectWrapper::DisconnectFrameClient(uint64_t clientId)
+{
+	std::shared_ptr<FrameStreamClient> client;
+	EnterCriticalSection(&frameClientCritSec);
+	auto it = frameClientMap.find(clientId);
+	if (it != frameClientMap.end())
+	{
+		client = it->second;
+		frameClientMap.erase(it);
+	}
+	LeaveCriticalSection(&frameClientCritSec);
+
+	// Joins the receive thread outside of the lock, other clients stay usable meanwhile
+	if (client != nullptr)
+	{
+		client->Disconnect();
+	}
+}
+
+bool AzureKinectWrapper::TryGetFrameClientFrame(
+	uint64_t clientId,
+	uint64_t *sequence,
+	FrameClientFrameInfo *info,
+	uint16_t *depthData,
+	byte *colorData,
+	int pixelCapacity)
+{
+	if (sequence == nullptr ||
+		pixelCapacity < 0)
+	{
+		return false;
+	}
+
+	std::shared_ptr<FrameStreamClient> client;
+	EnterCriticalSection(&frameClientCritSec);
+	auto it = frameClientMap.find(clientId);
+	if (it != frameClientMap.end())
+	{
+		client = it->second;
+	}
+	LeaveCriticalSection(&frameClientCritSec);
+
+	FrameStreamFrameHeader header;
+	if (client == nullptr ||
+		!client->TryCopyLatest(*sequence, header, depthData, colorData, static_cast<size_t>(pixelCapacity)))
+	{
+		return false;
+	}
+
+	if (info != nullptr)
+	{
+		info->sequence = *sequence;
+		info->frameSequence = header.frameSequence;
+		info->depthDeviceTimestampUsec = header.depthDeviceTimestampUsec;
+		info->depthHostTimestampNsec = header.depthHostTimestampNsec;
+		info->width = static_cast<int32_t>(header.width);
+		info->height = static_cast<int32_t>(header.height);
+		info->hasDepth = (header.flags & FrameStreamHasDepth) != 0 ? 1 : 0;
+		info->hasColor = (header.flags & FrameStreamHasColor) != 0 ? 1 : 0;
+	}
+	return true;
+}
+
+bool AzureKinectWrapper::TryGetFrameClientStats(
+	uint64_t clientId,
+	FrameClientStats *stats)
+{
+	if (stats == nullptr)
+	{
+		return false;
+	}
+
+	std::shared_ptr<FrameStreamClient> client;
+	EnterCriticalSection(&frameClientCritSec);
+	auto it = frameClientMap.find(clientId);
+	if (it != frameClientMap.end())
+	{
+		client = it->second;
+	}
+	LeaveCriticalSection(&frameClientCritSec);
+
+	if (client == nullptr)
+	{
+		return false;
+	}
+
+	auto clientStats = client->GetStats();
+	stats->connected = clientStats.connected;
+	stats->width = clientStats.width;
+	stats->height = clientStats.height;
+	stats->connectCount = clientStats.connectCount;
+	stats->receivedCount = clientStats.receivedCount;
+	stats->receivedBytes = clientStats.receivedBytes;
+	stats->missedCount = clientStats.missedCount;
+	stats->failedCount = clientStats.failedCount;
+	stats->lastEncodeMilliseconds = clientStats.lastEncodeMilliseconds;
+	stats->lastReceiveMilliseconds = clientStats.lastReceiveMilliseconds;
+	stats->lastDecodeMilliseconds = clientStats.lastDecodeMilliseconds;
+	stats->averageDecodeMilliseconds = clientStats.averageDecodeMilliseconds;
+	stats->lastLatencyMilliseconds = clientStats.lastLatencyMilliseconds;
+	stats->averageLatencyMilliseconds = clientStats.averageLatencyMilliseconds;
+	stats->averageIntervalMilliseconds = clientStats.averageIntervalMilliseconds;
+	stats->intervalJitterMilliseconds = clientStats.intervalJitterMilliseconds;
+	stats->megabitsPerSecond = clientStats.megabitsPerSecond;
+	return true;
+}
+
+void AzureKinectWrapper::SubmitFrameServerFrame(
+	unsigned int index,
+	DeviceSlot &slot,
+	bool hasColor,
+	const FrameTimestamps &frameTimestamps)
+{
+	FrameStreamServer &server = *slot.frameServer;
+	if (slot.frameServerCalibrationVersion != slot.calibrationVersion)
+	{
+		EnsureDeviceTable(false);
+		DeviceTable::Entry entry;
+		if (deviceTable.TryGetEntry(index, entry))
+		{
+			server.SetCalibration(entry.rawCalibration.data(),
+				entry.rawCalibration.size(),
+				slot.configuration.depth_mode,
+				slot.configuration.color_resolution,
+				slot.calibrationVersion);
+		}
+		slot.frameServerCalibrationVersion = slot.calibrationVersion;
+	}
+
+	if (slot.cachedDepthImageBuffer == nullptr)
+	{
+		return;
+	}
+
+	FrameStreamFrameInfo info = {};
+	info.frameSequence = frameTimestamps.sequence;
+	info.width = static_cast<uint32_t>(slot.cachedDepthImageBuffer->dimensions.width);
+	info.height = static_cast<uint32_t>(slot.cachedDepthImageBuffer->dimensions.height);
+	info.calibrationVersion = slot.calibrationVersion;
+	info.depthDeviceTimestampUsec = frameTimestamps.depthDeviceTimestampUsec;
+	info.depthHostTimestampNsec = frameTimestamps.depthHostTimestampNsec;
+	server.Submit(info,
+		reinterpret_cast<const uint16_t*>(slot.cachedDepthImageBuffer->buffer),
+		hasColor && slot.cachedTransformedColorImageBuffer != nullptr ?
+			slot.cachedTransformedColorImageBuffer->buffer :
+			nullptr);
+}
+
+bool AzureKinectWrapper::TrySetWorldTransform(
+	unsigned int index,
+	float *worldTransform)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr ||
+		worldTransform == nullptr)
+	{
+		return false;
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	memcpy(slot->worldTransform.data(), worldTransform, sizeof(float) * 16);
+	slot->hasWorldTransform = true;
+	LeaveCriticalSection(&slot->slotCritSec);
+	return true;
+}
+
+void AzureKinectWrapper::ClearWorldTransform(unsigned int index)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot != nullptr)
+	{
+		EnterCriticalSection(&slot->slotCritSec);
+		slot->hasWorldTransform = false;
+		LeaveCriticalSection(&slot->slotCritSec);
+	}
+}
+
+bool AzureKinectWrapper::TryFusePointClouds(
+	float voxelSize,
+	float *positions,
+	unsigned int *colors,
+	int capacity,
+	int *count)
+{
+	// Each slot is only locked while its frame is copied, so fusing never holds up a device's publishing
+	std::vector<FrameSnapshot> snapshots;
+	std::vector<PointCloudFusion::DeviceFrame> frames;
+	for (auto &slot : deviceSlots)
+	{
+		FrameSnapshot snapshot;
+		EnterCriticalSection(&slot.slotCritSec);
+		bool hasFrame = slot.hasWorldTransform &&
+			TryTakeFrameSnapshot(slot, snapshot);
+		PointCloudFusion::DeviceFrame frame;
+		memcpy(frame.worldTransform, slot.worldTransform.data(), sizeof(frame.worldTransform));
+		LeaveCriticalSection(&slot.slotCritSec);
+		if (!hasFrame)
+		{
+			continue;
+		}
+
+		frame.depthData = reinterpret_cast<uint16_t*>(snapshot.depthBuffer->buffer);
+		frame.xyTableData = reinterpret_cast<k4a_float2_t*>(k4a_image_get_buffer(snapshot.xyTableImage));
+		frame.colorData = snapshot.colorBuffer != nullptr ? snapshot.colorBuffer->buffer : nullptr;
+		frame.pixelCount = snapshot.depthBuffer->dimensions.width * snapshot.depthBuffer->dimensions.height;
+		frames.push_back(frame);
+		snapshots.push_back(snapshot);
+	}
+
+	bool fused = frames.size() > 0;
+	if (fused)
+	{
+		*count = pointCloudFusion.Fuse(frames, voxelSize, positions, colors, capacity);
+	}
+	else
+	{
+		OutputDebugString(L"No devices with world transforms, unable to fuse point clouds");
+	}
+
+	for (auto &snapshot : snapshots)
+	{
+		k4a_image_release(snapshot.xyTableImage);
+	}
+	return fused;
+}
+
+bool AzureKinectWrapper::TryTakeFrameSnapshot(DeviceSlot &slot, FrameSnapshot &snapshot)
+{
+	// A reconfigure swaps the table together with the cached buffers, so the one referenced here matches
+	// the frame. The reference keeps it alive past a reconfigure or stop.
+	if (slot.cachedDepthImageBuffer == nullptr ||
+		slot.xyTableImage == nullptr)
+	{
+		return false;
+	}
+
+	snapshot.depthBuffer = std::make_shared<ImageBuffer>(slot.cachedDepthImageBuffer->dimensions);
+	memcpy(snapshot.depthBuffer->buffer, slot.cachedDepthImageBuffer->buffer, snapshot.depthBuffer->GetSize());
+
+	snapshot.colorBuffer = nullptr;
+	if (slot.cachedTransformedColorImageBuffer != nullptr)
+	{
+		snapshot.colorBuffer = std::make_shared<ImageBuffer>(slot.cachedTransformedColorImageBuffer->dimensions);
+		memcpy(snapshot.colorBuffer->buffer, slot.cachedTransformedColorImageBuffer->buffer, snapshot.colorBuffer->GetSize());
+	}
+
+	snapshot.xyTableImage = slot.xyTableImage;
+	k4a_image_reference(snapshot.xyTableImage);
+	return true;
+}
+
+bool AzureKinectWrapper::TryGetFusionStats(
+	int *deviceCount,
+	int *inputPointCount,
+	int *fusedPointCount,
+	float *transformMilliseconds,
+	float *mergeMilliseconds)
+{
+	auto stats = pointCloudFusion.GetStats();
+	*deviceCount = stats.deviceCount;
+	*inputPointCount = stats.inputPointCount;
+	*fusedPointCount = stats.fusedPointCount;
+	*transformMilliseconds = stats.transformMilliseconds;
+	*mergeMilliseconds = stats.mergeMilliseconds;
+	return true;
+}
+
+bool AzureKinectWrapper::TryExportPointCloud(
+	unsigned int index,
+	const char *path,
+	PointCloudFileFormat format,
+	bool includeNormals,
+	int *pointCount)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return false;
+	}
+
+	// Take copies of the frame so the slot is not held while the file is written
+	FrameSnapshot snapshot;
+	EnterCriticalSection(&slot->slotCritSec);
+	bool hasFrame = TryTakeFrameSnapshot(*slot, snapshot);
+	LeaveCriticalSection(&slot->slotCritSec);
+	if (!hasFrame)
+	{
+		output_device_message(L"No frame available, unable to export point cloud: ", index);
+		return false;
+	}
+
+	PointCloudExporter::Frame frame;
+	frame.depthData = reinterpret_cast<uint16_t*>(snapshot.depthBuffer->buffer);
+	frame.xyTableData = reinterpret_cast<k4a_float2_t*>(k4a_image_get_buffer(snapshot.xyTableImage));
+	frame.colorData = snapshot.colorBuffer != nullptr ? snapshot.colorBuffer->buffer : nullptr;
+	frame.width = snapshot.depthBuffer->dimensions.width;
+	frame.height = snapshot.depthBuffer->dimensions.height;
+
+	bool result = pointCloudExporter.TryExport(frame, path, format, includeNormals, pointCount);
+	k4a_image_release(snapshot.xyTableImage);
+	return result;
+}
+
+bool AzureKinectWrapper::TryConvertRecording(
+	const char *recordingPath,
+	const char *outputDirectory,
+	PointCloudFileFormat format,
+	bool includeNormals,
+	int *frameCount)
+{
+	return pointCloudExporter.TryConvertRecording(recordingPath, outputDirectory, format, includeNormals, frameCount);
+}
+
+bool AzureKinectWrapper::TryGetExportStats(
+	int *frameCount,
+	int *pointCount,
+	uint64_t *writtenBytes,
+	float *encodeMilliseconds,
+	float *writeMilliseconds,
+	float *megabytesPerSecond)
+{
+	auto stats = pointCloudExporter.GetStats();
+	*frameCount = stats.frameCount;
+	*pointCount = stats.pointCount;
+	*writtenBytes = stats.writtenBytes;
+	*encodeMilliseconds = stats.encodeMilliseconds;
+	*writeMilliseconds = stats.writeMilliseconds;
+	*megabytesPerSecond = stats.megabytesPerSecond;
+	return true;
+}
+
+bool AzureKinectWrapper::TryCreateTsdfVolume(
+	unsigned int index,
+	float voxelSize,
+	float truncationDistance)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr ||
+		!slot->hasCalibration)
+	{
+		output_device_message(L"Unable to create tsdf volume without calibration for device: ", index);
+		return false;
+	}
+
+	auto volume = std::make_shared<TsdfVolume>(slot->calibration, voxelSize, truncationDistance);
+	EnterCriticalSection(&slot->slotCritSec);
+	slot->tsdfVolume = volume;
+	LeaveCriticalSection(&slot->slotCritSec);
+	return true;
+}
+
+void AzureKinectWrapper::DestroyTsdfVolume(unsigned int index)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot != nullptr)
+	{
+		EnterCriticalSection(&slot->slotCritSec);
+		slot->tsdfVolume = nullptr;
+		LeaveCriticalSection(&slot->slotCritSec);
+	}
+}
+
+bool AzureKinectWrapper::TryIntegrateTsdfVolume(
+	unsigned int index,
+	float *cameraToWorld)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return false;
+	}
+
+	// The depth is copied so the slot is only locked for the copy, the volume has a lock of its own
+	EnterCriticalSection(&slot->slotCritSec);
+	auto volume = slot->tsdfVolume;
+	if (volume == nullptr ||
+		slot->cachedDepthImageBuffer == nullptr)
+	{
+		LeaveCriticalSection(&slot->slotCritSec);
+		return false;
+	}
+
+	auto depthBuffer = std::make_shared<ImageBuffer>(slot->cachedDepthImageBuffer->dimensions);
+	memcpy(depthBuffer->buffer, slot->cachedDepthImageBuffer->buffer, depthBuffer->GetSize());
+	LeaveCriticalSection(&slot->slotCritSec);
+
+	// A depth mode change between the copy and here leaves the frame at the old size, which is refused
+	return volume->Integrate(reinterpret_cast<uint16_t*>(depthBuffer->buffer),
+		depthBuffer->dimensions.width,
+		depthBuffer->dimensions.height,
+		cameraToWorld);
+}
+
+bool AzureKinectWrapper::TryRaycastTsdfVolume(
+	unsigned int index,
+	float *cameraToWorld,
+	float *points,
+	int pointCapacity,
+	int *width,
+	int *height,
+	int *hitCount)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	auto volume = slot != nullptr ? LoadSlotPointer(*slot, &DeviceSlot::tsdfVolume) : nullptr;
+	if (volume == nullptr)
+	{
+		return false;
+	}
+	*width = volume->GetWidth();
+	*height = volume->GetHeight();
+	if (pointCapacity < (*width) * (*height))
+	{
+		return false;
+	}
+
+	*hitCount = volume->Raycast(cameraToWorld, points, pointCapacity);
+	return true;
+}
+
+bool AzureKinectWrapper::TryGetTsdfVolumeStats(
+	unsigned int index,
+	int *frameCount,
+	int *blockCount,
+	int *integratedBlockCount,
+	float *allocationMilliseconds,
+	float *integrationMilliseconds,
+	float *raycastMilliseconds)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	auto volume = slot != nullptr ? LoadSlotPointer(*slot, &DeviceSlot::tsdfVolume) : nullptr;
+	if (volume == nullptr)
+	{
+		return false;
+	}
+
+	auto stats = volume->GetStats();
+	*frameCount = stats.frameCount;
+	*blockCount = stats.blockCount;
+	*integratedBlockCount = stats.integratedBlockCount;
+	*allocationMilliseconds = stats.allocationMilliseconds;
+	*integrationMilliseconds = stats.integrationMilliseconds;
+	*raycastMilliseconds = stats.raycastMilliseconds;
+	return true;
+}
+
+bool AzureKinectWrapper::TryStartImu(unsigned int index)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr ||
+		slot->device == nullptr)
+	{
+		output_device_message(L"Unable to start imu for unknown device: ", index);
+		return false;
+	}
+
+	// The imu can only be started once the cameras are running
+	if (slot->imuStream == nullptr)
+	{
+		auto imuStream = std::make_shared<ImuStream>(slot->device);
+		EnterCriticalSection(&slot->slotCritSec);
+		slot->imuStream = imuStream;
+		LeaveCriticalSection(&slot->slotCritSec);
+	}
+
+	return slot->imuStream->TryStart();
+}
+
+void AzureKinectWrapper::StopImu(unsigned int index)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr ||
+		slot->imuStream == nullptr)
+	{
+		return;
+	}
+
+	slot->imuStream->Stop();
+	EnterCriticalSection(&slot->slotCritSec);
+	slot->imuStream = nullptr;
+	LeaveCriticalSection(&slot->slotCritSec);
+}
+
+bool AzureKinectWrapper::TryGetImuSamples(
+	unsigned int index,
+	uint64_t cursor,
+	k4a_imu_sample_t *samples,
+	int capacity,
+	int *count,
+	uint64_t *nextCursor,
+	uint64_t *depthTimestampUsec)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	auto imuStream = slot != nullptr ? LoadSlotPointer(*slot, &DeviceSlot::imuStream) : nullptr;
+	if (imuStream == nullptr)
+	{
+		return false;
+	}
+
+	*count = imuStream->ReadSince(cursor, samples, capacity, *nextCursor);
+
+	EnterCriticalSection(&slot->slotCritSec);
+	*depthTimestampUsec = slot->depthTimestampUsec;
+	LeaveCriticalSection(&slot->slotCritSec);
+	return true;
+}
+
+void AzureKinectWrapper::SubscribeIR(unsigned int index)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return;
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	slot->irSubscriberCount++;
+	LeaveCriticalSection(&slot->slotCritSec);
+}
+
+void AzureKinectWrapper::UnsubscribeIR(unsigned int index)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return;
+	}
+
+	// The count and the image change together, so an update either keeps its image or sees nobody wants it
+	EnterCriticalSection(&slot->slotCritSec);
+	if (slot->irSubscriberCount > 0 &&
+		--slot->irSubscriberCount == 0 &&
+		slot->latestIRImage != nullptr)
+	{
+		// Hand the capture memory back to the sdk, outstanding leases keep their own reference
+		k4a_image_release(slot->latestIRImage);
+		slot->latestIRImage = nullptr;
+	}
+	LeaveCriticalSection(&slot->slotCritSec);
+}
+
+bool AzureKinectWrapper::TryGetIRShaderResourceView(
+	unsigned int index,
+	ID3D11ShaderResourceView *&irSrv,
+	unsigned int &irWidth,
+	unsigned int &irHeight,
+	unsigned int &irBpp)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return false;
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	if (!slot->hasResources ||
+		slot->resources.irSrv == nullptr)
+	{
+		LeaveCriticalSection(&slot->slotCritSec);
+		return false;
+	}
+
+	irSrv = slot->resources.irSrv;
+	irWidth = slot->resources.irFrameDimensions.width;
+	irHeight = slot->resources.irFrameDimensions.height;
+	irBpp = slot->resources.irFrameDimensions.bpp;
+
+	LeaveCriticalSection(&slot->slotCritSec);
+	return true;
+}
+
+bool AzureKinectWrapper::TryGetIRImageBuffer(
+	unsigned int index,
+	byte *irImageData,
+	int irImageSize)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return false;
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	if (slot->latestIRImage == nullptr ||
+		static_cast<int>(k4a_image_get_size(slot->latestIRImage)) != irImageSize)
+	{
+		LeaveCriticalSection(&slot->slotCritSec);
+		return false;
+	}
+
+	memcpy(irImageData, k4a_image_get_buffer(slot->latestIRImage), irImageSize);
+	LeaveCriticalSection(&slot->slotCritSec);
+	return true;
+}
+
+bool AzureKinectWrapper::TryGetToneMappedIRImage(
+	unsigned int index,
+	byte *toneMappedImageData,
+	int toneMappedImageSize,
+	int minValue,
+	int maxValue)
+{
+	if (minValue < 0 ||
+		maxValue > UINT16_MAX ||
+		minValue >= maxValue)
+	{
+		return false;
+	}
+
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return false;
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	if (slot->latestIRImage == nullptr)
+	{
+		LeaveCriticalSection(&slot->slotCritSec);
+		return false;
+	}
+
+	auto irImage = slot->latestIRImage;
+	int width = k4a_image_get_width_pixels(irImage);
+	int height = k4a_image_get_height_pixels(irImage);
+	int stride = k4a_image_get_stride_bytes(irImage);
+	if (toneMappedImageSize != width * height)
+	{
+		LeaveCriticalSection(&slot->slotCritSec);
+		return false;
+	}
+
+	auto buffer = k4a_image_get_buffer(irImage);
+	for (int y = 0; y < height; y++)
+	{
+		tone_map_16_to_8(
+			reinterpret_cast<uint16_t*>(buffer + y * stride),
+			toneMappedImageData + y * width,
+			width,
+			static_cast<uint16_t>(minValue),
+			static_cast<uint16_t>(maxValue));
+	}
+
+	LeaveCriticalSection(&slot->slotCritSec);
+	return true;
+}
+
+bool AzureKinectWrapper::TryLeaseIRImage(
+	unsigned int index,
+	byte **irImageData,
+	int *width,
+	int *height,
+	int *stride,
+	uint64_t *leaseId)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return false;
+	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	if (slot->latestIRImage == nullptr)
+	{
+		LeaveCriticalSection(&slot->slotCritSec);
+		return false;
+	}
 
-			buffer = k4a_image_get_buffer(pointCloudTemplateImage);
-			byte *tempBuffer = k4a_image_get_buffer(rgbaImage);
-			for (int i = 0; i < k4a_image_get_width_pixels(rgbaImage) * k4a_image_get_height_pixels(rgbaImage); i++)
-			{
-				*reinterpret_cast<float*>(&tempBuffer[sizeof(float) * (4 * i)]) = *reinterpret_cast<float*>(&buffer[sizeof(float) * (3 * i)]);
-				*reinterpret_cast<float*>(&tempBuffer[sizeof(float) * (4 * i + 1)]) = *reinterpret_cast<float*>(&buffer[sizeof(float) * (3 * i + 1)]);
-				*reinterpret_cast<float*>(&tempBuffer[sizeof(float) * (4 * i + 2)]) = *reinterpret_cast<float*>(&buffer[sizeof(float) * (3 * i + 2)]);
-				*reinterpret_cast<float*>(&tempBuffer[sizeof(float) * (4 * i + 3)]) = 1.0;
-			}
+	// The lease shares the capture's buffer, it stays valid until released even if newer frames arrive
+	auto irImage = slot->latestIRImage;
+	k4a_image_reference(irImage);
+	LeaveCriticalSection(&slot->slotCritSec);
 
-			if (cachedPointCloudTemplateImageBufferMap.count(pair.first) != 0)
-			{
-				memcpy(cachedPointCloudTemplateImageBufferMap[pair.first]->buffer->data(), tempBuffer, cachedPointCloudTemplateImageBufferMap[pair.first]->GetSize());
-			}
+	*irImageData = k4a_image_get_buffer(irImage);
+	*width = k4a_image_get_width_pixels(irImage);
+	*height = k4a_image_get_height_pixels(irImage);
+	*stride = k4a_image_get_stride_bytes(irImage);
 
-			UpdateResources(rgbaImage,
-				resources.pointCloudTemplateSrv,
-				resources.pointCloudTemplateTexture,
-				resources.pointCloudTemplateFrameDimensions,
-				DXGI_FORMAT_R32G32B32A32_FLOAT);
+	EnterCriticalSection(&irCritSec);
+	*leaseId = nextIRLeaseId++;
+	irLeaseMap[*leaseId] = std::make_pair(static_cast<int>(index), irImage);
+	LeaveCriticalSection(&irCritSec);
+	return true;
+}
 
-			k4a_image_release(rgbaImage);
-			k4a_image_release(depthTemplateImage);
-		}
+void AzureKinectWrapper::ReleaseIRImageLease(uint64_t leaseId)
+{
+	EnterCriticalSection(&irCritSec);
+	if (irLeaseMap.count(leaseId) != 0)
+	{
+		k4a_image_release(irLeaseMap[leaseId].second);
+		irLeaseMap.erase(leaseId);
+	}
+	LeaveCriticalSection(&irCritSec);
+}
 
-		k4a_image_release(colorImage);
-		k4a_image_release(depthImage);
-		k4a_capture_release(capture);
+void AzureKinectWrapper::ReleaseIRImages(unsigned int index)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return;
 	}
 
-    return !observedFailure;
+	EnterCriticalSection(&slot->slotCritSec);
+	if (slot->latestIRImage != nullptr)
+	{
+		k4a_image_release(slot->latestIRImage);
+		slot->latestIRImage = nullptr;
+	}
+	LeaveCriticalSection(&slot->slotCritSec);
+
+	// Leases can not outlive the device they came from
+	EnterCriticalSection(&irCritSec);
+	for (auto it = irLeaseMap.begin(); it != irLeaseMap.end();)
+	{
+		if (it->second.first == static_cast<int>(index))
+		{
+			k4a_image_release(it->second.second);
+			it = irLeaseMap.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+	LeaveCriticalSection(&irCritSec);
 }
 
-bool AzureKinectWrapper::TryGetCalibration(
-	int index,
-	int *colorWidth,
-	int *colorHeight,
-	float *colorRotation,
-	float *colorTranslation,
-	int *colorIntrinsicsCount,
-	int colorIntrinsicsLength,
-	float *colorIntrinsics,
-	int *depthWidth,
-	int *depthHeight,
-	float *depthRotation,
-	float *depthTranslation,
-	int *depthIntrinsicsCount,
-	int depthIntrinsicsLength,
-	float *depthIntrinsics)
+bool AzureKinectWrapper::TrySetDeliveryPolicy(
+	unsigned int index,
+	DeliveryPolicy policy,
+	int queueCapacity)
 {
-	if (calibrationMap.count(index) == 0)
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
 	{
 		return false;
 	}
 
-	auto calibration = calibrationMap.at(index);
-	
-	*colorWidth = calibration.color_camera_calibration.resolution_width;
-	*colorHeight = calibration.color_camera_calibration.resolution_height;
-	memcpy(colorRotation, calibration.color_camera_calibration.extrinsics.rotation, sizeof(float) * 9);
-	memcpy(depthTranslation, calibration.color_camera_calibration.extrinsics.translation, sizeof(float) * 3);
-	*colorIntrinsicsCount = calibration.color_camera_calibration.intrinsics.parameter_count;
-	if ((*colorIntrinsicsCount) > colorIntrinsicsLength)
+	if (slot->device != nullptr)
 	{
+		output_device_message(L"Delivery policy has to be set before starting device: ", index);
 		return false;
 	}
-	memcpy(colorIntrinsics, calibration.color_camera_calibration.intrinsics.parameters.v, sizeof(float) * (*colorIntrinsicsCount));
 
-	*depthWidth = calibration.depth_camera_calibration.resolution_width;
-	*depthHeight = calibration.depth_camera_calibration.resolution_height;
-	memcpy(depthRotation, calibration.depth_camera_calibration.extrinsics.rotation, sizeof(float) * 9);
-	memcpy(depthTranslation, calibration.depth_camera_calibration.extrinsics.translation, sizeof(float) * 3);
-	*depthIntrinsicsCount = calibration.depth_camera_calibration.intrinsics.parameter_count;
-	if ((*depthIntrinsicsCount) > depthIntrinsicsLength)
+	if (policy < DeliveryPolicyLatestOnly ||
+		policy > DeliveryPolicyEveryFrame ||
+		queueCapacity < 1)
 	{
 		return false;
 	}
-	memcpy(depthIntrinsics, calibration.depth_camera_calibration.intrinsics.parameters.v, sizeof(float) * (*depthIntrinsicsCount));
 
+	slot->deliveryPolicy = policy;
+	slot->deliveryQueueCapacity = queueCapacity;
 	return true;
 }
 
-bool AzureKinectWrapper::TryGetImageBuffers(
-	int index,
-	byte *transformedColorImageData,
-	int transformedColorImageSize,
-	byte *depthImageData,
-	int depthImageSize,
-	byte *pointCloudTemplateImageData,
-	int pointCloudTemplateImageSize)
+bool AzureKinectWrapper::TryGetDeliveryStats(
+	unsigned int index,
+	int *policy,
+	int *queueCapacity,
+	int *queueDepth,
+	int *maxQueueDepth,
+	uint64_t *deliveredCount,
+	uint64_t *droppedCount,
+	float *lastAgeMilliseconds,
+	float *maxAgeMilliseconds,
+	float *averageAgeMilliseconds)
 {
-	if (cachedTransformedColorImageBufferMap.count(index) > 0 &&
-		cachedDepthImageBufferMap.count(index) > 0 &&
-		cachedPointCloudTemplateImageBufferMap.count(index) > 0)
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr ||
+		slot->captureQueue == nullptr)
 	{
-		int colorSize = cachedTransformedColorImageBufferMap[index]->GetSize();
-		if (transformedColorImageSize == colorSize)
+		return false;
+	}
+
+	auto stats = slot->captureQueue->GetStats();
+	*policy = stats.policy;
+	*queueCapacity = stats.capacity;
+	*queueDepth = stats.depth;
+	*maxQueueDepth = stats.maxDepth;
+	*deliveredCount = stats.deliveredCount;
+	*droppedCount = stats.droppedCount;
+	*lastAgeMilliseconds = stats.lastAgeMilliseconds;
+	*maxAgeMilliseconds = stats.maxAgeMilliseconds;
+	*averageAgeMilliseconds = stats.averageAgeMilliseconds;
+	return true;
+}
+
+bool AzureKinectWrapper::TryGetDeviceMemoryStats(
+	unsigned int index,
+	DeviceMemoryStats *stats)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr ||
+		stats == nullptr)
+	{
+		return false;
+	}
+
+	*stats = {};
+	stats->index = index;
+	auto addImage = [](k4a_image_t image, int32_t &count, uint64_t &bytes)
+	{
+		if (image != nullptr)
+		{
+			count++;
+			bytes += k4a_image_get_size(image);
+		}
+	};
+	auto addBuffer = [stats](const std::shared_ptr<ImageBuffer> &imageBuffer)
+	{
+		if (imageBuffer != nullptr)
 		{
-			memcpy(transformedColorImageData, cachedTransformedColorImageBufferMap[index]->buffer->data(), transformedColorImageSize);
+			stats->bufferCount++;
+			stats->bufferBytes += imageBuffer->GetSize();
 		}
+	};
 
-		int depthSize = cachedDepthImageBufferMap[index]->GetSize();
-		if (depthImageSize == depthSize)
+	// The sdk images and luts belong to the control thread, which is the only caller
+	addImage(slot->transformedColorImage, stats->imageCount, stats->imageBytes);
+	addImage(slot->pointCloudTemplateImage, stats->imageCount, stats->imageBytes);
+	addImage(slot->xyTableImage, stats->lutCount, stats->lutBytes);
+	addImage(slot->undistortLut, stats->lutCount, stats->lutBytes);
+	uint64_t outlierBytes = slot->outlierRatios.capacity() * sizeof(float) +
+		(slot->outlierScratch.capacity() + slot->outlierBandSums.capacity()) * sizeof(double) +
+		slot->outlierMaskWork.capacity();
+
+	EnterCriticalSection(&slot->slotCritSec);
+	k4a_image_t latestIRImage = slot->latestIRImage;
+	addImage(latestIRImage, stats->imageCount, stats->imageBytes);
+	addBuffer(slot->cachedTransformedColorImageBuffer);
+	addBuffer(slot->cachedDepthImageBuffer);
+	addBuffer(slot->cachedPointCloudTemplateImageBuffer);
+	addBuffer(slot->undistortedDepthImageBuffer);
+	addBuffer(slot->undistortedIRImageBuffer);
+	addBuffer(slot->colorUvImageBuffer);
+	addBuffer(slot->colorUvFlagsImageBuffer);
+	addBuffer(slot->colorUvScratchBuffer);
+	addBuffer(slot->colorUvZBuffer);
+	addBuffer(slot->changeDepthReference);
+	addBuffer(slot->changeIRReference);
+	outlierBytes += slot->outlierMask.capacity();
+	if (outlierBytes > 0)
+	{
+		stats->bufferCount++;
+		stats->bufferBytes += outlierBytes;
+	}
+	if (slot->sharedFrameWriter != nullptr)
+	{
+		stats->bufferCount++;
+		stats->bufferBytes += slot->sharedFrameWriter->GetMappingSize();
+	}
+	AddResourceMemory(slot->resources, *stats);
+	AddResourceMemory(slot->undistortResources, *stats);
+	AddResourceMemory(slot->colorUvResources, *stats);
+	for (auto &pyramidLevel : slot->pyramidLevels)
+	{
+		addBuffer(pyramidLevel.colorImageBuffer);
+		addBuffer(pyramidLevel.depthImageBuffer);
+		AddResourceMemory(pyramidLevel.resources, *stats);
+	}
+	LeaveCriticalSection(&slot->slotCritSec);
+
+	// Leases keep older ir images alive, several leases of one image count it once
+	std::vector<k4a_image_t> leasedImages = { latestIRImage };
+	EnterCriticalSection(&irCritSec);
+	for (auto &lease : irLeaseMap)
+	{
+		k4a_image_t image = lease.second.second;
+		if (lease.second.first == static_cast<int>(index) &&
+			std::find(leasedImages.begin(), leasedImages.end(), image) == leasedImages.end())
 		{
-			memcpy(depthImageData, cachedDepthImageBufferMap[index]->buffer->data(), depthImageSize);
+			leasedImages.push_back(image);
+			addImage(image, stats->imageCount, stats->imageBytes);
 		}
+	}
+	LeaveCriticalSection(&irCritSec);
 
-		int pointCloudSize = cachedPointCloudTemplateImageBufferMap[index]->GetSize();
-		if (pointCloudTemplateImageSize == pointCloudSize)
+	stats->totalBytes = stats->imageBytes + stats->bufferBytes + stats->lutBytes + stats->textureBytes + stats->uploadBytes;
+	return true;
+}
+
+uint64_t AzureKinectWrapper::TrimMemory()
+{
+	return ImagePool::GetShared().Trim();
+}
+
+bool AzureKinectWrapper::TryGetAllocationStats(
+	uint64_t *acquireCount,
+	uint64_t *heapAllocationCount,
+	uint64_t *heapAllocatedBytes,
+	uint64_t *outstandingCount,
+	uint64_t *outstandingBytes,
+	uint64_t *pooledBytes)
+{
+	auto stats = ImagePool::GetShared().GetStats();
+	*acquireCount = stats.acquireCount;
+	*heapAllocationCount = stats.heapAllocationCount;
+	*heapAllocatedBytes = stats.heapAllocatedBytes;
+	*outstandingCount = stats.outstandingCount;
+	*outstandingBytes = stats.outstandingBytes;
+	*pooledBytes = stats.pooledBytes;
+	return true;
+}
+
+int AzureKinectWrapper::UpdateAndGetFrameDescriptors(
+	FrameDescriptor *descriptors,
+	int capacity,
+	int descriptorSize)
+{
+	// A caller built against another layout would read every descriptor after the first at the wrong offset
+	if (descriptorSize != (int)sizeof(FrameDescriptor))
+	{
+		OutputDebugString(L"Frame descriptor size does not match the plugin's, the managed layout is out of date");
+		return -1;
+	}
+
+	CompleteDeviceStarts(false);
+
+	if (activeDeviceCount == 0 ||
+		descriptors == nullptr)
+	{
+		return 0;
+	}
+
+	// Sequences are only advanced by TryUpdate on this thread, no lock needed to snapshot them
+	uint64_t previousSequences[MaxDeviceCount];
+	for (unsigned int index = 0; index < MaxDeviceCount; index++)
+	{
+		previousSequences[index] = deviceSlots[index].frameSequence;
+	}
+
+	TryUpdate();
+
+	int count = 0;
+	for (unsigned int index = 0; index < MaxDeviceCount && count < capacity; index++)
+	{
+		DeviceSlot &slot = deviceSlots[index];
+		if (slot.device == nullptr)
 		{
-			memcpy(pointCloudTemplateImageData, cachedPointCloudTemplateImageBufferMap[index]->buffer->data(), pointCloudTemplateImageSize);
+			continue;
 		}
 
-		return true;
+		FrameDescriptor &descriptor = descriptors[count++];
+		descriptor = {};
+		descriptor.index = index;
+
+		EnterCriticalSection(&slot.slotCritSec);
+		const DeviceResources &resources = slot.resources;
+		descriptor.sequence = slot.frameSequence;
+		descriptor.depthTimestampUsec = slot.depthTimestampUsec;
+		descriptor.colorTimestampUsec = slot.colorTimestampUsec;
+		descriptor.calibrationVersion = slot.calibrationVersion;
+		descriptor.depthHostTimestampNsec = slot.frameTimestamps.depthHostTimestampNsec;
+		descriptor.captureToPublishMilliseconds = slot.frameTimestamps.captureToPublishMilliseconds;
+		descriptor.changedX = slot.changedRect.x;
+		descriptor.changedY = slot.changedRect.y;
+		descriptor.changedWidth = slot.changedRect.width;
+		descriptor.changedHeight = slot.changedRect.height;
+		if (slot.frameUnchanged)
+		{
+			descriptor.flags |= FrameDescriptorUnchanged;
+		}
+		if (slot.depthHostTimestampMapped)
+		{
+			descriptor.flags |= FrameDescriptorClockMapped;
+		}
+
+		descriptor.rgbSrv = resources.rgbSrv;
+		descriptor.depthSrv = resources.depthSrv;
+		descriptor.pointCloudTemplateSrv = resources.pointCloudTemplateSrv;
+		descriptor.irSrv = resources.irSrv;
+		descriptor.rgbWidth = resources.rgbFrameDimensions.width;
+		descriptor.rgbHeight = resources.rgbFrameDimensions.height;
+		descriptor.depthWidth = resources.depthFrameDimensions.width;
+		descriptor.depthHeight = resources.depthFrameDimensions.height;
+		descriptor.pointCloudTemplateWidth = resources.pointCloudTemplateFrameDimensions.width;
+		descriptor.pointCloudTemplateHeight = resources.pointCloudTemplateFrameDimensions.height;
+		descriptor.irWidth = resources.irFrameDimensions.width;
+		descriptor.irHeight = resources.irFrameDimensions.height;
+
+		if (slot.cachedTransformedColorImageBuffer != nullptr &&
+			slot.cachedDepthImageBuffer != nullptr)
+		{
+			descriptor.transformedColorBuffer = slot.cachedTransformedColorImageBuffer->buffer;
+			descriptor.depthBuffer = slot.cachedDepthImageBuffer->buffer;
+			descriptor.flags |= FrameDescriptorBuffersReady;
+		}
+		LeaveCriticalSection(&slot.slotCritSec);
+
+		if (descriptor.sequence != previousSequences[index])
+		{
+			descriptor.flags |= FrameDescriptorUpdated;
+		}
+
+		if (descriptor.rgbSrv != nullptr &&
+			descriptor.depthSrv != nullptr &&
+			descriptor.pointCloudTemplateSrv != nullptr)
+		{
+			descriptor.flags |= FrameDescriptorResourcesReady;
+		}
+
+		if (descriptor.irSrv != nullptr)
+		{
+			descriptor.flags |= FrameDescriptorIRReady;
+		}
+
+		if (slot.captureQueue != nullptr)
+		{
+			auto stats = slot.captureQueue->GetStats();
+			descriptor.queueDepth = stats.depth;
+			descriptor.deliveredCount = stats.deliveredCount;
+			descriptor.droppedCount = stats.droppedCount;
+			descriptor.lastAgeMilliseconds = stats.lastAgeMilliseconds;
+			descriptor.averageAgeMilliseconds = stats.averageAgeMilliseconds;
+		}
 	}
 
-	return false;
+	return count;
 }
 
-void AzureKinectWrapper::StopStreamingAll()
+bool AzureKinectWrapper::TryGetCalibrationBlob(
+	unsigned int index,
+	CalibrationBlob *blob)
 {
-	std::vector<int> indices;
-	for(auto device : deviceMap)
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr ||
+		blob == nullptr)
 	{
-		indices.push_back(device.first);
+		return false;
 	}
 
-	for (auto index : indices)
+	EnterCriticalSection(&slot->slotCritSec);
+	bool hasCalibration = slot->hasCalibration;
+	auto calibration = slot->calibration;
+	uint32_t calibrationVersion = slot->calibrationVersion;
+	LeaveCriticalSection(&slot->slotCritSec);
+
+	if (!hasCalibration)
 	{
-		StopStreaming(index);
+		return false;
 	}
+
+	auto fillCamera = [](const k4a_calibration_camera_t &camera, CalibrationBlobCamera &target)
+	{
+		target.width = camera.resolution_width;
+		target.height = camera.resolution_height;
+		target.intrinsicsType = static_cast<int32_t>(camera.intrinsics.type);
+		target.intrinsicsCount = static_cast<int32_t>(min(camera.intrinsics.parameter_count, 15u));
+		memcpy(target.intrinsics, camera.intrinsics.parameters.v, sizeof(target.intrinsics));
+		target.metricRadius = camera.metric_radius;
+		memcpy(target.rotation, camera.extrinsics.rotation, sizeof(target.rotation));
+		memcpy(target.translation, camera.extrinsics.translation, sizeof(target.translation));
+	};
+
+	*blob = {};
+	blob->magic = CalibrationBlob::Magic;
+	blob->layoutVersion = CalibrationBlob::LayoutVersion;
+	blob->size = sizeof(CalibrationBlob);
+	blob->calibrationVersion = calibrationVersion;
+	blob->depthMode = calibration.depth_mode;
+	blob->colorResolution = calibration.color_resolution;
+	fillCamera(calibration.depth_camera_calibration, blob->depth);
+	fillCamera(calibration.color_camera_calibration, blob->color);
+
+	const auto &depthToColor = calibration.extrinsics[K4A_CALIBRATION_TYPE_DEPTH][K4A_CALIBRATION_TYPE_COLOR];
+	memcpy(blob->depthToColorRotation, depthToColor.rotation, sizeof(blob->depthToColorRotation));
+	memcpy(blob->depthToColorTranslation, depthToColor.translation, sizeof(blob->depthToColorTranslation));
+	return true;
 }
 
-void AzureKinectWrapper::StopStreaming(unsigned int index)
+void AzureKinectWrapper::SetRenderThreadUploads(bool enabled)
 {
-    if (deviceMap.count(index) > 0)
-    {
-        OutputDebugString(L"Closed device: " + index);
-        k4a_device_close(deviceMap[index]);
-		deviceMap.erase(index);
-    }
-    else
-    {
-        OutputDebugString(L"Asked to close unknown device: " + index);
-    }
+	renderThreadUploads.store(enabled);
+}
+
+void AzureKinectWrapper::DrainUploads()
+{
+	uploadQueue->Drain();
+}
+
+bool AzureKinectWrapper::TryGetUploadStats(
+	int *targetCount,
+	uint64_t *submittedCount,
+	uint64_t *uploadedCount,
+	uint64_t *coalescedCount,
+	uint64_t *uploadedBytes)
+{
+	auto stats = uploadQueue->GetStats();
+	*targetCount = stats.targetCount;
+	*submittedCount = stats.submittedCount;
+	*uploadedCount = stats.uploadedCount;
+	*coalescedCount = stats.coalescedCount;
+	*uploadedBytes = stats.uploadedBytes;
+	return true;
+}
 
-	if (calibrationMap.count(index) != 0)
+bool AzureKinectWrapper::TryGetFrameSequence(
+	unsigned int index,
+	uint64_t *sequence)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
 	{
-		calibrationMap.erase(index);
+		return false;
 	}
 
-	if (transformationMap.count(index) != 0)
+	EnterCriticalSection(&slot->slotCritSec);
+	bool streaming = slot->streaming;
+	*sequence = slot->frameSequence;
+	LeaveCriticalSection(&slot->slotCritSec);
+	return streaming;
+}
+
+bool AzureKinectWrapper::TryWaitForFrame(
+	unsigned int index,
+	uint64_t afterSequence,
+	unsigned int timeoutMilliseconds,
+	uint64_t *sequence)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
 	{
-		k4a_transformation_destroy(transformationMap[index]);
-		transformationMap.erase(index);
+		return false;
 	}
 
-	if (transformedColorMap.count(index) != 0)
+	// Sleeps can wake spuriously, so wait against a deadline rather than the raw timeout
+	const ULONGLONG deadline = GetTickCount64() + timeoutMilliseconds;
+	EnterCriticalSection(&slot->slotCritSec);
+	while (slot->streaming &&
+		slot->frameSequence <= afterSequence)
 	{
-		k4a_image_release(transformedColorMap[index]);
-		transformedColorMap.erase(index);
+		DWORD remaining = INFINITE;
+		if (timeoutMilliseconds != INFINITE)
+		{
+			ULONGLONG now = GetTickCount64();
+			if (now >= deadline)
+			{
+				break;
+			}
+			remaining = static_cast<DWORD>(deadline - now);
+		}
+
+		SleepConditionVariableCS(&slot->frameAvailable, &slot->slotCritSec, remaining);
 	}
 
-	if (xyTableMap.count(index) != 0)
+	*sequence = slot->frameSequence;
+	bool published = slot->frameSequence > afterSequence;
+	LeaveCriticalSection(&slot->slotCritSec);
+	return published;
+}
+
+bool AzureKinectWrapper::TrySetFrameCallback(
+	unsigned int index,
+	FrameCallback callback,
+	void *context)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
 	{
-		k4a_image_release(xyTableMap[index]);
-		xyTableMap.erase(index);
+		return false;
 	}
 
-	if (pointCloudTemplateMap.count(index) != 0)
+	EnterCriticalSection(&slot->slotCritSec);
+	bool streaming = slot->streaming;
+	if (streaming)
 	{
-		k4a_image_release(pointCloudTemplateMap[index]);
-		pointCloudTemplateMap.erase(index);
+		slot->frameCallback = callback;
+		slot->frameCallbackContext = context;
 	}
+	LeaveCriticalSection(&slot->slotCritSec);
+	return streaming;
+}
 
-	if (cachedTransformedColorImageBufferMap.count(index) != 0)
+bool AzureKinectWrapper::TryGetFrameTimestamps(
+	unsigned int index,
+	FrameTimestamps *timestamps)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr ||
+		timestamps == nullptr)
 	{
-		cachedTransformedColorImageBufferMap.erase(index);
+		return false;
 	}
 
-	if (cachedDepthImageBufferMap.count(index) != 0)
+	EnterCriticalSection(&slot->slotCritSec);
+	*timestamps = slot->frameTimestamps;
+	LeaveCriticalSection(&slot->slotCritSec);
+	return timestamps->sequence != 0;
+}
+
+bool AzureKinectWrapper::TryGetClockMapping(
+	unsigned int index,
+	bool *hasFit,
+	int *sampleCount,
+	int *inlierCount,
+	int64_t *offsetMicroseconds,
+	double *driftPpm,
+	float *residualMicroseconds)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
 	{
-		cachedDepthImageBufferMap.erase(index);
+		return false;
 	}
 
-	if (cachedPointCloudTemplateImageBufferMap.count(index) != 0)
+	EnterCriticalSection(&slot->slotCritSec);
+	auto stats = slot->clockMapper.GetStats();
+	LeaveCriticalSection(&slot->slotCritSec);
+
+	*hasFit = stats.hasFit;
+	*sampleCount = stats.sampleCount;
+	*inlierCount = stats.inlierCount;
+	*offsetMicroseconds = stats.offsetMicroseconds;
+	*driftPpm = stats.driftPpm;
+	*residualMicroseconds = stats.residualMicroseconds;
+	return true;
+}
+
+bool AzureKinectWrapper::TryMapDeviceTimestamp(
+	unsigned int index,
+	uint64_t deviceTimestampUsec,
+	uint64_t *hostTimestampNsec)
+{
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
 	{
-		cachedPointCloudTemplateImageBufferMap.erase(index);
+		return false;
 	}
+
+	EnterCriticalSection(&slot->slotCritSec);
+	bool mapped = slot->clockMapper.TryMapToHost(deviceTimestampUsec, hostTimestampNsec);
+	LeaveCriticalSection(&slot->slotCritSec);
+	return mapped;
 }
 
-void AzureKinectWrapper::UpdateResources(k4a_image_t image,
-                                         ID3D11ShaderResourceView *&srv,
-                                         ID3D11Texture2D *&tex,
-                                         FrameDimensions &dim,
-                                         DXGI_FORMAT format)
+bool AzureKinectWrapper::TryGetLatencyStats(
+	unsigned int index,
+	uint64_t *frameCount,
+	float *lastMilliseconds,
+	float *averageMilliseconds,
+	float *maxMilliseconds)
 {
-    EnterCriticalSection(&resourcesCritSec);
-    dim.height = k4a_image_get_height_pixels(image);
-    dim.width = k4a_image_get_width_pixels(image);
-    auto stride = k4a_image_get_stride_bytes(image);
-    dim.bpp = stride / dim.width;
-    auto buffer = k4a_image_get_buffer(image);
-
-    if (tex == nullptr)
-    {
-        tex = DirectXHelper::CreateTexture(d3d11Device, buffer, dim.width, dim.height, dim.bpp, format);
-    }
+	DeviceSlot *slot = TryGetSlot(index);
+	if (slot == nullptr)
+	{
+		return false;
+	}
 
-    if (srv == nullptr)
-    {
-        srv = DirectXHelper::CreateShaderResourceView(d3d11Device, tex, format);
-    }
-    else
-    {
-        OutputDebugString(L"Updating shader resource view");
-        DirectXHelper::UpdateShaderResourceView(d3d11Device, srv, buffer, stride);
-    }
+	EnterCriticalSection(&slot->slotCritSec);
+	LatencyStats stats = slot->latencyStats;
+	LeaveCriticalSection(&slot->slotCritSec);
 
-    LeaveCriticalSection(&resourcesCritSec);
-}
\ No newline at end of file
+	*frameCount = stats.frameCount;
+	*lastMilliseconds = stats.lastMilliseconds;
+	*averageMilliseconds = stats.frameCount > 0 ? (float)(stats.totalMilliseconds / stats.frameCount) : 0.0f;
+	*maxMilliseconds = stats.maxMilliseconds;
+	return stats.frameCount > 0;
+}
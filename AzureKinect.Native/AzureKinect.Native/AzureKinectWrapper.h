@@ -1,11 +1,25 @@
 #pragma once
 
+// Called on the thread running TryUpdate after a device published a new frame
+typedef void (__stdcall *FrameCallback)(unsigned int index, uint64_t sequence, void *context);
+
+enum DeviceStartState
+{
+	DeviceStartStateIdle = 0,
+	// Opening and starting the cameras on a thread of its own
+	DeviceStartStateStarting = 1,
+	DeviceStartStateStarted = 2,
+	DeviceStartStateFailed = 3
+};
+
 class AzureKinectWrapper
 {
 public:
     static unsigned int GetDeviceCount();
 
     AzureKinectWrapper(ID3D11Device *device);
+	// Uploads go to the given backend instead of the device's context, textures still come from the device
+	AzureKinectWrapper(ID3D11Device *device, std::unique_ptr<TextureUploadBackend> uploadBackend);
     ~AzureKinectWrapper();
     bool TryGetDeviceSerialNumber(
 		unsigned int index,
@@ -31,6 +45,51 @@ public:
 		k4a_color_resolution_t colorResolution,
 		k4a_depth_mode_t depthMode,
 		k4a_fps_t fps);
+	bool TryStartStreamsAsync(
+		unsigned int index,
+		k4a_image_format_t colorFormat,
+		k4a_color_resolution_t colorResolution,
+		k4a_depth_mode_t depthMode,
+		k4a_fps_t fps);
+	bool TryReconfigureStreams(
+		unsigned int index,
+		k4a_image_format_t colorFormat,
+		k4a_color_resolution_t colorResolution,
+		k4a_depth_mode_t depthMode,
+		k4a_fps_t fps,
+		float *reconfigureMilliseconds);
+	bool TryGetReconfigureStats(
+		unsigned int index,
+		uint64_t *reconfigureCount,
+		float *lastMilliseconds,
+		float *cameraMilliseconds,
+		float *rebuildMilliseconds,
+		bool *calibrationChanged,
+		bool *resourcesRecreated);
+	bool TryGetDeviceStartState(
+		unsigned int index,
+		int *state,
+		float *openMilliseconds,
+		float *startMilliseconds);
+	bool TryWaitForDeviceStarts(unsigned int timeoutMilliseconds);
+	bool TryGetStartupStats(
+		int *deviceCount,
+		int *failedCount,
+		int *pendingCount,
+		float *wallMilliseconds,
+		float *summedMilliseconds);
+	bool TryGetDeviceInfo(
+		unsigned int index,
+		DeviceInfo *info);
+	bool TryGetDeviceRawCalibration(
+		unsigned int index,
+		byte *data,
+		int capacity,
+		int *size);
+	int FindDeviceBySerialNumber(const char *serialNumber);
+	bool TryRefreshDeviceTable(
+		int *deviceCount,
+		float *refreshMilliseconds);
     bool TryUpdate();
 	bool TryGetCalibration(
 		int index,
@@ -57,6 +116,397 @@ public:
 		byte *pointCloudTemplateImageData,
 		int pointCloudTemplateImageSize);
     void StopStreaming(unsigned int index);
+	bool TryEnableSpatialIndex(
+		unsigned int index,
+		float cellSize,
+		bool benchmark);
+	void DisableSpatialIndex(unsigned int index);
+	bool TryRaycastPointCloud(
+		unsigned int index,
+		float *origin,
+		float *direction,
+		float maxDistance,
+		float pickRadius,
+		float *hitPoint,
+		int *hitPixelIndex);
+	bool TryGetNearestPoints(
+		unsigned int index,
+		float *point,
+		int k,
+		int *pixelIndices,
+		float *distances,
+		int *count);
+	bool TryGetPointsInRadius(
+		unsigned int index,
+		float *point,
+		float radius,
+		int *pixelIndices,
+		int capacity,
+		int *count);
+	bool TryGetSpatialIndexStats(
+		unsigned int index,
+		int *pointCount,
+		float *cellSize,
+		float *buildMilliseconds,
+		float *queryMilliseconds,
+		float *bruteForceMilliseconds);
+	bool TrySetWorldTransform(
+		unsigned int index,
+		float *worldTransform);
+	bool TrySetRegionOfInterest(
+		unsigned int index,
+		int x,
+		int y,
+		int width,
+		int height,
+		unsigned short minDepth,
+		unsigned short maxDepth,
+		float *boxMin,
+		float *boxMax);
+	void ClearRegionOfInterest(unsigned int index);
+	bool TryGetRegionOfInterestStats(
+		unsigned int index,
+		int *processedPixelCount,
+		int *keptPixelCount,
+		uint64_t *copiedBytes,
+		float *processMilliseconds);
+	bool TrySetChangeDetection(
+		unsigned int index,
+		bool enabled,
+		int depthNoiseThreshold,
+		int irNoiseThreshold,
+		unsigned int tileThreshold,
+		int keyframeInterval);
+	bool TryGetChangeMask(
+		unsigned int index,
+		byte *maskData,
+		int maskSize,
+		int *columns,
+		int *rows);
+	bool TryGetChangeDetectionStats(
+		unsigned int index,
+		ChangeDetectionStats *stats);
+	bool TrySetOutlierFilter(
+		unsigned int index,
+		bool enabled,
+		int windowSize,
+		float sigma,
+		OutlierFilterMode mode);
+	bool TryGetOutlierMask(
+		unsigned int index,
+		byte *maskData,
+		int maskSize,
+		int *width,
+		int *height);
+	bool TryGetOutlierFilterStats(
+		unsigned int index,
+		OutlierFilterStats *stats);
+	bool TryStartSharedFrames(
+		unsigned int index,
+		const char *name,
+		int slotCount,
+		bool includeIR);
+	void StopSharedFrames(unsigned int index);
+	bool TryGetSharedFrameName(
+		unsigned int index,
+		char *name,
+		unsigned int nameSize);
+	bool TryGetSharedFrameStats(
+		unsigned int index,
+		SharedFrameStats *stats);
+	bool TryStartFrameServer(
+		unsigned int index,
+		int port,
+		int colorQuality,
+		int depthErrorMillimeters,
+		float maxFramesPerSecond,
+		int *boundPort);
+	void StopFrameServer(unsigned int index);
+	bool TryGetFrameServerStats(
+		unsigned int index,
+		FrameServerStats *stats);
+	bool TryConnectFrameClient(
+		const char *host,
+		int port,
+		uint64_t *clientId);
+	void DisconnectFrameClient(uint64_t clientId);
+	bool TryGetFrameClientFrame(
+		uint64_t clientId,
+		uint64_t *sequence,
+		FrameClientFrameInfo *info,
+		uint16_t *depthData,
+		byte *colorData,
+		int pixelCapacity);
+	bool TryGetFrameClientStats(
+		uint64_t clientId,
+		FrameClientStats *stats);
+	void ClearWorldTransform(unsigned int index);
+	bool TryFusePointClouds(
+		float voxelSize,
+		float *positions,
+		unsigned int *colors,
+		int capacity,
+		int *count);
+	bool TryGetFusionStats(
+		int *deviceCount,
+		int *inputPointCount,
+		int *fusedPointCount,
+		float *transformMilliseconds,
+		float *mergeMilliseconds);
+	bool TryExportPointCloud(
+		unsigned int index,
+		const char *path,
+		PointCloudFileFormat format,
+		bool includeNormals,
+		int *pointCount);
+	bool TryConvertRecording(
+		const char *recordingPath,
+		const char *outputDirectory,
+		PointCloudFileFormat format,
+		bool includeNormals,
+		int *frameCount);
+	bool TryGetExportStats(
+		int *frameCount,
+		int *pointCount,
+		uint64_t *writtenBytes,
+		float *encodeMilliseconds,
+		float *writeMilliseconds,
+		float *megabytesPerSecond);
+	bool TryCreateTsdfVolume(
+		unsigned int index,
+		float voxelSize,
+		float truncationDistance);
+	void DestroyTsdfVolume(unsigned int index);
+	bool TryIntegrateTsdfVolume(
+		unsigned int index,
+		float *cameraToWorld);
+	bool TryRaycastTsdfVolume(
+		unsigned int index,
+		float *cameraToWorld,
+		float *points,
+		int pointCapacity,
+		int *width,
+		int *height,
+		int *hitCount);
+	bool TryGetTsdfVolumeStats(
+		unsigned int index,
+		int *frameCount,
+		int *blockCount,
+		int *integratedBlockCount,
+		float *allocationMilliseconds,
+		float *integrationMilliseconds,
+		float *raycastMilliseconds);
+	bool TryStartImu(unsigned int index);
+	void StopImu(unsigned int index);
+	bool TryGetImuSamples(
+		unsigned int index,
+		uint64_t cursor,
+		k4a_imu_sample_t *samples,
+		int capacity,
+		int *count,
+		uint64_t *nextCursor,
+		uint64_t *depthTimestampUsec);
+	void SubscribeIR(unsigned int index);
+	void UnsubscribeIR(unsigned int index);
+	bool TryGetIRShaderResourceView(
+		unsigned int index,
+		ID3D11ShaderResourceView *&irSrv,
+		unsigned int &irWidth,
+		unsigned int &irHeight,
+		unsigned int &irBpp);
+	bool TryGetIRImageBuffer(
+		unsigned int index,
+		byte *irImageData,
+		int irImageSize);
+	bool TryGetToneMappedIRImage(
+		unsigned int index,
+		byte *toneMappedImageData,
+		int toneMappedImageSize,
+		int minValue,
+		int maxValue);
+	bool TryLeaseIRImage(
+		unsigned int index,
+		byte **irImageData,
+		int *width,
+		int *height,
+		int *stride,
+		uint64_t *leaseId);
+	void ReleaseIRImageLease(uint64_t leaseId);
+	bool TrySetDeliveryPolicy(
+		unsigned int index,
+		DeliveryPolicy policy,
+		int queueCapacity);
+	bool TryGetDeliveryStats(
+		unsigned int index,
+		int *policy,
+		int *queueCapacity,
+		int *queueDepth,
+		int *maxQueueDepth,
+		uint64_t *deliveredCount,
+		uint64_t *droppedCount,
+		float *lastAgeMilliseconds,
+		float *maxAgeMilliseconds,
+		float *averageAgeMilliseconds);
+	bool TryGetDeviceMemoryStats(
+		unsigned int index,
+		DeviceMemoryStats *stats);
+	uint64_t TrimMemory();
+	bool TryGetAllocationStats(
+		uint64_t *acquireCount,
+		uint64_t *heapAllocationCount,
+		uint64_t *heapAllocatedBytes,
+		uint64_t *outstandingCount,
+		uint64_t *outstandingBytes,
+		uint64_t *pooledBytes);
+	int UpdateAndGetFrameDescriptors(
+		FrameDescriptor *descriptors,
+		int capacity,
+		int descriptorSize);
+	bool TryGetCalibrationBlob(
+		unsigned int index,
+		CalibrationBlob *blob);
+	bool TryGetFrameSequence(
+		unsigned int index,
+		uint64_t *sequence);
+	bool TryWaitForFrame(
+		unsigned int index,
+		uint64_t afterSequence,
+		unsigned int timeoutMilliseconds,
+		uint64_t *sequence);
+	bool TrySetFrameCallback(
+		unsigned int index,
+		FrameCallback callback,
+		void *context);
+	bool TryGetFrameTimestamps(
+		unsigned int index,
+		FrameTimestamps *timestamps);
+	bool TryGetClockMapping(
+		unsigned int index,
+		bool *hasFit,
+		int *sampleCount,
+		int *inlierCount,
+		int64_t *offsetMicroseconds,
+		double *driftPpm,
+		float *residualMicroseconds);
+	bool TryMapDeviceTimestamp(
+		unsigned int index,
+		uint64_t deviceTimestampUsec,
+		uint64_t *hostTimestampNsec);
+	bool TryGetLatencyStats(
+		unsigned int index,
+		uint64_t *frameCount,
+		float *lastMilliseconds,
+		float *averageMilliseconds,
+		float *maxMilliseconds);
+	void SubscribePyramidLevel(
+		unsigned int index,
+		int level);
+	void UnsubscribePyramidLevel(
+		unsigned int index,
+		int level);
+	bool TrySetPyramidDepthFilter(
+		unsigned int index,
+		PyramidDepthFilter filter);
+	bool TryGetPyramidShaderResourceViews(
+		unsigned int index,
+		int level,
+		ID3D11ShaderResourceView *&rgbSrv,
+		unsigned int &rgbWidth,
+		unsigned int &rgbHeight,
+		ID3D11ShaderResourceView *&depthSrv,
+		unsigned int &depthWidth,
+		unsigned int &depthHeight);
+	bool TryGetPyramidImageBuffers(
+		unsigned int index,
+		int level,
+		byte *colorImageData,
+		int colorImageSize,
+		byte *depthImageData,
+		int depthImageSize);
+	void SubscribeUndistortedStream(
+		unsigned int index,
+		UndistortedStream stream);
+	void UnsubscribeUndistortedStream(
+		unsigned int index,
+		UndistortedStream stream);
+	bool TrySetUndistortInterpolation(
+		unsigned int index,
+		interpolation_t interpolation);
+	bool TryGetUndistortedPinhole(
+		unsigned int index,
+		float *fx,
+		float *fy,
+		float *px,
+		float *py,
+		int *width,
+		int *height);
+	bool TryGetUndistortedShaderResourceViews(
+		unsigned int index,
+		ID3D11ShaderResourceView *&depthSrv,
+		unsigned int &depthWidth,
+		unsigned int &depthHeight,
+		ID3D11ShaderResourceView *&irSrv,
+		unsigned int &irWidth,
+		unsigned int &irHeight);
+	bool TryGetUndistortedImageBuffers(
+		unsigned int index,
+		byte *depthImageData,
+		int depthImageSize,
+		byte *irImageData,
+		int irImageSize);
+	bool TryGetUndistortStats(
+		unsigned int index,
+		int *interpolation,
+		uint64_t *lutBytes,
+		float *lutMilliseconds,
+		float *depthRemapMilliseconds,
+		float *irRemapMilliseconds);
+	bool TryBenchmarkUndistort(
+		unsigned int index,
+		int iterations,
+		float *nearestNeighborMilliseconds,
+		float *bilinearMilliseconds,
+		float *bilinearDepthMilliseconds);
+	void SubscribeColorUvMap(unsigned int index);
+	void UnsubscribeColorUvMap(unsigned int index);
+	bool TrySetColorUvFormat(
+		unsigned int index,
+		ColorUvFormat format,
+		float occlusionTolerance);
+	bool TrySetRegistrationEnabled(
+		unsigned int index,
+		bool enabled);
+	bool TryGetColorUvShaderResourceViews(
+		unsigned int index,
+		ID3D11ShaderResourceView *&colorSrv,
+		unsigned int &colorWidth,
+		unsigned int &colorHeight,
+		ID3D11ShaderResourceView *&uvSrv,
+		ID3D11ShaderResourceView *&flagsSrv,
+		unsigned int &uvWidth,
+		unsigned int &uvHeight);
+	bool TryGetColorUvImageBuffers(
+		unsigned int index,
+		byte *uvImageData,
+		int uvImageSize,
+		byte *flagsImageData,
+		int flagsImageSize);
+	bool TryGetColorUvStats(
+		unsigned int index,
+		int *validPixelCount,
+		int *occludedPixelCount,
+		float *projectMilliseconds,
+		uint64_t *uploadBytes,
+		float *registrationMilliseconds,
+		uint64_t *registrationUploadBytes);
+	void SetRenderThreadUploads(bool enabled);
+	void DrainUploads();
+	bool TryGetUploadStats(
+		int *targetCount,
+		uint64_t *submittedCount,
+		uint64_t *uploadedCount,
+		uint64_t *coalescedCount,
+		uint64_t *uploadedBytes);
 
 private:
     struct FrameDimensions
@@ -77,6 +527,15 @@ private:
 		ID3D11Texture2D *pointCloudTemplateTexture;
 		ID3D11ShaderResourceView *pointCloudTemplateSrv;
 		FrameDimensions pointCloudTemplateFrameDimensions;
+		ID3D11Texture2D *irTexture;
+		ID3D11ShaderResourceView *irSrv;
+		FrameDimensions irFrameDimensions;
+
+		// Slots in the upload queue, registered with the first update after the texture exists
+		int rgbUploadTarget = -1;
+		int depthUploadTarget = -1;
+		int pointCloudTemplateUploadTarget = -1;
+		int irUploadTarget = -1;
     };
 
 	class ImageBuffer
@@ -85,40 +544,458 @@ private:
 		ImageBuffer(FrameDimensions dimensions)
 		{
 			this->dimensions = dimensions;
-			buffer = std::make_shared<std::vector<byte>>(GetSize());
+			buffer = ImagePool::GetShared().Acquire(GetSize(), sizeClass);
+			// Pooled memory still holds an earlier owner's pixels, and a buffer can be read before its first write
+			memset(buffer, 0, GetSize());
+		}
+
+		~ImageBuffer()
+		{
+			ImagePool::GetShared().Release(buffer, sizeClass);
 		}
 
+		ImageBuffer(const ImageBuffer &) = delete;
+		ImageBuffer &operator=(const ImageBuffer &) = delete;
+
 		int GetSize()
 		{
 			return dimensions.bpp * dimensions.height * dimensions.width;
 		}
 
 		FrameDimensions dimensions;
-		std::shared_ptr<std::vector<byte>> buffer;
+		byte *buffer;
+
+	private:
+		size_t sizeClass;
+	};
+
+	// Copies of a slot's cached depth and registered color with a reference on the xy table they were cached
+	// with, so the frame can be used without holding the slot's lock. Color is null when none was cached.
+	struct FrameSnapshot
+	{
+		std::shared_ptr<ImageBuffer> depthBuffer;
+		std::shared_ptr<ImageBuffer> colorBuffer;
+		k4a_image_t xyTableImage = nullptr;
+	};
+
+	// One downscaled stream, only the rgb and depth resources are used
+	struct PyramidLevel
+	{
+		int subscriberCount = 0;
+		bool hasColor = false;
+		DeviceResources resources = {};
+		std::shared_ptr<ImageBuffer> colorImageBuffer;
+		std::shared_ptr<ImageBuffer> depthImageBuffer;
+	};
+
+	// Level 1 halves the frame and level 2 quarters it
+	static const int PyramidLevelCount = 2;
+
+	// Describes the last processed frame, keptPixelCount is -1 without a region of interest
+	struct RegionOfInterestStats
+	{
+		int processedPixelCount;
+		int keptPixelCount;
+		uint64_t copiedBytes;
+		float processMilliseconds;
+	};
+
+	// Thresholds are per pixel in millimeters and ir counts, a negative ir threshold leaves ir out. The
+	// tile threshold is the sum over a tile's pixels of what exceeded them.
+	struct ChangeDetectionSettings
+	{
+		bool enabled;
+		uint16_t depthNoiseThreshold;
+		int irNoiseThreshold;
+		uint32_t tileThreshold;
+		int keyframeInterval;
+	};
+
+	// The window is square with an odd side in depth pixels. Pixels whose distance ratio is more than sigma
+	// standard deviations above the frame's mean are rejected.
+	struct OutlierFilterSettings
+	{
+		bool enabled;
+		int windowSize;
+		float sigma;
+		OutlierFilterMode mode;
+	};
+
+	// Describes the undistorted streams, remap times are for the last frame
+	struct UndistortStats
+	{
+		uint64_t lutBytes;
+		float lutMilliseconds;
+		float depthRemapMilliseconds;
+		float irRemapMilliseconds;
+	};
+
+	// Describes the last frame. Registration is the sdk warping the color image onto the depth camera,
+	// kept next to the uv map's cost so the two paths can be compared on the same frames.
+	struct ColorUvStats
+	{
+		int validPixelCount;
+		int occludedPixelCount;
+		float projectMilliseconds;
+		uint64_t uploadBytes;
+		float registrationMilliseconds;
+		uint64_t registrationUploadBytes;
+	};
+
+	// Capture to publish latency over every frame since the device started
+	struct LatencyStats
+	{
+		uint64_t frameCount;
+		float lastMilliseconds;
+		float maxMilliseconds;
+		double totalMilliseconds;
+	};
+
+	// Describes the last reconfiguration. Camera time is stopping and restarting the sensors, rebuild
+	// time is the calibration dependent state that had to be replaced.
+	struct ReconfigureStats
+	{
+		uint64_t reconfigureCount;
+		float lastMilliseconds;
+		float cameraMilliseconds;
+		float rebuildMilliseconds;
+		bool calibrationChanged;
+		bool resourcesRecreated;
+	};
+
+	// What opening a device produces before any of it is visible in its slot
+	struct OpenedDevice
+	{
+		k4a_device_t device = nullptr;
+		k4a_device_configuration_t configuration = K4A_DEVICE_CONFIG_INIT_DISABLE_ALL;
+		k4a_calibration_t calibration = {};
+		k4a_transformation_t transformation = nullptr;
+		k4a_image_t transformedColorImage = nullptr;
+		k4a_image_t xyTableImage = nullptr;
+		float openMilliseconds = 0.0f;
+	};
+
+	// The asynchronous starts launched while others were still in flight, from the first launch
+	// to the last device published
+	struct StartupStats
+	{
+		int deviceCount;
+		int failedCount;
+		int pendingCount;
+		int64_t startTimestamp;
+		float wallMilliseconds;
+		// Open times added up, roughly what starting the devices one after the other costs
+		float summedMilliseconds;
+	};
+
+	// Everything kept for one device. Slots live in a fixed array indexed by device index and are
+	// cache line aligned, so devices never share a lock or a line. The control thread (start, stop
+	// and update) owns the device handles and sdk images; slotCritSec guards what other threads
+	// read: the d3d resources, the cached cpu buffers, the latest ir image and the feature objects.
+	struct alignas(64) DeviceSlot
+	{
+		k4a_device_t device = nullptr;
+		CRITICAL_SECTION slotCritSec;
+		k4a_device_configuration_t configuration = K4A_DEVICE_CONFIG_INIT_DISABLE_ALL;
+
+		// An asynchronous start opens the device into openedDevice on startThread, the control
+		// thread joins it and publishes the device. startCompleted is guarded by startCritSec.
+		std::thread startThread;
+		bool startCompleted = false;
+		OpenedDevice openedDevice;
+		DeviceStartState startState = DeviceStartStateIdle;
+		int64_t startTimestamp = 0;
+		float openMilliseconds = 0.0f;
+		float startMilliseconds = 0.0f;
+		ReconfigureStats reconfigureStats = {};
+
+		bool hasResources = false;
+		DeviceResources resources = {};
+		std::shared_ptr<ImageBuffer> cachedTransformedColorImageBuffer;
+		std::shared_ptr<ImageBuffer> cachedDepthImageBuffer;
+		std::shared_ptr<ImageBuffer> cachedPointCloudTemplateImageBuffer;
+
+		bool hasCalibration = false;
+		k4a_calibration_t calibration = {};
+		k4a_transformation_t transformation = nullptr;
+		k4a_image_t transformedColorImage = nullptr;
+		k4a_image_t xyTableImage = nullptr;
+		k4a_image_t pointCloudTemplateImage = nullptr;
+		uint64_t depthTimestampUsec = 0;
+		uint64_t colorTimestampUsec = 0;
+		// Starts at zero and grows by one per published frame, waiters sleep on frameAvailable
+		uint64_t frameSequence = 0;
+		bool streaming = false;
+		CONDITION_VARIABLE frameAvailable;
+		FrameCallback frameCallback = nullptr;
+		void *frameCallbackContext = nullptr;
+		uint32_t calibrationVersion = 0;
+
+		// Fed with every depth image's timestamp pair, maps device time onto the host monotonic clock
+		FrameTimestamps frameTimestamps = {};
+		// Whether the last frame's host timestamp came from the mapping rather than the system timestamp
+		bool depthHostTimestampMapped = false;
+		ClockMapper clockMapper;
+		LatencyStats latencyStats = {};
+
+		std::shared_ptr<PointCloudSpatialIndex> spatialIndex;
+		bool hasWorldTransform = false;
+		std::array<float, 16> worldTransform = {};
+		std::shared_ptr<TsdfVolume> tsdfVolume;
+		std::shared_ptr<ImuStream> imuStream;
+
+		// The latest ir image is the capture's own buffer, held by reference instead of copied
+		int irSubscriberCount = 0;
+		k4a_image_t latestIRImage = nullptr;
+
+		// Policies are picked before the device starts, the queue is created with the streams
+		DeliveryPolicy deliveryPolicy = DeliveryPolicyLatestOnly;
+		int deliveryQueueCapacity = 1;
+		std::shared_ptr<CaptureQueue> captureQueue;
+
+		// The crop is picked up by the next update, changed forces one full copy and upload
+		bool hasRegionOfInterest = false;
+		bool regionOfInterestChanged = false;
+		RegionOfInterest regionOfInterest = {};
+		RegionOfInterestStats regionOfInterestStats = { 0, -1, 0, 0.0f };
+
+		// Frames without a changed tile skip the color transform and every copy and upload, others limit
+		// them to the rect around the changed tiles, and every keyframeInterval frames one goes through
+		// whole. The references and the working mask belong to the control thread, changeMask is the
+		// published copy. Changed settings force a keyframe like a changed region does.
+		ChangeDetectionSettings changeDetection = { false, 20, -1, 4096, 30 };
+		bool changeDetectionChanged = false;
+		bool hasChangeReference = false;
+		int framesSinceKeyframe = 0;
+		std::shared_ptr<ImageBuffer> changeDepthReference;
+		std::shared_ptr<ImageBuffer> changeIRReference;
+		std::vector<uint8_t> changeMaskWork;
+		std::vector<uint8_t> changeMask;
+		PixelRect changedRect = {};
+		bool frameUnchanged = false;
+		ChangeDetectionStats changeDetectionStats = {};
+
+		// Flying pixel rejection over the organized depth grid, right after the crop so change detection and
+		// everything after it see the cleaned depth. The ratios, sums and working mask belong to the control
+		// thread, outlierMask is the published copy and only kept in mask mode.
+		OutlierFilterSettings outlierFilter = { false, 5, 2.0f, OutlierFilterMask };
+		std::vector<float> outlierRatios;
+		std::vector<double> outlierScratch;
+		std::vector<double> outlierBandSums;
+		std::vector<uint8_t> outlierMaskWork;
+		std::vector<uint8_t> outlierMask;
+		OutlierFilterStats outlierFilterStats = {};
+
+		// Each level is built from the one above it, only while it or a smaller level has subscribers
+		std::array<PyramidLevel, PyramidLevelCount> pyramidLevels;
+		PyramidDepthFilter pyramidDepthFilter = PyramidDepthFilterMedian;
+
+		// Depth and ir remapped onto a pinhole camera while subscribed, only the depth and ir resources
+		// are used. The lut belongs to the control thread and is rebuilt when the interpolation needs
+		// the other layout, the pinhole is published with it.
+		int undistortedDepthSubscriberCount = 0;
+		int undistortedIRSubscriberCount = 0;
+		interpolation_t undistortInterpolation = INTERPOLATION_BILINEAR_DEPTH;
+		k4a_image_t undistortLut = nullptr;
+		bool undistortLutBilinear = false;
+		bool hasUndistortPinhole = false;
+		pinhole_t undistortPinhole = {};
+		DeviceResources undistortResources = {};
+		std::shared_ptr<ImageBuffer> undistortedDepthImageBuffer;
+		std::shared_ptr<ImageBuffer> undistortedIRImageBuffer;
+		UndistortStats undistortStats = {};
+
+		// Per depth pixel coordinates into the unwarped color image while subscribed. The rgb resources
+		// hold the color image itself, depth the uv map and ir the occlusion flags. Without registration
+		// the sdk color transform is skipped and the registered color stream stays empty.
+		int colorUvSubscriberCount = 0;
+		ColorUvFormat colorUvFormat = ColorUvFormatRG16;
+		float colorUvOcclusionTolerance = 30.0f;
+		bool registrationEnabled = true;
+		DeviceResources colorUvResources = {};
+		std::shared_ptr<ImageBuffer> colorUvImageBuffer;
+		std::shared_ptr<ImageBuffer> colorUvFlagsImageBuffer;
+		std::shared_ptr<ImageBuffer> colorUvScratchBuffer;
+		std::shared_ptr<ImageBuffer> colorUvZBuffer;
+		ColorUvStats colorUvStats = {};
+
+		// Frames mirrored into a named shared memory ring for other processes. The settings outlive a
+		// stop, the writer belongs to the control thread and is created by the first frame it publishes.
+		bool sharedFramesEnabled = false;
+		std::string sharedFrameName;
+		int sharedFrameSlotCount = 4;
+		bool sharedFrameIR = false;
+		std::unique_ptr<SharedFrameWriter> sharedFrameWriter;
+		uint32_t sharedFrameCalibrationVersion = 0;
+		SharedFrameStats sharedFrameStats = {};
+
+		// Registered color and depth served over tcp. The server runs its own threads and copies what it
+		// is handed, it is kept across a stop so viewers stay connected while the device restarts.
+		std::unique_ptr<FrameStreamServer> frameServer;
+		uint32_t frameServerCalibrationVersion = 0;
 	};
 
+	static const unsigned int MaxDeviceCount = 16;
+
+	// Shared frame rings are sized once for the largest depth camera image, wide field of view
+	// unbinned and passive ir, so changing the depth mode never has to replace a ring readers hold
+	static const int SharedFrameMaxWidth = 1024;
+	static const int SharedFrameMaxHeight = 1024;
+
+	DeviceSlot *TryGetSlot(unsigned int index)
+	{
+		return index < MaxDeviceCount ? &deviceSlots[index] : nullptr;
+	}
+
+	// Feature objects are swapped by the control thread, readers take their own reference
+	template <typename T>
+	std::shared_ptr<T> LoadSlotPointer(DeviceSlot &slot, std::shared_ptr<T> DeviceSlot::*member)
+	{
+		EnterCriticalSection(&slot.slotCritSec);
+		auto result = slot.*member;
+		LeaveCriticalSection(&slot.slotCritSec);
+		return result;
+	}
+
+	// Sized for the depth camera, the textures are created by the first update
+	static DeviceResources CreateDeviceResources(const k4a_calibration_t &calibration);
+	// Callers hold the slot's lock, unregisters and releases the textures and leaves resources empty
+	void ReleaseResources(DeviceResources &resources);
+	// Callers hold the slot's lock
+	void AddResourceMemory(
+		const DeviceResources &resources,
+		DeviceMemoryStats &stats);
+	// Callers hold the slot's lock
     void UpdateResources(
 		k4a_image_t image,
         ID3D11ShaderResourceView *&srv,
         ID3D11Texture2D *&tex,
         FrameDimensions &dim,
-        DXGI_FORMAT format);
+        DXGI_FORMAT format,
+		int &uploadTarget,
+		const PixelRect *rect);
+	void UpdateResources(
+		const byte *buffer,
+		int width,
+		int height,
+		int stride,
+		ID3D11ShaderResourceView *&srv,
+		ID3D11Texture2D *&tex,
+		FrameDimensions &dim,
+		DXGI_FORMAT format,
+		int &uploadTarget,
+		const PixelRect *rect);
+	// Callers hold the slot's lock, colorImage is null when the frame had no color
+	void UpdatePyramid(
+		DeviceSlot &slot,
+		k4a_image_t depthImage,
+		k4a_image_t colorImage);
+	// Control thread only, keeps the slot's references at the frame's size and runs detect_changed_tiles.
+	// Returns false for a keyframe, which counts every tile as changed and covers the whole frame.
+	bool DetectChanges(
+		DeviceSlot &slot,
+		k4a_image_t depthImage,
+		k4a_image_t irImage,
+		const ChangeDetectionSettings &settings,
+		bool forceKeyframe,
+		PixelRect &changedRect,
+		int &changedTileCount);
+	// Control thread only, outside of the slot's lock. Fills the working mask in mask mode and zeroes the
+	// rejected depth otherwise, stats gets the frame's own fields.
+	void FilterOutliers(
+		DeviceSlot &slot,
+		k4a_image_t depthImage,
+		const OutlierFilterSettings &settings,
+		OutlierFilterStats &stats);
+	// Callers hold the slot's lock, colorImage is null when the frame had no color
+	void UpdateColorUv(
+		DeviceSlot &slot,
+		k4a_image_t depthImage,
+		k4a_image_t colorImage);
+	// Callers hold the slot's lock
+	void ReleaseColorUv(DeviceSlot &slot);
+	// Callers hold the slot's lock, false without a cached frame. The caller releases the xy table.
+	bool TryTakeFrameSnapshot(DeviceSlot &slot, FrameSnapshot &snapshot);
+	// Control thread only, outside of the slot's lock. Copies the frame from the cached buffers, which
+	// nothing but the control thread writes.
+	void PublishSharedFrame(
+		unsigned int index,
+		DeviceSlot &slot,
+		k4a_image_t depthImage,
+		bool hasColor,
+		k4a_image_t irImage,
+		const FrameTimestamps &frameTimestamps,
+		uint32_t flags);
+	// Control thread only, outside of the slot's lock. Hands the cached buffers to the frame server.
+	void SubmitFrameServerFrame(
+		unsigned int index,
+		DeviceSlot &slot,
+		bool hasColor,
+		const FrameTimestamps &frameTimestamps);
+	// Only called by the control thread, the lut is built outside of the slot's lock
+	void UpdateUndistortLut(
+		DeviceSlot &slot,
+		interpolation_t interpolation);
+	// Callers hold the slot's lock, either image can be null
+	void UpdateUndistorted(
+		DeviceSlot &slot,
+		k4a_image_t depthImage,
+		k4a_image_t irImage,
+		interpolation_t interpolation);
+	// Safe on any thread, touches nothing but opened, the shared pools and the device table
+	bool TryOpenDevice(
+		unsigned int index,
+		const k4a_device_configuration_t &configuration,
+		OpenedDevice &opened);
+	void ReleaseOpenedDevice(OpenedDevice &opened);
+	// Control thread only, moves opened into the device's slot and starts delivering its captures
+	bool TryPublishDevice(
+		unsigned int index,
+		OpenedDevice &opened);
+	// Publishes the asynchronous starts that finished opening, or waits for all of them
+	void CompleteDeviceStarts(bool wait);
+	void FinishDeviceStart(
+		unsigned int index,
+		bool publish);
+	// Control thread only, replaces what depends on the calibration and keeps what did not change size.
+	// resourcesRecreated is set when any texture was released, their views have to be fetched again.
+	void RebuildCalibration(
+		DeviceSlot &slot,
+		const k4a_calibration_t &calibration,
+		bool depthModeChanged,
+		bool *resourcesRecreated);
+	// Reads the device table unless it is still current, starts in flight are finished first
+	void EnsureDeviceTable(bool force);
+	// Copies the whole image, or only rect when given, and returns the bytes copied
+	uint64_t CopyImageBuffer(k4a_image_t image, ImageBuffer &imageBuffer, const PixelRect *rect);
 	void StopStreamingAll();
+	void ReleaseIRImages(unsigned int index);
 
     ID3D11Device *d3d11Device;
     static std::shared_ptr<AzureKinectWrapper> instance;
-    std::map<int, k4a_device_t> deviceMap;
-
-	std::map<int, DeviceResources> resourcesMap;
-    CRITICAL_SECTION resourcesCritSec;
-	k4a_device_configuration_t config = K4A_DEVICE_CONFIG_INIT_DISABLE_ALL;
-	
-	std::map<int, std::shared_ptr<ImageBuffer>> cachedTransformedColorImageBufferMap;
-	std::map<int, std::shared_ptr<ImageBuffer>> cachedDepthImageBufferMap;
-	std::map<int, std::shared_ptr<ImageBuffer>> cachedPointCloudTemplateImageBufferMap;
-	std::map<int, k4a_calibration_t> calibrationMap;
-	std::map<int, k4a_transformation_t> transformationMap;
-	std::map<int, k4a_image_t> transformedColorMap;
-	std::map<int, k4a_image_t> xyTableMap;
-	std::map<int, k4a_image_t> pointCloudTemplateMap;
+
+	std::array<DeviceSlot, MaxDeviceCount> deviceSlots;
+	unsigned int activeDeviceCount = 0;
+	uint32_t nextCalibrationVersion = 1;
+
+	DeviceTable deviceTable;
+	StartupStats startupStats = {};
+	CRITICAL_SECTION startCritSec;
+	CONDITION_VARIABLE startCompletedCondition;
+	PointCloudFusion pointCloudFusion;
+	PointCloudExporter pointCloudExporter;
+
+	// Uploads go through the queue either way. Unless the render thread drains it, TryUpdate does.
+	std::unique_ptr<TextureUploadQueue> uploadQueue;
+	std::atomic<bool> renderThreadUploads{ false };
+
+	// Leases are handed out across devices and released by id
+	std::map<uint64_t, std::pair<int, k4a_image_t>> irLeaseMap;
+	uint64_t nextIRLeaseId = 1;
+	CRITICAL_SECTION irCritSec;
+
+	// Clients are looked up by id, callers take their own reference before using one
+	std::map<uint64_t, std::shared_ptr<FrameStreamClient>> frameClientMap;
+	uint64_t nextFrameClientId = 1;
+	CRITICAL_SECTION frameClientCritSec;
 };
@@ -0,0 +1,203 @@
+#include "pch.h"
+#include "CaptureQueue.h"
+
+CaptureQueue::CaptureQueue(k4a_device_t device, DeliveryPolicy policy, int capacity) :
+	running(false)
+{
+	this->device = device;
+	this->policy = policy;
+
+	// Latest only is a single slot that gets overwritten
+	if (policy == DeliveryPolicyLatestOnly || capacity < 1)
+	{
+		capacity = 1;
+	}
+
+	slots.resize(capacity, Slot{ nullptr, 0 });
+	head = 0;
+	depth = 0;
+
+	stats = {};
+	stats.policy = policy;
+	stats.capacity = capacity;
+	totalAgeMilliseconds = 0.0;
+	framePeriodUsec = 0;
+	lastDepthTimestampUsec = 0;
+}
+
+CaptureQueue::~CaptureQueue()
+{
+	Stop();
+}
+
+bool CaptureQueue::TryStart(k4a_fps_t fps)
+{
+	if (readerThread.joinable())
+	{
+		if (running.load())
+		{
+			return true;
+		}
+
+		// The reader stopped itself after a failure, clean it up before restarting
+		Stop();
+	}
+
+	switch (fps)
+	{
+	case K4A_FRAMES_PER_SECOND_5:
+		framePeriodUsec = 1000000 / 5;
+		break;
+	case K4A_FRAMES_PER_SECOND_15:
+		framePeriodUsec = 1000000 / 15;
+		break;
+	default:
+		framePeriodUsec = 1000000 / 30;
+		break;
+	}
+
+	// The device timestamps restart with the cameras
+	lastDepthTimestampUsec = 0;
+	running.store(true);
+	readerThread = std::thread(&CaptureQueue::ReaderLoop, this);
+	return true;
+}
+
+void CaptureQueue::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		running.store(false);
+	}
+
+	notFull.notify_all();
+	if (readerThread.joinable())
+	{
+		readerThread.join();
+	}
+
+	std::lock_guard<std::mutex> lock(queueMutex);
+	ReleaseQueued();
+}
+
+k4a_wait_result_t CaptureQueue::TryPop(k4a_capture_t &capture)
+{
+	std::unique_lock<std::mutex> lock(queueMutex);
+	if (depth == 0)
+	{
+		return running.load() ? K4A_WAIT_RESULT_TIMEOUT : K4A_WAIT_RESULT_FAILED;
+	}
+
+	Slot &slot = slots[head];
+	capture = slot.capture;
+	slot.capture = nullptr;
+	head = (head + 1) % static_cast<int>(slots.size());
+	depth--;
+
+	float age = TimingHelper::GetElapsedMilliseconds(slot.enqueuedMicroseconds);
+	stats.deliveredCount++;
+	stats.lastAgeMilliseconds = age;
+	stats.maxAgeMilliseconds = max(stats.maxAgeMilliseconds, age);
+	totalAgeMilliseconds += age;
+	lock.unlock();
+
+	notFull.notify_one();
+	return K4A_WAIT_RESULT_SUCCEEDED;
+}
+
+CaptureQueue::Stats CaptureQueue::GetStats()
+{
+	std::lock_guard<std::mutex> lock(queueMutex);
+	Stats result = stats;
+	result.depth = depth;
+	result.averageAgeMilliseconds = stats.deliveredCount > 0 ?
+		static_cast<float>(totalAgeMilliseconds / stats.deliveredCount) : 0.0f;
+	return result;
+}
+
+void CaptureQueue::ReaderLoop()
+{
+	const int capacity = static_cast<int>(slots.size());
+	k4a_capture_t capture = nullptr;
+	while (running.load())
+	{
+		switch (k4a_device_get_capture(device, &capture, 100))
+		{
+		case K4A_WAIT_RESULT_SUCCEEDED:
+		{
+			CountMissedFrames(capture);
+			std::unique_lock<std::mutex> lock(queueMutex);
+			if (policy == DeliveryPolicyEveryFrame)
+			{
+				// Backpressure, the sdk's queue is short and drops its oldest captures while we wait here,
+				// those are counted from the timestamp gap once reading resumes
+				notFull.wait(lock, [&] { return depth < capacity || !running.load(); });
+				if (!running.load())
+				{
+					k4a_capture_release(capture);
+					break;
+				}
+			}
+			else if (depth == capacity)
+			{
+				k4a_capture_release(slots[head].capture);
+				slots[head].capture = nullptr;
+				head = (head + 1) % capacity;
+				depth--;
+				stats.droppedCount++;
+			}
+
+			Slot &slot = slots[(head + depth) % capacity];
+			slot.capture = capture;
+			slot.enqueuedMicroseconds = TimingHelper::GetTimestampMicroseconds();
+			depth++;
+			stats.maxDepth = max(stats.maxDepth, depth);
+		}
+		break;
+		case K4A_WAIT_RESULT_TIMEOUT:
+			break;
+		case K4A_WAIT_RESULT_FAILED:
+			OutputDebugString(L"Failed to read capture");
+			running.store(false);
+			break;
+		}
+	}
+}
+
+void CaptureQueue::ReleaseQueued()
+{
+	const int capacity = static_cast<int>(slots.size());
+	for (; depth > 0; depth--)
+	{
+		k4a_capture_release(slots[head].capture);
+		slots[head].capture = nullptr;
+		head = (head + 1) % capacity;
+	}
+}
+
+void CaptureQueue::CountMissedFrames(k4a_capture_t capture)
+{
+	k4a_image_t depthImage = k4a_capture_get_depth_image(capture);
+	if (depthImage == nullptr)
+	{
+		return;
+	}
+
+	uint64_t timestamp = k4a_image_get_device_timestamp_usec(depthImage);
+	k4a_image_release(depthImage);
+
+	// Anything past one and a half periods is rounded to the frames that never reached us
+	uint64_t missed = 0;
+	if (lastDepthTimestampUsec != 0 &&
+		timestamp > lastDepthTimestampUsec + framePeriodUsec + framePeriodUsec / 2)
+	{
+		missed = (timestamp - lastDepthTimestampUsec + framePeriodUsec / 2) / framePeriodUsec - 1;
+	}
+	lastDepthTimestampUsec = timestamp;
+
+	if (missed > 0)
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		stats.droppedCount += missed;
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+enum DeliveryPolicy
+{
+	// Only the newest capture is kept, older ones are released as soon as a newer one arrives
+	DeliveryPolicyLatestOnly = 0,
+	// Up to capacity captures are buffered, the oldest is dropped when a new one does not fit
+	DeliveryPolicyBoundedQueue = 1,
+	// Nothing is dropped here, the reader stops pulling from the sdk until the consumer catches up. The sdk's
+	// own queue is short and drops its oldest captures meanwhile, those show up as gaps in the depth timestamps
+	DeliveryPolicyEveryFrame = 2
+};
+
+// Pulls captures from a device on a dedicated thread into a fixed ring of slots allocated up front,
+// and hands them to the consumer according to the device's delivery policy.
+class CaptureQueue
+{
+public:
+	struct Stats
+	{
+		int policy;
+		int capacity;
+		int depth;
+		int maxDepth;
+		uint64_t deliveredCount;
+		// Captures released here plus frames missing between consecutive depth timestamps
+		uint64_t droppedCount;
+		float lastAgeMilliseconds;
+		float maxAgeMilliseconds;
+		float averageAgeMilliseconds;
+	};
+
+	CaptureQueue(k4a_device_t device, DeliveryPolicy policy, int capacity);
+	~CaptureQueue();
+
+	// Fps is what the cameras were started with, it sets the frame period gaps are measured against
+	bool TryStart(k4a_fps_t fps);
+	void Stop();
+
+	// Never blocks. Timeout means nothing is queued, failed means the reader gave up on the device.
+	k4a_wait_result_t TryPop(k4a_capture_t &capture);
+	Stats GetStats();
+
+private:
+	struct Slot
+	{
+		k4a_capture_t capture;
+		int64_t enqueuedMicroseconds;
+	};
+
+	void ReaderLoop();
+	void ReleaseQueued();
+	void CountMissedFrames(k4a_capture_t capture);
+
+	k4a_device_t device;
+	DeliveryPolicy policy;
+	std::vector<Slot> slots;
+	int head;
+	int depth;
+
+	std::thread readerThread;
+	std::atomic<bool> running;
+	std::mutex queueMutex;
+	std::condition_variable notFull;
+
+	Stats stats;
+	double totalAgeMilliseconds;
+
+	// Only the reader thread touches these while it runs
+	uint64_t framePeriodUsec;
+	uint64_t lastDepthTimestampUsec;
+};
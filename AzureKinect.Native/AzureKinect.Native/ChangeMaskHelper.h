@@ -0,0 +1,211 @@
+#pragma once
+
+#include "SimdHelper.h"
+#include "ThreadPool.h"
+
+// Square tiles the change mask is kept in, tiles on the right and bottom edge may be partial
+#define CHANGE_TILE_SIZE 32
+
+static inline int change_tile_count(int pixels)
+{
+	return (pixels + CHANGE_TILE_SIZE - 1) / CHANGE_TILE_SIZE;
+}
+
+// Sum of the absolute differences of a run of pixels, each lowered by the noise threshold first so
+// sensor noise adds nothing. A pixel turning valid or invalid differs by its whole depth.
+static inline uint32_t thresholded_sad(const uint16_t *current, const uint16_t *reference, int count, uint16_t noise_threshold)
+{
+	uint32_t sum = 0;
+	int x = 0;
+
+#ifdef AZUREKINECT_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i noise = _mm_set1_epi16((short)noise_threshold);
+	__m128i sum4 = _mm_setzero_si128();
+	for (; x + 8 <= count; x += 8)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*)(current + x));
+		__m128i b = _mm_loadu_si128((const __m128i*)(reference + x));
+
+		// Saturating subtraction both ways leaves the absolute difference in one of the two
+		__m128i difference = _mm_or_si128(_mm_subs_epu16(a, b), _mm_subs_epu16(b, a));
+		difference = _mm_subs_epu16(difference, noise);
+		sum4 = _mm_add_epi32(sum4, _mm_add_epi32(_mm_unpacklo_epi16(difference, zero), _mm_unpackhi_epi16(difference, zero)));
+	}
+
+	alignas(16) uint32_t lanes[4];
+	_mm_store_si128((__m128i*)lanes, sum4);
+	sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+
+	for (; x < count; x++)
+	{
+		int difference = abs((int)current[x] - (int)reference[x]) - noise_threshold;
+		sum += difference > 0 ? (uint32_t)difference : 0;
+	}
+
+	return sum;
+}
+
+// Sets the mask entry of every tile whose thresholded sad against the reference exceeds
+// tile_threshold and leaves the others alone, so several images can be marked into one mask
+static void mark_changed_tiles(const uint16_t *current,
+	const uint16_t *reference,
+	int width,
+	int height,
+	uint16_t noise_threshold,
+	uint32_t tile_threshold,
+	uint8_t *mask)
+{
+	const int columns = change_tile_count(width);
+	const int rows = change_tile_count(height);
+	ThreadPool::GetShared().ParallelFor(rows, [&](int row)
+	{
+		const int y_begin = row * CHANGE_TILE_SIZE;
+		const int y_end = min(y_begin + CHANGE_TILE_SIZE, height);
+		for (int column = 0; column < columns; column++)
+		{
+			uint8_t &entry = mask[row * columns + column];
+			if (entry != 0)
+			{
+				continue;
+			}
+
+			const int x_begin = column * CHANGE_TILE_SIZE;
+			const int count = min(CHANGE_TILE_SIZE, width - x_begin);
+			uint32_t sum = 0;
+			for (int y = y_begin; y < y_end && sum <= tile_threshold; y++)
+			{
+				size_t offset = (size_t)y * width + x_begin;
+				sum += thresholded_sad(current + offset, reference + offset, count, noise_threshold);
+			}
+
+			entry = sum > tile_threshold ? 1 : 0;
+		}
+	});
+}
+
+// Copies the changed tiles into the reference. Unchanged tiles keep the frame they last changed in,
+// so slow drift adds up until it crosses the threshold instead of hiding below it frame by frame.
+static void update_reference_tiles(const uint16_t *current, uint16_t *reference, int width, int height, const uint8_t *mask)
+{
+	const int columns = change_tile_count(width);
+	for (int y = 0; y < height; y++)
+	{
+		const uint8_t *mask_row = mask + (y / CHANGE_TILE_SIZE) * columns;
+		size_t row_offset = (size_t)y * width;
+		for (int column = 0; column < columns; column++)
+		{
+			if (mask_row[column] != 0)
+			{
+				const int x_begin = column * CHANGE_TILE_SIZE;
+				memcpy(reference + row_offset + x_begin, current + row_offset + x_begin, min(CHANGE_TILE_SIZE, width - x_begin) * sizeof(uint16_t));
+			}
+		}
+	}
+}
+
+// Smallest rect in pixels that covers every changed tile, empty when none changed
+static PixelRect changed_tile_rect(const uint8_t *mask, int width, int height, int *changed_count)
+{
+	const int columns = change_tile_count(width);
+	const int rows = change_tile_count(height);
+	int left = columns, top = rows, right = -1, bottom = -1;
+	int count = 0;
+	for (int row = 0; row < rows; row++)
+	{
+		for (int column = 0; column < columns; column++)
+		{
+			if (mask[row * columns + column] != 0)
+			{
+				left = min(left, column);
+				right = max(right, column);
+				top = min(top, row);
+				bottom = max(bottom, row);
+				count++;
+			}
+		}
+	}
+
+	*changed_count = count;
+	if (count == 0)
+	{
+		return PixelRect{ 0, 0, 0, 0 };
+	}
+
+	return clamp_rect(PixelRect{
+		left * CHANGE_TILE_SIZE,
+		top * CHANGE_TILE_SIZE,
+		(right - left + 1) * CHANGE_TILE_SIZE,
+		(bottom - top + 1) * CHANGE_TILE_SIZE },
+		width,
+		height);
+}
+
+// One frame of change detection against references the caller keeps at the image size, ir_reference only
+// when IR is compared. A keyframe, when forced or every keyframe_interval frames, copies the images into the
+// references whole, marks every tile and returns false. Otherwise only tiles that changed in either image
+// are marked and taken into both references, so they stay from the same frames, and changed_rect covers
+// them. The mask has one entry per tile.
+static bool detect_changed_tiles(const uint16_t *depth,
+	const uint16_t *ir,
+	int width,
+	int height,
+	uint16_t depth_noise_threshold,
+	uint16_t ir_noise_threshold,
+	uint32_t tile_threshold,
+	int keyframe_interval,
+	bool force_keyframe,
+	uint16_t *depth_reference,
+	uint16_t *ir_reference,
+	int *frames_since_keyframe,
+	uint8_t *mask,
+	PixelRect *changed_rect,
+	int *changed_tile_count)
+{
+	const size_t image_size = (size_t)width * height * sizeof(uint16_t);
+	const int tile_count = change_tile_count(width) * change_tile_count(height);
+	if (force_keyframe ||
+		(keyframe_interval > 0 && *frames_since_keyframe >= keyframe_interval))
+	{
+		memcpy(depth_reference, depth, image_size);
+		if (ir != nullptr)
+		{
+			memcpy(ir_reference, ir, image_size);
+		}
+
+		memset(mask, 1, tile_count);
+		*frames_since_keyframe = 0;
+		*changed_rect = PixelRect{ 0, 0, width, height };
+		*changed_tile_count = tile_count;
+		return false;
+	}
+
+	memset(mask, 0, tile_count);
+	mark_changed_tiles(depth, depth_reference, width, height, depth_noise_threshold, tile_threshold, mask);
+	if (ir != nullptr)
+	{
+		mark_changed_tiles(ir, ir_reference, width, height, ir_noise_threshold, tile_threshold, mask);
+		update_reference_tiles(ir, ir_reference, width, height, mask);
+	}
+	update_reference_tiles(depth, depth_reference, width, height, mask);
+
+	(*frames_since_keyframe)++;
+	*changed_rect = changed_tile_rect(mask, width, height, changed_tile_count);
+	return true;
+}
+
+// The overlap of two rects, empty when they do not touch
+static PixelRect intersect_rect(const PixelRect &a, const PixelRect &b)
+{
+	int left = max(a.x, b.x);
+	int top = max(a.y, b.y);
+	int right = min(a.x + a.width, b.x + b.width);
+	int bottom = min(a.y + a.height, b.y + b.height);
+	if (right <= left || bottom <= top)
+	{
+		return PixelRect{ 0, 0, 0, 0 };
+	}
+
+	return PixelRect{ left, top, right - left, bottom - top };
+}
@@ -0,0 +1,188 @@
+#include "pch.h"
+#include "ClockMapper.h"
+
+ClockMapper::ClockMapper()
+{
+	resetCount = 0;
+	Reset();
+}
+
+void ClockMapper::Reset()
+{
+	head = 0;
+	count = 0;
+	hasFit = false;
+	reference = {};
+	slope = 1000.0;
+	intercept = 0.0;
+	inlierCount = 0;
+	residualMicroseconds = 0.0f;
+}
+
+void ClockMapper::AddSample(uint64_t deviceTimestampUsec, uint64_t hostTimestampNsec)
+{
+	if (deviceTimestampUsec == 0 ||
+		hostTimestampNsec == 0)
+	{
+		return;
+	}
+
+	// The device clock only goes backwards when the device restarted, the old samples no longer apply
+	if (count > 0)
+	{
+		const Sample &newest = samples[(head + Capacity - 1) % Capacity];
+		if (deviceTimestampUsec <= newest.deviceTimestampUsec)
+		{
+			if (deviceTimestampUsec == newest.deviceTimestampUsec)
+			{
+				return;
+			}
+
+			resetCount++;
+			Reset();
+		}
+	}
+
+	samples[head] = Sample{ deviceTimestampUsec, hostTimestampNsec };
+	head = (head + 1) % Capacity;
+	count = min(count + 1, Capacity);
+
+	if (count >= MinFitSamples)
+	{
+		Fit();
+	}
+}
+
+void ClockMapper::Fit()
+{
+	// Relative to the newest sample, so doubles keep sub nanosecond precision over the window
+	reference = samples[(head + Capacity - 1) % Capacity];
+
+	double x[Capacity];
+	double y[Capacity];
+	double residuals[Capacity];
+	bool inliers[Capacity];
+	for (int i = 0; i < count; i++)
+	{
+		const Sample &sample = samples[i];
+		x[i] = (double)(int64_t)(sample.deviceTimestampUsec - reference.deviceTimestampUsec);
+		y[i] = (double)(int64_t)(sample.hostTimestampNsec - reference.hostTimestampNsec);
+		inliers[i] = true;
+	}
+
+	double fitSlope = slope;
+	double fitIntercept = intercept;
+	int used = 0;
+	for (int pass = 0; pass < 2; pass++)
+	{
+		double sumX = 0.0, sumY = 0.0;
+		used = 0;
+		for (int i = 0; i < count; i++)
+		{
+			if (inliers[i])
+			{
+				sumX += x[i];
+				sumY += y[i];
+				used++;
+			}
+		}
+
+		if (used < 2)
+		{
+			return;
+		}
+
+		double meanX = sumX / used;
+		double meanY = sumY / used;
+		double sxx = 0.0, sxy = 0.0;
+		for (int i = 0; i < count; i++)
+		{
+			if (inliers[i])
+			{
+				sxx += (x[i] - meanX) * (x[i] - meanX);
+				sxy += (x[i] - meanX) * (y[i] - meanY);
+			}
+		}
+
+		if (sxx <= 0.0)
+		{
+			return;
+		}
+
+		fitSlope = sxy / sxx;
+		fitIntercept = meanY - fitSlope * meanX;
+
+		if (pass == 1)
+		{
+			break;
+		}
+
+		// Median absolute deviation scaled to a standard deviation, with a floor so a perfectly
+		// clean window does not throw out samples over rounding
+		for (int i = 0; i < count; i++)
+		{
+			residuals[i] = fabs(y[i] - (fitIntercept + fitSlope * x[i]));
+		}
+
+		double sorted[Capacity];
+		memcpy(sorted, residuals, count * sizeof(double));
+		std::nth_element(sorted, sorted + count / 2, sorted + count);
+		double threshold = max(3.0 * 1.4826 * sorted[count / 2], 50000.0);
+		for (int i = 0; i < count; i++)
+		{
+			inliers[i] = residuals[i] <= threshold;
+		}
+	}
+
+	double squaredResidualSum = 0.0;
+	double minResidual = DBL_MAX;
+	for (int i = 0; i < count; i++)
+	{
+		if (inliers[i])
+		{
+			double residual = y[i] - (fitIntercept + fitSlope * x[i]);
+			squaredResidualSum += residual * residual;
+			minResidual = min(minResidual, residual);
+		}
+	}
+
+	// Jitter only delays arrival, the line is moved down onto the fastest inlier so mapped times are
+	// the earliest the host could have seen the exposure rather than a typical arrival
+	hasFit = true;
+	slope = fitSlope;
+	intercept = fitIntercept + minResidual;
+	inlierCount = used;
+	residualMicroseconds = (float)(sqrt(squaredResidualSum / used) / 1000.0);
+}
+
+bool ClockMapper::TryMapToHost(uint64_t deviceTimestampUsec, uint64_t *hostTimestampNsec) const
+{
+	if (!hasFit ||
+		hostTimestampNsec == nullptr)
+	{
+		return false;
+	}
+
+	double dx = (double)(int64_t)(deviceTimestampUsec - reference.deviceTimestampUsec);
+	*hostTimestampNsec = reference.hostTimestampNsec + (int64_t)llround(intercept + slope * dx);
+	return true;
+}
+
+ClockMapper::Stats ClockMapper::GetStats() const
+{
+	Stats stats = {};
+	stats.hasFit = hasFit;
+	stats.sampleCount = count;
+	stats.inlierCount = inlierCount;
+	stats.resetCount = resetCount;
+	if (hasFit)
+	{
+		uint64_t hostTimestampNsec = 0;
+		TryMapToHost(reference.deviceTimestampUsec, &hostTimestampNsec);
+		stats.offsetMicroseconds = (int64_t)(hostTimestampNsec / 1000) - (int64_t)reference.deviceTimestampUsec;
+		stats.driftPpm = (1000.0 / slope - 1.0) * 1e6;
+		stats.residualMicroseconds = residualMicroseconds;
+	}
+
+	return stats;
+}
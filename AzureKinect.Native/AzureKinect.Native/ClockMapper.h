@@ -0,0 +1,57 @@
+#pragma once
+
+// Maps a device's microsecond clock onto the host's monotonic nanosecond clock. Every frame adds the
+// pair of timestamps the sdk stamped on one image. The host side includes usb and driver jitter,
+// which only ever delays it, so the fit is least squares over the recent samples followed by one
+// refit without the samples further than three robust deviations from the first line, shifted down
+// onto the lower envelope of what is left.
+class ClockMapper
+{
+public:
+	struct Stats
+	{
+		bool hasFit;
+		int sampleCount;
+		int inlierCount;
+		// Host minus device time at the newest sample
+		int64_t offsetMicroseconds;
+		// How much faster the device clock runs than the host clock
+		double driftPpm;
+		float residualMicroseconds;
+		uint64_t resetCount;
+	};
+
+	ClockMapper();
+
+	void AddSample(uint64_t deviceTimestampUsec, uint64_t hostTimestampNsec);
+	bool TryMapToHost(uint64_t deviceTimestampUsec, uint64_t *hostTimestampNsec) const;
+	void Reset();
+
+	Stats GetStats() const;
+
+private:
+	// A few seconds at the usual frame rates, long enough to average out jitter and short enough to follow drift
+	static const int Capacity = 128;
+	static const int MinFitSamples = 8;
+
+	struct Sample
+	{
+		uint64_t deviceTimestampUsec;
+		uint64_t hostTimestampNsec;
+	};
+
+	void Fit();
+
+	Sample samples[Capacity];
+	int head;
+	int count;
+
+	// host = reference.host + intercept + slope * (device - reference.device), in nanoseconds
+	bool hasFit;
+	Sample reference;
+	double slope;
+	double intercept;
+	int inlierCount;
+	float residualMicroseconds;
+	uint64_t resetCount;
+};
@@ -0,0 +1,352 @@
+#pragma once
+
+#include "k4a/k4a.h"
+#include <float.h>
+#include "SimdHelper.h"
+#include "ThreadPool.h"
+
+// Layout of the per depth pixel coordinates into the color frame
+enum ColorUvFormat
+{
+	// Two unorm 16 bit channels, a step of 1/65535 is well below a texel of the largest color mode
+	ColorUvFormatRG16 = 0,
+	// Two 32 bit floats
+	ColorUvFormatRG32F = 1
+};
+
+// Stored one byte per depth pixel, chosen so an unorm sample reads 0, about 0.5 and 1
+enum ColorUvFlag
+{
+	ColorUvFlagValid = 0,
+	// Lands on the color image behind a nearer surface, the color there belongs to something else
+	ColorUvFlagOccluded = 128,
+	// No depth, no ray or outside of the color image
+	ColorUvFlagInvalid = 255
+};
+
+// Depth camera millimeters into color pixels, the same model the sdk projects with
+typedef struct _color_projection_t
+{
+	float rotation[9];
+	float translation[3];
+
+	float cx;
+	float cy;
+	float fx;
+	float fy;
+	float k[6];
+	float codx;
+	float cody;
+	float p1;
+	float p2;
+	float max_radius_squared;
+	// Brown conrady doubles the cross term of the tangential distortion, rational 6kt does not
+	float tangential_scale;
+
+	int width;
+	int height;
+} color_projection_t;
+
+typedef struct _color_uv_counts_t
+{
+	int valid;
+	int occluded;
+} color_uv_counts_t;
+
+static color_projection_t create_color_projection(const k4a_calibration_t *calibration)
+{
+	const k4a_calibration_extrinsics_t &extrinsics = calibration->extrinsics[K4A_CALIBRATION_TYPE_DEPTH][K4A_CALIBRATION_TYPE_COLOR];
+	const k4a_calibration_camera_t &camera = calibration->color_camera_calibration;
+	const k4a_calibration_intrinsic_parameters_t &params = camera.intrinsics.parameters;
+
+	color_projection_t projection;
+	memcpy(projection.rotation, extrinsics.rotation, sizeof(projection.rotation));
+	memcpy(projection.translation, extrinsics.translation, sizeof(projection.translation));
+	projection.cx = params.param.cx;
+	projection.cy = params.param.cy;
+	projection.fx = params.param.fx;
+	projection.fy = params.param.fy;
+	projection.k[0] = params.param.k1;
+	projection.k[1] = params.param.k2;
+	projection.k[2] = params.param.k3;
+	projection.k[3] = params.param.k4;
+	projection.k[4] = params.param.k5;
+	projection.k[5] = params.param.k6;
+	projection.codx = params.param.codx;
+	projection.cody = params.param.cody;
+	projection.p1 = params.param.p1;
+	projection.p2 = params.param.p2;
+	projection.max_radius_squared = camera.metric_radius > 0.f ? camera.metric_radius * camera.metric_radius : FLT_MAX;
+	projection.tangential_scale = camera.intrinsics.type == K4A_CALIBRATION_LENS_DISTORTION_MODEL_BROWN_CONRADY ? 2.f : 1.f;
+	projection.width = camera.resolution_width;
+	projection.height = camera.resolution_height;
+	return projection;
+}
+
+// Returns the color camera z, or zero when the pixel has no valid projection
+static inline float project_color_pixel(const color_projection_t *p, uint16_t depth, const k4a_float2_t &xy, float &u, float &v)
+{
+	u = v = 0.f;
+	if (depth == 0)
+	{
+		return 0.f;
+	}
+
+	const float dx = xy.xy.x * (float)depth;
+	const float dy = xy.xy.y * (float)depth;
+	const float dz = (float)depth;
+	const float x = p->rotation[0] * dx + p->rotation[1] * dy + p->rotation[2] * dz + p->translation[0];
+	const float y = p->rotation[3] * dx + p->rotation[4] * dy + p->rotation[5] * dz + p->translation[1];
+	const float z = p->rotation[6] * dx + p->rotation[7] * dy + p->rotation[8] * dz + p->translation[2];
+
+	// A nan ray fails here as well
+	if (!(z > 0.f))
+	{
+		return 0.f;
+	}
+
+	const float xp = x / z - p->codx;
+	const float yp = y / z - p->cody;
+	const float xp2 = xp * xp;
+	const float yp2 = yp * yp;
+	const float xyp = xp * yp;
+	const float rs = xp2 + yp2;
+	if (!(rs <= p->max_radius_squared))
+	{
+		return 0.f;
+	}
+
+	const float rss = rs * rs;
+	const float rsc = rss * rs;
+	const float a = 1.f + p->k[0] * rs + p->k[1] * rss + p->k[2] * rsc;
+	const float b = 1.f + p->k[3] * rs + p->k[4] * rss + p->k[5] * rsc;
+	const float d = b != 0.f ? a / b : 1.f;
+
+	const float xp_d = xp * d + (rs + 2.f * xp2) * p->p2 + p->tangential_scale * xyp * p->p1;
+	const float yp_d = yp * d + (rs + 2.f * yp2) * p->p1 + p->tangential_scale * xyp * p->p2;
+	const float pu = (xp_d + p->codx) * p->fx + p->cx;
+	const float pv = (yp_d + p->cody) * p->fy + p->cy;
+	if (!(pu >= -0.5f && pu < (float)p->width - 0.5f && pv >= -0.5f && pv < (float)p->height - 0.5f))
+	{
+		return 0.f;
+	}
+
+	u = pu;
+	v = pv;
+	return z;
+}
+
+// Projects a run of pixels into planar u, v and z, z is zero where the projection is invalid
+static void project_color_run(const color_projection_t *p, const uint16_t *depth, const k4a_float2_t *xy, float *u, float *v, float *z, int count)
+{
+	int i = 0;
+
+#ifdef AZUREKINECT_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 zerof = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 two = _mm_set1_ps(2.f);
+	const __m128 codx = _mm_set1_ps(p->codx);
+	const __m128 cody = _mm_set1_ps(p->cody);
+	const __m128 max_radius = _mm_set1_ps(p->max_radius_squared);
+	const __m128 low = _mm_set1_ps(-0.5f);
+	const __m128 width = _mm_set1_ps((float)p->width - 0.5f);
+	const __m128 height = _mm_set1_ps((float)p->height - 0.5f);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 dz = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(depth + i)), zero));
+
+		// Two interleaved xy pairs per load, split into the x and y lanes
+		__m128 xy0 = _mm_loadu_ps(&xy[i].xy.x);
+		__m128 xy1 = _mm_loadu_ps(&xy[i + 2].xy.x);
+		__m128 dx = _mm_mul_ps(_mm_shuffle_ps(xy0, xy1, _MM_SHUFFLE(2, 0, 2, 0)), dz);
+		__m128 dy = _mm_mul_ps(_mm_shuffle_ps(xy0, xy1, _MM_SHUFFLE(3, 1, 3, 1)), dz);
+
+		__m128 x = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p->rotation[0]), dx), _mm_mul_ps(_mm_set1_ps(p->rotation[1]), dy)),
+			_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p->rotation[2]), dz), _mm_set1_ps(p->translation[0])));
+		__m128 y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p->rotation[3]), dx), _mm_mul_ps(_mm_set1_ps(p->rotation[4]), dy)),
+			_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p->rotation[5]), dz), _mm_set1_ps(p->translation[1])));
+		__m128 cz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p->rotation[6]), dx), _mm_mul_ps(_mm_set1_ps(p->rotation[7]), dy)),
+			_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p->rotation[8]), dz), _mm_set1_ps(p->translation[2])));
+
+		// Ordered compares are false for nan, so a nan ray drops out of the mask on its own
+		__m128 valid = _mm_and_ps(_mm_cmpgt_ps(dz, zerof), _mm_cmpgt_ps(cz, zerof));
+
+		__m128 xp = _mm_sub_ps(_mm_div_ps(x, cz), codx);
+		__m128 yp = _mm_sub_ps(_mm_div_ps(y, cz), cody);
+		__m128 xp2 = _mm_mul_ps(xp, xp);
+		__m128 yp2 = _mm_mul_ps(yp, yp);
+		__m128 xyp = _mm_mul_ps(xp, yp);
+		__m128 rs = _mm_add_ps(xp2, yp2);
+		__m128 rss = _mm_mul_ps(rs, rs);
+		__m128 rsc = _mm_mul_ps(rss, rs);
+		valid = _mm_and_ps(valid, _mm_cmple_ps(rs, max_radius));
+
+		__m128 a = _mm_add_ps(_mm_add_ps(one, _mm_mul_ps(_mm_set1_ps(p->k[0]), rs)),
+			_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p->k[1]), rss), _mm_mul_ps(_mm_set1_ps(p->k[2]), rsc)));
+		__m128 b = _mm_add_ps(_mm_add_ps(one, _mm_mul_ps(_mm_set1_ps(p->k[3]), rs)),
+			_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p->k[4]), rss), _mm_mul_ps(_mm_set1_ps(p->k[5]), rsc)));
+		__m128 b_zero = _mm_cmpeq_ps(b, zerof);
+		__m128 d = _mm_or_ps(_mm_and_ps(b_zero, one), _mm_andnot_ps(b_zero, _mm_div_ps(a, _mm_or_ps(b, _mm_and_ps(b_zero, one)))));
+
+		__m128 ts_xyp = _mm_mul_ps(_mm_set1_ps(p->tangential_scale), xyp);
+		__m128 xp_d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(xp, d), _mm_mul_ps(_mm_add_ps(rs, _mm_mul_ps(two, xp2)), _mm_set1_ps(p->p2))),
+			_mm_mul_ps(ts_xyp, _mm_set1_ps(p->p1)));
+		__m128 yp_d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(yp, d), _mm_mul_ps(_mm_add_ps(rs, _mm_mul_ps(two, yp2)), _mm_set1_ps(p->p1))),
+			_mm_mul_ps(ts_xyp, _mm_set1_ps(p->p2)));
+		__m128 pu = _mm_add_ps(_mm_mul_ps(_mm_add_ps(xp_d, codx), _mm_set1_ps(p->fx)), _mm_set1_ps(p->cx));
+		__m128 pv = _mm_add_ps(_mm_mul_ps(_mm_add_ps(yp_d, cody), _mm_set1_ps(p->fy)), _mm_set1_ps(p->cy));
+
+		valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(pu, low), _mm_cmplt_ps(pu, width)));
+		valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(pv, low), _mm_cmplt_ps(pv, height)));
+
+		_mm_storeu_ps(u + i, _mm_and_ps(valid, pu));
+		_mm_storeu_ps(v + i, _mm_and_ps(valid, pv));
+		_mm_storeu_ps(z + i, _mm_and_ps(valid, cz));
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		z[i] = project_color_pixel(p, depth[i], xy[i], u[i], v[i]);
+	}
+}
+
+// Maps every depth pixel onto the color image and flags the ones a nearer surface hides there.
+// scratch holds three planar floats per depth pixel and zbuffer one float per cell, a cell being
+// cell_size color pixels square so it is about the footprint of one depth pixel. Returns the counts of
+// valid and occluded pixels. uv is two unorm shorts or two floats per pixel depending on format.
+static color_uv_counts_t compute_color_uv(const color_projection_t *projection,
+	const uint16_t *depth_data,
+	const k4a_float2_t *xy_table_data,
+	int width,
+	int height,
+	float occlusion_tolerance,
+	ColorUvFormat format,
+	float *scratch,
+	float *zbuffer,
+	void *uv_data,
+	uint8_t *flag_data)
+{
+	const size_t pixel_count = (size_t)width * height;
+	float *u_plane = scratch;
+	float *v_plane = scratch + pixel_count;
+	float *z_plane = scratch + 2 * pixel_count;
+
+	const int rows_per_band = 16;
+	const int band_count = (height + rows_per_band - 1) / rows_per_band;
+	ThreadPool::GetShared().ParallelFor(band_count, [&](int band)
+	{
+		size_t begin = (size_t)band * rows_per_band * width;
+		size_t end = (size_t)min((band + 1) * rows_per_band, height) * width;
+		project_color_run(projection,
+			depth_data + begin,
+			xy_table_data + begin,
+			u_plane + begin,
+			v_plane + begin,
+			z_plane + begin,
+			(int)(end - begin));
+	});
+
+	// Every point writes its depth into its cell and the right and lower neighbors, which closes the
+	// gaps between neighboring depth pixels that land a little more than a cell apart
+	const int cell_size = max(1, projection->width / width);
+	const int cell_width = (projection->width + cell_size - 1) / cell_size;
+	const int cell_height = (projection->height + cell_size - 1) / cell_size;
+	const float cell_scale = 1.f / (float)cell_size;
+	std::fill(zbuffer, zbuffer + (size_t)cell_width * cell_height, FLT_MAX);
+	for (size_t i = 0; i < pixel_count; i++)
+	{
+		const float z = z_plane[i];
+		if (z == 0.f)
+		{
+			continue;
+		}
+
+		const int cx = min((int)((u_plane[i] + 0.5f) * cell_scale), cell_width - 1);
+		const int cy = min((int)((v_plane[i] + 0.5f) * cell_scale), cell_height - 1);
+		const int nx = min(cx + 1, cell_width - 1);
+		const int ny = min(cy + 1, cell_height - 1);
+		float *row0 = zbuffer + (size_t)cy * cell_width;
+		float *row1 = zbuffer + (size_t)ny * cell_width;
+		row0[cx] = min(row0[cx], z);
+		row0[nx] = min(row0[nx], z);
+		row1[cx] = min(row1[cx], z);
+		row1[nx] = min(row1[nx], z);
+	}
+
+	std::atomic<int> valid_count{ 0 };
+	std::atomic<int> occluded_count{ 0 };
+	const float u_scale = 1.f / (float)projection->width;
+	const float v_scale = 1.f / (float)projection->height;
+	ThreadPool::GetShared().ParallelFor(band_count, [&](int band)
+	{
+		size_t begin = (size_t)band * rows_per_band * width;
+		size_t end = (size_t)min((band + 1) * rows_per_band, height) * width;
+		int band_valid = 0;
+		int band_occluded = 0;
+		for (size_t i = begin; i < end; i++)
+		{
+			const float z = z_plane[i];
+			float nu = 0.f;
+			float nv = 0.f;
+			if (z == 0.f)
+			{
+				flag_data[i] = ColorUvFlagInvalid;
+			}
+			else
+			{
+				// Normalized so a pixel center lands on a texel center
+				nu = (u_plane[i] + 0.5f) * u_scale;
+				nv = (v_plane[i] + 0.5f) * v_scale;
+
+				const int cx = min((int)((u_plane[i] + 0.5f) * cell_scale), cell_width - 1);
+				const int cy = min((int)((v_plane[i] + 0.5f) * cell_scale), cell_height - 1);
+				if (z > zbuffer[(size_t)cy * cell_width + cx] + occlusion_tolerance)
+				{
+					flag_data[i] = ColorUvFlagOccluded;
+					band_occluded++;
+				}
+				else
+				{
+					flag_data[i] = ColorUvFlagValid;
+					band_valid++;
+				}
+			}
+
+			if (format == ColorUvFormatRG16)
+			{
+				uint16_t *out = (uint16_t *)uv_data + 2 * i;
+				out[0] = (uint16_t)(min(max(nu, 0.f), 1.f) * 65535.f + 0.5f);
+				out[1] = (uint16_t)(min(max(nv, 0.f), 1.f) * 65535.f + 0.5f);
+			}
+			else
+			{
+				float *out = (float *)uv_data + 2 * i;
+				out[0] = nu;
+				out[1] = nv;
+			}
+		}
+
+		valid_count += band_valid;
+		occluded_count += band_occluded;
+	});
+
+	color_uv_counts_t counts;
+	counts.valid = valid_count;
+	counts.occluded = occluded_count;
+	return counts;
+}
+
+// Bytes of one uv pixel in the given layout
+static inline int color_uv_pixel_size(ColorUvFormat format)
+{
+	return format == ColorUvFormatRG16 ? 2 * sizeof(uint16_t) : 2 * sizeof(float);
+}
+
+// Floats of zbuffer compute_color_uv needs for a color image and a depth image width
+static inline size_t color_uv_zbuffer_size(const color_projection_t *projection, int depth_width)
+{
+	const int cell_size = max(1, projection->width / depth_width);
+	return (size_t)((projection->width + cell_size - 1) / cell_size) * ((projection->height + cell_size - 1) / cell_size);
+}
@@ -0,0 +1,151 @@
+#include "pch.h"
+#include "DeviceTable.h"
+#include <thread>
+
+bool DeviceTable::TryRead(k4a_device_t device, Entry &entry)
+{
+	entry = Entry{};
+
+	// Sizes first, both calls report how much they need when handed an empty buffer
+	size_t serialNumberSize = 0;
+	if (K4A_BUFFER_RESULT_TOO_SMALL != k4a_device_get_serialnum(device, nullptr, &serialNumberSize) ||
+		serialNumberSize == 0)
+	{
+		return false;
+	}
+
+	std::vector<char> serialNumber(serialNumberSize);
+	if (K4A_BUFFER_RESULT_SUCCEEDED != k4a_device_get_serialnum(device, serialNumber.data(), &serialNumberSize) ||
+		K4A_RESULT_SUCCEEDED != k4a_device_get_version(device, &entry.version))
+	{
+		return false;
+	}
+
+	size_t rawCalibrationSize = 0;
+	if (K4A_BUFFER_RESULT_TOO_SMALL != k4a_device_get_raw_calibration(device, nullptr, &rawCalibrationSize))
+	{
+		return false;
+	}
+
+	entry.rawCalibration.resize(rawCalibrationSize);
+	if (K4A_BUFFER_RESULT_SUCCEEDED != k4a_device_get_raw_calibration(device, entry.rawCalibration.data(), &rawCalibrationSize))
+	{
+		entry.rawCalibration.clear();
+		return false;
+	}
+
+	entry.serialNumber.assign(serialNumber.data());
+	entry.valid = true;
+	return true;
+}
+
+bool DeviceTable::IsCurrent()
+{
+	uint32_t deviceCount = k4a_device_get_installed_count();
+
+	std::lock_guard<std::mutex> lock(tableMutex);
+	return filled && entries.size() == deviceCount;
+}
+
+void DeviceTable::Refresh(const std::vector<k4a_device_t> &openDevices)
+{
+	auto start = TimingHelper::GetTimestampMicroseconds();
+	uint32_t deviceCount = k4a_device_get_installed_count();
+
+	// Opening a device takes long enough that reading them one after the other adds up
+	std::vector<Entry> refreshed(deviceCount);
+	std::vector<std::thread> readers;
+	for (uint32_t index = 0; index < deviceCount; index++)
+	{
+		k4a_device_t device = index < openDevices.size() ? openDevices[index] : nullptr;
+		if (device != nullptr)
+		{
+			TryRead(device, refreshed[index]);
+			continue;
+		}
+
+		readers.emplace_back([index, &refreshed]()
+		{
+			k4a_device_t device = nullptr;
+			if (K4A_RESULT_SUCCEEDED == k4a_device_open(index, &device))
+			{
+				TryRead(device, refreshed[index]);
+				k4a_device_close(device);
+			}
+		});
+	}
+
+	for (auto &reader : readers)
+	{
+		reader.join();
+	}
+
+	std::lock_guard<std::mutex> lock(tableMutex);
+	entries = std::move(refreshed);
+	filled = true;
+	refreshCount++;
+	refreshMilliseconds = TimingHelper::GetElapsedMilliseconds(start);
+}
+
+void DeviceTable::Update(unsigned int index, k4a_device_t device)
+{
+	{
+		std::lock_guard<std::mutex> lock(tableMutex);
+		if (index < entries.size() && entries[index].valid)
+		{
+			return;
+		}
+	}
+
+	Entry entry;
+	if (!TryRead(device, entry))
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(tableMutex);
+	if (index >= entries.size())
+	{
+		entries.resize(index + 1);
+	}
+	entries[index] = std::move(entry);
+}
+
+bool DeviceTable::TryGetEntry(unsigned int index, Entry &entry)
+{
+	std::lock_guard<std::mutex> lock(tableMutex);
+	if (index >= entries.size() ||
+		!entries[index].valid)
+	{
+		return false;
+	}
+
+	entry = entries[index];
+	return true;
+}
+
+int DeviceTable::FindSerialNumber(const char *serialNumber)
+{
+	std::lock_guard<std::mutex> lock(tableMutex);
+	for (size_t index = 0; index < entries.size(); index++)
+	{
+		if (entries[index].valid &&
+			entries[index].serialNumber == serialNumber)
+		{
+			return static_cast<int>(index);
+		}
+	}
+
+	return -1;
+}
+
+DeviceTable::Stats DeviceTable::GetStats()
+{
+	std::lock_guard<std::mutex> lock(tableMutex);
+	Stats stats = { static_cast<int>(entries.size()), 0, refreshCount, refreshMilliseconds };
+	for (const auto &entry : entries)
+	{
+		stats.validCount += entry.valid ? 1 : 0;
+	}
+	return stats;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+// Serial number, firmware versions and factory calibration of every installed device, read once and
+// kept, so looking devices up never goes back to the hardware. Devices that are not open are opened in
+// parallel for the read, devices that are open are read through their existing handle. The table is
+// read again when the installed count changes or when asked to.
+class DeviceTable
+{
+public:
+	struct Entry
+	{
+		bool valid = false;
+		std::string serialNumber;
+		k4a_hardware_version_t version = {};
+		// Mode independent, k4a_calibration_get_from_raw turns it into a calibration for any mode
+		std::vector<uint8_t> rawCalibration;
+	};
+
+	struct Stats
+	{
+		int deviceCount;
+		int validCount;
+		uint64_t refreshCount;
+		float refreshMilliseconds;
+	};
+
+	// Nothing to do when the table is filled and the installed count still matches
+	bool IsCurrent();
+
+	// openDevices has a handle per device index that is already open, null for the rest
+	void Refresh(const std::vector<k4a_device_t> &openDevices);
+
+	// Fills one entry through a handle opened elsewhere, leaves an entry that is already valid alone
+	void Update(unsigned int index, k4a_device_t device);
+
+	bool TryGetEntry(unsigned int index, Entry &entry);
+
+	// Returns -1 when no device has the serial number
+	int FindSerialNumber(const char *serialNumber);
+
+	Stats GetStats();
+
+private:
+	static bool TryRead(k4a_device_t device, Entry &entry);
+
+	std::mutex tableMutex;
+	std::vector<Entry> entries;
+	bool filled = false;
+	uint64_t refreshCount = 0;
+	float refreshMilliseconds = 0.0f;
+};
@@ -0,0 +1,253 @@
+#pragma once
+
+// Blittable per-frame state handed to managed code in one call for every device. The layouts are
+// mirrored in AzureKinectUnityAPI.cs, append fields at the end and keep both sides in step. Frame
+// descriptors are fetched with the caller's struct size and the calibration blob carries its layout
+// version, so a stale mirror is rejected rather than read with the wrong layout.
+enum FrameDescriptorFlags : uint32_t
+{
+	// A capture was processed for this device during the call that filled the descriptor
+	FrameDescriptorUpdated = 1 << 0,
+	// The rgb, depth and point cloud template views exist
+	FrameDescriptorResourcesReady = 1 << 1,
+	FrameDescriptorIRReady = 1 << 2,
+	// The cached cpu buffers below are populated
+	FrameDescriptorBuffersReady = 1 << 3,
+	// Change detection found no changed tile, the buffers and views kept the previous frame's contents
+	FrameDescriptorUnchanged = 1 << 4,
+	// The host timestamp was mapped from the depth device timestamp, not taken from its system timestamp
+	FrameDescriptorClockMapped = 1 << 5
+};
+
+struct FrameDescriptor
+{
+	uint32_t index;
+	uint32_t flags;
+	uint64_t sequence;
+	uint64_t depthTimestampUsec;
+	uint64_t colorTimestampUsec;
+
+	// Checked against the last fetched calibration blob, only refetch when it changes
+	uint32_t calibrationVersion;
+	int32_t queueDepth;
+
+	ID3D11ShaderResourceView *rgbSrv;
+	ID3D11ShaderResourceView *depthSrv;
+	ID3D11ShaderResourceView *pointCloudTemplateSrv;
+	ID3D11ShaderResourceView *irSrv;
+
+	// Owned by the plugin, valid until the next update or until the device is stopped
+	byte *transformedColorBuffer;
+	byte *depthBuffer;
+
+	uint32_t rgbWidth;
+	uint32_t rgbHeight;
+	uint32_t depthWidth;
+	uint32_t depthHeight;
+	uint32_t pointCloudTemplateWidth;
+	uint32_t pointCloudTemplateHeight;
+	uint32_t irWidth;
+	uint32_t irHeight;
+
+	uint64_t deliveredCount;
+	uint64_t droppedCount;
+	float lastAgeMilliseconds;
+	float averageAgeMilliseconds;
+
+	// Depth exposure on the host monotonic clock and how long ago that was when the frame was
+	// published. Without FrameDescriptorClockMapped the mapping does not have enough samples yet and
+	// the exposure is the depth image's system timestamp, so the latency leaves out the usb transfer.
+	uint64_t depthHostTimestampNsec;
+	float captureToPublishMilliseconds;
+
+	// Depth pixels the last frame rewrote in the buffers and views, the whole frame unless change
+	// detection or a region of interest limited it
+	int32_t changedX;
+	int32_t changedY;
+	int32_t changedWidth;
+	int32_t changedHeight;
+};
+
+// Timestamps of the last published frame. Device timestamps are the center of exposure on the device
+// clock, system timestamps are when the host received the image. Zero when the image was missing.
+struct FrameTimestamps
+{
+	uint64_t sequence;
+	uint64_t colorDeviceTimestampUsec;
+	uint64_t colorSystemTimestampNsec;
+	uint64_t depthDeviceTimestampUsec;
+	uint64_t depthSystemTimestampNsec;
+	uint64_t irDeviceTimestampUsec;
+	uint64_t irSystemTimestampNsec;
+
+	// Depth exposure mapped onto the host clock, falls back to the system timestamp without a fit
+	uint64_t depthHostTimestampNsec;
+	uint64_t publishHostTimestampNsec;
+	float captureToPublishMilliseconds;
+};
+
+struct CalibrationBlobCamera
+{
+	int32_t width;
+	int32_t height;
+	int32_t intrinsicsType;
+	int32_t intrinsicsCount;
+	float intrinsics[15];
+	float metricRadius;
+	float rotation[9];
+	float translation[3];
+};
+
+struct CalibrationBlob
+{
+	static const uint32_t Magic = 0x42434b41; // "AKCB"
+	static const uint32_t LayoutVersion = 1;
+
+	uint32_t magic;
+	uint32_t layoutVersion;
+	uint32_t size;
+	uint32_t calibrationVersion;
+	int32_t depthMode;
+	int32_t colorResolution;
+	CalibrationBlobCamera depth;
+	CalibrationBlobCamera color;
+	float depthToColorRotation[9];
+	float depthToColorTranslation[3];
+};
+
+// One row of the cached device table. Versions are major, minor and iteration, the raw calibration
+// is fetched separately and its size is here.
+struct DeviceInfo
+{
+	uint32_t index;
+	char serialNumber[32];
+	uint32_t colorFirmwareVersion[3];
+	uint32_t depthFirmwareVersion[3];
+	uint32_t audioFirmwareVersion[3];
+	uint32_t depthSensorVersion[3];
+	int32_t firmwareBuild;
+	int32_t firmwareSignature;
+	uint32_t rawCalibrationSize;
+};
+
+// Live memory held by one device. Images are the sdk images kept between frames, buffers the cpu
+// copies handed to readers, luts the xy table and undistort table, textures the d3d textures and
+// uploads the upload queue's staging copies of them. All of it is zero once the device stopped.
+struct DeviceMemoryStats
+{
+	uint32_t index;
+	int32_t imageCount;
+	int32_t bufferCount;
+	int32_t lutCount;
+	int32_t textureCount;
+	int32_t uploadTargetCount;
+	uint64_t imageBytes;
+	uint64_t bufferBytes;
+	uint64_t lutBytes;
+	uint64_t textureBytes;
+	uint64_t uploadBytes;
+	uint64_t totalBytes;
+};
+
+// Tile change detection of one device. The counts and bytes add up from when it was enabled, full
+// frame bytes are what the copies would have been without it. The tile counts are the last frame's.
+struct ChangeDetectionStats
+{
+	uint64_t frameCount;
+	uint64_t unchangedFrameCount;
+	uint64_t keyframeCount;
+	uint64_t copiedBytes;
+	uint64_t fullFrameBytes;
+	int32_t tileColumns;
+	int32_t tileRows;
+	int32_t changedTileCount;
+	float detectMilliseconds;
+};
+
+// Outlier filter of one device. The frame and rejected totals add up from when it was enabled, the rest is the
+// last frame's. Ratios are a pixel's rms distance to the valid pixels in its window over its depth.
+struct OutlierFilterStats
+{
+	uint64_t frameCount;
+	uint64_t rejectedTotal;
+	int32_t width;
+	int32_t height;
+	int32_t validPixelCount;
+	int32_t rejectedPixelCount;
+	float meanRatio;
+	float ratioDeviation;
+	float thresholdRatio;
+	float filterMilliseconds;
+};
+
+// Shared memory publishing of one device. Counts and bytes add up from when the ring was created, publish
+// times cover copying one frame into its slot, the last frame's and the slowest since the ring was created.
+struct SharedFrameStats
+{
+	uint64_t publishedCount;
+	uint64_t publishedBytes;
+	uint64_t mappingBytes;
+	int32_t slotCount;
+	float lastPublishMilliseconds;
+	float maxPublishMilliseconds;
+};
+
+// Frame server of one device. Counts and bytes add up from when the server started, the compression ratio
+// compares the raw images with their encoded payloads and bandwidth covers every client over the last second.
+struct FrameServerStats
+{
+	int32_t port;
+	int32_t clientCount;
+	uint64_t submittedCount;
+	uint64_t skippedCount;
+	uint64_t encodedCount;
+	uint64_t sentCount;
+	uint64_t droppedCount;
+	uint64_t rawBytes;
+	uint64_t encodedBytes;
+	uint64_t sentBytes;
+	float lastColorEncodeMilliseconds;
+	float lastDepthEncodeMilliseconds;
+	float averageEncodeMilliseconds;
+	float lastSendMilliseconds;
+	float maxSendMilliseconds;
+	float compressionRatio;
+	float megabitsPerSecond;
+};
+
+// One frame a client decoded. sequence counts the frames the client decoded, frameSequence is the
+// device's own. The host timestamp is on the server's clock.
+struct FrameClientFrameInfo
+{
+	uint64_t sequence;
+	uint64_t frameSequence;
+	uint64_t depthDeviceTimestampUsec;
+	uint64_t depthHostTimestampNsec;
+	int32_t width;
+	int32_t height;
+	int32_t hasDepth;
+	int32_t hasColor;
+};
+
+// A frame client's connection. Latency runs from the depth capture on the server to decoded here and only
+// means something with both on the same machine, jitter is the deviation of the time between frames.
+struct FrameClientStats
+{
+	int32_t connected;
+	int32_t width;
+	int32_t height;
+	uint64_t connectCount;
+	uint64_t receivedCount;
+	uint64_t receivedBytes;
+	uint64_t missedCount;
+	uint64_t failedCount;
+	float lastEncodeMilliseconds;
+	float lastReceiveMilliseconds;
+	float lastDecodeMilliseconds;
+	float averageDecodeMilliseconds;
+	float lastLatencyMilliseconds;
+	float averageLatencyMilliseconds;
+	float averageIntervalMilliseconds;
+	float intervalJitterMilliseconds;
+	float megabitsPerSecond;
+};
@@ -0,0 +1,1003 @@
+#include "pch.h"
+#include "FrameStream.h"
+#include "RgbdCodec.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// Larger frames are refused on both ends, a wide field of view depth image is a quarter of this
+static const size_t MaxPixelCount = 1 << 24;
+static const int ConnectTimeoutMilliseconds = 1000;
+static const int ReconnectIntervalMilliseconds = 500;
+
+// Winsock is reference counted, every start is paired with a stop
+static bool start_sockets()
+{
+#ifdef _WIN32
+	WSADATA data;
+	return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+#else
+	return true;
+#endif
+}
+
+static void stop_sockets()
+{
+#ifdef _WIN32
+	WSACleanup();
+#endif
+}
+
+static void close_socket(FrameStreamSocket socket)
+{
+#ifdef _WIN32
+	closesocket(socket);
+#else
+	close(socket);
+#endif
+}
+
+// Wakes whatever thread is blocked sending or receiving on the socket
+static void shutdown_socket(FrameStreamSocket socket)
+{
+#ifdef _WIN32
+	shutdown(socket, SD_BOTH);
+#else
+	shutdown(socket, SHUT_RDWR);
+#endif
+}
+
+static void set_blocking(FrameStreamSocket socket, bool blocking)
+{
+#ifdef _WIN32
+	u_long nonBlocking = blocking ? 0 : 1;
+	ioctlsocket(socket, FIONBIO, &nonBlocking);
+#else
+	int flags = fcntl(socket, F_GETFL, 0);
+	fcntl(socket, F_SETFL, blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK));
+#endif
+}
+
+static void set_no_delay(FrameStreamSocket socket)
+{
+	// Frames go out as one write each, waiting to coalesce them only adds latency
+	int value = 1;
+	setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static bool send_all(FrameStreamSocket socket, const uint8_t *data, size_t size)
+{
+	while (size > 0)
+	{
+		int chunk = static_cast<int>(min(size, static_cast<size_t>(1 << 20)));
+#ifdef _WIN32
+		int sent = send(socket, reinterpret_cast<const char*>(data), chunk, 0);
+#else
+		ssize_t sent = send(socket, data, chunk, MSG_NOSIGNAL);
+		if (sent < 0 &&
+			errno == EINTR)
+		{
+			continue;
+		}
+#endif
+		if (sent <= 0)
+		{
+			return false;
+		}
+
+		data += sent;
+		size -= static_cast<size_t>(sent);
+	}
+
+	return true;
+}
+
+static bool receive_all(FrameStreamSocket socket, void *buffer, size_t size)
+{
+	uint8_t *data = static_cast<uint8_t*>(buffer);
+	while (size > 0)
+	{
+		int chunk = static_cast<int>(min(size, static_cast<size_t>(1 << 20)));
+#ifdef _WIN32
+		int received = recv(socket, reinterpret_cast<char*>(data), chunk, 0);
+#else
+		ssize_t received = recv(socket, data, chunk, 0);
+		if (received < 0 &&
+			errno == EINTR)
+		{
+			continue;
+		}
+#endif
+		if (received <= 0)
+		{
+			return false;
+		}
+
+		data += received;
+		size -= static_cast<size_t>(received);
+	}
+
+	return true;
+}
+
+static bool wait_readable(FrameStreamSocket socket, int timeoutMilliseconds)
+{
+	fd_set readable;
+	FD_ZERO(&readable);
+	FD_SET(socket, &readable);
+	timeval timeout = { timeoutMilliseconds / 1000, (timeoutMilliseconds % 1000) * 1000 };
+	return select(static_cast<int>(socket) + 1, &readable, nullptr, nullptr, &timeout) > 0;
+}
+
+static bool try_resolve(const std::string &host, int port, addrinfo **addresses)
+{
+	addrinfo hints = {};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+	std::string service = std::to_string(port);
+	return getaddrinfo(host.c_str(), service.c_str(), &hints, addresses) == 0;
+}
+
+// Connects without blocking longer than the timeout, so an unreachable server never holds up Disconnect
+static FrameStreamSocket connect_to(const std::string &host, int port, int timeoutMilliseconds)
+{
+	addrinfo *addresses = nullptr;
+	if (!try_resolve(host, port, &addresses))
+	{
+		return FrameStreamNoSocket;
+	}
+
+	FrameStreamSocket result = FrameStreamNoSocket;
+	for (addrinfo *address = addresses; address != nullptr && result == FrameStreamNoSocket; address = address->ai_next)
+	{
+		FrameStreamSocket candidate = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+		if (candidate == FrameStreamNoSocket)
+		{
+			continue;
+		}
+
+		set_blocking(candidate, false);
+		bool connected = connect(candidate, address->ai_addr, static_cast<int>(address->ai_addrlen)) == 0;
+		if (!connected)
+		{
+			fd_set writable;
+			FD_ZERO(&writable);
+			FD_SET(candidate, &writable);
+			timeval timeout = { timeoutMilliseconds / 1000, (timeoutMilliseconds % 1000) * 1000 };
+			int error = -1;
+			socklen_t errorSize = sizeof(error);
+			connected = select(static_cast<int>(candidate) + 1, nullptr, &writable, nullptr, &timeout) > 0 &&
+				getsockopt(candidate, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &errorSize) == 0 &&
+				error == 0;
+		}
+
+		if (connected)
+		{
+			set_blocking(candidate, true);
+			result = candidate;
+		}
+		else
+		{
+			close_socket(candidate);
+		}
+	}
+
+	freeaddrinfo(addresses);
+	return result;
+}
+
+static void append_bytes(std::vector<uint8_t> &output, const void *data, size_t size)
+{
+	const uint8_t *bytes = static_cast<const uint8_t*>(data);
+	output.insert(output.end(), bytes, bytes + size);
+}
+
+static void append_message_header(std::vector<uint8_t> &output, uint32_t type, size_t bodySize)
+{
+	FrameStreamMessageHeader header = {};
+	header.magic = FrameStreamMessageHeader::Magic;
+	header.type = type;
+	header.bodySize = static_cast<uint32_t>(bodySize);
+	append_bytes(output, &header, sizeof(header));
+}
+
+FrameStreamServer::Options FrameStreamServer::GetDefaultOptions()
+{
+	Options options = {};
+	options.port = 0;
+	options.colorQuality = 75;
+	options.depthErrorMillimeters = 0;
+	options.maxFramesPerSecond = 0.0f;
+	options.maxClients = 8;
+	return options;
+}
+
+FrameStreamServer::~FrameStreamServer()
+{
+	Stop();
+}
+
+bool FrameStreamServer::TryStart(const Options &options)
+{
+	Stop();
+
+	if (options.port < 0 ||
+		options.port > 65535 ||
+		options.colorQuality < 1 ||
+		options.colorQuality > 100 ||
+		options.depthErrorMillimeters < 0 ||
+		options.depthErrorMillimeters > 1000 ||
+		options.maxFramesPerSecond < 0.0f ||
+		options.maxClients < 1 ||
+		!start_sockets())
+	{
+		return false;
+	}
+
+	FrameStreamSocket listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (listener == FrameStreamNoSocket)
+	{
+		stop_sockets();
+		return false;
+	}
+
+#ifndef _WIN32
+	// Lets a restarted server take the port back while the old connections linger in time wait
+	int reuse = 1;
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+#endif
+
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(static_cast<uint16_t>(options.port));
+	sockaddr_in bound = {};
+	socklen_t boundSize = sizeof(bound);
+	if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+		listen(listener, options.maxClients) != 0 ||
+		getsockname(listener, reinterpret_cast<sockaddr*>(&bound), &boundSize) != 0)
+	{
+		close_socket(listener);
+		stop_sockets();
+		return false;
+	}
+
+	this->options = options;
+	port = ntohs(bound.sin_port);
+	listenSocket = listener;
+	stats = {};
+	stats.port = port;
+	totalEncodeMilliseconds = 0.0;
+	bandwidthWindowStartMicroseconds = TimingHelper::GetTimestampMicroseconds();
+	bandwidthWindowBytes = 0;
+	nextDueMicroseconds = 0;
+	sequence = 0;
+
+	running.store(true);
+	acceptThread = std::thread(&FrameStreamServer::AcceptLoop, this);
+	encoderThread = std::thread(&FrameStreamServer::EncoderLoop, this);
+	return true;
+}
+
+void FrameStreamServer::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!running.load())
+		{
+			return;
+		}
+
+		running.store(false);
+		for (auto &client : clients)
+		{
+			shutdown_socket(client->socket);
+		}
+	}
+
+	frameSubmitted.notify_all();
+	frameEncoded.notify_all();
+	acceptThread.join();
+	encoderThread.join();
+
+	// Nothing adds clients once the accept thread is gone
+	for (auto &client : clients)
+	{
+		client->senderThread.join();
+		close_socket(client->socket);
+	}
+	clients.clear();
+
+	close_socket(listenSocket);
+	listenSocket = FrameStreamNoSocket;
+	stop_sockets();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	hasPendingInput = false;
+	std::vector<uint16_t>().swap(pendingDepth);
+	std::vector<uint8_t>().swap(pendingColor);
+	calibrationMessage = nullptr;
+	calibrationVersion = 0;
+	stats.clientCount = 0;
+}
+
+void FrameStreamServer::SetCalibration(
+	const uint8_t *data,
+	size_t size,
+	int depthMode,
+	int colorResolution,
+	uint32_t calibrationVersion)
+{
+	FrameStreamCalibrationHeader header = {};
+	header.calibrationVersion = calibrationVersion;
+	header.depthMode = depthMode;
+	header.colorResolution = colorResolution;
+	header.calibrationSize = static_cast<uint32_t>(size);
+
+	auto message = std::make_shared<std::vector<uint8_t>>();
+	message->reserve(sizeof(FrameStreamMessageHeader) + sizeof(header) + size);
+	append_message_header(*message, FrameStreamMessageHeader::CalibrationMessage, sizeof(header) + size);
+	append_bytes(*message, &header, sizeof(header));
+	append_bytes(*message, data, size);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	calibrationMessage = std::move(message);
+	this->calibrationVersion = calibrationVersion;
+}
+
+bool FrameStreamServer::Submit(
+	const FrameStreamFrameInfo &info,
+	const uint16_t *depthData,
+	const uint8_t *colorData)
+{
+	size_t pixelCount = static_cast<size_t>(info.width) * info.height;
+	if (!running.load() ||
+		(depthData == nullptr && colorData == nullptr) ||
+		pixelCount == 0 ||
+		pixelCount > MaxPixelCount)
+	{
+		return false;
+	}
+
+	int64_t now = TimingHelper::GetTimestampMicroseconds();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.submittedCount++;
+		if (clients.empty())
+		{
+			stats.skippedCount++;
+			return false;
+		}
+
+		if (options.maxFramesPerSecond > 0.0f)
+		{
+			// The cadence is kept from frame to frame, with a little slack so camera jitter does not
+			// leave out the frame that lands right on the boundary
+			int64_t interval = static_cast<int64_t>(1000000.0f / options.maxFramesPerSecond);
+			if (now + interval / 8 < nextDueMicroseconds)
+			{
+				stats.skippedCount++;
+				return false;
+			}
+
+			nextDueMicroseconds = now - nextDueMicroseconds < interval ?
+				nextDueMicroseconds + interval :
+				now + interval;
+		}
+
+		if (hasPendingInput)
+		{
+			stats.skippedCount++;
+		}
+
+		if (depthData != nullptr)
+		{
+			pendingDepth.assign(depthData, depthData + pixelCount);
+		}
+		else
+		{
+			pendingDepth.clear();
+		}
+
+		if (colorData != nullptr)
+		{
+			pendingColor.assign(colorData, colorData + pixelCount * 4);
+		}
+		else
+		{
+			pendingColor.clear();
+		}
+
+		pendingInfo = info;
+		hasPendingInput = true;
+	}
+
+	frameSubmitted.notify_one();
+	return true;
+}
+
+FrameStreamServer::Stats FrameStreamServer::GetStats()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return stats;
+}
+
+void FrameStreamServer::AcceptLoop()
+{
+	while (running.load())
+	{
+		bool readable = wait_readable(listenSocket, 100);
+
+		std::vector<std::unique_ptr<Client>> finished;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			ReapClients(finished);
+		}
+
+		for (auto &client : finished)
+		{
+			client->senderThread.join();
+			close_socket(client->socket);
+		}
+
+		if (!readable)
+		{
+			continue;
+		}
+
+		FrameStreamSocket socket = accept(listenSocket, nullptr, nullptr);
+		if (socket == FrameStreamNoSocket)
+		{
+			continue;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!running.load() ||
+			static_cast<int>(clients.size()) >= options.maxClients)
+		{
+			close_socket(socket);
+			continue;
+		}
+
+		set_no_delay(socket);
+		auto client = std::make_unique<Client>();
+		client->socket = socket;
+		client->senderThread = std::thread(&FrameStreamServer::SenderLoop, this, client.get());
+		clients.push_back(std::move(client));
+		stats.clientCount = static_cast<int32_t>(clients.size());
+	}
+}
+
+void FrameStreamServer::ReapClients(std::vector<std::unique_ptr<Client>> &finished)
+{
+	for (auto &client : clients)
+	{
+		if (!client->connected)
+		{
+			finished.push_back(std::move(client));
+		}
+	}
+
+	clients.erase(std::remove(clients.begin(), clients.end(), nullptr), clients.end());
+	stats.clientCount = static_cast<int32_t>(clients.size());
+}
+
+void FrameStreamServer::EncoderLoop()
+{
+	FrameStreamFrameInfo info = {};
+	std::vector<uint16_t> depth;
+	std::vector<uint8_t> color;
+	std::vector<uint8_t> colorPayload;
+	std::vector<uint8_t> depthPayload;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			frameSubmitted.wait(lock, [this]() { return !running.load() || hasPendingInput; });
+			if (!running.load())
+			{
+				return;
+			}
+
+			info = pendingInfo;
+			depth.swap(pendingDepth);
+			color.swap(pendingColor);
+			hasPendingInput = false;
+		}
+
+		// Each codec spreads its bands over the shared pool, one after the other
+		colorPayload.clear();
+		auto colorStart = TimingHelper::GetTimestampMicroseconds();
+		bool hasColor = !color.empty() &&
+			RgbdCodec::TryEncodeColor(color.data(), info.width, info.height, options.colorQuality, colorPayload);
+		float colorMilliseconds = TimingHelper::GetElapsedMilliseconds(colorStart);
+
+		depthPayload.clear();
+		auto depthStart = TimingHelper::GetTimestampMicroseconds();
+		bool hasDepth = !depth.empty() &&
+			RgbdCodec::TryEncodeDepth(depth.data(), info.width, info.height, options.depthErrorMillimeters, depthPayload);
+		float depthMilliseconds = TimingHelper::GetElapsedMilliseconds(depthStart);
+
+		if (!hasColor && !hasDepth)
+		{
+			continue;
+		}
+
+		FrameStreamFrameHeader header = {};
+		header.sequence = ++sequence;
+		header.frameSequence = info.frameSequence;
+		header.flags = (hasDepth ? FrameStreamHasDepth : 0) | (hasColor ? FrameStreamHasColor : 0);
+		header.width = info.width;
+		header.height = info.height;
+		header.calibrationVersion = info.calibrationVersion;
+		header.depthDeviceTimestampUsec = info.depthDeviceTimestampUsec;
+		header.depthHostTimestampNsec = info.depthHostTimestampNsec;
+		header.encodedHostTimestampNsec = TimingHelper::GetTimestampNanoseconds();
+		header.colorEncodeMilliseconds = colorMilliseconds;
+		header.depthEncodeMilliseconds = depthMilliseconds;
+		header.colorSize = static_cast<uint32_t>(colorPayload.size());
+		header.depthSize = static_cast<uint32_t>(depthPayload.size());
+
+		// One message shared by every client, whoever sends it last frees it
+		size_t bodySize = sizeof(header) + colorPayload.size() + depthPayload.size();
+		auto message = std::make_shared<std::vector<uint8_t>>();
+		message->reserve(sizeof(FrameStreamMessageHeader) + bodySize);
+		append_message_header(*message, FrameStreamMessageHeader::FrameMessage, bodySize);
+		append_bytes(*message, &header, sizeof(header));
+		append_bytes(*message, colorPayload.data(), colorPayload.size());
+		append_bytes(*message, depthPayload.data(), depthPayload.size());
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stats.encodedCount++;
+			stats.rawBytes += (hasDepth ? depth.size() * sizeof(uint16_t) : 0) + (hasColor ? color.size() : 0);
+			stats.encodedBytes += colorPayload.size() + depthPayload.size();
+			stats.lastColorEncodeMilliseconds = colorMilliseconds;
+			stats.lastDepthEncodeMilliseconds = depthMilliseconds;
+			totalEncodeMilliseconds += colorMilliseconds + depthMilliseconds;
+			stats.averageEncodeMilliseconds = static_cast<float>(totalEncodeMilliseconds / stats.encodedCount);
+			stats.compressionRatio = stats.encodedBytes > 0 ? static_cast<float>(stats.rawBytes) / stats.encodedBytes : 0.0f;
+
+			for (auto &client : clients)
+			{
+				if (client->pendingFrame != nullptr)
+				{
+					stats.droppedCount++;
+				}
+				client->pendingFrame = message;
+			}
+		}
+
+		frameEncoded.notify_all();
+	}
+}
+
+void FrameStreamServer::SenderLoop(Client *client)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		frameEncoded.wait(lock, [this, client]() { return !running.load() || client->pendingFrame != nullptr; });
+		if (!running.load())
+		{
+			break;
+		}
+
+		// A client that connected after the calibration was set, or before it changed, gets it first
+		Message frame = std::move(client->pendingFrame);
+		client->pendingFrame = nullptr;
+		Message calibration;
+		if (calibrationMessage != nullptr &&
+			client->sentCalibrationVersion != calibrationVersion)
+		{
+			calibration = calibrationMessage;
+			client->sentCalibrationVersion = calibrationVersion;
+		}
+		lock.unlock();
+
+		auto sendStart = TimingHelper::GetTimestampMicroseconds();
+		bool sent = (calibration == nullptr || send_all(client->socket, calibration->data(), calibration->size())) &&
+			send_all(client->socket, frame->data(), frame->size());
+		float sendMilliseconds = TimingHelper::GetElapsedMilliseconds(sendStart);
+
+		lock.lock();
+		if (!sent)
+		{
+			break;
+		}
+
+		uint64_t bytes = frame->size() + (calibration != nullptr ? calibration->size() : 0);
+		stats.sentCount++;
+		stats.sentBytes += bytes;
+		stats.lastSendMilliseconds = sendMilliseconds;
+		stats.maxSendMilliseconds = max(stats.maxSendMilliseconds, sendMilliseconds);
+		UpdateBandwidth(bytes);
+	}
+
+	client->connected = false;
+	client->pendingFrame = nullptr;
+}
+
+void FrameStreamServer::UpdateBandwidth(uint64_t bytes)
+{
+	// Averaged over about a second, every client's bytes together
+	bandwidthWindowBytes += bytes;
+	int64_t now = TimingHelper::GetTimestampMicroseconds();
+	int64_t elapsed = now - bandwidthWindowStartMicroseconds;
+	if (elapsed >= 1000000)
+	{
+		stats.megabitsPerSecond = static_cast<float>(bandwidthWindowBytes * 8.0 / elapsed);
+		bandwidthWindowBytes = 0;
+		bandwidthWindowStartMicroseconds = now;
+	}
+}
+
+FrameStreamClient::~FrameStreamClient()
+{
+	Disconnect();
+}
+
+bool FrameStreamClient::TryConnect(const std::string &host, int port)
+{
+	Disconnect();
+
+	if (host.empty() ||
+		port <= 0 ||
+		port > 65535 ||
+		!start_sockets())
+	{
+		return false;
+	}
+
+	addrinfo *addresses = nullptr;
+	if (!try_resolve(host, port, &addresses))
+	{
+		stop_sockets();
+		return false;
+	}
+	freeaddrinfo(addresses);
+
+	this->host = host;
+	this->port = port;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stats = {};
+		latestSequence = 0;
+		latestHeader = {};
+		totalDecodeMilliseconds = 0.0;
+		totalLatencyMilliseconds = 0.0;
+		lastFrameMicroseconds = 0;
+		totalIntervalMilliseconds = 0.0;
+		totalIntervalSquares = 0.0;
+		intervalCount = 0;
+		bandwidthWindowStartMicroseconds = TimingHelper::GetTimestampMicroseconds();
+		bandwidthWindowBytes = 0;
+	}
+
+	running.store(true);
+	receiveThread = std::thread(&FrameStreamClient::ReceiveLoop, this);
+	return true;
+}
+
+void FrameStreamClient::Disconnect()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!running.load())
+		{
+			return;
+		}
+
+		running.store(false);
+		if (activeSocket != FrameStreamNoSocket)
+		{
+			shutdown_socket(activeSocket);
+		}
+	}
+
+	disconnecting.notify_all();
+	frameDecoded.notify_all();
+	receiveThread.join();
+	stop_sockets();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	stats.connected = 0;
+	std::vector<uint16_t>().swap(decodedDepth);
+	std::vector<uint8_t>().swap(decodedColor);
+	std::vector<uint16_t>().swap(latestDepth);
+	std::vector<uint8_t>().swap(latestColor);
+}
+
+bool FrameStreamClient::IsConnected()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return stats.connected != 0;
+}
+
+bool FrameStreamClient::TryCopyLatest(
+	uint64_t &sequence,
+	FrameStreamFrameHeader &header,
+	uint16_t *depthData,
+	uint8_t *colorData,
+	size_t pixelCapacity)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	size_t pixelCount = static_cast<size_t>(latestHeader.width) * latestHeader.height;
+	if (latestSequence <= sequence ||
+		pixelCount > pixelCapacity)
+	{
+		return false;
+	}
+
+	if (depthData != nullptr &&
+		!latestDepth.empty())
+	{
+		memcpy(depthData, latestDepth.data(), pixelCount * sizeof(uint16_t));
+	}
+
+	if (colorData != nullptr &&
+		!latestColor.empty())
+	{
+		memcpy(colorData, latestColor.data(), pixelCount * 4);
+	}
+
+	header = latestHeader;
+	sequence = latestSequence;
+	return true;
+}
+
+bool FrameStreamClient::TryCopyCalibration(
+	std::vector<uint8_t> &data,
+	int *depthMode,
+	int *colorResolution,
+	uint32_t *calibrationVersion)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (calibration.empty())
+	{
+		return false;
+	}
+
+	data = calibration;
+	if (depthMode != nullptr)
+	{
+		*depthMode = calibrationHeader.depthMode;
+	}
+	if (colorResolution != nullptr)
+	{
+		*colorResolution = calibrationHeader.colorResolution;
+	}
+	if (calibrationVersion != nullptr)
+	{
+		*calibrationVersion = calibrationHeader.calibrationVersion;
+	}
+	return true;
+}
+
+bool FrameStreamClient::TryWaitForFrame(uint64_t sequence, int timeoutMilliseconds)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	return frameDecoded.wait_for(lock, std::chrono::milliseconds(timeoutMilliseconds), [this, sequence]()
+	{
+		return !running.load() || latestSequence > sequence;
+	}) && latestSequence > sequence;
+}
+
+FrameStreamClient::Stats FrameStreamClient::GetStats()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return stats;
+}
+
+void FrameStreamClient::ReceiveLoop()
+{
+	while (running.load())
+	{
+		FrameStreamSocket socket = connect_to(host, port, ConnectTimeoutMilliseconds);
+		if (socket != FrameStreamNoSocket)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (!running.load())
+				{
+					close_socket(socket);
+					break;
+				}
+
+				activeSocket = socket;
+				stats.connected = 1;
+				stats.connectCount++;
+				lastServerSequence = 0;
+				lastFrameMicroseconds = 0;
+			}
+
+			set_no_delay(socket);
+			ReceiveMessages(socket);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				activeSocket = FrameStreamNoSocket;
+				stats.connected = 0;
+			}
+			close_socket(socket);
+		}
+
+		std::unique_lock<std::mutex> lock(mutex);
+		disconnecting.wait_for(lock, std::chrono::milliseconds(ReconnectIntervalMilliseconds), [this]() { return !running.load(); });
+	}
+}
+
+void FrameStreamClient::ReceiveMessages(FrameStreamSocket socket)
+{
+	std::vector<uint8_t> body;
+	while (running.load())
+	{
+		FrameStreamMessageHeader header;
+		if (!receive_all(socket, &header, sizeof(header)))
+		{
+			return;
+		}
+
+		// Anything else on the port is not a frame server, reconnecting starts over in sync
+		auto receiveStart = TimingHelper::GetTimestampMicroseconds();
+		if (header.magic != FrameStreamMessageHeader::Magic ||
+			header.bodySize > FrameStreamMessageHeader::MaxBodySize)
+		{
+			return;
+		}
+
+		body.resize(header.bodySize);
+		if (!receive_all(socket, body.data(), body.size()))
+		{
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stats.receivedBytes += sizeof(header) + body.size();
+			bandwidthWindowBytes += sizeof(header) + body.size();
+			int64_t now = TimingHelper::GetTimestampMicroseconds();
+			int64_t elapsed = now - bandwidthWindowStartMicroseconds;
+			if (elapsed >= 1000000)
+			{
+				stats.megabitsPerSecond = static_cast<float>(bandwidthWindowBytes * 8.0 / elapsed);
+				bandwidthWindowBytes = 0;
+				bandwidthWindowStartMicroseconds = now;
+			}
+		}
+
+		if (header.type == FrameStreamMessageHeader::CalibrationMessage)
+		{
+			FrameStreamCalibrationHeader calibrationMessage;
+			if (body.size() < sizeof(calibrationMessage))
+			{
+				return;
+			}
+
+			memcpy(&calibrationMessage, body.data(), sizeof(calibrationMessage));
+			if (calibrationMessage.calibrationSize != body.size() - sizeof(calibrationMessage))
+			{
+				return;
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			calibrationHeader = calibrationMessage;
+			calibration.assign(body.begin() + sizeof(calibrationMessage), body.end());
+		}
+		else if (header.type == FrameStreamMessageHeader::FrameMessage)
+		{
+			DecodeFrame(body, receiveStart);
+		}
+		// Message types a newer server added are skipped
+	}
+}
+
+void FrameStreamClient::DecodeFrame(const std::vector<uint8_t> &body, int64_t receiveStartMicroseconds)
+{
+	float receiveMilliseconds = TimingHelper::GetElapsedMilliseconds(receiveStartMicroseconds);
+
+	FrameStreamFrameHeader header = {};
+	size_t pixelCount = 0;
+	bool valid = body.size() >= sizeof(header);
+	if (valid)
+	{
+		memcpy(&header, body.data(), sizeof(header));
+		pixelCount = static_cast<size_t>(header.width) * header.height;
+		valid = pixelCount > 0 &&
+			pixelCount <= MaxPixelCount &&
+			sizeof(header) + static_cast<size_t>(header.colorSize) + header.depthSize == body.size();
+	}
+
+	auto decodeStart = TimingHelper::GetTimestampMicroseconds();
+	const uint8_t *colorPayload = body.data() + sizeof(header);
+	const uint8_t *depthPayload = colorPayload + header.colorSize;
+	bool hasColor = (header.flags & FrameStreamHasColor) != 0;
+	bool hasDepth = (header.flags & FrameStreamHasDepth) != 0;
+	if (valid)
+	{
+		decodedColor.resize(hasColor ? pixelCount * 4 : 0);
+		decodedDepth.resize(hasDepth ? pixelCount : 0);
+		valid = (!hasColor || RgbdCodec::TryDecodeColor(colorPayload, header.colorSize, header.width, header.height, decodedColor.data())) &&
+			(!hasDepth || RgbdCodec::TryDecodeDepth(depthPayload, header.depthSize, header.width, header.height, decodedDepth.data()));
+	}
+
+	// The codec leaves alpha out, registered color is transparent black wherever depth is invalid
+	if (valid &&
+		hasColor &&
+		hasDepth)
+	{
+		for (size_t i = 0; i < pixelCount; i++)
+		{
+			if (decodedDepth[i] == 0)
+			{
+				memset(&decodedColor[i * 4], 0, 4);
+			}
+		}
+	}
+	float decodeMilliseconds = TimingHelper::GetElapsedMilliseconds(decodeStart);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!valid)
+		{
+			stats.failedCount++;
+			return;
+		}
+
+		latestDepth.swap(decodedDepth);
+		latestColor.swap(decodedColor);
+		latestHeader = header;
+		latestSequence++;
+
+		int64_t now = TimingHelper::GetTimestampMicroseconds();
+		stats.receivedCount++;
+		stats.width = static_cast<int32_t>(header.width);
+		stats.height = static_cast<int32_t>(header.height);
+		if (lastServerSequence != 0 &&
+			header.sequence > lastServerSequence + 1)
+		{
+			stats.missedCount += header.sequence - lastServerSequence - 1;
+		}
+		lastServerSequence = header.sequence;
+
+		stats.lastEncodeMilliseconds = header.colorEncodeMilliseconds + header.depthEncodeMilliseconds;
+		stats.lastReceiveMilliseconds = receiveMilliseconds;
+		stats.lastDecodeMilliseconds = decodeMilliseconds;
+		totalDecodeMilliseconds += decodeMilliseconds;
+		stats.averageDecodeMilliseconds = static_cast<float>(totalDecodeMilliseconds / stats.receivedCount);
+
+		if (header.depthHostTimestampNsec != 0)
+		{
+			stats.lastLatencyMilliseconds = (TimingHelper::GetTimestampNanoseconds() - (int64_t)header.depthHostTimestampNsec) / 1000000.0f;
+			totalLatencyMilliseconds += stats.lastLatencyMilliseconds;
+			stats.averageLatencyMilliseconds = static_cast<float>(totalLatencyMilliseconds / stats.receivedCount);
+		}
+
+		// Jitter is the standard deviation of the time between decoded frames
+		if (lastFrameMicroseconds != 0)
+		{
+			double interval = (now - lastFrameMicroseconds) / 1000.0;
+			totalIntervalMilliseconds += interval;
+			totalIntervalSquares += interval * interval;
+			intervalCount++;
+			double mean = totalIntervalMilliseconds / intervalCount;
+			stats.averageIntervalMilliseconds = static_cast<float>(mean);
+			stats.intervalJitterMilliseconds = static_cast<float>(sqrt(max(totalIntervalSquares / intervalCount - mean * mean, 0.0)));
+		}
+		lastFrameMicroseconds = now;
+	}
+
+	frameDecoded.notify_all();
+}
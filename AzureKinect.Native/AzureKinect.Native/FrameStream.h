@@ -0,0 +1,288 @@
+#pragma once
+
+// Registered color and depth streamed over tcp. The server compresses each frame once with RgbdCodec
+// and sends it to every connected client, the client decodes it back into a depth image and a bgra
+// image at the depth camera's size, the same layout the device publishes them in.
+#ifdef _WIN32
+typedef uintptr_t FrameStreamSocket;
+#else
+typedef int FrameStreamSocket;
+#endif
+static const FrameStreamSocket FrameStreamNoSocket = static_cast<FrameStreamSocket>(-1);
+
+enum FrameStreamFlags : uint32_t
+{
+	FrameStreamHasDepth = 1 << 0,
+	FrameStreamHasColor = 1 << 1
+};
+
+// Every message starts with this, the body follows. Calibration messages hold
+// FrameStreamCalibrationHeader and the raw calibration, frame messages FrameStreamFrameHeader and
+// the color payload followed by the depth payload.
+struct FrameStreamMessageHeader
+{
+	static const uint32_t Magic = 0x4d534b41; // "AKSM"
+	static const uint32_t CalibrationMessage = 1;
+	static const uint32_t FrameMessage = 2;
+	static const uint32_t MaxBodySize = 64 * 1024 * 1024;
+
+	uint32_t magic;
+	uint32_t type;
+	uint32_t bodySize;
+	uint32_t reserved;
+};
+
+struct FrameStreamCalibrationHeader
+{
+	uint32_t calibrationVersion;
+	int32_t depthMode;
+	int32_t colorResolution;
+	uint32_t calibrationSize;
+};
+
+struct FrameStreamFrameHeader
+{
+	// Counts the frames the server encoded, the device's own sequence skips what pacing dropped
+	uint64_t sequence;
+	uint64_t frameSequence;
+	uint32_t flags;
+	uint32_t width;
+	uint32_t height;
+	uint32_t calibrationVersion;
+	uint64_t depthDeviceTimestampUsec;
+	// On the server's monotonic clock, only comparable with the client's on the same machine
+	uint64_t depthHostTimestampNsec;
+	uint64_t encodedHostTimestampNsec;
+	float colorEncodeMilliseconds;
+	float depthEncodeMilliseconds;
+	uint32_t colorSize;
+	uint32_t depthSize;
+};
+
+// What the server is handed for one frame, the images share the depth camera's size
+struct FrameStreamFrameInfo
+{
+	uint64_t frameSequence;
+	uint32_t width;
+	uint32_t height;
+	uint32_t calibrationVersion;
+	uint64_t depthDeviceTimestampUsec;
+	uint64_t depthHostTimestampNsec;
+};
+
+// Accepts clients on its own thread and encodes on another, so Submit only copies the frame. Only the
+// newest frame waits for the encoder and only the newest encoded frame waits for each client, a slow
+// client misses frames without holding up the others.
+class FrameStreamServer
+{
+public:
+	struct Options
+	{
+		// Zero picks any free port, GetPort tells which
+		int port;
+		int colorQuality;
+		// Zero keeps depth lossless
+		int depthErrorMillimeters;
+		// Zero sends every frame the encoder keeps up with
+		float maxFramesPerSecond;
+		int maxClients;
+	};
+
+	struct Stats
+	{
+		int32_t port;
+		int32_t clientCount;
+		uint64_t submittedCount;
+		// Left out by pacing or replaced by a newer frame before the encoder got to them
+		uint64_t skippedCount;
+		uint64_t encodedCount;
+		uint64_t rawBytes;
+		uint64_t encodedBytes;
+		uint64_t sentCount;
+		uint64_t sentBytes;
+		// Encoded frames a client was still sending the frame before when they were replaced
+		uint64_t droppedCount;
+		float lastColorEncodeMilliseconds;
+		float lastDepthEncodeMilliseconds;
+		float averageEncodeMilliseconds;
+		float lastSendMilliseconds;
+		float maxSendMilliseconds;
+		float compressionRatio;
+		float megabitsPerSecond;
+	};
+
+	static Options GetDefaultOptions();
+
+	FrameStreamServer() {}
+	~FrameStreamServer();
+
+	FrameStreamServer(const FrameStreamServer &) = delete;
+	FrameStreamServer &operator=(const FrameStreamServer &) = delete;
+
+	// Listens right away, false when the port could not be bound
+	bool TryStart(const Options &options);
+	void Stop();
+	bool IsRunning() const { return running.load(); }
+	int GetPort() const { return port; }
+
+	// Sent to every client before its first frame and again whenever calibrationVersion changes
+	void SetCalibration(
+		const uint8_t *data,
+		size_t size,
+		int depthMode,
+		int colorResolution,
+		uint32_t calibrationVersion);
+	// Never waits for the encoder. Either image can be null. False when the frame was left out, frames
+	// are also left out while no client is connected.
+	bool Submit(
+		const FrameStreamFrameInfo &info,
+		const uint16_t *depthData,
+		const uint8_t *colorData);
+
+	Stats GetStats();
+
+private:
+	typedef std::shared_ptr<const std::vector<uint8_t>> Message;
+
+	struct Client
+	{
+		FrameStreamSocket socket;
+		std::thread senderThread;
+		Message pendingFrame;
+		uint32_t sentCalibrationVersion = 0;
+		bool connected = true;
+	};
+
+	void AcceptLoop();
+	void EncoderLoop();
+	void SenderLoop(Client *client);
+	// Callers hold the lock
+	void ReapClients(std::vector<std::unique_ptr<Client>> &finished);
+	void UpdateBandwidth(uint64_t bytes);
+
+	Options options = {};
+	int port = 0;
+	FrameStreamSocket listenSocket = FrameStreamNoSocket;
+	std::atomic<bool> running{ false };
+	std::thread acceptThread;
+	std::thread encoderThread;
+
+	std::mutex mutex;
+	std::condition_variable frameSubmitted;
+	std::condition_variable frameEncoded;
+
+	// The newest frame waiting for the encoder, its buffers are swapped with the encoder's own
+	bool hasPendingInput = false;
+	FrameStreamFrameInfo pendingInfo = {};
+	std::vector<uint16_t> pendingDepth;
+	std::vector<uint8_t> pendingColor;
+	int64_t nextDueMicroseconds = 0;
+
+	Message calibrationMessage;
+	uint32_t calibrationVersion = 0;
+	std::vector<std::unique_ptr<Client>> clients;
+	uint64_t sequence = 0;
+
+	Stats stats = {};
+	double totalEncodeMilliseconds = 0.0;
+	int64_t bandwidthWindowStartMicroseconds = 0;
+	uint64_t bandwidthWindowBytes = 0;
+};
+
+// Connects on its own thread and keeps reconnecting until Disconnect, decoding each frame as it arrives.
+// Readers copy the newest decoded frame out, frames nobody copied in time are replaced.
+class FrameStreamClient
+{
+public:
+	struct Stats
+	{
+		int32_t connected;
+		int32_t width;
+		int32_t height;
+		uint64_t connectCount;
+		uint64_t receivedCount;
+		uint64_t receivedBytes;
+		// Frames the server sent that never arrived, counted from gaps in its sequence
+		uint64_t missedCount;
+		uint64_t failedCount;
+		float lastEncodeMilliseconds;
+		// From the first byte of a frame to its last, network and server send together
+		float lastReceiveMilliseconds;
+		float lastDecodeMilliseconds;
+		float averageDecodeMilliseconds;
+		// From the depth capture on the server to decoded here, meaningful on the same machine only
+		float lastLatencyMilliseconds;
+		float averageLatencyMilliseconds;
+		float averageIntervalMilliseconds;
+		float intervalJitterMilliseconds;
+		float megabitsPerSecond;
+	};
+
+	FrameStreamClient() {}
+	~FrameStreamClient();
+
+	FrameStreamClient(const FrameStreamClient &) = delete;
+	FrameStreamClient &operator=(const FrameStreamClient &) = delete;
+
+	// False when the host does not resolve, an unreachable server is retried in the background
+	bool TryConnect(const std::string &host, int port);
+	void Disconnect();
+	bool IsConnected();
+
+	// Copies the newest frame when it is newer than sequence, which counts the frames this client
+	// decoded and is updated. Either image can be null, both have to hold width times height pixels.
+	bool TryCopyLatest(
+		uint64_t &sequence,
+		FrameStreamFrameHeader &header,
+		uint16_t *depthData,
+		uint8_t *colorData,
+		size_t pixelCapacity);
+	bool TryCopyCalibration(
+		std::vector<uint8_t> &data,
+		int *depthMode,
+		int *colorResolution,
+		uint32_t *calibrationVersion);
+	// Waits until a frame newer than sequence was decoded, false on timeout
+	bool TryWaitForFrame(uint64_t sequence, int timeoutMilliseconds);
+
+	Stats GetStats();
+
+private:
+	void ReceiveLoop();
+	// Reads and decodes messages until the connection fails or the client disconnects
+	void ReceiveMessages(FrameStreamSocket socket);
+	void DecodeFrame(const std::vector<uint8_t> &body, int64_t receiveStartMicroseconds);
+
+	std::string host;
+	int port = 0;
+	std::atomic<bool> running{ false };
+	std::thread receiveThread;
+
+	std::mutex mutex;
+	std::condition_variable frameDecoded;
+	std::condition_variable disconnecting;
+	// Shut down by Disconnect to wake the receive thread
+	FrameStreamSocket activeSocket = FrameStreamNoSocket;
+
+	// Decoded on the receive thread and swapped in with the latest frame
+	std::vector<uint16_t> decodedDepth;
+	std::vector<uint8_t> decodedColor;
+	uint64_t latestSequence = 0;
+	FrameStreamFrameHeader latestHeader = {};
+	std::vector<uint16_t> latestDepth;
+	std::vector<uint8_t> latestColor;
+
+	std::vector<uint8_t> calibration;
+	FrameStreamCalibrationHeader calibrationHeader = {};
+
+	Stats stats = {};
+	uint64_t lastServerSequence = 0;
+	double totalDecodeMilliseconds = 0.0;
+	double totalLatencyMilliseconds = 0.0;
+	int64_t lastFrameMicroseconds = 0;
+	double totalIntervalMilliseconds = 0.0;
+	double totalIntervalSquares = 0.0;
+	uint64_t intervalCount = 0;
+	int64_t bandwidthWindowStartMicroseconds = 0;
+	uint64_t bandwidthWindowBytes = 0;
+};
@@ -0,0 +1,176 @@
+#include "pch.h"
+#include "ImagePool.h"
+#include <malloc.h>
+
+ImagePool &ImagePool::GetShared()
+{
+	static ImagePool pool;
+	return pool;
+}
+
+ImagePool::~ImagePool()
+{
+	// Buffers still held by the sdk or by images are left alone
+	for (auto &pair : freeLists)
+	{
+		for (auto buffer : pair.second)
+		{
+			_aligned_free(buffer);
+		}
+	}
+}
+
+bool ImagePool::TryInstallSdkAllocator()
+{
+	std::lock_guard<std::mutex> lock(poolMutex);
+	if (sdkAllocatorInstalled)
+	{
+		return true;
+	}
+
+	if (K4A_RESULT_SUCCEEDED != k4a_set_allocator(&ImagePool::SdkAllocate, &ImagePool::SdkFree))
+	{
+		OutputDebugString(L"Failed to install pooled allocator, sdk already has allocations outstanding");
+		return false;
+	}
+
+	sdkAllocatorInstalled = true;
+	return true;
+}
+
+size_t ImagePool::GetSizeClass(size_t size)
+{
+	// Small buffers share 64 byte classes, frames round up to whole pages. Every frame of a given
+	// mode has the same size, so page granularity wastes little and keeps the class count low.
+	const size_t granularity = size < 16384 ? Alignment : 4096;
+	return (size + granularity - 1) / granularity * granularity;
+}
+
+byte *ImagePool::Acquire(size_t size, size_t &sizeClass)
+{
+	sizeClass = GetSizeClass(max(size, static_cast<size_t>(1)));
+
+	std::unique_lock<std::mutex> lock(poolMutex);
+	stats.acquireCount++;
+	stats.outstandingCount++;
+	stats.outstandingBytes += sizeClass;
+
+	auto &freeList = freeLists[sizeClass];
+	if (!freeList.empty())
+	{
+		byte *buffer = freeList.back();
+		freeList.pop_back();
+		stats.pooledBytes -= sizeClass;
+		return buffer;
+	}
+
+	stats.heapAllocationCount++;
+	stats.heapAllocatedBytes += sizeClass;
+	lock.unlock();
+
+	byte *buffer = static_cast<byte*>(_aligned_malloc(sizeClass, Alignment));
+	if (buffer == nullptr)
+	{
+		lock.lock();
+		stats.outstandingCount--;
+		stats.outstandingBytes -= sizeClass;
+	}
+
+	return buffer;
+}
+
+void ImagePool::Release(byte *buffer, size_t sizeClass)
+{
+	if (buffer == nullptr)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(poolMutex);
+	freeLists[sizeClass].push_back(buffer);
+	stats.outstandingCount--;
+	stats.outstandingBytes -= sizeClass;
+	stats.pooledBytes += sizeClass;
+}
+
+bool ImagePool::TryCreateImage(
+	k4a_image_format_t format,
+	int width,
+	int height,
+	int stride,
+	k4a_image_t *image)
+{
+	size_t size = static_cast<size_t>(stride) * height;
+	size_t sizeClass = 0;
+	byte *buffer = Acquire(size, sizeClass);
+	if (buffer == nullptr)
+	{
+		return false;
+	}
+
+	// The size class rides along as the release context
+	if (K4A_RESULT_SUCCEEDED != k4a_image_create_from_buffer(
+		format,
+		width,
+		height,
+		stride,
+		buffer,
+		size,
+		&ImagePool::ImageRelease,
+		reinterpret_cast<void*>(sizeClass),
+		image))
+	{
+		Release(buffer, sizeClass);
+		return false;
+	}
+
+	return true;
+}
+
+uint64_t ImagePool::Trim()
+{
+	std::vector<byte*> buffers;
+	uint64_t trimmedBytes = 0;
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		for (auto &pair : freeLists)
+		{
+			buffers.insert(buffers.end(), pair.second.begin(), pair.second.end());
+		}
+
+		freeLists.clear();
+		trimmedBytes = stats.pooledBytes;
+		stats.pooledBytes = 0;
+	}
+
+	for (auto buffer : buffers)
+	{
+		_aligned_free(buffer);
+	}
+
+	return trimmedBytes;
+}
+
+ImagePool::Stats ImagePool::GetStats()
+{
+	std::lock_guard<std::mutex> lock(poolMutex);
+	return stats;
+}
+
+uint8_t *ImagePool::SdkAllocate(int size, void **context)
+{
+	size_t sizeClass = 0;
+	byte *buffer = GetShared().Acquire(static_cast<size_t>(max(size, 0)), sizeClass);
+	*context = reinterpret_cast<void*>(sizeClass);
+	return buffer;
+}
+
+void ImagePool::SdkFree(void *buffer, void *context)
+{
+	GetShared().Release(static_cast<byte*>(buffer), reinterpret_cast<size_t>(context));
+}
+
+void ImagePool::ImageRelease(void *buffer, void *context)
+{
+	GetShared().Release(static_cast<byte*>(buffer), reinterpret_cast<size_t>(context));
+}
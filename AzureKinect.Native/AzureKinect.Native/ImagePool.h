@@ -0,0 +1,54 @@
+#pragma once
+
+// Recycles 64 byte aligned image buffers by size class. Backs the sdk's own allocations through
+// k4a_set_allocator and the plugin's intermediate images through k4a_image_create_from_buffer, so
+// once every size in use has been seen the steady state no longer reaches the heap.
+class ImagePool
+{
+public:
+	struct Stats
+	{
+		uint64_t acquireCount;
+		uint64_t heapAllocationCount;
+		uint64_t heapAllocatedBytes;
+		uint64_t outstandingCount;
+		uint64_t outstandingBytes;
+		uint64_t pooledBytes;
+	};
+
+	static const size_t Alignment = 64;
+
+	static ImagePool &GetShared();
+
+	~ImagePool();
+
+	// Has to happen before the sdk makes its first allocation, later calls are ignored
+	bool TryInstallSdkAllocator();
+
+	byte *Acquire(size_t size, size_t &sizeClass);
+	void Release(byte *buffer, size_t sizeClass);
+
+	// Pooled replacement for k4a_image_create, the buffer returns to the pool with the image
+	bool TryCreateImage(
+		k4a_image_format_t format,
+		int width,
+		int height,
+		int stride,
+		k4a_image_t *image);
+
+	// Frees every pooled buffer, buffers still out are untouched. Returns the bytes handed back to the heap.
+	uint64_t Trim();
+
+	Stats GetStats();
+
+private:
+	static size_t GetSizeClass(size_t size);
+	static uint8_t *SdkAllocate(int size, void **context);
+	static void SdkFree(void *buffer, void *context);
+	static void ImageRelease(void *buffer, void *context);
+
+	std::mutex poolMutex;
+	std::unordered_map<size_t, std::vector<byte*>> freeLists;
+	bool sdkAllocatorInstalled = false;
+	Stats stats = {};
+};
@@ -0,0 +1,110 @@
+#include "pch.h"
+#include "ImuStream.h"
+
+ImuStream::ImuStream(k4a_device_t device) :
+	running(false),
+	writeSequence(0)
+{
+	this->device = device;
+}
+
+ImuStream::~ImuStream()
+{
+	Stop();
+}
+
+bool ImuStream::TryStart()
+{
+	if (readerThread.joinable())
+	{
+		if (running.load())
+		{
+			return true;
+		}
+
+		// The reader stopped itself after a failure, clean it up before restarting
+		Stop();
+	}
+
+	if (K4A_RESULT_SUCCEEDED != k4a_device_start_imu(device))
+	{
+		OutputDebugString(L"Failed to start imu");
+		return false;
+	}
+
+	running.store(true);
+	readerThread = std::thread(&ImuStream::ReaderLoop, this);
+	return true;
+}
+
+void ImuStream::Stop()
+{
+	running.store(false);
+	if (readerThread.joinable())
+	{
+		readerThread.join();
+		k4a_device_stop_imu(device);
+	}
+}
+
+int ImuStream::ReadSince(
+	uint64_t cursor,
+	k4a_imu_sample_t *samples,
+	int capacity,
+	uint64_t &nextCursor)
+{
+	uint64_t end = writeSequence.load(std::memory_order_acquire);
+	uint64_t begin = max(cursor, end > Capacity ? end - Capacity : 0);
+	if (begin >= end || capacity <= 0)
+	{
+		nextCursor = max(cursor, end);
+		return 0;
+	}
+
+	// Oldest samples first, the caller picks up the rest with the returned cursor
+	end = min(end, begin + static_cast<uint64_t>(capacity));
+	for (uint64_t sequence = begin; sequence < end; sequence++)
+	{
+		samples[sequence - begin] = ring[sequence & CapacityMask];
+	}
+
+	// The producer may have lapped the oldest slots while they were being copied. The slot it is
+	// currently writing is one past the last published sequence, so stay one further back.
+	std::atomic_thread_fence(std::memory_order_acquire);
+	uint64_t published = writeSequence.load(std::memory_order_relaxed);
+	uint64_t firstIntact = published + 1 > Capacity ? published + 1 - Capacity : 0;
+	int count = static_cast<int>(end - begin);
+	if (firstIntact > begin)
+	{
+		int lost = static_cast<int>(min(firstIntact, end) - begin);
+		memmove(samples, samples + lost, sizeof(k4a_imu_sample_t) * (count - lost));
+		count -= lost;
+	}
+
+	nextCursor = end;
+	return count;
+}
+
+void ImuStream::ReaderLoop()
+{
+	k4a_imu_sample_t sample;
+	while (running.load())
+	{
+		switch (k4a_device_get_imu_sample(device, &sample, 100))
+		{
+		case K4A_WAIT_RESULT_SUCCEEDED:
+		{
+			uint64_t sequence = writeSequence.load(std::memory_order_relaxed);
+			ring[sequence & CapacityMask] = sample;
+			writeSequence.store(sequence + 1, std::memory_order_release);
+		}
+		break;
+		case K4A_WAIT_RESULT_TIMEOUT:
+			break;
+		case K4A_WAIT_RESULT_FAILED:
+			OutputDebugString(L"Failed to read imu sample");
+			running.store(false);
+			break;
+		}
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+// Drains a device's IMU on a dedicated thread into a fixed ring of samples. The reader thread is the
+// only producer, and consumers never block it: each read copies everything published since the
+// caller's cursor and then discards whatever the producer overwrote while it was copying.
+class ImuStream
+{
+public:
+	ImuStream(k4a_device_t device);
+	~ImuStream();
+
+	bool TryStart();
+	void Stop();
+	int ReadSince(
+		uint64_t cursor,
+		k4a_imu_sample_t *samples,
+		int capacity,
+		uint64_t &nextCursor);
+
+	uint64_t GetSampleCount() const
+	{
+		return writeSequence.load();
+	}
+
+private:
+	// Roughly two and a half seconds of samples at 1.6 kHz
+	static const uint64_t Capacity = 4096;
+	static const uint64_t CapacityMask = Capacity - 1;
+
+	void ReaderLoop();
+
+	k4a_device_t device;
+	std::thread readerThread;
+	std::atomic<bool> running;
+	std::atomic<uint64_t> writeSequence;
+	k4a_imu_sample_t ring[Capacity];
+};
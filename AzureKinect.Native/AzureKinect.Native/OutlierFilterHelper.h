@@ -0,0 +1,255 @@
+#pragma once
+
+#include "k4a/k4a.h"
+#include <float.h>
+#include <math.h>
+#include "SimdHelper.h"
+#include "ThreadPool.h"
+
+// What the outlier filter hands downstream
+enum OutlierFilterMode
+{
+	// Depth is left alone, a mask with one byte per depth pixel marks the pixels that passed
+	OutlierFilterMask = 0,
+	// Rejected pixels are zeroed in the depth image before anything else reads it
+	OutlierFilterInPlace = 1
+};
+
+// Largest window side, windows are odd so they center on their pixel
+#define OUTLIER_MAX_WINDOW 31
+// Rows one task filters, each task first sums the rows above its first window center
+#define OUTLIER_BAND_ROWS 32
+// Per pixel lanes of the window sums: valid count, the point and its squared length, padded to three sse2 pairs
+#define OUTLIER_SUM_LANES 6
+
+static inline int outlier_band_count(int height)
+{
+	return (height + OUTLIER_BAND_ROWS - 1) / OUTLIER_BAND_ROWS;
+}
+
+// Doubles one band needs, its column sums padded for the widest window and the lanes of one row
+static inline size_t outlier_band_scratch_size(int width)
+{
+	return ((size_t)width + OUTLIER_MAX_WINDOW) * OUTLIER_SUM_LANES + (size_t)width * OUTLIER_SUM_LANES;
+}
+
+// Lanes of each pixel in a row, all zero for invalid depth or a nan ray so they add nothing to a sum
+static inline void outlier_row_lanes(const uint16_t *depth_row, const k4a_float2_t *xy_row, int width, double *lanes)
+{
+	for (int x = 0; x < width; x++, lanes += OUTLIER_SUM_LANES)
+	{
+		const uint16_t depth = depth_row[x];
+		const k4a_float2_t &xy = xy_row[x];
+		if (depth == 0 ||
+			isnan(xy.xy.x))
+		{
+			memset(lanes, 0, OUTLIER_SUM_LANES * sizeof(double));
+			continue;
+		}
+
+		const double z = depth;
+		const double px = xy.xy.x * z;
+		const double py = xy.xy.y * z;
+		lanes[0] = 1.0;
+		lanes[1] = px;
+		lanes[2] = py;
+		lanes[3] = z;
+		lanes[4] = px * px + py * py + z * z;
+		lanes[5] = 0.0;
+	}
+}
+
+// Adds a row's lanes to the column sums, or takes them away
+static inline void outlier_add_lanes(double *sums, const double *lanes, size_t count, bool subtract)
+{
+	size_t i = 0;
+
+#ifdef AZUREKINECT_SSE2
+	const __m128d sign = _mm_set1_pd(subtract ? -1.0 : 1.0);
+	for (; i + 2 <= count; i += 2)
+	{
+		_mm_storeu_pd(sums + i, _mm_add_pd(_mm_loadu_pd(sums + i), _mm_mul_pd(_mm_loadu_pd(lanes + i), sign)));
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		sums[i] += subtract ? -lanes[i] : lanes[i];
+	}
+}
+
+// Per pixel rms distance from its point to the valid points in the window around it, over its depth so near
+// and far surfaces compare alike. Unlike the mean distance, the rms one follows from window sums alone,
+// sum |q - p|^2 = sum |q|^2 - 2 p . sum q + n |p|^2. Column sums slide down each band and a running sum
+// across each row, so the cost per pixel does not grow with the window. Invalid pixels get -1 and pixels
+// without a valid neighbor FLT_MAX. band_sums takes the count, sum and sum of squares of each band's
+// finite ratios, scratch holds outlier_band_scratch_size doubles per band.
+static void outlier_distance_ratios(const uint16_t *depth_data,
+	const k4a_float2_t *xy_table_data,
+	int width,
+	int height,
+	int window_size,
+	double *scratch,
+	float *ratios,
+	double *band_sums)
+{
+	const int radius = window_size / 2;
+	const size_t row_lanes = (size_t)width * OUTLIER_SUM_LANES;
+	ThreadPool::GetShared().ParallelFor(outlier_band_count(height), [&](int band)
+	{
+		// Zero padded on both sides, so the running sum never checks the image edge
+		double *padded_columns = scratch + band * outlier_band_scratch_size(width);
+		double *columns = padded_columns + (radius + 1) * OUTLIER_SUM_LANES;
+		double *rows = padded_columns + ((size_t)width + OUTLIER_MAX_WINDOW) * OUTLIER_SUM_LANES;
+		memset(padded_columns, 0, ((size_t)width + 2 * radius + 1) * OUTLIER_SUM_LANES * sizeof(double));
+
+		const int y_begin = band * OUTLIER_BAND_ROWS;
+		const int y_end = min(y_begin + OUTLIER_BAND_ROWS, height);
+		for (int y = max(y_begin - radius, 0); y < min(y_begin + radius, height); y++)
+		{
+			outlier_row_lanes(depth_data + (size_t)y * width, xy_table_data + (size_t)y * width, width, rows);
+			outlier_add_lanes(columns, rows, row_lanes, false);
+		}
+
+		double count = 0.0, sum = 0.0, sum_squares = 0.0;
+		for (int y = y_begin; y < y_end; y++)
+		{
+			// The window of row y covers rows y - radius through y + radius
+			const int entering = y + radius;
+			const int leaving = y - radius - 1;
+			if (entering < height)
+			{
+				outlier_row_lanes(depth_data + (size_t)entering * width, xy_table_data + (size_t)entering * width, width, rows);
+				outlier_add_lanes(columns, rows, row_lanes, false);
+			}
+			if (y > y_begin &&
+				leaving >= 0)
+			{
+				outlier_row_lanes(depth_data + (size_t)leaving * width, xy_table_data + (size_t)leaving * width, width, rows);
+				outlier_add_lanes(columns, rows, row_lanes, true);
+			}
+
+			const uint16_t *depth_row = depth_data + (size_t)y * width;
+			const k4a_float2_t *xy_row = xy_table_data + (size_t)y * width;
+			float *ratio_row = ratios + (size_t)y * width;
+
+			alignas(16) double window[OUTLIER_SUM_LANES] = {};
+#ifdef AZUREKINECT_SSE2
+			__m128d window0 = _mm_setzero_pd(), window1 = _mm_setzero_pd(), window2 = _mm_setzero_pd();
+			for (int x = -radius; x < radius; x++)
+			{
+				const double *column = columns + x * OUTLIER_SUM_LANES;
+				window0 = _mm_add_pd(window0, _mm_loadu_pd(column));
+				window1 = _mm_add_pd(window1, _mm_loadu_pd(column + 2));
+				window2 = _mm_add_pd(window2, _mm_loadu_pd(column + 4));
+			}
+#else
+			for (int x = -radius; x < radius; x++)
+			{
+				for (int lane = 0; lane < OUTLIER_SUM_LANES; lane++)
+				{
+					window[lane] += columns[x * OUTLIER_SUM_LANES + lane];
+				}
+			}
+#endif
+
+			for (int x = 0; x < width; x++)
+			{
+				const double *column_in = columns + (x + radius) * OUTLIER_SUM_LANES;
+				const double *column_out = columns + (x - radius - 1) * OUTLIER_SUM_LANES;
+#ifdef AZUREKINECT_SSE2
+				window0 = _mm_add_pd(window0, _mm_sub_pd(_mm_loadu_pd(column_in), _mm_loadu_pd(column_out)));
+				window1 = _mm_add_pd(window1, _mm_sub_pd(_mm_loadu_pd(column_in + 2), _mm_loadu_pd(column_out + 2)));
+				window2 = _mm_add_pd(window2, _mm_sub_pd(_mm_loadu_pd(column_in + 4), _mm_loadu_pd(column_out + 4)));
+#else
+				for (int lane = 0; lane < OUTLIER_SUM_LANES; lane++)
+				{
+					window[lane] += column_in[lane] - column_out[lane];
+				}
+#endif
+
+				const uint16_t depth = depth_row[x];
+				const k4a_float2_t &xy = xy_row[x];
+				if (depth == 0 ||
+					isnan(xy.xy.x))
+				{
+					ratio_row[x] = -1.0f;
+					continue;
+				}
+
+#ifdef AZUREKINECT_SSE2
+				_mm_store_pd(window, window0);
+				_mm_store_pd(window + 2, window1);
+				_mm_store_pd(window + 4, window2);
+#endif
+				// The pixel itself is in the window at distance zero
+				const double neighbors = window[0] - 1.0;
+				if (neighbors < 0.5)
+				{
+					ratio_row[x] = FLT_MAX;
+					continue;
+				}
+
+				const double z = depth;
+				const double px = xy.xy.x * z;
+				const double py = xy.xy.y * z;
+				double squares = window[4] -
+					2.0 * (px * window[1] + py * window[2] + z * window[3]) +
+					window[0] * (px * px + py * py + z * z);
+				const double ratio = sqrt(max(squares, 0.0) / neighbors) / z;
+				ratio_row[x] = (float)ratio;
+				count += 1.0;
+				sum += ratio;
+				sum_squares += ratio * ratio;
+			}
+		}
+
+		band_sums[band * 3] = count;
+		band_sums[band * 3 + 1] = sum;
+		band_sums[band * 3 + 2] = sum_squares;
+	});
+}
+
+// Rejects valid pixels whose ratio is above the threshold, which includes those without a valid neighbor.
+// The mask gets 1 for kept pixels and 0 for invalid and rejected ones, depth has the rejected ones zeroed,
+// either can be null. Returns how many were rejected, kept_count how many valid pixels passed.
+static int reject_outliers(const float *ratios, int width, int height, float threshold, uint16_t *depth_data, uint8_t *mask, int *kept_count)
+{
+	const int band_count = outlier_band_count(height);
+	std::vector<int> band_counts(band_count * 2, 0);
+	ThreadPool::GetShared().ParallelFor(band_count, [&](int band)
+	{
+		const size_t begin = (size_t)band * OUTLIER_BAND_ROWS * width;
+		const size_t end = (size_t)min((band + 1) * OUTLIER_BAND_ROWS, height) * width;
+		int rejected = 0;
+		int kept = 0;
+		for (size_t i = begin; i < end; i++)
+		{
+			const float ratio = ratios[i];
+			const bool reject = ratio > threshold;
+			const bool keep = ratio >= 0.0f && !reject;
+			if (mask != nullptr)
+			{
+				mask[i] = keep ? 1 : 0;
+			}
+			if (reject &&
+				depth_data != nullptr)
+			{
+				depth_data[i] = 0;
+			}
+			rejected += reject ? 1 : 0;
+			kept += keep ? 1 : 0;
+		}
+		band_counts[band * 2] = rejected;
+		band_counts[band * 2 + 1] = kept;
+	});
+
+	int rejected = 0;
+	*kept_count = 0;
+	for (int band = 0; band < band_count; band++)
+	{
+		rejected += band_counts[band * 2];
+		*kept_count += band_counts[band * 2 + 1];
+	}
+	return rejected;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+// The headless tools build the cpu processing stages on other platforms as well. This stands in for
+// the parts of windows.h those stages use, nothing that touches d3d or the unity plugin is covered.
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+
+typedef unsigned char byte;
+
+// windows.h provides these as macros, templates keep the standard headers that follow intact
+template <typename A, typename B>
+inline typename std::common_type<A, B>::type min(A a, B b)
+{
+	return a < b ? a : b;
+}
+
+template <typename A, typename B>
+inline typename std::common_type<A, B>::type max(A a, B b)
+{
+	return a > b ? a : b;
+}
+
+// Critical sections are recursive, and so is this
+typedef std::recursive_mutex CRITICAL_SECTION;
+
+inline void InitializeCriticalSection(CRITICAL_SECTION *)
+{
+}
+
+inline void DeleteCriticalSection(CRITICAL_SECTION *)
+{
+}
+
+inline void EnterCriticalSection(CRITICAL_SECTION *criticalSection)
+{
+	criticalSection->lock();
+}
+
+inline void LeaveCriticalSection(CRITICAL_SECTION *criticalSection)
+{
+	criticalSection->unlock();
+}
+
+// Messages are ascii, they go to stderr instead of the debugger
+inline void OutputDebugString(const wchar_t *message)
+{
+	for (; *message != L'\0'; message++)
+	{
+		fputc(*message < 0x80 ? static_cast<char>(*message) : '?', stderr);
+	}
+	fputc('\n', stderr);
+}
+
+inline int fopen_s(FILE **file, const char *path, const char *mode)
+{
+	*file = fopen(path, mode);
+	return *file != nullptr ? 0 : errno;
+}
+
+inline void *_aligned_malloc(size_t size, size_t alignment)
+{
+	void *buffer = nullptr;
+	return posix_memalign(&buffer, alignment, size) == 0 ? buffer : nullptr;
+}
+
+inline void _aligned_free(void *buffer)
+{
+	free(buffer);
+}
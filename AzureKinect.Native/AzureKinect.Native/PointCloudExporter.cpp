@@ -0,0 +1,435 @@
+#include "pch.h"
+#include "PointCloudExporter.h"
+
+// Rows encoded by a single task
+static const int RowsPerChunk = 16;
+// Stream buffer for the output file, so the chunks reach the disk as a few large sequential writes
+static const size_t WriteBufferSize = 8 * 1024 * 1024;
+
+static int GetRecordSize(PointCloudFileFormat format, bool includeNormals)
+{
+	// ply: xyz floats, optional normal floats, rgb bytes. pcd: xyz floats, packed rgb, optional normal floats.
+	int size = format == PointCloudFileFormatPly ? 3 * sizeof(float) + 3 : 4 * sizeof(float);
+	return includeNormals ? size + 3 * sizeof(float) : size;
+}
+
+static bool TryGetPoint(const PointCloudExporter::Frame &frame, int x, int y, float *point)
+{
+	int i = y * frame.width + x;
+	uint16_t depth = frame.depthData[i];
+	const k4a_float2_t &xy = frame.xyTableData[i];
+	if (depth == 0 || isnan(xy.xy.x) || isnan(xy.xy.y))
+	{
+		return false;
+	}
+
+	point[0] = xy.xy.x * (float)depth;
+	point[1] = xy.xy.y * (float)depth;
+	point[2] = (float)depth;
+	return true;
+}
+
+// Cross product of the horizontal and vertical tangents on the organized grid, turned to face the camera.
+// Pixels without a valid neighbor in either direction get a zero normal.
+static void EstimateNormal(const PointCloudExporter::Frame &frame, int x, int y, const float *point, float *normal)
+{
+	float neighbor[3];
+	float horizontal[3];
+	float vertical[3];
+	normal[0] = normal[1] = normal[2] = 0.0f;
+
+	if (x + 1 < frame.width && TryGetPoint(frame, x + 1, y, neighbor))
+	{
+		for (int i = 0; i < 3; i++) horizontal[i] = neighbor[i] - point[i];
+	}
+	else if (x > 0 && TryGetPoint(frame, x - 1, y, neighbor))
+	{
+		for (int i = 0; i < 3; i++) horizontal[i] = point[i] - neighbor[i];
+	}
+	else
+	{
+		return;
+	}
+
+	if (y + 1 < frame.height && TryGetPoint(frame, x, y + 1, neighbor))
+	{
+		for (int i = 0; i < 3; i++) vertical[i] = neighbor[i] - point[i];
+	}
+	else if (y > 0 && TryGetPoint(frame, x, y - 1, neighbor))
+	{
+		for (int i = 0; i < 3; i++) vertical[i] = point[i] - neighbor[i];
+	}
+	else
+	{
+		return;
+	}
+
+	float nx = horizontal[1] * vertical[2] - horizontal[2] * vertical[1];
+	float ny = horizontal[2] * vertical[0] - horizontal[0] * vertical[2];
+	float nz = horizontal[0] * vertical[1] - horizontal[1] * vertical[0];
+	float length = sqrtf(nx * nx + ny * ny + nz * nz);
+	if (length <= 0.0f)
+	{
+		return;
+	}
+
+	// The camera sits at the origin, so a normal facing it points against the point's position
+	float scale = (nx * point[0] + ny * point[1] + nz * point[2]) > 0.0f ? -1.0f / length : 1.0f / length;
+	normal[0] = nx * scale;
+	normal[1] = ny * scale;
+	normal[2] = nz * scale;
+}
+
+static std::string BuildHeader(PointCloudFileFormat format, bool includeNormals, int pointCount)
+{
+	char line[128];
+	std::string header;
+	if (format == PointCloudFileFormatPly)
+	{
+		header += "ply\nformat binary_little_endian 1.0\ncomment units millimeters\n";
+		snprintf(line, sizeof(line), "element vertex %d\n", pointCount);
+		header += line;
+		header += "property float x\nproperty float y\nproperty float z\n";
+		if (includeNormals)
+		{
+			header += "property float nx\nproperty float ny\nproperty float nz\n";
+		}
+		header += "property uchar red\nproperty uchar green\nproperty uchar blue\nend_header\n";
+	}
+	else
+	{
+		// rgb is packed into the bits of a float, which is what pcl expects
+		header += "# .PCD v0.7 - Point Cloud Data file format\nVERSION 0.7\n";
+		header += includeNormals ?
+			"FIELDS x y z rgb normal_x normal_y normal_z\nSIZE 4 4 4 4 4 4 4\nTYPE F F F F F F F\nCOUNT 1 1 1 1 1 1 1\n" :
+			"FIELDS x y z rgb\nSIZE 4 4 4 4\nTYPE F F F F\nCOUNT 1 1 1 1\n";
+		snprintf(line, sizeof(line), "WIDTH %d\nHEIGHT 1\nVIEWPOINT 0 0 0 1 0 0 0\nPOINTS %d\nDATA binary\n", pointCount, pointCount);
+		header += line;
+	}
+	return header;
+}
+
+PointCloudExporter::PointCloudExporter()
+{
+	InitializeCriticalSection(&exporterCritSec);
+	stats = Stats{ 0, 0, 0, 0.0f, 0.0f, 0.0f };
+}
+
+PointCloudExporter::~PointCloudExporter()
+{
+	DeleteCriticalSection(&exporterCritSec);
+}
+
+bool PointCloudExporter::TryExport(
+	const Frame &frame,
+	const char *path,
+	PointCloudFileFormat format,
+	bool includeNormals,
+	int *pointCount)
+{
+	EnterCriticalSection(&exporterCritSec);
+	auto start = TimingHelper::GetTimestampMicroseconds();
+
+	EncodedFrame &encoded = encodedFrames[0];
+	Encode(frame, format, includeNormals, encoded);
+	float encodeMilliseconds = TimingHelper::GetElapsedMilliseconds(start);
+
+	auto writeStart = TimingHelper::GetTimestampMicroseconds();
+	bool result = TryWrite(encoded, path, format, includeNormals);
+	float writeMilliseconds = TimingHelper::GetElapsedMilliseconds(writeStart);
+	float totalMilliseconds = TimingHelper::GetElapsedMilliseconds(start);
+
+	uint64_t writtenBytes = static_cast<uint64_t>(encoded.pointCount) * GetRecordSize(format, includeNormals);
+	stats.frameCount = 1;
+	stats.pointCount = encoded.pointCount;
+	stats.writtenBytes = writtenBytes;
+	stats.encodeMilliseconds = encodeMilliseconds;
+	stats.writeMilliseconds = writeMilliseconds;
+	stats.megabytesPerSecond = totalMilliseconds > 0.0f ? (writtenBytes / 1048576.0f) / (totalMilliseconds / 1000.0f) : 0.0f;
+	*pointCount = encoded.pointCount;
+	LeaveCriticalSection(&exporterCritSec);
+
+	return result;
+}
+
+bool PointCloudExporter::TryConvertRecording(
+	const char *recordingPath,
+	const char *outputDirectory,
+	PointCloudFileFormat format,
+	bool includeNormals,
+	int *frameCount)
+{
+	k4a_playback_t playback = nullptr;
+	if (K4A_RESULT_SUCCEEDED != k4a_playback_open(recordingPath, &playback))
+	{
+		OutputDebugString(L"Failed to open recording");
+		return false;
+	}
+
+	k4a_calibration_t calibration;
+	if (K4A_RESULT_SUCCEEDED != k4a_playback_get_calibration(playback, &calibration) ||
+		K4A_RESULT_SUCCEEDED != k4a_playback_set_color_conversion(playback, K4A_IMAGE_FORMAT_COLOR_BGRA32))
+	{
+		OutputDebugString(L"Failed to read calibration from recording");
+		k4a_playback_close(playback);
+		return false;
+	}
+
+	int width = calibration.depth_camera_calibration.resolution_width;
+	int height = calibration.depth_camera_calibration.resolution_height;
+	k4a_transformation_t transformation = k4a_transformation_create(&calibration);
+
+	k4a_image_t xyTableImage = nullptr;
+	k4a_image_t transformedColorImage = nullptr;
+	ImagePool::GetShared().TryCreateImage(K4A_IMAGE_FORMAT_CUSTOM,
+		width,
+		height,
+		width * (int)sizeof(k4a_float2_t),
+		&xyTableImage);
+	ImagePool::GetShared().TryCreateImage(K4A_IMAGE_FORMAT_COLOR_BGRA32,
+		width,
+		height,
+		width * 4 * (int)sizeof(uint8_t),
+		&transformedColorImage);
+	create_xy_table(&calibration, xyTableImage);
+
+	std::string directory(outputDirectory);
+	if (!directory.empty() && directory.back() != '/' && directory.back() != '\\')
+	{
+		directory += '/';
+	}
+	const char *extension = format == PointCloudFileFormatPly ? "ply" : "pcd";
+
+	EnterCriticalSection(&exporterCritSec);
+	auto start = TimingHelper::GetTimestampMicroseconds();
+	Stats conversionStats = Stats{ 0, 0, 0, 0.0f, 0.0f, 0.0f };
+
+	// Frame n is written on its own thread while frame n + 1 is decoded and encoded into the other buffer
+	std::thread writerThread;
+	bool writeSucceeded = true;
+	float writeMilliseconds = 0.0f;
+	bool result = true;
+	int frameIndex = 0;
+
+	while (true)
+	{
+		k4a_capture_t capture = nullptr;
+		k4a_stream_result_t streamResult = k4a_playback_get_next_capture(playback, &capture);
+		if (streamResult == K4A_STREAM_RESULT_EOF)
+		{
+			break;
+		}
+
+		if (streamResult != K4A_STREAM_RESULT_SUCCEEDED)
+		{
+			OutputDebugString(L"Failed to read capture from recording");
+			result = false;
+			break;
+		}
+
+		k4a_image_t depthImage = k4a_capture_get_depth_image(capture);
+		if (depthImage == nullptr)
+		{
+			k4a_capture_release(capture);
+			continue;
+		}
+
+		k4a_image_t colorImage = k4a_capture_get_color_image(capture);
+		bool transformedColor = colorImage != nullptr &&
+			K4A_RESULT_SUCCEEDED == k4a_transformation_color_image_to_depth_camera(
+				transformation,
+				depthImage,
+				colorImage,
+				transformedColorImage);
+
+		Frame frame;
+		frame.depthData = reinterpret_cast<uint16_t*>(k4a_image_get_buffer(depthImage));
+		frame.xyTableData = reinterpret_cast<k4a_float2_t*>(k4a_image_get_buffer(xyTableImage));
+		frame.colorData = transformedColor ? k4a_image_get_buffer(transformedColorImage) : nullptr;
+		frame.width = width;
+		frame.height = height;
+
+		auto encodeStart = TimingHelper::GetTimestampMicroseconds();
+		EncodedFrame &encoded = encodedFrames[frameIndex % 2];
+		Encode(frame, format, includeNormals, encoded);
+		conversionStats.encodeMilliseconds += TimingHelper::GetElapsedMilliseconds(encodeStart);
+
+		if (colorImage != nullptr)
+		{
+			k4a_image_release(colorImage);
+		}
+		k4a_image_release(depthImage);
+		k4a_capture_release(capture);
+
+		if (writerThread.joinable())
+		{
+			writerThread.join();
+		}
+
+		if (!writeSucceeded)
+		{
+			result = false;
+			break;
+		}
+
+		char fileName[32];
+		snprintf(fileName, sizeof(fileName), "frame_%06d.%s", frameIndex, extension);
+		std::string path = directory + fileName;
+		conversionStats.frameCount++;
+		conversionStats.pointCount += encoded.pointCount;
+		conversionStats.writtenBytes += static_cast<uint64_t>(encoded.pointCount) * GetRecordSize(format, includeNormals);
+
+		writerThread = std::thread([this, &encoded, path, format, includeNormals, &writeSucceeded, &writeMilliseconds]()
+		{
+			auto writeStart = TimingHelper::GetTimestampMicroseconds();
+			writeSucceeded = TryWrite(encoded, path.c_str(), format, includeNormals);
+			writeMilliseconds += TimingHelper::GetElapsedMilliseconds(writeStart);
+		});
+		frameIndex++;
+	}
+
+	if (writerThread.joinable())
+	{
+		writerThread.join();
+	}
+	result = result && writeSucceeded;
+
+	float totalMilliseconds = TimingHelper::GetElapsedMilliseconds(start);
+	conversionStats.writeMilliseconds = writeMilliseconds;
+	conversionStats.megabytesPerSecond = totalMilliseconds > 0.0f ?
+		(conversionStats.writtenBytes / 1048576.0f) / (totalMilliseconds / 1000.0f) :
+		0.0f;
+	stats = conversionStats;
+	*frameCount = conversionStats.frameCount;
+	LeaveCriticalSection(&exporterCritSec);
+
+	k4a_image_release(transformedColorImage);
+	k4a_image_release(xyTableImage);
+	k4a_transformation_destroy(transformation);
+	k4a_playback_close(playback);
+	return result;
+}
+
+PointCloudExporter::Stats PointCloudExporter::GetStats()
+{
+	EnterCriticalSection(&exporterCritSec);
+	auto result = stats;
+	LeaveCriticalSection(&exporterCritSec);
+	return result;
+}
+
+void PointCloudExporter::Encode(const Frame &frame, PointCloudFileFormat format, bool includeNormals, EncodedFrame &encoded)
+{
+	const int recordSize = GetRecordSize(format, includeNormals);
+	const int chunkCount = (frame.height + RowsPerChunk - 1) / RowsPerChunk;
+
+	// Chunk buffers are sized for every pixel being valid and kept between frames
+	encoded.chunks.resize(chunkCount);
+	encoded.chunkPointCounts.resize(chunkCount);
+	ThreadPool::GetShared().ParallelFor(chunkCount, [&](int chunk)
+	{
+		int beginRow = chunk * RowsPerChunk;
+		int endRow = min(beginRow + RowsPerChunk, frame.height);
+		auto &bytes = encoded.chunks[chunk];
+		bytes.resize(static_cast<size_t>(endRow - beginRow) * frame.width * recordSize);
+
+		uint8_t *output = bytes.data();
+		int count = 0;
+		float point[3];
+		float normal[3];
+		for (int y = beginRow; y < endRow; y++)
+		{
+			for (int x = 0; x < frame.width; x++)
+			{
+				if (!TryGetPoint(frame, x, y, point))
+				{
+					continue;
+				}
+
+				uint8_t red = 255;
+				uint8_t green = 255;
+				uint8_t blue = 255;
+				if (frame.colorData != nullptr)
+				{
+					const uint8_t *bgra = frame.colorData + 4 * (static_cast<size_t>(y) * frame.width + x);
+					blue = bgra[0];
+					green = bgra[1];
+					red = bgra[2];
+				}
+
+				if (includeNormals)
+				{
+					EstimateNormal(frame, x, y, point, normal);
+				}
+
+				memcpy(output, point, sizeof(point));
+				output += sizeof(point);
+				if (format == PointCloudFileFormatPly)
+				{
+					if (includeNormals)
+					{
+						memcpy(output, normal, sizeof(normal));
+						output += sizeof(normal);
+					}
+					output[0] = red;
+					output[1] = green;
+					output[2] = blue;
+					output += 3;
+				}
+				else
+				{
+					uint32_t rgb = (static_cast<uint32_t>(red) << 16) | (static_cast<uint32_t>(green) << 8) | blue;
+					memcpy(output, &rgb, sizeof(rgb));
+					output += sizeof(rgb);
+					if (includeNormals)
+					{
+						memcpy(output, normal, sizeof(normal));
+						output += sizeof(normal);
+					}
+				}
+				count++;
+			}
+		}
+		encoded.chunkPointCounts[chunk] = count;
+	});
+
+	encoded.pointCount = 0;
+	encoded.recordSize = recordSize;
+	for (int chunk = 0; chunk < chunkCount; chunk++)
+	{
+		encoded.pointCount += encoded.chunkPointCounts[chunk];
+	}
+}
+
+bool PointCloudExporter::TryWrite(const EncodedFrame &encoded, const char *path, PointCloudFileFormat format, bool includeNormals)
+{
+	FILE *file = nullptr;
+	if (fopen_s(&file, path, "wb") != 0 || file == nullptr)
+	{
+		OutputDebugString(L"Failed to open point cloud file for writing");
+		return false;
+	}
+
+	if (writeBuffer.size() != WriteBufferSize)
+	{
+		writeBuffer.resize(WriteBufferSize);
+	}
+	setvbuf(file, writeBuffer.data(), _IOFBF, writeBuffer.size());
+
+	// The point count is known before anything is written, so the header goes out first and the file is never patched
+	const size_t recordSize = GetRecordSize(format, includeNormals);
+	std::string header = BuildHeader(format, includeNormals, encoded.pointCount);
+	bool result = fwrite(header.data(), 1, header.size(), file) == header.size();
+	for (size_t chunk = 0; result && chunk < encoded.chunkPointCounts.size(); chunk++)
+	{
+		size_t size = encoded.chunkPointCounts[chunk] * recordSize;
+		result = fwrite(encoded.chunks[chunk].data(), 1, size, file) == size;
+	}
+
+	result = fclose(file) == 0 && result;
+	if (!result)
+	{
+		OutputDebugString(L"Failed to write point cloud file");
+	}
+	return result;
+}
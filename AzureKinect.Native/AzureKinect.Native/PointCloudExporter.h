@@ -0,0 +1,75 @@
+#pragma once
+
+enum PointCloudFileFormat
+{
+	PointCloudFileFormatPly = 0,
+	PointCloudFileFormatPcd = 1
+};
+
+// Writes organized depth frames straight to disk as binary PLY or PCD with position, color and
+// optionally normals. Invalid pixels are skipped. Row blocks are encoded in parallel on the shared
+// thread pool into reusable chunk buffers, which then go out through one large buffered file stream.
+// Recordings are converted frame by frame, with the write of one frame overlapping the next encode.
+class PointCloudExporter
+{
+public:
+	// colorData is the BGRA color image registered to the depth camera and may be null.
+	// Positions are written in millimeters in the depth camera frame.
+	struct Frame
+	{
+		const uint16_t *depthData;
+		const k4a_float2_t *xyTableData;
+		const uint8_t *colorData;
+		int width;
+		int height;
+	};
+
+	// One frame's worth of encoded points, a chunk per row block
+	struct EncodedFrame
+	{
+		std::vector<std::vector<uint8_t>> chunks;
+		std::vector<int> chunkPointCounts;
+		int pointCount;
+		int recordSize;
+	};
+
+	struct Stats
+	{
+		int frameCount;
+		int pointCount;
+		uint64_t writtenBytes;
+		float encodeMilliseconds;
+		float writeMilliseconds;
+		float megabytesPerSecond;
+	};
+
+	PointCloudExporter();
+	~PointCloudExporter();
+
+	bool TryExport(
+		const Frame &frame,
+		const char *path,
+		PointCloudFileFormat format,
+		bool includeNormals,
+		int *pointCount);
+	bool TryConvertRecording(
+		const char *recordingPath,
+		const char *outputDirectory,
+		PointCloudFileFormat format,
+		bool includeNormals,
+		int *frameCount);
+	Stats GetStats();
+
+	// The two halves of an export for callers that run them as separate stages. Encoding only touches
+	// encoded, writing goes through this exporter's stream buffer, so one writer per exporter.
+	void Encode(const Frame &frame, PointCloudFileFormat format, bool includeNormals, EncodedFrame &encoded);
+	bool TryWrite(const EncodedFrame &encoded, const char *path, PointCloudFileFormat format, bool includeNormals);
+
+private:
+	// Two frames, so a recording can encode into one while the other is written
+	EncodedFrame encodedFrames[2];
+	std::vector<char> writeBuffer;
+
+	Stats stats;
+	CRITICAL_SECTION exporterCritSec;
+};
@@ -0,0 +1,252 @@
+#include "pch.h"
+#include "PointCloudFusion.h"
+
+// Pixels handled by a single transform or merge task
+static const int BlockSize = 16384;
+static const uint64_t EmptyVoxelKey = ~0ull;
+
+PointCloudFusion::PointCloudFusion()
+{
+	InitializeCriticalSection(&fusionCritSec);
+	voxelKeyCapacity = 0;
+	stats = Stats{ 0, 0, 0, 0.0f, 0.0f };
+}
+
+PointCloudFusion::~PointCloudFusion()
+{
+	DeleteCriticalSection(&fusionCritSec);
+}
+
+int PointCloudFusion::Fuse(
+	const std::vector<DeviceFrame> &frames,
+	float voxelSize,
+	float *positions,
+	uint32_t *colors,
+	int capacity)
+{
+	EnterCriticalSection(&fusionCritSec);
+	auto start = TimingHelper::GetTimestampMicroseconds();
+
+	// Every task covers one block of one device, so devices are processed concurrently
+	std::vector<std::pair<int, int>> blocks;
+	if (stagedPoints.size() < frames.size())
+	{
+		stagedPoints.resize(frames.size());
+	}
+
+	for (int device = 0; device < static_cast<int>(frames.size()); device++)
+	{
+		stagedPoints[device].resize(frames[device].pixelCount);
+		for (int begin = 0; begin < frames[device].pixelCount; begin += BlockSize)
+		{
+			blocks.push_back(std::make_pair(device, begin));
+		}
+	}
+
+	std::atomic<int> inputPointCount{ 0 };
+	ThreadPool::GetShared().ParallelFor(static_cast<int>(blocks.size()), [&](int block)
+	{
+		int device = blocks[block].first;
+		int begin = blocks[block].second;
+		int end = min(begin + BlockSize, frames[device].pixelCount);
+		FusedPoint *output = stagedPoints[device].data();
+		TransformBlock(frames[device], begin, end, output);
+
+		int validCount = 0;
+		for (int i = begin; i < end; i++)
+		{
+			validCount += isnan(output[i].x) ? 0 : 1;
+		}
+		inputPointCount.fetch_add(validCount);
+	});
+
+	stats.deviceCount = static_cast<int>(frames.size());
+	stats.inputPointCount = inputPointCount.load();
+	stats.transformMilliseconds = TimingHelper::GetElapsedMilliseconds(start);
+	start = TimingHelper::GetTimestampMicroseconds();
+
+	EnsureHashCapacity(static_cast<size_t>(stats.inputPointCount));
+	const size_t keyMask = voxelKeyCapacity - 1;
+	const int clearBlockCount = static_cast<int>((voxelKeyCapacity + BlockSize - 1) / BlockSize);
+	ThreadPool::GetShared().ParallelFor(clearBlockCount, [&](int block)
+	{
+		size_t end = min(static_cast<size_t>(block + 1) * BlockSize, voxelKeyCapacity);
+		for (size_t i = static_cast<size_t>(block) * BlockSize; i < end; i++)
+		{
+			voxelKeys[i].store(EmptyVoxelKey, std::memory_order_relaxed);
+		}
+	});
+
+	const float inverseVoxelSize = 1.0f / (voxelSize > 0.0f ? voxelSize : 1.0f);
+	std::atomic<int> outputCount{ 0 };
+	ThreadPool::GetShared().ParallelFor(static_cast<int>(blocks.size()), [&](int block)
+	{
+		int device = blocks[block].first;
+		int begin = blocks[block].second;
+		int end = min(begin + BlockSize, frames[device].pixelCount);
+		const FusedPoint *staged = stagedPoints[device].data();
+		uint64_t previousKey = EmptyVoxelKey;
+
+		for (int i = begin; i < end; i++)
+		{
+			const FusedPoint &point = staged[i];
+			if (isnan(point.x))
+			{
+				continue;
+			}
+
+			// 21 bits per axis covers +/- 1M voxels around the origin
+			uint64_t vx = static_cast<uint64_t>(static_cast<int64_t>(floorf(point.x * inverseVoxelSize)) + (1 << 20)) & 0x1FFFFF;
+			uint64_t vy = static_cast<uint64_t>(static_cast<int64_t>(floorf(point.y * inverseVoxelSize)) + (1 << 20)) & 0x1FFFFF;
+			uint64_t vz = static_cast<uint64_t>(static_cast<int64_t>(floorf(point.z * inverseVoxelSize)) + (1 << 20)) & 0x1FFFFF;
+			uint64_t key = vx | (vy << 21) | (vz << 42);
+
+			// Neighboring pixels usually share a voxel, skip the hash set for those
+			if (key == previousKey)
+			{
+				continue;
+			}
+			previousKey = key;
+
+			bool inserted = false;
+			size_t slot = static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & keyMask;
+			while (true)
+			{
+				uint64_t existing = voxelKeys[slot].load(std::memory_order_relaxed);
+				if (existing == key)
+				{
+					break;
+				}
+
+				if (existing == EmptyVoxelKey)
+				{
+					if (voxelKeys[slot].compare_exchange_strong(existing, key))
+					{
+						inserted = true;
+						break;
+					}
+
+					if (existing == key)
+					{
+						break;
+					}
+				}
+
+				slot = (slot + 1) & keyMask;
+			}
+
+			if (inserted)
+			{
+				int index = outputCount.fetch_add(1);
+				if (index < capacity)
+				{
+					positions[3 * index] = point.x;
+					positions[3 * index + 1] = point.y;
+					positions[3 * index + 2] = point.z;
+					colors[index] = point.color;
+				}
+			}
+		}
+	});
+
+	stats.fusedPointCount = outputCount.load();
+	stats.mergeMilliseconds = TimingHelper::GetElapsedMilliseconds(start);
+	int count = min(stats.fusedPointCount, capacity);
+	LeaveCriticalSection(&fusionCritSec);
+	return count;
+}
+
+PointCloudFusion::Stats PointCloudFusion::GetStats()
+{
+	EnterCriticalSection(&fusionCritSec);
+	Stats result = stats;
+	LeaveCriticalSection(&fusionCritSec);
+	return result;
+}
+
+void PointCloudFusion::TransformBlock(const DeviceFrame &frame, int begin, int end, FusedPoint *output)
+{
+	const float *m = frame.worldTransform;
+	const uint32_t *colorData = reinterpret_cast<const uint32_t*>(frame.colorData);
+	int i = begin;
+
+#ifdef AZUREKINECT_SSE2
+	const __m128 m00 = _mm_set1_ps(m[0]), m01 = _mm_set1_ps(m[1]), m02 = _mm_set1_ps(m[2]), m03 = _mm_set1_ps(m[3]);
+	const __m128 m10 = _mm_set1_ps(m[4]), m11 = _mm_set1_ps(m[5]), m12 = _mm_set1_ps(m[6]), m13 = _mm_set1_ps(m[7]);
+	const __m128 m20 = _mm_set1_ps(m[8]), m21 = _mm_set1_ps(m[9]), m22 = _mm_set1_ps(m[10]), m23 = _mm_set1_ps(m[11]);
+	const __m128 zero = _mm_setzero_ps();
+	alignas(16) float wx[4];
+	alignas(16) float wy[4];
+	alignas(16) float wz[4];
+
+	for (; i + 4 <= end; i += 4)
+	{
+		__m128i depth16 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(frame.depthData + i));
+		__m128 depth = _mm_cvtepi32_ps(_mm_unpacklo_epi16(depth16, _mm_setzero_si128()));
+
+		// De-interleave four k4a_float2_t table entries
+		__m128 xy01 = _mm_loadu_ps(&frame.xyTableData[i].xy.x);
+		__m128 xy23 = _mm_loadu_ps(&frame.xyTableData[i + 2].xy.x);
+		__m128 tableX = _mm_shuffle_ps(xy01, xy23, _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 tableY = _mm_shuffle_ps(xy01, xy23, _MM_SHUFFLE(3, 1, 3, 1));
+
+		__m128 px = _mm_mul_ps(tableX, depth);
+		__m128 py = _mm_mul_ps(tableY, depth);
+		int validMask = _mm_movemask_ps(_mm_and_ps(_mm_cmpneq_ps(depth, zero), _mm_cmpord_ps(tableX, tableY)));
+
+		_mm_store_ps(wx, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, px), _mm_mul_ps(m01, py)), _mm_add_ps(_mm_mul_ps(m02, depth), m03)));
+		_mm_store_ps(wy, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m10, px), _mm_mul_ps(m11, py)), _mm_add_ps(_mm_mul_ps(m12, depth), m13)));
+		_mm_store_ps(wz, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m20, px), _mm_mul_ps(m21, py)), _mm_add_ps(_mm_mul_ps(m22, depth), m23)));
+
+		for (int lane = 0; lane < 4; lane++)
+		{
+			FusedPoint &point = output[i + lane];
+			if (validMask & (1 << lane))
+			{
+				point.x = wx[lane];
+				point.y = wy[lane];
+				point.z = wz[lane];
+				point.color = colorData != nullptr ? colorData[i + lane] : 0xFFFFFFFF;
+			}
+			else
+			{
+				point.x = nanf("");
+			}
+		}
+	}
+#endif
+
+	for (; i < end; i++)
+	{
+		FusedPoint &point = output[i];
+		float depth = (float)frame.depthData[i];
+		if (frame.depthData[i] == 0 || isnan(frame.xyTableData[i].xy.x) || isnan(frame.xyTableData[i].xy.y))
+		{
+			point.x = nanf("");
+			continue;
+		}
+
+		float px = frame.xyTableData[i].xy.x * depth;
+		float py = frame.xyTableData[i].xy.y * depth;
+		point.x = m[0] * px + m[1] * py + m[2] * depth + m[3];
+		point.y = m[4] * px + m[5] * py + m[6] * depth + m[7];
+		point.z = m[8] * px + m[9] * py + m[10] * depth + m[11];
+		point.color = colorData != nullptr ? colorData[i] : 0xFFFFFFFF;
+	}
+}
+
+void PointCloudFusion::EnsureHashCapacity(size_t pointCount)
+{
+	// Keep the load factor at or below one half
+	size_t required = 1024;
+	while (required < 2 * pointCount)
+	{
+		required <<= 1;
+	}
+
+	if (required > voxelKeyCapacity)
+	{
+		voxelKeys.reset(new std::atomic<uint64_t>[required]);
+		voxelKeyCapacity = required;
+	}
+}
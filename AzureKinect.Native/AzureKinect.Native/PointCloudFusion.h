@@ -0,0 +1,58 @@
+#pragma once
+
+// Merges the point clouds of several devices into one buffer in a common world frame. Points are
+// transformed with SSE, spread over the shared thread pool by device and row block, and overlap is
+// removed by keeping the first point that lands in each voxel of a lock-free hash set.
+class PointCloudFusion
+{
+public:
+	// worldTransform is a row-major 4x4 that maps depth camera millimeters into the world frame,
+	// colorData is the BGRA color image registered to the depth camera and may be null.
+	struct DeviceFrame
+	{
+		const uint16_t *depthData;
+		const k4a_float2_t *xyTableData;
+		const uint8_t *colorData;
+		int pixelCount;
+		float worldTransform[16];
+	};
+
+	struct Stats
+	{
+		int deviceCount;
+		int inputPointCount;
+		int fusedPointCount;
+		float transformMilliseconds;
+		float mergeMilliseconds;
+	};
+
+	PointCloudFusion();
+	~PointCloudFusion();
+
+	int Fuse(
+		const std::vector<DeviceFrame> &frames,
+		float voxelSize,
+		float *positions,
+		uint32_t *colors,
+		int capacity);
+	Stats GetStats();
+
+private:
+	struct FusedPoint
+	{
+		float x;
+		float y;
+		float z;
+		uint32_t color;
+	};
+
+	void TransformBlock(const DeviceFrame &frame, int begin, int end, FusedPoint *output);
+	void EnsureHashCapacity(size_t pointCount);
+
+	std::vector<std::vector<FusedPoint>> stagedPoints;
+	std::unique_ptr<std::atomic<uint64_t>[]> voxelKeys;
+	size_t voxelKeyCapacity;
+
+	Stats stats;
+	CRITICAL_SECTION fusionCritSec;
+};
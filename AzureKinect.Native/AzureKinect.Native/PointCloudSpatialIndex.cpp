@@ -0,0 +1,499 @@
+#include "pch.h"
+#include "PointCloudSpatialIndex.h"
+
+// Upper bound on the number of grid cells, the cell size is grown to stay under it. The grid is
+// also kept at or below one cell per point so clearing and scanning it stays cheap per frame.
+static const double MaxCellCount = 1 << 20;
+static const double MinCellCount = 1 << 12;
+
+PointCloudSpatialIndex::PointCloudSpatialIndex(float cellSize, bool benchmark)
+{
+	InitializeCriticalSection(&indexCritSec);
+	this->requestedCellSize = cellSize > 0.0f ? cellSize : 20.0f;
+	this->cellSize = this->requestedCellSize;
+	this->benchmark = benchmark;
+	memset(boundsMin, 0, sizeof(boundsMin));
+	memset(dimensions, 0, sizeof(dimensions));
+	stats = Stats{ 0, 0, this->cellSize, 0.0f, 0.0f, 0.0f };
+}
+
+PointCloudSpatialIndex::~PointCloudSpatialIndex()
+{
+	DeleteCriticalSection(&indexCritSec);
+}
+
+void PointCloudSpatialIndex::Build(const uint16_t *depthData, const k4a_float2_t *xyTableData, int pixelCount)
+{
+	auto start = TimingHelper::GetTimestampMicroseconds();
+	EnterCriticalSection(&indexCritSec);
+
+	points.clear();
+	float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	boundsMin[0] = boundsMin[1] = boundsMin[2] = FLT_MAX;
+
+	for (int i = 0; i < pixelCount; i++)
+	{
+		if (depthData[i] == 0 || isnan(xyTableData[i].xy.x) || isnan(xyTableData[i].xy.y))
+		{
+			continue;
+		}
+
+		float depth = (float)depthData[i];
+		Point point{ xyTableData[i].xy.x * depth, xyTableData[i].xy.y * depth, depth, i };
+		points.push_back(point);
+
+		boundsMin[0] = min(boundsMin[0], point.x);
+		boundsMin[1] = min(boundsMin[1], point.y);
+		boundsMin[2] = min(boundsMin[2], point.z);
+		boundsMax[0] = max(boundsMax[0], point.x);
+		boundsMax[1] = max(boundsMax[1], point.y);
+		boundsMax[2] = max(boundsMax[2], point.z);
+	}
+
+	int pointCount = static_cast<int>(points.size());
+	if (pointCount == 0)
+	{
+		memset(dimensions, 0, sizeof(dimensions));
+		sortedPoints.clear();
+		cellStart.assign(1, 0);
+	}
+	else
+	{
+		cellSize = requestedCellSize;
+		double cellCount = 1.0;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			cellCount *= floor((boundsMax[axis] - boundsMin[axis]) / cellSize) + 1.0;
+		}
+
+		double cellLimit = min(MaxCellCount, max(MinCellCount, static_cast<double>(pointCount)));
+		if (cellCount > cellLimit)
+		{
+			// Grow the cells uniformly, with a little headroom for the floor() above
+			cellSize *= static_cast<float>(cbrt(cellCount / cellLimit)) * 1.01f;
+		}
+
+		int totalCells = 1;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			dimensions[axis] = static_cast<int>((boundsMax[axis] - boundsMin[axis]) / cellSize) + 1;
+			totalCells *= dimensions[axis];
+		}
+
+		// Counting sort of the points by cell
+		cellStart.assign(totalCells + 1, 0);
+		pointCells.resize(pointCount);
+		sortedPoints.resize(pointCount);
+		const float inverseCellSize = 1.0f / cellSize;
+		for (int i = 0; i < pointCount; i++)
+		{
+			// Points are inside the bounds, so truncation is enough here
+			int cell = GetCellIndex(
+				min(static_cast<int>((points[i].x - boundsMin[0]) * inverseCellSize), dimensions[0] - 1),
+				min(static_cast<int>((points[i].y - boundsMin[1]) * inverseCellSize), dimensions[1] - 1),
+				min(static_cast<int>((points[i].z - boundsMin[2]) * inverseCellSize), dimensions[2] - 1));
+			pointCells[i] = cell;
+			cellStart[cell + 1]++;
+		}
+
+		for (int cell = 0; cell < totalCells; cell++)
+		{
+			cellStart[cell + 1] += cellStart[cell];
+		}
+
+		cellCursor.assign(cellStart.begin(), cellStart.end() - 1);
+		for (int i = 0; i < pointCount; i++)
+		{
+			sortedPoints[cellCursor[pointCells[i]]++] = points[i];
+		}
+	}
+
+	stats.pointCount = pointCount;
+	stats.cellCount = dimensions[0] * dimensions[1] * dimensions[2];
+	stats.cellSize = cellSize;
+	stats.buildMilliseconds = TimingHelper::GetElapsedMilliseconds(start);
+	LeaveCriticalSection(&indexCritSec);
+}
+
+bool PointCloudSpatialIndex::TryRaycast(
+	const float *origin,
+	const float *direction,
+	float maxDistance,
+	float pickRadius,
+	float *hitPoint,
+	int &hitPixelIndex)
+{
+	float length = sqrtf(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+	if (length <= 0.0f)
+	{
+		return false;
+	}
+
+	const float dir[3] = { direction[0] / length, direction[1] / length, direction[2] / length };
+
+	EnterCriticalSection(&indexCritSec);
+	auto start = TimingHelper::GetTimestampMicroseconds();
+
+	if (pickRadius <= 0.0f)
+	{
+		pickRadius = 0.5f * cellSize;
+	}
+
+	int best = -1;
+	float bestT = FLT_MAX;
+	float tEnter = 0.0f;
+	float tExit = maxDistance;
+
+	// Clip the ray against the grid bounds, grown by the pick radius
+	for (int axis = 0; axis < 3 && !sortedPoints.empty(); axis++)
+	{
+		float low = boundsMin[axis] - pickRadius;
+		float high = boundsMin[axis] + dimensions[axis] * cellSize + pickRadius;
+		if (fabsf(dir[axis]) < 1e-12f)
+		{
+			if (origin[axis] < low || origin[axis] > high)
+			{
+				tExit = -1.0f;
+			}
+			continue;
+		}
+
+		float t0 = (low - origin[axis]) / dir[axis];
+		float t1 = (high - origin[axis]) / dir[axis];
+		tEnter = max(tEnter, min(t0, t1));
+		tExit = min(tExit, max(t0, t1));
+	}
+
+	if (!sortedPoints.empty() && tEnter <= tExit)
+	{
+		// Walk the grid with a 3D DDA, testing the neighborhood of every visited cell
+		int cell[3];
+		int step[3];
+		float tMax[3];
+		float tDelta[3];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			cell[axis] = ClampCell(origin[axis] + dir[axis] * tEnter, axis);
+			if (dir[axis] > 0.0f)
+			{
+				step[axis] = 1;
+				tMax[axis] = (boundsMin[axis] + (cell[axis] + 1) * cellSize - origin[axis]) / dir[axis];
+				tDelta[axis] = cellSize / dir[axis];
+			}
+			else if (dir[axis] < 0.0f)
+			{
+				step[axis] = -1;
+				tMax[axis] = (boundsMin[axis] + cell[axis] * cellSize - origin[axis]) / dir[axis];
+				tDelta[axis] = -cellSize / dir[axis];
+			}
+			else
+			{
+				step[axis] = 0;
+				tMax[axis] = FLT_MAX;
+				tDelta[axis] = FLT_MAX;
+			}
+		}
+
+		const int reach = static_cast<int>(ceilf(pickRadius / cellSize));
+		const float slack = (reach + 1) * cellSize * 1.7320508f;
+		const float radiusSquared = pickRadius * pickRadius;
+		float tCell = tEnter;
+
+		while (tCell <= tExit && (best < 0 || tCell - slack < bestT))
+		{
+			for (int z = max(cell[2] - reach, 0); z <= min(cell[2] + reach, dimensions[2] - 1); z++)
+			{
+				for (int y = max(cell[1] - reach, 0); y <= min(cell[1] + reach, dimensions[1] - 1); y++)
+				{
+					int rowStart = GetCellIndex(max(cell[0] - reach, 0), y, z);
+					int rowEnd = GetCellIndex(min(cell[0] + reach, dimensions[0] - 1), y, z);
+					for (int i = cellStart[rowStart]; i < cellStart[rowEnd + 1]; i++)
+					{
+						float v[3] = {
+							sortedPoints[i].x - origin[0],
+							sortedPoints[i].y - origin[1],
+							sortedPoints[i].z - origin[2] };
+						float t = v[0] * dir[0] + v[1] * dir[1] + v[2] * dir[2];
+						if (t < 0.0f || t > maxDistance || t >= bestT)
+						{
+							continue;
+						}
+
+						float distanceSquared = v[0] * v[0] + v[1] * v[1] + v[2] * v[2] - t * t;
+						if (distanceSquared <= radiusSquared)
+						{
+							bestT = t;
+							best = i;
+						}
+					}
+				}
+			}
+
+			int axis = (tMax[0] < tMax[1]) ? ((tMax[0] < tMax[2]) ? 0 : 2) : ((tMax[1] < tMax[2]) ? 1 : 2);
+			tCell = tMax[axis];
+			cell[axis] += step[axis];
+			if (step[axis] == 0 || cell[axis] < 0 || cell[axis] >= dimensions[axis])
+			{
+				break;
+			}
+			tMax[axis] += tDelta[axis];
+		}
+	}
+
+	if (best >= 0)
+	{
+		hitPoint[0] = sortedPoints[best].x;
+		hitPoint[1] = sortedPoints[best].y;
+		hitPoint[2] = sortedPoints[best].z;
+		hitPixelIndex = sortedPoints[best].pixelIndex;
+	}
+
+	stats.queryMilliseconds = TimingHelper::GetElapsedMilliseconds(start);
+	if (benchmark)
+	{
+		float bruteForceT;
+		int bruteForceHit;
+		start = TimingHelper::GetTimestampMicroseconds();
+		RaycastBruteForce(origin, dir, maxDistance, pickRadius, bruteForceT, bruteForceHit);
+		stats.bruteForceMilliseconds = TimingHelper::GetElapsedMilliseconds(start);
+	}
+
+	LeaveCriticalSection(&indexCritSec);
+	return best >= 0;
+}
+
+int PointCloudSpatialIndex::FindNearest(
+	const float *point,
+	int k,
+	int *pixelIndices,
+	float *distances)
+{
+	if (k <= 0)
+	{
+		return 0;
+	}
+
+	EnterCriticalSection(&indexCritSec);
+	auto start = TimingHelper::GetTimestampMicroseconds();
+	nearestHeap.clear();
+
+	if (!sortedPoints.empty())
+	{
+		int center[3] = { ClampCell(point[0], 0), ClampCell(point[1], 1), ClampCell(point[2], 2) };
+		int maxRing = max(dimensions[0], max(dimensions[1], dimensions[2]));
+
+		// Search shells of cells at increasing Chebyshev distance until the k-th neighbor is closer
+		// than anything outside of the searched block could be
+		for (int ring = 0; ring <= maxRing; ring++)
+		{
+			for (int z = max(center[2] - ring, 0); z <= min(center[2] + ring, dimensions[2] - 1); z++)
+			{
+				for (int y = max(center[1] - ring, 0); y <= min(center[1] + ring, dimensions[1] - 1); y++)
+				{
+					bool onShell = abs(z - center[2]) == ring || abs(y - center[1]) == ring;
+					int xStep = onShell ? 1 : max(2 * ring, 1);
+					for (int x = center[0] - ring; x <= center[0] + ring; x += xStep)
+					{
+						if (x < 0 || x >= dimensions[0])
+						{
+							continue;
+						}
+
+						int cell = GetCellIndex(x, y, z);
+						for (int i = cellStart[cell]; i < cellStart[cell + 1]; i++)
+						{
+							float dx = sortedPoints[i].x - point[0];
+							float dy = sortedPoints[i].y - point[1];
+							float dz = sortedPoints[i].z - point[2];
+							float distanceSquared = dx * dx + dy * dy + dz * dz;
+							if (static_cast<int>(nearestHeap.size()) < k)
+							{
+								nearestHeap.push_back(std::make_pair(distanceSquared, i));
+								std::push_heap(nearestHeap.begin(), nearestHeap.end());
+							}
+							else if (distanceSquared < nearestHeap.front().first)
+							{
+								std::pop_heap(nearestHeap.begin(), nearestHeap.end());
+								nearestHeap.back() = std::make_pair(distanceSquared, i);
+								std::push_heap(nearestHeap.begin(), nearestHeap.end());
+							}
+						}
+					}
+				}
+			}
+
+			bool coversGrid = true;
+			float bound = FLT_MAX;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				coversGrid &= center[axis] - ring <= 0 && center[axis] + ring >= dimensions[axis] - 1;
+				float low = boundsMin[axis] + (center[axis] - ring) * cellSize;
+				float high = boundsMin[axis] + (center[axis] + ring + 1) * cellSize;
+				bound = min(bound, min(point[axis] - low, high - point[axis]));
+			}
+
+			if (coversGrid ||
+				(static_cast<int>(nearestHeap.size()) == k && bound > 0.0f && bound * bound >= nearestHeap.front().first))
+			{
+				break;
+			}
+		}
+	}
+
+	std::sort_heap(nearestHeap.begin(), nearestHeap.end());
+	int count = static_cast<int>(nearestHeap.size());
+	for (int i = 0; i < count; i++)
+	{
+		pixelIndices[i] = sortedPoints[nearestHeap[i].second].pixelIndex;
+		distances[i] = sqrtf(nearestHeap[i].first);
+	}
+
+	stats.queryMilliseconds = TimingHelper::GetElapsedMilliseconds(start);
+	if (benchmark)
+	{
+		start = TimingHelper::GetTimestampMicroseconds();
+		FindNearestBruteForce(point, k);
+		stats.bruteForceMilliseconds = TimingHelper::GetElapsedMilliseconds(start);
+	}
+
+	LeaveCriticalSection(&indexCritSec);
+	return count;
+}
+
+int PointCloudSpatialIndex::FindInRadius(
+	const float *point,
+	float radius,
+	int *pixelIndices,
+	int capacity)
+{
+	EnterCriticalSection(&indexCritSec);
+	auto start = TimingHelper::GetTimestampMicroseconds();
+
+	int count = 0;
+	const float radiusSquared = radius * radius;
+	if (!sortedPoints.empty() && radius > 0.0f)
+	{
+		int low[3];
+		int high[3];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			low[axis] = ClampCell(point[axis] - radius, axis);
+			high[axis] = ClampCell(point[axis] + radius, axis);
+		}
+
+		for (int z = low[2]; z <= high[2] && count < capacity; z++)
+		{
+			for (int y = low[1]; y <= high[1] && count < capacity; y++)
+			{
+				int rowStart = GetCellIndex(low[0], y, z);
+				int rowEnd = GetCellIndex(high[0], y, z);
+				for (int i = cellStart[rowStart]; i < cellStart[rowEnd + 1] && count < capacity; i++)
+				{
+					float dx = sortedPoints[i].x - point[0];
+					float dy = sortedPoints[i].y - point[1];
+					float dz = sortedPoints[i].z - point[2];
+					if (dx * dx + dy * dy + dz * dz <= radiusSquared)
+					{
+						pixelIndices[count++] = sortedPoints[i].pixelIndex;
+					}
+				}
+			}
+		}
+	}
+
+	stats.queryMilliseconds = TimingHelper::GetElapsedMilliseconds(start);
+	if (benchmark)
+	{
+		start = TimingHelper::GetTimestampMicroseconds();
+		FindInRadiusBruteForce(point, radius);
+		stats.bruteForceMilliseconds = TimingHelper::GetElapsedMilliseconds(start);
+	}
+
+	LeaveCriticalSection(&indexCritSec);
+	return count;
+}
+
+PointCloudSpatialIndex::Stats PointCloudSpatialIndex::GetStats()
+{
+	EnterCriticalSection(&indexCritSec);
+	Stats result = stats;
+	LeaveCriticalSection(&indexCritSec);
+	return result;
+}
+
+int PointCloudSpatialIndex::ClampCell(float value, int axis) const
+{
+	int cell = static_cast<int>(floorf((value - boundsMin[axis]) / cellSize));
+	return max(0, min(cell, dimensions[axis] - 1));
+}
+
+bool PointCloudSpatialIndex::RaycastBruteForce(
+	const float *origin,
+	const float *direction,
+	float maxDistance,
+	float pickRadius,
+	float &hitT,
+	int &hitPoint)
+{
+	hitT = FLT_MAX;
+	hitPoint = -1;
+	const float radiusSquared = pickRadius * pickRadius;
+	for (int i = 0; i < static_cast<int>(points.size()); i++)
+	{
+		float v[3] = { points[i].x - origin[0], points[i].y - origin[1], points[i].z - origin[2] };
+		float t = v[0] * direction[0] + v[1] * direction[1] + v[2] * direction[2];
+		if (t < 0.0f || t > maxDistance || t >= hitT)
+		{
+			continue;
+		}
+
+		if (v[0] * v[0] + v[1] * v[1] + v[2] * v[2] - t * t <= radiusSquared)
+		{
+			hitT = t;
+			hitPoint = i;
+		}
+	}
+
+	return hitPoint >= 0;
+}
+
+void PointCloudSpatialIndex::FindNearestBruteForce(const float *point, int k)
+{
+	nearestHeap.clear();
+	for (int i = 0; i < static_cast<int>(points.size()); i++)
+	{
+		float dx = points[i].x - point[0];
+		float dy = points[i].y - point[1];
+		float dz = points[i].z - point[2];
+		float distanceSquared = dx * dx + dy * dy + dz * dz;
+		if (static_cast<int>(nearestHeap.size()) < k)
+		{
+			nearestHeap.push_back(std::make_pair(distanceSquared, i));
+			std::push_heap(nearestHeap.begin(), nearestHeap.end());
+		}
+		else if (distanceSquared < nearestHeap.front().first)
+		{
+			std::pop_heap(nearestHeap.begin(), nearestHeap.end());
+			nearestHeap.back() = std::make_pair(distanceSquared, i);
+			std::push_heap(nearestHeap.begin(), nearestHeap.end());
+		}
+	}
+}
+
+int PointCloudSpatialIndex::FindInRadiusBruteForce(const float *point, float radius)
+{
+	int count = 0;
+	const float radiusSquared = radius * radius;
+	for (int i = 0; i < static_cast<int>(points.size()); i++)
+	{
+		float dx = points[i].x - point[0];
+		float dy = points[i].y - point[1];
+		float dz = points[i].z - point[2];
+		if (dx * dx + dy * dy + dz * dz <= radiusSquared)
+		{
+			count++;
+		}
+	}
+
+	return count;
+}
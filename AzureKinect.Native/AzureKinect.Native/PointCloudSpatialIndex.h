@@ -0,0 +1,82 @@
+#pragma once
+
+// Uniform grid over the depth camera point cloud. Points are in millimeters in depth camera space,
+// matching generate_point_cloud. The grid is rebuilt every frame with a counting sort that reuses
+// its allocations, so steady state building does not touch the heap.
+class PointCloudSpatialIndex
+{
+public:
+	struct Stats
+	{
+		int pointCount;
+		int cellCount;
+		float cellSize;
+		float buildMilliseconds;
+		float queryMilliseconds;
+		float bruteForceMilliseconds;
+	};
+
+	PointCloudSpatialIndex(float cellSize, bool benchmark);
+	~PointCloudSpatialIndex();
+
+	void Build(const uint16_t *depthData, const k4a_float2_t *xyTableData, int pixelCount);
+	bool TryRaycast(
+		const float *origin,
+		const float *direction,
+		float maxDistance,
+		float pickRadius,
+		float *hitPoint,
+		int &hitPixelIndex);
+	int FindNearest(
+		const float *point,
+		int k,
+		int *pixelIndices,
+		float *distances);
+	int FindInRadius(
+		const float *point,
+		float radius,
+		int *pixelIndices,
+		int capacity);
+	Stats GetStats();
+
+private:
+	struct Point
+	{
+		float x;
+		float y;
+		float z;
+		int pixelIndex;
+	};
+
+	int GetCellIndex(int x, int y, int z) const
+	{
+		return (z * dimensions[1] + y) * dimensions[0] + x;
+	}
+
+	int ClampCell(float value, int axis) const;
+	bool RaycastBruteForce(
+		const float *origin,
+		const float *direction,
+		float maxDistance,
+		float pickRadius,
+		float &hitT,
+		int &hitPoint);
+	void FindNearestBruteForce(const float *point, int k);
+	int FindInRadiusBruteForce(const float *point, float radius);
+
+	float requestedCellSize;
+	float cellSize;
+	bool benchmark;
+	float boundsMin[3];
+	int dimensions[3];
+
+	std::vector<Point> points;
+	std::vector<Point> sortedPoints;
+	std::vector<int> pointCells;
+	std::vector<int> cellStart;
+	std::vector<int> cellCursor;
+	std::vector<std::pair<float, int>> nearestHeap;
+
+	Stats stats;
+	CRITICAL_SECTION indexCritSec;
+};
@@ -0,0 +1,161 @@
+#pragma once
+
+enum PyramidDepthFilter
+{
+	// Nearest valid depth of each 2x2 block, keeps thin foreground objects
+	PyramidDepthFilterMin = 0,
+	// Lower median of the valid depths of each 2x2 block, rejects flying pixels on edges
+	PyramidDepthFilterMedian = 1
+};
+
+// Zero depth is invalid and never mixed into a result. Samples are stored as (depth - 1) with the sign bit
+// flipped, so zero becomes the largest value, sorts last and unsigned order maps onto signed 16 bit order.
+static inline int16_t bias_depth(uint16_t depth)
+{
+	return (int16_t)((uint16_t)(depth - 1) ^ 0x8000);
+}
+
+static inline uint16_t unbias_depth(int16_t value)
+{
+	return (uint16_t)(((uint16_t)value ^ 0x8000) + 1);
+}
+
+static inline uint16_t downsample_depth_block(uint16_t d0, uint16_t d1, uint16_t d2, uint16_t d3, PyramidDepthFilter filter)
+{
+	int16_t s[4] = { bias_depth(d0), bias_depth(d1), bias_depth(d2), bias_depth(d3) };
+	if (filter == PyramidDepthFilterMin)
+	{
+		return unbias_depth(min(min(s[0], s[1]), min(s[2], s[3])));
+	}
+
+	// Sorted, invalid samples end up at the top. With three or more valid the lower median is s[1].
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < 3 - i; j++)
+		{
+			if (s[j] > s[j + 1])
+			{
+				int16_t t = s[j];
+				s[j] = s[j + 1];
+				s[j + 1] = t;
+			}
+		}
+	}
+
+	return unbias_depth(s[2] != INT16_MAX ? s[1] : s[0]);
+}
+
+#ifdef AZUREKINECT_SSE2
+// Splits 8 biased samples into the even and odd columns, each widened to 32 bits with sign extension
+static inline __m128i even_samples(__m128i v)
+{
+	return _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+}
+
+static inline __m128i odd_samples(__m128i v)
+{
+	return _mm_srai_epi32(v, 16);
+}
+#endif
+
+// Halves a depth image, dst_width and dst_height are the source dimensions divided by two rounded down
+static void downsample_depth_2x(const uint16_t *src, int src_width, int src_height, uint16_t *dst, PyramidDepthFilter filter)
+{
+	const int dst_width = src_width / 2;
+	const int dst_height = src_height / 2;
+
+	for (int y = 0; y < dst_height; y++)
+	{
+		const uint16_t *row0 = src + (size_t)(2 * y) * src_width;
+		const uint16_t *row1 = row0 + src_width;
+		uint16_t *out = dst + (size_t)y * dst_width;
+		int x = 0;
+
+#ifdef AZUREKINECT_SSE2
+		const __m128i one = _mm_set1_epi16(1);
+		const __m128i sign = _mm_set1_epi16((short)0x8000);
+		const __m128i invalid = _mm_set1_epi16(INT16_MAX);
+		for (; x + 8 <= dst_width; x += 8)
+		{
+			__m128i a0 = _mm_xor_si128(_mm_sub_epi16(_mm_loadu_si128((const __m128i*)(row0 + 2 * x)), one), sign);
+			__m128i a1 = _mm_xor_si128(_mm_sub_epi16(_mm_loadu_si128((const __m128i*)(row0 + 2 * x + 8)), one), sign);
+			__m128i b0 = _mm_xor_si128(_mm_sub_epi16(_mm_loadu_si128((const __m128i*)(row1 + 2 * x)), one), sign);
+			__m128i b1 = _mm_xor_si128(_mm_sub_epi16(_mm_loadu_si128((const __m128i*)(row1 + 2 * x + 8)), one), sign);
+
+			// The four samples of eight output pixels, one vector each
+			__m128i s0 = _mm_packs_epi32(even_samples(a0), even_samples(a1));
+			__m128i s1 = _mm_packs_epi32(odd_samples(a0), odd_samples(a1));
+			__m128i s2 = _mm_packs_epi32(even_samples(b0), even_samples(b1));
+			__m128i s3 = _mm_packs_epi32(odd_samples(b0), odd_samples(b1));
+
+			__m128i result;
+			if (filter == PyramidDepthFilterMin)
+			{
+				result = _mm_min_epi16(_mm_min_epi16(s0, s1), _mm_min_epi16(s2, s3));
+			}
+			else
+			{
+				// Five compare-exchanges sort four values
+				__m128i t;
+				t = _mm_min_epi16(s0, s1); s1 = _mm_max_epi16(s0, s1); s0 = t;
+				t = _mm_min_epi16(s2, s3); s3 = _mm_max_epi16(s2, s3); s2 = t;
+				t = _mm_min_epi16(s0, s2); s2 = _mm_max_epi16(s0, s2); s0 = t;
+				t = _mm_min_epi16(s1, s3); s3 = _mm_max_epi16(s1, s3); s1 = t;
+				t = _mm_min_epi16(s1, s2); s2 = _mm_max_epi16(s1, s2); s1 = t;
+
+				__m128i fewValid = _mm_cmpeq_epi16(s2, invalid);
+				result = _mm_or_si128(_mm_and_si128(fewValid, s0), _mm_andnot_si128(fewValid, s1));
+			}
+
+			result = _mm_add_epi16(_mm_xor_si128(result, sign), one);
+			_mm_storeu_si128((__m128i*)(out + x), result);
+		}
+#endif
+
+		for (; x < dst_width; x++)
+		{
+			out[x] = downsample_depth_block(row0[2 * x], row0[2 * x + 1], row1[2 * x], row1[2 * x + 1], filter);
+		}
+	}
+}
+
+// Halves a BGRA image with a 2x2 box filter
+static void downsample_bgra_2x(const uint8_t *src, int src_width, int src_height, uint8_t *dst)
+{
+	const int dst_width = src_width / 2;
+	const int dst_height = src_height / 2;
+
+	for (int y = 0; y < dst_height; y++)
+	{
+		const uint8_t *row0 = src + (size_t)(2 * y) * src_width * 4;
+		const uint8_t *row1 = row0 + (size_t)src_width * 4;
+		uint8_t *out = dst + (size_t)y * dst_width * 4;
+		int x = 0;
+
+#ifdef AZUREKINECT_SSE2
+		for (; x + 4 <= dst_width; x += 4)
+		{
+			// Vertical pairs first, then even and odd pixels are split out and averaged
+			__m128i v0 = _mm_avg_epu8(
+				_mm_loadu_si128((const __m128i*)(row0 + 8 * x)),
+				_mm_loadu_si128((const __m128i*)(row1 + 8 * x)));
+			__m128i v1 = _mm_avg_epu8(
+				_mm_loadu_si128((const __m128i*)(row0 + 8 * x + 16)),
+				_mm_loadu_si128((const __m128i*)(row1 + 8 * x + 16)));
+			__m128i even = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(v0), _mm_castsi128_ps(v1), _MM_SHUFFLE(2, 0, 2, 0)));
+			__m128i odd = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(v0), _mm_castsi128_ps(v1), _MM_SHUFFLE(3, 1, 3, 1)));
+			_mm_storeu_si128((__m128i*)(out + 4 * x), _mm_avg_epu8(even, odd));
+		}
+#endif
+
+		for (; x < dst_width; x++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				int left = (row0[8 * x + c] + row1[8 * x + c] + 1) >> 1;
+				int right = (row0[8 * x + 4 + c] + row1[8 * x + 4 + c] + 1) >> 1;
+				out[4 * x + c] = (uint8_t)((left + right + 1) >> 1);
+			}
+		}
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+struct PixelRect
+{
+	int x;
+	int y;
+	int width;
+	int height;
+};
+
+// Per device crop applied to the depth image before anything else touches the frame. The rect is in
+// depth pixels, depths are millimeters with a max of 0 meaning unbounded, and the optional box is
+// axis aligned in depth camera millimeters.
+struct RegionOfInterest
+{
+	PixelRect rect;
+	uint16_t minDepth;
+	uint16_t maxDepth;
+	bool hasBox;
+	float boxMin[3];
+	float boxMax[3];
+};
+
+static PixelRect clamp_rect(const PixelRect &rect, int width, int height)
+{
+	int left = max(rect.x, 0);
+	int top = max(rect.y, 0);
+	int right = min(rect.x + rect.width, width);
+	int bottom = min(rect.y + rect.height, height);
+	if (right <= left || bottom <= top)
+	{
+		return PixelRect{ 0, 0, 0, 0 };
+	}
+
+	return PixelRect{ left, top, right - left, bottom - top };
+}
+
+// Zeroes every depth pixel outside of the region, so the sdk color transform and everything downstream
+// skips them as invalid. Returns the number of pixels kept.
+static int crop_depth(uint16_t *depth_data, const k4a_float2_t *xy_table_data, int width, int height, const RegionOfInterest &roi, const PixelRect &rect)
+{
+	for (int y = 0; y < rect.y; y++)
+	{
+		memset(depth_data + y * width, 0, width * sizeof(uint16_t));
+	}
+	for (int y = rect.y + rect.height; y < height; y++)
+	{
+		memset(depth_data + y * width, 0, width * sizeof(uint16_t));
+	}
+
+	const uint16_t max_depth = roi.maxDepth != 0 ? roi.maxDepth : UINT16_MAX;
+	int kept_count = 0;
+	for (int y = rect.y; y < rect.y + rect.height; y++)
+	{
+		uint16_t *row = depth_data + y * width;
+		memset(row, 0, rect.x * sizeof(uint16_t));
+		memset(row + rect.x + rect.width, 0, (width - rect.x - rect.width) * sizeof(uint16_t));
+
+		for (int x = rect.x; x < rect.x + rect.width; x++)
+		{
+			uint16_t depth = row[x];
+			if (depth < roi.minDepth || depth > max_depth)
+			{
+				row[x] = 0;
+				continue;
+			}
+
+			if (depth != 0 && roi.hasBox)
+			{
+				const k4a_float2_t &xy = xy_table_data[y * width + x];
+				float px = xy.xy.x * (float)depth;
+				float py = xy.xy.y * (float)depth;
+				float pz = (float)depth;
+
+				// A nan ray fails every comparison and is dropped here as well
+				if (!(px >= roi.boxMin[0] && px <= roi.boxMax[0] &&
+					py >= roi.boxMin[1] && py <= roi.boxMax[1] &&
+					pz >= roi.boxMin[2] && pz <= roi.boxMax[2]))
+				{
+					row[x] = 0;
+					continue;
+				}
+			}
+
+			kept_count += depth != 0 ? 1 : 0;
+		}
+	}
+
+	return kept_count;
+}
+
+// Copies only the rect out of an image laid out like the destination
+static void copy_rect(const uint8_t *src, uint8_t *dst, int stride, int bytes_per_pixel, const PixelRect &rect)
+{
+	size_t offset = (size_t)rect.y * stride + (size_t)rect.x * bytes_per_pixel;
+	size_t row_size = (size_t)rect.width * bytes_per_pixel;
+	for (int y = 0; y < rect.height; y++, offset += stride)
+	{
+		memcpy(dst + offset, src + offset, row_size);
+	}
+}
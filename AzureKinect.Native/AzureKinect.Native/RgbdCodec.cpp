@@ -0,0 +1,830 @@
+#include "pch.h"
+#include "RgbdCodec.h"
+
+// Color bands are rows of 16x16 macroblocks, depth bands rows of pixels. Either payload starts with the
+// band count, the codec's parameter and every band's size, followed by the bands themselves.
+static const int ColorBandMacroblockRows = 2;
+static const int DepthBandRows = 32;
+static const int MaxPixelCount = 1 << 26;
+
+static const uint8_t zigzag_order[64] = {
+	0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+	12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+	35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+	58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63 };
+
+// Annex K of the jpeg standard, in natural order
+static const uint8_t luma_quantization[64] = {
+	16, 11, 10, 16, 24, 40, 51, 61,
+	12, 12, 14, 19, 26, 58, 60, 55,
+	14, 13, 16, 24, 40, 57, 69, 56,
+	14, 17, 22, 29, 51, 87, 80, 62,
+	18, 22, 37, 56, 68, 109, 103, 77,
+	24, 35, 55, 64, 81, 104, 113, 92,
+	49, 64, 78, 87, 103, 121, 120, 101,
+	72, 92, 95, 98, 112, 100, 103, 99 };
+
+static const uint8_t chroma_quantization[64] = {
+	17, 18, 24, 47, 99, 99, 99, 99,
+	18, 21, 26, 66, 99, 99, 99, 99,
+	24, 26, 56, 99, 99, 99, 99, 99,
+	47, 66, 99, 99, 99, 99, 99, 99,
+	99, 99, 99, 99, 99, 99, 99, 99,
+	99, 99, 99, 99, 99, 99, 99, 99,
+	99, 99, 99, 99, 99, 99, 99, 99,
+	99, 99, 99, 99, 99, 99, 99, 99 };
+
+// Quantization steps for one quality, luma first. The dct basis is orthonormal, so the same matrix
+// transforms both ways.
+struct ColorTables
+{
+	float basis[8][8];
+	float reciprocal[2][64];
+	float step[2][64];
+};
+
+static void build_color_tables(int quality, ColorTables &tables)
+{
+	for (int u = 0; u < 8; u++)
+	{
+		float scale = u == 0 ? sqrtf(0.125f) : 0.5f;
+		for (int x = 0; x < 8; x++)
+		{
+			tables.basis[u][x] = scale * cosf((2 * x + 1) * u * 3.14159265f / 16.0f);
+		}
+	}
+
+	int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+	for (int i = 0; i < 64; i++)
+	{
+		int luma = (luma_quantization[i] * scale + 50) / 100;
+		int chroma = (chroma_quantization[i] * scale + 50) / 100;
+		tables.step[0][i] = (float)min(max(luma, 1), 255);
+		tables.step[1][i] = (float)min(max(chroma, 1), 255);
+		tables.reciprocal[0][i] = 1.0f / tables.step[0][i];
+		tables.reciprocal[1][i] = 1.0f / tables.step[1][i];
+	}
+}
+
+static void forward_dct(const float *block, const ColorTables &tables, float *coefficients)
+{
+	float rows[64];
+	for (int y = 0; y < 8; y++)
+	{
+		for (int u = 0; u < 8; u++)
+		{
+			float sum = 0.0f;
+			for (int x = 0; x < 8; x++)
+			{
+				sum += tables.basis[u][x] * block[y * 8 + x];
+			}
+			rows[y * 8 + u] = sum;
+		}
+	}
+
+	for (int v = 0; v < 8; v++)
+	{
+		for (int u = 0; u < 8; u++)
+		{
+			float sum = 0.0f;
+			for (int y = 0; y < 8; y++)
+			{
+				sum += tables.basis[v][y] * rows[y * 8 + u];
+			}
+			coefficients[v * 8 + u] = sum;
+		}
+	}
+}
+
+static void inverse_dct(const float *coefficients, const ColorTables &tables, float *block)
+{
+	float rows[64];
+	for (int v = 0; v < 8; v++)
+	{
+		for (int x = 0; x < 8; x++)
+		{
+			float sum = 0.0f;
+			for (int u = 0; u < 8; u++)
+			{
+				sum += tables.basis[u][x] * coefficients[v * 8 + u];
+			}
+			rows[v * 8 + x] = sum;
+		}
+	}
+
+	for (int y = 0; y < 8; y++)
+	{
+		for (int x = 0; x < 8; x++)
+		{
+			float sum = 0.0f;
+			for (int v = 0; v < 8; v++)
+			{
+				sum += tables.basis[v][y] * rows[v * 8 + x];
+			}
+			block[y * 8 + x] = sum;
+		}
+	}
+}
+
+static inline uint32_t zigzag_signed(int32_t value)
+{
+	return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline int32_t unzigzag_signed(uint32_t value)
+{
+	return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+// Most significant bit first, flushed a byte at a time
+class BitWriter
+{
+public:
+	BitWriter(std::vector<uint8_t> &output) : output(output) {}
+
+	// length is 1 to 32
+	void Write(uint32_t value, int length)
+	{
+		bits = (bits << length) | (value & (0xffffffffu >> (32 - length)));
+		count += length;
+		while (count >= 8)
+		{
+			count -= 8;
+			output.push_back(static_cast<uint8_t>(bits >> count));
+		}
+	}
+
+	// Exp-Golomb of order zero, one bit for zero and longer codes for larger values
+	void WriteExpGolomb(uint32_t value)
+	{
+		uint64_t code = (uint64_t)value + 1;
+		int length = 0;
+		while ((code >> length) > 1)
+		{
+			length++;
+		}
+
+		if (length > 0)
+		{
+			Write(0, length);
+		}
+		Write(static_cast<uint32_t>(code >> 32 ? 0xffffffff : code), length + 1);
+	}
+
+	void Flush()
+	{
+		if (count > 0)
+		{
+			output.push_back(static_cast<uint8_t>(bits << (8 - count)));
+			count = 0;
+		}
+	}
+
+private:
+	std::vector<uint8_t> &output;
+	uint64_t bits = 0;
+	int count = 0;
+};
+
+// Reads past the end as zeros, IsOverrun tells afterwards whether that happened
+class BitReader
+{
+public:
+	BitReader(const uint8_t *data, size_t size) : data(data), size(size) {}
+
+	// length is 1 to 32
+	uint32_t Read(int length)
+	{
+		if (count < length)
+		{
+			Refill();
+		}
+
+		uint32_t value = static_cast<uint32_t>(bits >> (64 - length));
+		bits <<= length;
+		count -= length;
+		return value;
+	}
+
+	bool TryReadExpGolomb(uint32_t &value)
+	{
+		int length = 0;
+		while (Read(1) == 0)
+		{
+			// Nothing this codec writes is that long, a corrupt stream would otherwise spin on zeros
+			if (++length > 24 ||
+				IsOverrun())
+			{
+				return false;
+			}
+		}
+
+		value = length > 0 ? ((1u << length) | Read(length)) - 1 : 0;
+		return true;
+	}
+
+	bool IsOverrun() const
+	{
+		return position * 8 - count > size * 8;
+	}
+
+private:
+	void Refill()
+	{
+		while (count <= 56)
+		{
+			uint64_t next = position < size ? data[position] : 0;
+			bits |= next << (56 - count);
+			position++;
+			count += 8;
+		}
+	}
+
+	const uint8_t *data;
+	size_t size;
+	size_t position = 0;
+	uint64_t bits = 0;
+	int count = 0;
+};
+
+static void encode_block(BitWriter &writer, const float *block, const ColorTables &tables, int table, int &previousDc)
+{
+	float coefficients[64];
+	forward_dct(block, tables, coefficients);
+
+	int quantized[64];
+	for (int i = 0; i < 64; i++)
+	{
+		int index = zigzag_order[i];
+		quantized[i] = (int)lrintf(coefficients[index] * tables.reciprocal[table][index]);
+	}
+
+	// The dc term is coded against the block before it, every ac term as the zeros before it and its
+	// magnitude, with one bit ahead of each saying whether another one follows
+	writer.WriteExpGolomb(zigzag_signed(quantized[0] - previousDc));
+	previousDc = quantized[0];
+
+	int run = 0;
+	for (int i = 1; i < 64; i++)
+	{
+		if (quantized[i] == 0)
+		{
+			run++;
+			continue;
+		}
+
+		writer.Write(1, 1);
+		writer.WriteExpGolomb(run);
+		writer.WriteExpGolomb(abs(quantized[i]) - 1);
+		writer.Write(quantized[i] < 0 ? 1 : 0, 1);
+		run = 0;
+	}
+	writer.Write(0, 1);
+}
+
+static bool try_decode_block(BitReader &reader, const ColorTables &tables, int table, int &previousDc, float *block)
+{
+	float coefficients[64] = {};
+	uint32_t code;
+	if (!reader.TryReadExpGolomb(code))
+	{
+		return false;
+	}
+
+	previousDc += unzigzag_signed(code);
+	coefficients[0] = previousDc * tables.step[table][0];
+
+	int i = 1;
+	while (reader.Read(1) != 0)
+	{
+		uint32_t run, magnitude;
+		if (!reader.TryReadExpGolomb(run) ||
+			!reader.TryReadExpGolomb(magnitude))
+		{
+			return false;
+		}
+
+		i += (int)run;
+		if (i > 63)
+		{
+			return false;
+		}
+
+		int index = zigzag_order[i];
+		float value = (float)(magnitude + 1) * tables.step[table][index];
+		coefficients[index] = reader.Read(1) != 0 ? -value : value;
+		i++;
+
+		if (reader.IsOverrun())
+		{
+			return false;
+		}
+	}
+
+	inverse_dct(coefficients, tables, block);
+	return true;
+}
+
+static inline uint8_t clamp_byte(float value)
+{
+	return static_cast<uint8_t>(value <= 0.0f ? 0 : value >= 255.0f ? 255 : (int)(value + 0.5f));
+}
+
+static void encode_color_band(
+	const uint8_t *bgraData,
+	int width,
+	int height,
+	int macroblockRowBegin,
+	int macroblockRowEnd,
+	const ColorTables &tables,
+	std::vector<uint8_t> &output)
+{
+	BitWriter writer(output);
+	int previousDc[3] = {};
+	const int macroblockColumns = (width + 15) / 16;
+	for (int macroblockRow = macroblockRowBegin; macroblockRow < macroblockRowEnd; macroblockRow++)
+	{
+		for (int macroblockColumn = 0; macroblockColumn < macroblockColumns; macroblockColumn++)
+		{
+			// Edge macroblocks repeat the last row and column, which costs the least to code
+			float luma[4][64];
+			float cb[64] = {};
+			float cr[64] = {};
+			for (int y = 0; y < 16; y++)
+			{
+				int sourceY = min(macroblockRow * 16 + y, height - 1);
+				for (int x = 0; x < 16; x++)
+				{
+					int sourceX = min(macroblockColumn * 16 + x, width - 1);
+					const uint8_t *pixel = bgraData + ((size_t)sourceY * width + sourceX) * 4;
+					float b = pixel[0];
+					float g = pixel[1];
+					float r = pixel[2];
+					luma[(y / 8) * 2 + x / 8][(y % 8) * 8 + x % 8] = 0.299f * r + 0.587f * g + 0.114f * b - 128.0f;
+					cb[(y / 2) * 8 + x / 2] += 0.25f * (-0.168736f * r - 0.331264f * g + 0.5f * b);
+					cr[(y / 2) * 8 + x / 2] += 0.25f * (0.5f * r - 0.418688f * g - 0.081312f * b);
+				}
+			}
+
+			for (int block = 0; block < 4; block++)
+			{
+				encode_block(writer, luma[block], tables, 0, previousDc[0]);
+			}
+			encode_block(writer, cb, tables, 1, previousDc[1]);
+			encode_block(writer, cr, tables, 1, previousDc[2]);
+		}
+	}
+
+	writer.Flush();
+}
+
+static bool try_decode_color_band(
+	const uint8_t *data,
+	size_t size,
+	int width,
+	int height,
+	int macroblockRowBegin,
+	int macroblockRowEnd,
+	const ColorTables &tables,
+	uint8_t *bgraData)
+{
+	BitReader reader(data, size);
+	int previousDc[3] = {};
+	const int macroblockColumns = (width + 15) / 16;
+	for (int macroblockRow = macroblockRowBegin; macroblockRow < macroblockRowEnd; macroblockRow++)
+	{
+		for (int macroblockColumn = 0; macroblockColumn < macroblockColumns; macroblockColumn++)
+		{
+			float luma[4][64];
+			float cb[64];
+			float cr[64];
+			for (int block = 0; block < 4; block++)
+			{
+				if (!try_decode_block(reader, tables, 0, previousDc[0], luma[block]))
+				{
+					return false;
+				}
+			}
+
+			if (!try_decode_block(reader, tables, 1, previousDc[1], cb) ||
+				!try_decode_block(reader, tables, 1, previousDc[2], cr))
+			{
+				return false;
+			}
+
+			int yEnd = min(16, height - macroblockRow * 16);
+			int xEnd = min(16, width - macroblockColumn * 16);
+			for (int y = 0; y < yEnd; y++)
+			{
+				uint8_t *pixel = bgraData + ((size_t)(macroblockRow * 16 + y) * width + macroblockColumn * 16) * 4;
+				for (int x = 0; x < xEnd; x++, pixel += 4)
+				{
+					float l = luma[(y / 8) * 2 + x / 8][(y % 8) * 8 + x % 8] + 128.0f;
+					float blue = cb[(y / 2) * 8 + x / 2];
+					float red = cr[(y / 2) * 8 + x / 2];
+					pixel[0] = clamp_byte(l + 1.772f * blue);
+					pixel[1] = clamp_byte(l - 0.344136f * blue - 0.714136f * red);
+					pixel[2] = clamp_byte(l + 1.402f * red);
+					pixel[3] = 255;
+				}
+			}
+		}
+	}
+
+	return !reader.IsOverrun();
+}
+
+static void append_uint32(std::vector<uint8_t> &output, uint32_t value)
+{
+	uint8_t bytes[4];
+	memcpy(bytes, &value, sizeof(bytes));
+	output.insert(output.end(), bytes, bytes + sizeof(bytes));
+}
+
+static uint32_t read_uint32(const uint8_t *data)
+{
+	uint32_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static void append_bands(std::vector<uint8_t> &output, uint32_t parameter, const std::vector<std::vector<uint8_t>> &bands)
+{
+	size_t size = 8 + bands.size() * 4;
+	for (auto &band : bands)
+	{
+		size += band.size();
+	}
+
+	output.reserve(output.size() + size);
+	append_uint32(output, static_cast<uint32_t>(bands.size()));
+	append_uint32(output, parameter);
+	for (auto &band : bands)
+	{
+		append_uint32(output, static_cast<uint32_t>(band.size()));
+	}
+	for (auto &band : bands)
+	{
+		output.insert(output.end(), band.begin(), band.end());
+	}
+}
+
+// Finds where each band starts, false unless the payload has exactly bandCount bands that fit in it
+static bool try_split_bands(
+	const uint8_t *data,
+	size_t size,
+	int bandCount,
+	uint32_t &parameter,
+	std::vector<std::pair<const uint8_t*, size_t>> &bands)
+{
+	if (data == nullptr ||
+		size < 8 ||
+		read_uint32(data) != (uint32_t)bandCount ||
+		size < 8 + (size_t)bandCount * 4)
+	{
+		return false;
+	}
+
+	parameter = read_uint32(data + 4);
+	size_t offset = 8 + (size_t)bandCount * 4;
+	bands.resize(bandCount);
+	for (int band = 0; band < bandCount; band++)
+	{
+		size_t bandSize = read_uint32(data + 8 + band * 4);
+		if (bandSize > size - offset)
+		{
+			return false;
+		}
+
+		bands[band] = { data + offset, bandSize };
+		offset += bandSize;
+	}
+
+	return true;
+}
+
+static bool is_valid_size(int width, int height)
+{
+	return width > 0 &&
+		height > 0 &&
+		(int64_t)width * height <= MaxPixelCount;
+}
+
+bool RgbdCodec::TryEncodeColor(
+	const uint8_t *bgraData,
+	int width,
+	int height,
+	int quality,
+	std::vector<uint8_t> &output)
+{
+	if (bgraData == nullptr ||
+		!is_valid_size(width, height) ||
+		quality < 1 ||
+		quality > 100)
+	{
+		return false;
+	}
+
+	ColorTables tables;
+	build_color_tables(quality, tables);
+
+	const int macroblockRows = (height + 15) / 16;
+	const int bandCount = (macroblockRows + ColorBandMacroblockRows - 1) / ColorBandMacroblockRows;
+	std::vector<std::vector<uint8_t>> bands(bandCount);
+	ThreadPool::GetShared().ParallelFor(bandCount, [&](int band)
+	{
+		int begin = band * ColorBandMacroblockRows;
+		bands[band].reserve((size_t)width * 16 * ColorBandMacroblockRows / 2);
+		encode_color_band(bgraData, width, height, begin, min(begin + ColorBandMacroblockRows, macroblockRows), tables, bands[band]);
+	});
+
+	append_bands(output, static_cast<uint32_t>(quality), bands);
+	return true;
+}
+
+bool RgbdCodec::TryDecodeColor(
+	const uint8_t *data,
+	size_t size,
+	int width,
+	int height,
+	uint8_t *bgraData)
+{
+	if (bgraData == nullptr ||
+		!is_valid_size(width, height))
+	{
+		return false;
+	}
+
+	const int macroblockRows = (height + 15) / 16;
+	const int bandCount = (macroblockRows + ColorBandMacroblockRows - 1) / ColorBandMacroblockRows;
+	uint32_t quality;
+	std::vector<std::pair<const uint8_t*, size_t>> bands;
+	if (!try_split_bands(data, size, bandCount, quality, bands) ||
+		quality < 1 ||
+		quality > 100)
+	{
+		return false;
+	}
+
+	ColorTables tables;
+	build_color_tables((int)quality, tables);
+
+	std::atomic<bool> succeeded{ true };
+	ThreadPool::GetShared().ParallelFor(bandCount, [&](int band)
+	{
+		int begin = band * ColorBandMacroblockRows;
+		if (!try_decode_color_band(bands[band].first, bands[band].second, width, height, begin, min(begin + ColorBandMacroblockRows, macroblockRows), tables, bgraData))
+		{
+			succeeded = false;
+		}
+	});
+
+	return succeeded;
+}
+
+// Three bits of value per nibble, the fourth says another nibble follows. Eight nibbles make a word.
+class NibbleWriter
+{
+public:
+	NibbleWriter(std::vector<uint32_t> &output) : output(output) {}
+
+	void Write(uint32_t value)
+	{
+		do
+		{
+			uint32_t nibble = value & 0x7;
+			value >>= 3;
+			if (value != 0)
+			{
+				nibble |= 0x8;
+			}
+
+			word = (word << 4) | nibble;
+			if (++nibbleCount == 8)
+			{
+				output.push_back(word);
+				word = 0;
+				nibbleCount = 0;
+			}
+		} while (value != 0);
+	}
+
+	void Flush()
+	{
+		if (nibbleCount > 0)
+		{
+			output.push_back(word << (4 * (8 - nibbleCount)));
+			word = 0;
+			nibbleCount = 0;
+		}
+	}
+
+private:
+	std::vector<uint32_t> &output;
+	uint32_t word = 0;
+	int nibbleCount = 0;
+};
+
+class NibbleReader
+{
+public:
+	NibbleReader(const uint8_t *data, size_t wordCount) : data(data), wordCount(wordCount) {}
+
+	bool TryRead(uint32_t &value)
+	{
+		value = 0;
+		for (int shift = 0; shift < 32; shift += 3)
+		{
+			if (nibbleCount == 0)
+			{
+				if (wordIndex >= wordCount)
+				{
+					return false;
+				}
+
+				word = read_uint32(data + wordIndex * 4);
+				wordIndex++;
+				nibbleCount = 8;
+			}
+
+			uint32_t nibble = word >> 28;
+			word <<= 4;
+			nibbleCount--;
+			value |= (nibble & 0x7) << shift;
+			if ((nibble & 0x8) == 0)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+private:
+	const uint8_t *data;
+	size_t wordCount;
+	size_t wordIndex = 0;
+	uint32_t word = 0;
+	int nibbleCount = 0;
+};
+
+static void encode_depth_band(const uint16_t *depthData, int pixelCount, int errorMillimeters, std::vector<uint32_t> &output)
+{
+	NibbleWriter writer(output);
+	const int step = errorMillimeters * 2 + 1;
+	int previous = 0;
+	int i = 0;
+	while (i < pixelCount)
+	{
+		int zeros = 0;
+		for (; i + zeros < pixelCount && depthData[i + zeros] == 0; zeros++)
+		{
+		}
+		writer.Write(zeros);
+		i += zeros;
+
+		int nonzeros = 0;
+		for (; i + nonzeros < pixelCount && depthData[i + nonzeros] != 0; nonzeros++)
+		{
+		}
+		writer.Write(nonzeros);
+
+		for (int end = i + nonzeros; i < end; i++)
+		{
+			// Quantized depths start at one, so zero keeps meaning invalid
+			int current = errorMillimeters > 0 ? (depthData[i] + errorMillimeters) / step + 1 : depthData[i];
+			writer.Write(zigzag_signed(current - previous));
+			previous = current;
+		}
+	}
+
+	writer.Flush();
+}
+
+static bool try_decode_depth_band(const uint8_t *data, size_t size, int pixelCount, int errorMillimeters, uint16_t *depthData)
+{
+	if (size % 4 != 0)
+	{
+		return false;
+	}
+
+	NibbleReader reader(data, size / 4);
+	const int step = errorMillimeters * 2 + 1;
+	int previous = 0;
+	int i = 0;
+	while (i < pixelCount)
+	{
+		uint32_t zeros, nonzeros;
+		if (!reader.TryRead(zeros) ||
+			zeros > (uint32_t)(pixelCount - i))
+		{
+			return false;
+		}
+
+		memset(depthData + i, 0, zeros * sizeof(uint16_t));
+		i += (int)zeros;
+
+		if (!reader.TryRead(nonzeros) ||
+			nonzeros > (uint32_t)(pixelCount - i))
+		{
+			return false;
+		}
+
+		for (int end = i + (int)nonzeros; i < end; i++)
+		{
+			uint32_t code;
+			if (!reader.TryRead(code))
+			{
+				return false;
+			}
+
+			int current = previous + unzigzag_signed(code);
+			int depth = errorMillimeters > 0 ? (current - 1) * step : current;
+			if (current <= 0 ||
+				depth > UINT16_MAX)
+			{
+				return false;
+			}
+
+			depthData[i] = static_cast<uint16_t>(depth);
+			previous = current;
+		}
+	}
+
+	return true;
+}
+
+bool RgbdCodec::TryEncodeDepth(
+	const uint16_t *depthData,
+	int width,
+	int height,
+	int errorMillimeters,
+	std::vector<uint8_t> &output)
+{
+	if (depthData == nullptr ||
+		!is_valid_size(width, height) ||
+		errorMillimeters < 0 ||
+		errorMillimeters > 1000)
+	{
+		return false;
+	}
+
+	const int bandCount = (height + DepthBandRows - 1) / DepthBandRows;
+	std::vector<std::vector<uint32_t>> words(bandCount);
+	ThreadPool::GetShared().ParallelFor(bandCount, [&](int band)
+	{
+		int rowBegin = band * DepthBandRows;
+		int rowCount = min(DepthBandRows, height - rowBegin);
+		words[band].reserve((size_t)width * rowCount / 4);
+		encode_depth_band(depthData + (size_t)rowBegin * width, width * rowCount, errorMillimeters, words[band]);
+	});
+
+	std::vector<std::vector<uint8_t>> bands(bandCount);
+	for (int band = 0; band < bandCount; band++)
+	{
+		bands[band].resize(words[band].size() * 4);
+		if (!words[band].empty())
+		{
+			memcpy(bands[band].data(), words[band].data(), bands[band].size());
+		}
+	}
+
+	append_bands(output, static_cast<uint32_t>(errorMillimeters), bands);
+	return true;
+}
+
+bool RgbdCodec::TryDecodeDepth(
+	const uint8_t *data,
+	size_t size,
+	int width,
+	int height,
+	uint16_t *depthData)
+{
+	if (depthData == nullptr ||
+		!is_valid_size(width, height))
+	{
+		return false;
+	}
+
+	const int bandCount = (height + DepthBandRows - 1) / DepthBandRows;
+	uint32_t errorMillimeters;
+	std::vector<std::pair<const uint8_t*, size_t>> bands;
+	if (!try_split_bands(data, size, bandCount, errorMillimeters, bands) ||
+		errorMillimeters > 1000)
+	{
+		return false;
+	}
+
+	std::atomic<bool> succeeded{ true };
+	ThreadPool::GetShared().ParallelFor(bandCount, [&](int band)
+	{
+		int rowBegin = band * DepthBandRows;
+		int rowCount = min(DepthBandRows, height - rowBegin);
+		if (!try_decode_depth_band(bands[band].first, bands[band].second, width * rowCount, (int)errorMillimeters, depthData + (size_t)rowBegin * width))
+		{
+			succeeded = false;
+		}
+	});
+
+	return succeeded;
+}
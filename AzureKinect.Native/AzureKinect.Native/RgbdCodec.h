@@ -0,0 +1,40 @@
+#pragma once
+
+// Intra frame codecs for streaming registered color and depth. Both cut the image into bands of rows
+// that are encoded and decoded independently on the shared thread pool, and both payloads describe
+// themselves, decoding only needs the image size. Decoders check every size and offset against the
+// payload, a corrupt or truncated one fails instead of reading or writing out of bounds.
+class RgbdCodec
+{
+public:
+	// Lossy, an 8x8 dct of YCbCr with 4:2:0 chroma like baseline jpeg. Quality 1 to 100 scales the jpeg
+	// quantization tables the way libjpeg does. Alpha is dropped, decoding writes 255. Appended to output.
+	static bool TryEncodeColor(
+		const uint8_t *bgraData,
+		int width,
+		int height,
+		int quality,
+		std::vector<uint8_t> &output);
+	static bool TryDecodeColor(
+		const uint8_t *data,
+		size_t size,
+		int width,
+		int height,
+		uint8_t *bgraData);
+
+	// Run lengths of invalid pixels and variable length deltas between valid ones (RVL). Lossless with
+	// a zero error, otherwise valid depths are rounded to steps of 2 * errorMillimeters + 1, which keeps
+	// every pixel within errorMillimeters and every invalid one zero. Appended to output.
+	static bool TryEncodeDepth(
+		const uint16_t *depthData,
+		int width,
+		int height,
+		int errorMillimeters,
+		std::vector<uint8_t> &output);
+	static bool TryDecodeDepth(
+		const uint8_t *data,
+		size_t size,
+		int width,
+		int height,
+		uint16_t *depthData);
+};
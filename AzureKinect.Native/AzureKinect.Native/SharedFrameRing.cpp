@@ -0,0 +1,586 @@
+// Built without the precompiled header, the subscriber library has neither the sdk nor d3d
+#include "SharedFrameRing.h"
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const int SharedFrameMaxSlotCount = 64;
+
+static uint64_t align_up(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+// Orders every read of the frame before the second look at its slot's sequence
+static bool is_frame_intact(const SharedFrame &frame)
+{
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return frame.slot != nullptr &&
+		frame.slot->seq.load(std::memory_order_relaxed) == frame.seq;
+}
+
+static bool is_valid_name(const std::string &name)
+{
+	return !name.empty() &&
+		name.size() < 200 &&
+		name.find_first_of("/\\") == std::string::npos;
+}
+
+SharedMemoryMapping::~SharedMemoryMapping()
+{
+	Close();
+}
+
+#ifdef _WIN32
+bool SharedMemoryMapping::TryCreate(const std::string &name, size_t size)
+{
+	Close();
+	if (!is_valid_name(name))
+	{
+		return false;
+	}
+
+	// Readers still holding an earlier publisher's mapping keep it alive, the name then opens that
+	// one again and it is reused as long as it is large enough
+	HANDLE mappingHandle = CreateFileMappingA(INVALID_HANDLE_VALUE,
+		nullptr,
+		PAGE_READWRITE,
+		(DWORD)((uint64_t)size >> 32),
+		(DWORD)((uint64_t)size & 0xffffffff),
+		name.c_str());
+	if (mappingHandle == nullptr)
+	{
+		return false;
+	}
+
+	void *view = MapViewOfFile(mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	MEMORY_BASIC_INFORMATION info = {};
+	if (view == nullptr ||
+		VirtualQuery(view, &info, sizeof(info)) == 0 ||
+		info.RegionSize < size)
+	{
+		if (view != nullptr)
+		{
+			UnmapViewOfFile(view);
+		}
+		CloseHandle(mappingHandle);
+		return false;
+	}
+
+	handle = mappingHandle;
+	data = static_cast<uint8_t*>(view);
+	this->size = size;
+	created = true;
+	platformName = name;
+	return true;
+}
+
+bool SharedMemoryMapping::TryOpen(const std::string &name)
+{
+	Close();
+	if (!is_valid_name(name))
+	{
+		return false;
+	}
+
+	HANDLE mappingHandle = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+	if (mappingHandle == nullptr)
+	{
+		return false;
+	}
+
+	void *view = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	MEMORY_BASIC_INFORMATION info = {};
+	if (view == nullptr ||
+		VirtualQuery(view, &info, sizeof(info)) == 0)
+	{
+		if (view != nullptr)
+		{
+			UnmapViewOfFile(view);
+		}
+		CloseHandle(mappingHandle);
+		return false;
+	}
+
+	handle = mappingHandle;
+	data = static_cast<uint8_t*>(view);
+	size = info.RegionSize;
+	created = false;
+	platformName = name;
+	return true;
+}
+
+void SharedMemoryMapping::Close()
+{
+	if (data != nullptr)
+	{
+		UnmapViewOfFile(data);
+		data = nullptr;
+	}
+
+	if (handle != nullptr)
+	{
+		CloseHandle(handle);
+		handle = nullptr;
+	}
+
+	size = 0;
+	created = false;
+	platformName.clear();
+}
+#else
+bool SharedMemoryMapping::TryCreate(const std::string &name, size_t size)
+{
+	Close();
+	if (!is_valid_name(name))
+	{
+		return false;
+	}
+
+	// A fresh object every time, readers still mapping the old one keep it until they let go
+	std::string objectName = "/" + name;
+	shm_unlink(objectName.c_str());
+	int fd = shm_open(objectName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	void *view = MAP_FAILED;
+	if (ftruncate(fd, (off_t)size) == 0)
+	{
+		view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	close(fd);
+
+	if (view == MAP_FAILED)
+	{
+		shm_unlink(objectName.c_str());
+		return false;
+	}
+
+	data = static_cast<uint8_t*>(view);
+	this->size = size;
+	created = true;
+	platformName = objectName;
+	return true;
+}
+
+bool SharedMemoryMapping::TryOpen(const std::string &name)
+{
+	Close();
+	if (!is_valid_name(name))
+	{
+		return false;
+	}
+
+	std::string objectName = "/" + name;
+	int fd = shm_open(objectName.c_str(), O_RDONLY, 0);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat status = {};
+	void *view = MAP_FAILED;
+	if (fstat(fd, &status) == 0 &&
+		status.st_size > 0)
+	{
+		view = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	}
+	close(fd);
+
+	if (view == MAP_FAILED)
+	{
+		return false;
+	}
+
+	data = static_cast<uint8_t*>(view);
+	size = (size_t)status.st_size;
+	created = false;
+	platformName = objectName;
+	return true;
+}
+
+void SharedMemoryMapping::Close()
+{
+	if (data != nullptr)
+	{
+		munmap(data, size);
+		data = nullptr;
+	}
+
+	// Only the name goes away, mappings that are still open stay valid
+	if (created)
+	{
+		shm_unlink(platformName.c_str());
+	}
+
+	size = 0;
+	created = false;
+	platformName.clear();
+}
+#endif
+
+SharedFrameWriter::~SharedFrameWriter()
+{
+	Close();
+}
+
+bool SharedFrameWriter::TryCreate(const std::string &name, int slotCount, int maxWidth, int maxHeight)
+{
+	Close();
+	if (slotCount < 2 ||
+		slotCount > SharedFrameMaxSlotCount ||
+		maxWidth <= 0 ||
+		maxHeight <= 0)
+	{
+		return false;
+	}
+
+	// Images start on cache lines so the copies into them run at full speed
+	uint64_t pixelCount = (uint64_t)maxWidth * maxHeight;
+	uint64_t headerSize = align_up(sizeof(SharedFrameRingHeader), 4096);
+	uint64_t depthOffset = align_up(sizeof(SharedFrameSlotHeader), 64);
+	uint64_t colorOffset = depthOffset + align_up(pixelCount * sizeof(uint16_t), 64);
+	uint64_t irOffset = colorOffset + align_up(pixelCount * 4, 64);
+	uint64_t slotStride = align_up(irOffset + pixelCount * sizeof(uint16_t), 4096);
+	if (!mapping.TryCreate(name, (size_t)(headerSize + slotStride * slotCount)))
+	{
+		return false;
+	}
+
+	header = reinterpret_cast<SharedFrameRingHeader*>(mapping.GetData());
+
+	// A mapping reused on windows keeps counting where the last publisher stopped, so no slot's
+	// sequence ever repeats a value a reader could have seen before
+	sequence = 0;
+	if (header->magic == SharedFrameRingHeader::Magic &&
+		header->layoutVersion == SharedFrameRingHeader::LayoutVersion &&
+		header->slotCount == (uint32_t)slotCount &&
+		header->slotStride == slotStride)
+	{
+		sequence = header->latestSequence.load(std::memory_order_relaxed);
+		for (int i = 0; i < slotCount; i++)
+		{
+			auto slot = reinterpret_cast<SharedFrameSlotHeader*>(mapping.GetData() + headerSize + slotStride * i);
+			uint64_t slotSequence = (slot->seq.load(std::memory_order_relaxed) + 1) / 2;
+			sequence = slotSequence > sequence ? slotSequence : sequence;
+		}
+	}
+	else
+	{
+		memset(mapping.GetData(), 0, (size_t)headerSize);
+	}
+
+	header->layoutVersion = SharedFrameRingHeader::LayoutVersion;
+	header->slotCount = (uint32_t)slotCount;
+	header->maxWidth = (uint32_t)maxWidth;
+	header->maxHeight = (uint32_t)maxHeight;
+	header->headerSize = (uint32_t)headerSize;
+	header->slotStride = slotStride;
+	header->depthOffset = depthOffset;
+	header->colorOffset = colorOffset;
+	header->irOffset = irOffset;
+	header->latestSequence.store(sequence, std::memory_order_relaxed);
+	header->closed.store(0, std::memory_order_relaxed);
+
+	// Readers check the magic first, it goes in last
+	std::atomic_thread_fence(std::memory_order_release);
+	header->magic = SharedFrameRingHeader::Magic;
+	return true;
+}
+
+void SharedFrameWriter::Close()
+{
+	if (header != nullptr)
+	{
+		header->closed.store(1, std::memory_order_release);
+		header = nullptr;
+	}
+
+	mapping.Close();
+}
+
+void SharedFrameWriter::SetCalibration(
+	const uint8_t *data,
+	size_t size,
+	int depthMode,
+	int colorResolution,
+	uint32_t calibrationVersion)
+{
+	if (header == nullptr)
+	{
+		return;
+	}
+
+	// Too large to fit leaves the calibration empty, readers then have to ask the device
+	size = data != nullptr && size <= sizeof(header->calibration) ? size : 0;
+	uint32_t seq = header->calibrationSeq.load(std::memory_order_relaxed);
+	header->calibrationSeq.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	header->calibrationVersion = calibrationVersion;
+	header->depthMode = depthMode;
+	header->colorResolution = colorResolution;
+	header->calibrationSize = (uint32_t)size;
+	if (size > 0)
+	{
+		memcpy(header->calibration, data, size);
+	}
+
+	header->calibrationSeq.store(seq + 2, std::memory_order_release);
+}
+
+uint64_t SharedFrameWriter::Publish(
+	const SharedFrameInfo &info,
+	const uint16_t *depthData,
+	const uint8_t *colorData,
+	const uint16_t *irData)
+{
+	if (header == nullptr ||
+		info.width > header->maxWidth ||
+		info.height > header->maxHeight)
+	{
+		return 0;
+	}
+
+	sequence++;
+	uint8_t *slotData = mapping.GetData() + header->headerSize + header->slotStride * ((sequence - 1) % header->slotCount);
+	auto slot = reinterpret_cast<SharedFrameSlotHeader*>(slotData);
+
+	// Odd from here on, readers that started on the slot's last frame find it changed when they check
+	slot->seq.store(sequence * 2 - 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	size_t pixelCount = (size_t)info.width * info.height;
+	uint64_t copiedBytes = 0;
+	uint32_t flags = info.flags & ~(SharedFrameHasDepth | SharedFrameHasColor | SharedFrameHasIR);
+	if (depthData != nullptr)
+	{
+		memcpy(slotData + header->depthOffset, depthData, pixelCount * sizeof(uint16_t));
+		copiedBytes += pixelCount * sizeof(uint16_t);
+		flags |= SharedFrameHasDepth;
+	}
+
+	if (colorData != nullptr)
+	{
+		memcpy(slotData + header->colorOffset, colorData, pixelCount * 4);
+		copiedBytes += pixelCount * 4;
+		flags |= SharedFrameHasColor;
+	}
+
+	if (irData != nullptr)
+	{
+		memcpy(slotData + header->irOffset, irData, pixelCount * sizeof(uint16_t));
+		copiedBytes += pixelCount * sizeof(uint16_t);
+		flags |= SharedFrameHasIR;
+	}
+
+	slot->sequence = sequence;
+	slot->frameSequence = info.frameSequence;
+	slot->flags = flags;
+	slot->width = info.width;
+	slot->height = info.height;
+	slot->calibrationVersion = info.calibrationVersion;
+	slot->depthDeviceTimestampUsec = info.depthDeviceTimestampUsec;
+	slot->colorDeviceTimestampUsec = info.colorDeviceTimestampUsec;
+	slot->irDeviceTimestampUsec = info.irDeviceTimestampUsec;
+	slot->depthHostTimestampNsec = info.depthHostTimestampNsec;
+	slot->publishHostTimestampNsec = info.publishHostTimestampNsec;
+
+	slot->seq.store(sequence * 2, std::memory_order_release);
+	header->latestSequence.store(sequence, std::memory_order_release);
+	return copiedBytes;
+}
+
+bool SharedFrameReader::TryOpen(const std::string &name)
+{
+	Close();
+	if (!mapping.TryOpen(name))
+	{
+		return false;
+	}
+
+	// Everything the layout promises has to fit in what was actually mapped
+	auto mapped = reinterpret_cast<const SharedFrameRingHeader*>(mapping.GetData());
+	if (mapping.GetSize() < sizeof(SharedFrameRingHeader) ||
+		mapped->magic != SharedFrameRingHeader::Magic ||
+		mapped->layoutVersion != SharedFrameRingHeader::LayoutVersion ||
+		mapped->slotCount == 0 ||
+		mapped->headerSize < sizeof(SharedFrameRingHeader) ||
+		mapped->headerSize + mapped->slotStride * mapped->slotCount > mapping.GetSize())
+	{
+		mapping.Close();
+		return false;
+	}
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+	header = mapped;
+	lastSequence = 0;
+	stats = {};
+	return true;
+}
+
+void SharedFrameReader::Close()
+{
+	header = nullptr;
+	mapping.Close();
+}
+
+bool SharedFrameReader::IsClosed() const
+{
+	return header == nullptr ||
+		header->closed.load(std::memory_order_acquire) != 0;
+}
+
+uint64_t SharedFrameReader::GetLatestSequence() const
+{
+	return header != nullptr ? header->latestSequence.load(std::memory_order_acquire) : 0;
+}
+
+bool SharedFrameReader::TryWaitForFrame(uint64_t sequence, int timeoutMilliseconds) const
+{
+	// There is nothing to block on across processes without a kernel object per reader, the latest
+	// sequence is polled at a fraction of any frame interval instead
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMilliseconds);
+	while (GetLatestSequence() <= sequence)
+	{
+		if (IsClosed() ||
+			std::chrono::steady_clock::now() >= deadline)
+		{
+			return false;
+		}
+
+		std::this_thread::sleep_for(std::chrono::microseconds(500));
+	}
+
+	return true;
+}
+
+bool SharedFrameReader::TryAcquireLatest(SharedFrame &frame)
+{
+	if (header == nullptr)
+	{
+		return false;
+	}
+
+	const uint8_t *base = mapping.GetData();
+	for (int attempt = 0; attempt < 4; attempt++)
+	{
+		uint64_t sequence = header->latestSequence.load(std::memory_order_acquire);
+		if (sequence == 0)
+		{
+			return false;
+		}
+
+		const uint8_t *slotData = base + header->headerSize + header->slotStride * ((sequence - 1) % header->slotCount);
+		auto slot = reinterpret_cast<const SharedFrameSlotHeader*>(slotData);
+
+		// Anything but the frame's own even value means the publisher lapped the reader since it read
+		// the latest sequence, the next attempt starts from the newer one
+		uint64_t seq = slot->seq.load(std::memory_order_acquire);
+		if (seq != sequence * 2)
+		{
+			stats.retryCount++;
+			continue;
+		}
+
+		frame.seq = seq;
+		frame.sequence = slot->sequence;
+		frame.frameSequence = slot->frameSequence;
+		frame.flags = slot->flags;
+		frame.width = slot->width;
+		frame.height = slot->height;
+		frame.calibrationVersion = slot->calibrationVersion;
+		frame.depthDeviceTimestampUsec = slot->depthDeviceTimestampUsec;
+		frame.colorDeviceTimestampUsec = slot->colorDeviceTimestampUsec;
+		frame.irDeviceTimestampUsec = slot->irDeviceTimestampUsec;
+		frame.depthHostTimestampNsec = slot->depthHostTimestampNsec;
+		frame.publishHostTimestampNsec = slot->publishHostTimestampNsec;
+		frame.depthData = (frame.flags & SharedFrameHasDepth) != 0 ? reinterpret_cast<const uint16_t*>(slotData + header->depthOffset) : nullptr;
+		frame.colorData = (frame.flags & SharedFrameHasColor) != 0 ? slotData + header->colorOffset : nullptr;
+		frame.irData = (frame.flags & SharedFrameHasIR) != 0 ? reinterpret_cast<const uint16_t*>(slotData + header->irOffset) : nullptr;
+		frame.slot = slot;
+
+		// The header fields are only trusted when the slot still holds the same frame after reading them
+		if (!is_frame_intact(frame))
+		{
+			stats.retryCount++;
+			continue;
+		}
+
+		if (lastSequence != 0 &&
+			sequence > lastSequence + 1)
+		{
+			stats.skippedCount += sequence - lastSequence - 1;
+		}
+
+		lastSequence = sequence;
+		stats.acquiredCount++;
+		return true;
+	}
+
+	return false;
+}
+
+bool SharedFrameReader::IsValid(const SharedFrame &frame)
+{
+	if (!is_frame_intact(frame))
+	{
+		stats.tornCount++;
+		return false;
+	}
+
+	return true;
+}
+
+bool SharedFrameReader::TryCopyCalibration(
+	std::vector<uint8_t> &data,
+	int *depthMode,
+	int *colorResolution,
+	uint32_t *calibrationVersion)
+{
+	if (header == nullptr ||
+		depthMode == nullptr ||
+		colorResolution == nullptr ||
+		calibrationVersion == nullptr)
+	{
+		return false;
+	}
+
+	for (int attempt = 0; attempt < 16; attempt++)
+	{
+		uint32_t seq = header->calibrationSeq.load(std::memory_order_acquire);
+		if ((seq & 1) != 0)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		uint32_t size = header->calibrationSize < sizeof(header->calibration) ? header->calibrationSize : (uint32_t)sizeof(header->calibration);
+		data.assign(header->calibration, header->calibration + size);
+		*depthMode = header->depthMode;
+		*colorResolution = header->colorResolution;
+		*calibrationVersion = header->calibrationVersion;
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (header->calibrationSeq.load(std::memory_order_relaxed) == seq)
+		{
+			return seq != 0 && !data.empty();
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,220 @@
+#pragma once
+
+// Frames published to other processes through a named shared memory ring, a file mapping on windows
+// and posix shared memory elsewhere. This header and SharedFrameRing.cpp stand on their own, so the
+// subscriber library builds them without the sdk, d3d or the precompiled header.
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum SharedFrameFlags : uint32_t
+{
+	SharedFrameHasDepth = 1 << 0,
+	// Registered color, bgra at the depth camera's size
+	SharedFrameHasColor = 1 << 1,
+	SharedFrameHasIR = 1 << 2,
+	// Change detection found no changed tile, the images repeat the previous frame's
+	SharedFrameUnchanged = 1 << 3
+};
+
+// The mapping starts with this header, the slots follow at headerSize apart by slotStride. Every slot
+// holds a SharedFrameSlotHeader and the depth, color and ir images at the offsets given here, each
+// sized for maxWidth by maxHeight pixels.
+struct alignas(64) SharedFrameRingHeader
+{
+	static const uint32_t Magic = 0x46524b41; // "AKRF"
+	static const uint32_t LayoutVersion = 1;
+
+	uint32_t magic;
+	uint32_t layoutVersion;
+	uint32_t slotCount;
+	uint32_t maxWidth;
+	uint32_t maxHeight;
+	uint32_t headerSize;
+	uint64_t slotStride;
+	uint64_t depthOffset;
+	uint64_t colorOffset;
+	uint64_t irOffset;
+
+	// Ring sequence of the newest complete slot, zero before the first frame. Frame n is in slot
+	// (n - 1) % slotCount.
+	std::atomic<uint64_t> latestSequence;
+	// Set when the publisher went away, readers reopen the name to pick up a new one
+	std::atomic<uint32_t> closed;
+
+	// The raw calibration the sdk turns into a k4a_calibration_t with the depth mode and color
+	// resolution, guarded by its own sequence the same way the slots are
+	std::atomic<uint32_t> calibrationSeq;
+	uint32_t calibrationVersion;
+	int32_t depthMode;
+	int32_t colorResolution;
+	uint32_t calibrationSize;
+	uint8_t calibration[32768];
+};
+
+// Written before and after the images. seq is odd while the publisher writes the slot and twice the
+// ring sequence once the frame is complete, so a reader that sees the same even value before and
+// after reading knows nothing was overwritten in between.
+struct alignas(64) SharedFrameSlotHeader
+{
+	std::atomic<uint64_t> seq;
+	uint64_t sequence;
+	// The device's own frame sequence, it skips frames the ring never saw
+	uint64_t frameSequence;
+	uint32_t flags;
+	uint32_t width;
+	uint32_t height;
+	uint32_t calibrationVersion;
+	uint64_t depthDeviceTimestampUsec;
+	uint64_t colorDeviceTimestampUsec;
+	uint64_t irDeviceTimestampUsec;
+	// On the host monotonic clock, which every process on the machine shares
+	uint64_t depthHostTimestampNsec;
+	uint64_t publishHostTimestampNsec;
+};
+
+// What the publisher fills in for one frame, the images share the depth camera's size
+struct SharedFrameInfo
+{
+	uint64_t frameSequence;
+	uint32_t flags;
+	uint32_t width;
+	uint32_t height;
+	uint32_t calibrationVersion;
+	uint64_t depthDeviceTimestampUsec;
+	uint64_t colorDeviceTimestampUsec;
+	uint64_t irDeviceTimestampUsec;
+	uint64_t depthHostTimestampNsec;
+	uint64_t publishHostTimestampNsec;
+};
+
+// One mapped view of a named shared memory object
+class SharedMemoryMapping
+{
+public:
+	SharedMemoryMapping() {}
+	~SharedMemoryMapping();
+
+	SharedMemoryMapping(const SharedMemoryMapping &) = delete;
+	SharedMemoryMapping &operator=(const SharedMemoryMapping &) = delete;
+
+	// Names are plain, without the platform's prefix or slashes. Creating replaces what an earlier
+	// publisher left behind under the same name.
+	bool TryCreate(const std::string &name, size_t size);
+	bool TryOpen(const std::string &name);
+	void Close();
+
+	uint8_t *GetData() const { return data; }
+	size_t GetSize() const { return size; }
+
+private:
+	uint8_t *data = nullptr;
+	size_t size = 0;
+	bool created = false;
+	std::string platformName;
+#ifdef _WIN32
+	void *handle = nullptr;
+#endif
+};
+
+// The publishing side, one per device. Only one thread publishes, Publish copies the images into the
+// next slot and never waits for readers.
+class SharedFrameWriter
+{
+public:
+	~SharedFrameWriter();
+
+	// maxWidth and maxHeight bound every image published later, slotCount is at least two
+	bool TryCreate(const std::string &name, int slotCount, int maxWidth, int maxHeight);
+	void Close();
+
+	void SetCalibration(
+		const uint8_t *data,
+		size_t size,
+		int depthMode,
+		int colorResolution,
+		uint32_t calibrationVersion);
+	// Images are tightly packed, any of them can be null and its flag is cleared. Returns the bytes copied.
+	uint64_t Publish(
+		const SharedFrameInfo &info,
+		const uint16_t *depthData,
+		const uint8_t *colorData,
+		const uint16_t *irData);
+
+	size_t GetMappingSize() const { return mapping.GetSize(); }
+	int GetSlotCount() const { return header != nullptr ? (int)header->slotCount : 0; }
+
+private:
+	SharedMemoryMapping mapping;
+	SharedFrameRingHeader *header = nullptr;
+	uint64_t sequence = 0;
+};
+
+// One frame as the reader sees it. The pointers lead straight into the mapping, nothing is copied, and
+// stay readable until the publisher comes around to the slot again slotCount frames later. Check
+// SharedFrameReader::IsValid once done with the data to know whether that happened.
+struct SharedFrame
+{
+	uint64_t seq;
+	uint64_t sequence;
+	uint64_t frameSequence;
+	uint32_t flags;
+	uint32_t width;
+	uint32_t height;
+	uint32_t calibrationVersion;
+	uint64_t depthDeviceTimestampUsec;
+	uint64_t colorDeviceTimestampUsec;
+	uint64_t irDeviceTimestampUsec;
+	uint64_t depthHostTimestampNsec;
+	uint64_t publishHostTimestampNsec;
+	const uint16_t *depthData;
+	const uint8_t *colorData;
+	const uint16_t *irData;
+	const SharedFrameSlotHeader *slot;
+};
+
+// The subscribing side, usable from any process. Readers never write to the mapping, any number of
+// them can follow one publisher.
+class SharedFrameReader
+{
+public:
+	struct Stats
+	{
+		uint64_t acquiredCount;
+		// The publisher was writing the slot or overwrote it before the reader could start
+		uint64_t retryCount;
+		// IsValid calls that found the slot overwritten while the reader was using it
+		uint64_t tornCount;
+		// Ring sequences that were published but never acquired
+		uint64_t skippedCount;
+	};
+
+	bool TryOpen(const std::string &name);
+	void Close();
+	bool IsOpen() const { return header != nullptr; }
+	// The publisher stopped, the reader has to reopen the name to follow a new one
+	bool IsClosed() const;
+
+	uint64_t GetLatestSequence() const;
+	// Polls until a frame newer than sequence is published, returns false on timeout
+	bool TryWaitForFrame(uint64_t sequence, int timeoutMilliseconds) const;
+	// The newest complete frame, false before the first one or when the publisher kept overwriting it
+	bool TryAcquireLatest(SharedFrame &frame);
+	// True while nothing has overwritten the frame since it was acquired
+	bool IsValid(const SharedFrame &frame);
+	bool TryCopyCalibration(
+		std::vector<uint8_t> &data,
+		int *depthMode,
+		int *colorResolution,
+		uint32_t *calibrationVersion);
+
+	Stats GetStats() const { return stats; }
+
+private:
+	SharedMemoryMapping mapping;
+	const SharedFrameRingHeader *header = nullptr;
+	uint64_t lastSequence = 0;
+	Stats stats = {};
+};
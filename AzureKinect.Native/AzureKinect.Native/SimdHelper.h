@@ -0,0 +1,7 @@
+#pragma once
+
+// SSE2 is part of the x64 baseline, other targets fall back to the scalar paths
+#if defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define AZUREKINECT_SSE2 1
+#include <emmintrin.h>
+#endif
@@ -0,0 +1,193 @@
+#include "pch.h"
+#include "TextureUploadQueue.h"
+
+TextureUploadQueue::TextureUploadQueue(std::unique_ptr<TextureUploadBackend> backend) :
+	backend(std::move(backend))
+{
+}
+
+TextureUploadQueue::~TextureUploadQueue()
+{
+	std::lock_guard<std::mutex> lock(targetMutex);
+	for (auto &target : targets)
+	{
+		ReleaseTarget(target);
+	}
+}
+
+int TextureUploadQueue::RegisterTarget(ID3D11Texture2D *texture, int width, int height, int stride)
+{
+	std::lock_guard<std::mutex> lock(targetMutex);
+	for (int index = 0; index < MaxTargets; index++)
+	{
+		Target &target = targets[index];
+		if (target.texture != nullptr)
+		{
+			continue;
+		}
+
+		target.width = width;
+		target.height = height;
+		target.stride = stride;
+		target.size = stride * height;
+		for (int i = 0; i < 3; i++)
+		{
+			target.buffers[i] = ImagePool::GetShared().Acquire(target.size, target.sizeClasses[i]);
+		}
+
+		target.backIndex = 0;
+		target.frontIndex = 2;
+		target.pending.store(1);
+		target.texture = texture;
+		return index;
+	}
+
+	OutputDebugString(L"No upload targets left, falling back to direct uploads");
+	return -1;
+}
+
+void TextureUploadQueue::UnregisterTarget(int target)
+{
+	if (target < 0 || target >= MaxTargets)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(targetMutex);
+	ReleaseTarget(targets[target]);
+}
+
+uint64_t TextureUploadQueue::GetTargetBytes(int target)
+{
+	if (target < 0 || target >= MaxTargets)
+	{
+		return 0;
+	}
+
+	std::lock_guard<std::mutex> lock(targetMutex);
+	const Target &entry = targets[target];
+	if (entry.texture == nullptr)
+	{
+		return 0;
+	}
+
+	return entry.sizeClasses[0] + entry.sizeClasses[1] + entry.sizeClasses[2];
+}
+
+void TextureUploadQueue::Submit(int target, const byte *data)
+{
+	Target &entry = targets[target];
+	Submit(target, data, PixelRect{ 0, 0, entry.width, entry.height });
+}
+
+void TextureUploadQueue::Submit(int target, const byte *data, const PixelRect &rect)
+{
+	Target &entry = targets[target];
+	PixelRect uploadRect = clamp_rect(rect, entry.width, entry.height);
+
+	// Only the producer sets the dirty bit, so a frame seen pending here is either still pending at the
+	// exchange below or already uploaded. Covering its rect as well costs at most a redundant upload.
+	uint32_t pending = entry.pending.load(std::memory_order_acquire);
+	if ((pending & PendingDirty) != 0)
+	{
+		const PixelRect &pendingRect = entry.rects[pending & PendingIndexMask];
+		if (pendingRect.width > 0 && pendingRect.height > 0)
+		{
+			if (uploadRect.width == 0 || uploadRect.height == 0)
+			{
+				uploadRect = pendingRect;
+			}
+			else
+			{
+				int left = min(uploadRect.x, pendingRect.x);
+				int top = min(uploadRect.y, pendingRect.y);
+				int right = max(uploadRect.x + uploadRect.width, pendingRect.x + pendingRect.width);
+				int bottom = max(uploadRect.y + uploadRect.height, pendingRect.y + pendingRect.height);
+				uploadRect = PixelRect{ left, top, right - left, bottom - top };
+			}
+		}
+	}
+
+	int bytesPerPixel = entry.stride / entry.width;
+	if (uploadRect.x == 0 && uploadRect.width == entry.width)
+	{
+		size_t offset = static_cast<size_t>(uploadRect.y) * entry.stride;
+		memcpy(entry.buffers[entry.backIndex] + offset, data + offset, static_cast<size_t>(uploadRect.height) * entry.stride);
+	}
+	else
+	{
+		copy_rect(data, entry.buffers[entry.backIndex], entry.stride, bytesPerPixel, uploadRect);
+	}
+	entry.rects[entry.backIndex] = uploadRect;
+
+	uint32_t previous = entry.pending.exchange(static_cast<uint32_t>(entry.backIndex) | PendingDirty, std::memory_order_acq_rel);
+	entry.backIndex = static_cast<int>(previous & PendingIndexMask);
+
+	submittedCount++;
+	if ((previous & PendingDirty) != 0)
+	{
+		coalescedCount++;
+	}
+}
+
+void TextureUploadQueue::Drain()
+{
+	std::lock_guard<std::mutex> lock(targetMutex);
+	for (auto &target : targets)
+	{
+		if (target.texture == nullptr ||
+			(target.pending.load(std::memory_order_acquire) & PendingDirty) == 0)
+		{
+			continue;
+		}
+
+		uint32_t previous = target.pending.exchange(static_cast<uint32_t>(target.frontIndex), std::memory_order_acq_rel);
+		target.frontIndex = static_cast<int>(previous & PendingIndexMask);
+
+		const PixelRect &rect = target.rects[target.frontIndex];
+		if (rect.width == 0 || rect.height == 0)
+		{
+			continue;
+		}
+
+		int bytesPerPixel = target.stride / target.width;
+		size_t offset = static_cast<size_t>(rect.y) * target.stride + static_cast<size_t>(rect.x) * bytesPerPixel;
+		backend->Upload(target.texture, target.buffers[target.frontIndex] + offset, target.stride, rect);
+		uploadedCount++;
+		uploadedBytes += static_cast<uint64_t>(rect.width) * rect.height * bytesPerPixel;
+	}
+}
+
+TextureUploadQueue::Stats TextureUploadQueue::GetStats()
+{
+	Stats stats = {};
+	{
+		std::lock_guard<std::mutex> lock(targetMutex);
+		for (auto &target : targets)
+		{
+			stats.targetCount += target.texture != nullptr ? 1 : 0;
+		}
+	}
+
+	stats.submittedCount = submittedCount.load();
+	stats.uploadedCount = uploadedCount.load();
+	stats.coalescedCount = coalescedCount.load();
+	stats.uploadedBytes = uploadedBytes.load();
+	return stats;
+}
+
+void TextureUploadQueue::ReleaseTarget(Target &target)
+{
+	if (target.texture == nullptr)
+	{
+		return;
+	}
+
+	for (int i = 0; i < 3; i++)
+	{
+		ImagePool::GetShared().Release(target.buffers[i], target.sizeClasses[i]);
+		target.buffers[i] = nullptr;
+	}
+
+	target.texture = nullptr;
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+// Where drained uploads end up. The d3d11 backend writes textures through a context fetched once,
+// the counting backend lets the queue run headless without a graphics device.
+class TextureUploadBackend
+{
+public:
+	virtual ~TextureUploadBackend() {}
+	// data points at the first byte of rect, rows are stride bytes apart
+	virtual void Upload(ID3D11Texture2D *texture, const byte *data, int stride, const PixelRect &rect) = 0;
+};
+
+class D3D11UploadBackend : public TextureUploadBackend
+{
+public:
+	D3D11UploadBackend(ID3D11Device *device)
+	{
+		device->GetImmediateContext(&context);
+	}
+
+	~D3D11UploadBackend()
+	{
+		if (context != nullptr)
+		{
+			context->Release();
+		}
+	}
+
+	void Upload(ID3D11Texture2D *texture, const byte *data, int stride, const PixelRect &rect) override
+	{
+		if (context != nullptr)
+		{
+			D3D11_BOX box = {
+				static_cast<UINT>(rect.x),
+				static_cast<UINT>(rect.y),
+				0,
+				static_cast<UINT>(rect.x + rect.width),
+				static_cast<UINT>(rect.y + rect.height),
+				1 };
+			context->UpdateSubresource(texture, 0, &box, data, stride, 0);
+		}
+	}
+
+private:
+	ID3D11DeviceContext *context = nullptr;
+};
+
+class CountingUploadBackend : public TextureUploadBackend
+{
+public:
+	void Upload(ID3D11Texture2D *texture, const byte *data, int stride, const PixelRect &rect) override
+	{
+		uploadCount++;
+	}
+
+	std::atomic<uint64_t> uploadCount{ 0 };
+};
+
+// Hands texture contents from the processing thread to whichever thread owns the d3d context.
+// Every registered texture is a triple buffer: Submit fills the back buffer and swaps it into the
+// pending slot with one atomic exchange, Drain swaps the pending slot out and uploads it. A frame
+// that is still pending when a newer one is submitted is replaced, so only the newest frame per
+// texture is ever uploaded and submitting never waits on the render thread. Submissions can be limited
+// to a rect, only that part is copied and uploaded. A coalesced frame's rect is merged into the newer one.
+class TextureUploadQueue
+{
+public:
+	struct Stats
+	{
+		int targetCount;
+		uint64_t submittedCount;
+		uint64_t uploadedCount;
+		uint64_t coalescedCount;
+		uint64_t uploadedBytes;
+	};
+
+	static const int MaxTargets = 64;
+
+	TextureUploadQueue(std::unique_ptr<TextureUploadBackend> backend);
+	~TextureUploadQueue();
+
+	// Returns -1 when every target is taken
+	int RegisterTarget(ID3D11Texture2D *texture, int width, int height, int stride);
+	void UnregisterTarget(int target);
+	// Staging memory held for a target, zero for a free or invalid one
+	uint64_t GetTargetBytes(int target);
+
+	// One producer per target, data is always the whole image laid out like the texture
+	void Submit(int target, const byte *data);
+	void Submit(int target, const byte *data, const PixelRect &rect);
+	void Drain();
+
+	Stats GetStats();
+
+private:
+	static const uint32_t PendingDirty = 4;
+	static const uint32_t PendingIndexMask = 3;
+
+	struct Target
+	{
+		ID3D11Texture2D *texture = nullptr;
+		int width = 0;
+		int height = 0;
+		int stride = 0;
+		int size = 0;
+		byte *buffers[3] = {};
+		PixelRect rects[3] = {};
+		size_t sizeClasses[3] = {};
+		int backIndex = 0;
+		int frontIndex = 2;
+		std::atomic<uint32_t> pending{ 1 };
+	};
+
+	void ReleaseTarget(Target &target);
+
+	std::unique_ptr<TextureUploadBackend> backend;
+	Target targets[MaxTargets];
+
+	// Registration and draining share this, submitting never takes it
+	std::mutex targetMutex;
+
+	std::atomic<uint64_t> submittedCount{ 0 };
+	std::atomic<uint64_t> uploadedCount{ 0 };
+	std::atomic<uint64_t> coalescedCount{ 0 };
+	std::atomic<uint64_t> uploadedBytes{ 0 };
+};
@@ -0,0 +1,120 @@
+#include "pch.h"
+#include "ThreadPool.h"
+
+static thread_local bool isWorkerThread = false;
+
+ThreadPool &ThreadPool::GetShared()
+{
+	static ThreadPool sharedPool(max(std::thread::hardware_concurrency(), 2u) - 1);
+	return sharedPool;
+}
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+{
+	for (unsigned int i = 0; i < threadCount; i++)
+	{
+		workers.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(stateMutex);
+		shuttingDown = true;
+	}
+
+	workAvailable.notify_all();
+	for (auto &worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void ThreadPool::ParallelFor(int count, const std::function<void(int)> &task)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	if (count == 1 || workers.empty() || isWorkerThread)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			task(i);
+		}
+		return;
+	}
+
+	std::lock_guard<std::mutex> dispatchLock(dispatchMutex);
+	uint32_t taskGeneration;
+	{
+		// The previous dispatch's claims all finished before it returned, so nothing counts into this one
+		std::lock_guard<std::mutex> lock(stateMutex);
+		currentTask = &task;
+		taskCount = count;
+		completedCount.store(0);
+		generation++;
+		taskGeneration = static_cast<uint32_t>(generation);
+		nextClaim.store(static_cast<uint64_t>(taskGeneration) << 32);
+	}
+
+	workAvailable.notify_all();
+	RunTasks(taskGeneration, &task, count);
+
+	std::unique_lock<std::mutex> lock(stateMutex);
+	workDone.wait(lock, [&] { return activeWorkers == 0 && completedCount.load() == count; });
+	currentTask = nullptr;
+	taskCount = 0;
+}
+
+void ThreadPool::WorkerLoop()
+{
+	isWorkerThread = true;
+	uint64_t seenGeneration = 0;
+
+	std::unique_lock<std::mutex> lock(stateMutex);
+	while (true)
+	{
+		workAvailable.wait(lock, [&] { return shuttingDown || generation != seenGeneration; });
+		if (shuttingDown)
+		{
+			return;
+		}
+
+		// A dispatch that already returned left no task behind, and its generation is not claimable anymore
+		seenGeneration = generation;
+		const std::function<void(int)> *task = currentTask;
+		int count = taskCount;
+		if (task == nullptr)
+		{
+			continue;
+		}
+
+		activeWorkers++;
+		lock.unlock();
+
+		RunTasks(static_cast<uint32_t>(seenGeneration), task, count);
+
+		lock.lock();
+		activeWorkers--;
+		workDone.notify_all();
+	}
+}
+
+void ThreadPool::RunTasks(uint32_t taskGeneration, const std::function<void(int)> *task, int count)
+{
+	uint64_t claim = nextClaim.load();
+	while (static_cast<uint32_t>(claim >> 32) == taskGeneration &&
+		static_cast<int>(claim & 0xffffffff) < count)
+	{
+		// A failed exchange reloads claim, which then either names another index or a newer dispatch
+		if (nextClaim.compare_exchange_weak(claim, claim + 1))
+		{
+			(*task)(static_cast<int>(claim & 0xffffffff));
+			completedCount.fetch_add(1);
+			claim = nextClaim.load();
+		}
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Fixed set of worker threads shared by the CPU processing stages. ParallelFor blocks until every
+// task index has run, with the calling thread helping out. Calls made from a worker thread run inline.
+class ThreadPool
+{
+public:
+	static ThreadPool &GetShared();
+
+	ThreadPool(unsigned int threadCount);
+	~ThreadPool();
+
+	unsigned int GetThreadCount() const
+	{
+		return static_cast<unsigned int>(workers.size()) + 1;
+	}
+
+	void ParallelFor(int count, const std::function<void(int)> &task);
+
+private:
+	void WorkerLoop();
+	// Claims and runs indices of the given dispatch until it has none left. Claims carry the dispatch's
+	// generation, so a worker that wakes late for one that already returned can never claim an index
+	// of the next.
+	void RunTasks(uint32_t taskGeneration, const std::function<void(int)> *task, int count);
+
+	std::vector<std::thread> workers;
+	std::mutex dispatchMutex;
+	std::mutex stateMutex;
+	std::condition_variable workAvailable;
+	std::condition_variable workDone;
+
+	// Guarded by stateMutex, workers take a copy when they wake
+	const std::function<void(int)> *currentTask = nullptr;
+	int taskCount = 0;
+	// Generation in the high half, the next index to claim in the low half
+	std::atomic<uint64_t> nextClaim{ 0 };
+	std::atomic<int> completedCount{ 0 };
+	int activeWorkers = 0;
+	uint64_t generation = 0;
+	bool shuttingDown = false;
+};
@@ -0,0 +1,24 @@
+#pragma once
+#include <chrono>
+
+class TimingHelper
+{
+public:
+	static int64_t GetTimestampMicroseconds()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// Same clock the sdk stamps system timestamps with, QueryPerformanceCounter on windows
+	static int64_t GetTimestampNanoseconds()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static float GetElapsedMilliseconds(int64_t startMicroseconds)
+	{
+		return (GetTimestampMicroseconds() - startMicroseconds) / 1000.0f;
+	}
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+// Linearly maps [min_value, max_value] of a 16 bit image onto 0-255, clamping values outside of the range.
+// Ranges narrower than 256 are widened to 256 so the fixed point scale fits in 16 bits.
+static void tone_map_16_to_8(const uint16_t *src, uint8_t *dst, int count, uint16_t min_value, uint16_t max_value)
+{
+	int range = (int)max_value - (int)min_value;
+	if (range < 256)
+	{
+		range = 256;
+	}
+
+	// 0.16 fixed point scale, out = ((value - min) * scale) >> 16
+	const uint32_t scale = (255u << 16) / (uint32_t)range;
+	int i = 0;
+
+#ifdef AZUREKINECT_SSE2
+	const __m128i min_vector = _mm_set1_epi16((short)min_value);
+	const __m128i range_vector = _mm_set1_epi16((short)range);
+	const __m128i scale_vector = _mm_set1_epi16((short)scale);
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i lo = _mm_subs_epu16(_mm_loadu_si128((const __m128i *)(src + i)), min_vector);
+		__m128i hi = _mm_subs_epu16(_mm_loadu_si128((const __m128i *)(src + i + 8)), min_vector);
+
+		// Unsigned min(value, range) without SSE4.1
+		lo = _mm_sub_epi16(lo, _mm_subs_epu16(lo, range_vector));
+		hi = _mm_sub_epi16(hi, _mm_subs_epu16(hi, range_vector));
+
+		lo = _mm_mulhi_epu16(lo, scale_vector);
+		hi = _mm_mulhi_epu16(hi, scale_vector);
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		uint32_t value = src[i] > min_value ? (uint32_t)(src[i] - min_value) : 0u;
+		if (value > (uint32_t)range)
+		{
+			value = (uint32_t)range;
+		}
+		dst[i] = (uint8_t)((value * scale) >> 16);
+	}
+}
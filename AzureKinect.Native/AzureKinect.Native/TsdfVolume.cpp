@@ -0,0 +1,393 @@
+#include "pch.h"
+#include "TsdfVolume.h"
+
+static int FloorDivide(int value, int divisor)
+{
+	return value >= 0 ? value / divisor : (value - divisor + 1) / divisor;
+}
+
+TsdfVolume::TsdfVolume(const k4a_calibration_t &calibration, float voxelSize, float truncationDistance)
+{
+	InitializeCriticalSection(&volumeCritSec);
+	this->calibration = calibration;
+	this->voxelSize = voxelSize > 0.0f ? voxelSize : 10.0f;
+	this->truncationDistance = truncationDistance > 0.0f ? truncationDistance : 4.0f * this->voxelSize;
+	maxWeight = 64.0f;
+	frameIndex = 0;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		boundsMin[axis] = INT_MAX;
+		boundsMax[axis] = INT_MIN;
+	}
+	stats = Stats{ 0, 0, 0, 0.0f, 0.0f, 0.0f };
+
+	pinhole = {};
+	undistortionLut = nullptr;
+	undistortedDepthImage = nullptr;
+	SetCalibration(calibration);
+}
+
+TsdfVolume::~TsdfVolume()
+{
+	k4a_image_release(undistortionLut);
+	k4a_image_release(undistortedDepthImage);
+	DeleteCriticalSection(&volumeCritSec);
+}
+
+void TsdfVolume::SetCalibration(const k4a_calibration_t &calibration)
+{
+	EnterCriticalSection(&volumeCritSec);
+	this->calibration = calibration;
+
+	// The images only go back to the pool when the pinhole changed size, the lut is rebuilt either way
+	pinhole_t newPinhole = create_pinhole_from_xy_range(&this->calibration, K4A_CALIBRATION_TYPE_DEPTH);
+	if (undistortionLut == nullptr ||
+		newPinhole.width != pinhole.width ||
+		newPinhole.height != pinhole.height)
+	{
+		if (undistortionLut != nullptr)
+		{
+			k4a_image_release(undistortionLut);
+			k4a_image_release(undistortedDepthImage);
+		}
+
+		ImagePool::GetShared().TryCreateImage(K4A_IMAGE_FORMAT_CUSTOM,
+			newPinhole.width,
+			newPinhole.height,
+			newPinhole.width * (int)sizeof(lut_entry_t),
+			&undistortionLut);
+
+		ImagePool::GetShared().TryCreateImage(K4A_IMAGE_FORMAT_DEPTH16,
+			newPinhole.width,
+			newPinhole.height,
+			newPinhole.width * (int)sizeof(uint16_t),
+			&undistortedDepthImage);
+	}
+
+	pinhole = newPinhole;
+	create_undistortion_lut(&this->calibration, K4A_CALIBRATION_TYPE_DEPTH, &pinhole, undistortionLut, INTERPOLATION_NEARESTNEIGHBOR);
+	LeaveCriticalSection(&volumeCritSec);
+}
+
+bool TsdfVolume::Integrate(const uint16_t *depthData, int width, int height, const float *cameraToWorld)
+{
+	EnterCriticalSection(&volumeCritSec);
+	int depthWidth = calibration.depth_camera_calibration.resolution_width;
+	int depthHeight = calibration.depth_camera_calibration.resolution_height;
+	if (width != depthWidth ||
+		height != depthHeight)
+	{
+		LeaveCriticalSection(&volumeCritSec);
+		return false;
+	}
+
+	auto start = TimingHelper::GetTimestampMicroseconds();
+	frameIndex++;
+
+	k4a_image_t depthImage;
+	k4a_image_create_from_buffer(K4A_IMAGE_FORMAT_DEPTH16,
+		depthWidth,
+		depthHeight,
+		depthWidth * (int)sizeof(uint16_t),
+		const_cast<uint8_t*>(reinterpret_cast<const uint8_t*>(depthData)),
+		depthWidth * depthHeight * sizeof(uint16_t),
+		nullptr,
+		nullptr,
+		&depthImage);
+	remap(depthImage, undistortionLut, undistortedDepthImage, INTERPOLATION_NEARESTNEIGHBOR);
+	k4a_image_release(depthImage);
+	const uint16_t *undistortedDepth = reinterpret_cast<uint16_t*>(k4a_image_get_buffer(undistortedDepthImage));
+
+	// Allocate every block the truncation band passes through. Blocks are much larger than a pixel
+	// footprint, so every other pixel in each direction is enough to find them.
+	const float *m = cameraToWorld;
+	const float inverseBlockExtent = 1.0f / (BlockSize * voxelSize);
+	const float sampleStep = 0.5f * BlockSize * voxelSize;
+	uint64_t previousKey = ~0ull;
+	visibleBlocks.clear();
+
+	for (int v = 0; v < pinhole.height; v += 2)
+	{
+		float rayY = ((float)v - pinhole.py) / pinhole.fy;
+		for (int u = 0; u < pinhole.width; u += 2)
+		{
+			uint16_t depth = undistortedDepth[v * pinhole.width + u];
+			if (depth == 0)
+			{
+				continue;
+			}
+
+			float rayX = ((float)u - pinhole.px) / pinhole.fx;
+			float zEnd = depth + truncationDistance;
+			for (float z = max(depth - truncationDistance, 1.0f); z < zEnd + sampleStep; z += sampleStep)
+			{
+				float cz = min(z, zEnd);
+				float cx = rayX * cz;
+				float cy = rayY * cz;
+				int bx = static_cast<int>(floorf((m[0] * cx + m[1] * cy + m[2] * cz + m[3]) * inverseBlockExtent));
+				int by = static_cast<int>(floorf((m[4] * cx + m[5] * cy + m[6] * cz + m[7]) * inverseBlockExtent));
+				int bz = static_cast<int>(floorf((m[8] * cx + m[9] * cy + m[10] * cz + m[11]) * inverseBlockExtent));
+
+				uint64_t key = GetBlockKey(bx, by, bz);
+				if (key != previousKey)
+				{
+					AllocateBlock(bx, by, bz);
+					previousKey = key;
+				}
+			}
+		}
+	}
+
+	stats.allocationMilliseconds = TimingHelper::GetElapsedMilliseconds(start);
+	start = TimingHelper::GetTimestampMicroseconds();
+
+	// Inverse of the rigid camera to world transform
+	const float worldToCamera[12] = {
+		m[0], m[4], m[8], -(m[0] * m[3] + m[4] * m[7] + m[8] * m[11]),
+		m[1], m[5], m[9], -(m[1] * m[3] + m[5] * m[7] + m[9] * m[11]),
+		m[2], m[6], m[10], -(m[2] * m[3] + m[6] * m[7] + m[10] * m[11]) };
+
+	ThreadPool::GetShared().ParallelFor(static_cast<int>(visibleBlocks.size()), [&](int i)
+	{
+		IntegrateBlock(*blocks[visibleBlocks[i]], worldToCamera, undistortedDepth);
+	});
+
+	stats.frameCount = frameIndex;
+	stats.blockCount = static_cast<int>(blocks.size());
+	stats.integratedBlockCount = static_cast<int>(visibleBlocks.size());
+	stats.integrationMilliseconds = TimingHelper::GetElapsedMilliseconds(start);
+	LeaveCriticalSection(&volumeCritSec);
+	return true;
+}
+
+int TsdfVolume::Raycast(const float *cameraToWorld, float *points, int pointCapacity)
+{
+	// The pinhole changes with the calibration, so it is only read under the lock
+	EnterCriticalSection(&volumeCritSec);
+	const int pixelCount = pinhole.width * pinhole.height;
+	if (pointCapacity < pixelCount)
+	{
+		LeaveCriticalSection(&volumeCritSec);
+		return 0;
+	}
+
+	auto start = TimingHelper::GetTimestampMicroseconds();
+
+	const float *m = cameraToWorld;
+	const float origin[3] = { m[3], m[7], m[11] };
+	const float blockExtent = BlockSize * voxelSize;
+	const float inverseVoxelSize = 1.0f / voxelSize;
+	std::atomic<int> hitCount{ 0 };
+
+	ThreadPool::GetShared().ParallelFor(pinhole.height, [&](int v)
+	{
+		const VoxelBlock *cachedBlock = nullptr;
+		int cachedBlockCoordinates[3] = { INT_MIN, INT_MIN, INT_MIN };
+		int rowHits = 0;
+
+		for (int u = 0; u < pinhole.width; u++)
+		{
+			float *point = &points[3 * (v * pinhole.width + u)];
+			point[0] = point[1] = point[2] = nanf("");
+			if (blocks.empty())
+			{
+				continue;
+			}
+
+			// Ray through the pixel, parameterized by camera depth
+			float cameraRay[3] = { ((float)u - pinhole.px) / pinhole.fx, ((float)v - pinhole.py) / pinhole.fy, 1.0f };
+			float ray[3];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				ray[axis] = m[4 * axis] * cameraRay[0] + m[4 * axis + 1] * cameraRay[1] + m[4 * axis + 2] * cameraRay[2];
+			}
+
+			// Clip against the bounds of the allocated blocks
+			float tEnter = 0.0f;
+			float tExit = FLT_MAX;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				float low = boundsMin[axis] * blockExtent;
+				float high = (boundsMax[axis] + 1) * blockExtent;
+				if (fabsf(ray[axis]) < 1e-9f)
+				{
+					if (origin[axis] < low || origin[axis] > high)
+					{
+						tExit = -1.0f;
+					}
+					continue;
+				}
+
+				float t0 = (low - origin[axis]) / ray[axis];
+				float t1 = (high - origin[axis]) / ray[axis];
+				tEnter = max(tEnter, min(t0, t1));
+				tExit = min(tExit, max(t0, t1));
+			}
+
+			const float step = 0.5f * truncationDistance / sqrtf(ray[0] * ray[0] + ray[1] * ray[1] + ray[2] * ray[2]);
+			bool hasPrevious = false;
+			float previousTsdf = 0.0f;
+			for (float t = tEnter; t <= tExit; t += step)
+			{
+				int voxel[3];
+				int block[3];
+				for (int axis = 0; axis < 3; axis++)
+				{
+					voxel[axis] = static_cast<int>(floorf((origin[axis] + ray[axis] * t) * inverseVoxelSize));
+					block[axis] = FloorDivide(voxel[axis], BlockSize);
+				}
+
+				if (block[0] != cachedBlockCoordinates[0] ||
+					block[1] != cachedBlockCoordinates[1] ||
+					block[2] != cachedBlockCoordinates[2])
+				{
+					cachedBlock = FindBlock(block[0], block[1], block[2]);
+					memcpy(cachedBlockCoordinates, block, sizeof(block));
+				}
+
+				const Voxel *sample = nullptr;
+				if (cachedBlock != nullptr)
+				{
+					int local = ((voxel[2] - block[2] * BlockSize) * BlockSize + (voxel[1] - block[1] * BlockSize)) * BlockSize +
+						(voxel[0] - block[0] * BlockSize);
+					sample = &cachedBlock->voxels[local];
+				}
+
+				if (sample == nullptr || sample->weight == 0.0f)
+				{
+					hasPrevious = false;
+					continue;
+				}
+
+				if (hasPrevious && previousTsdf > 0.0f && sample->tsdf <= 0.0f)
+				{
+					// Interpolate the zero crossing between the last two samples
+					float tHit = t - step + step * previousTsdf / (previousTsdf - sample->tsdf);
+					point[0] = origin[0] + ray[0] * tHit;
+					point[1] = origin[1] + ray[1] * tHit;
+					point[2] = origin[2] + ray[2] * tHit;
+					rowHits++;
+					break;
+				}
+
+				if (hasPrevious && previousTsdf < 0.0f && sample->tsdf > 0.0f)
+				{
+					// Leaving a surface from behind
+					break;
+				}
+
+				previousTsdf = sample->tsdf;
+				hasPrevious = true;
+			}
+		}
+
+		hitCount.fetch_add(rowHits);
+	});
+
+	stats.raycastMilliseconds = TimingHelper::GetElapsedMilliseconds(start);
+	LeaveCriticalSection(&volumeCritSec);
+	return hitCount.load();
+}
+
+TsdfVolume::Stats TsdfVolume::GetStats()
+{
+	EnterCriticalSection(&volumeCritSec);
+	Stats result = stats;
+	LeaveCriticalSection(&volumeCritSec);
+	return result;
+}
+
+void TsdfVolume::AllocateBlock(int x, int y, int z)
+{
+	int index;
+	auto existing = blockLookup.find(GetBlockKey(x, y, z));
+	if (existing == blockLookup.end())
+	{
+		index = static_cast<int>(blocks.size());
+		std::unique_ptr<VoxelBlock> block(new VoxelBlock);
+		block->x = x;
+		block->y = y;
+		block->z = z;
+		block->lastIntegratedFrame = 0;
+		for (int i = 0; i < BlockVoxelCount; i++)
+		{
+			block->voxels[i] = Voxel{ 1.0f, 0.0f };
+		}
+
+		blocks.push_back(std::move(block));
+		blockLookup[GetBlockKey(x, y, z)] = index;
+
+		boundsMin[0] = min(boundsMin[0], x);
+		boundsMin[1] = min(boundsMin[1], y);
+		boundsMin[2] = min(boundsMin[2], z);
+		boundsMax[0] = max(boundsMax[0], x);
+		boundsMax[1] = max(boundsMax[1], y);
+		boundsMax[2] = max(boundsMax[2], z);
+	}
+	else
+	{
+		index = existing->second;
+	}
+
+	if (blocks[index]->lastIntegratedFrame != frameIndex)
+	{
+		blocks[index]->lastIntegratedFrame = frameIndex;
+		visibleBlocks.push_back(index);
+	}
+}
+
+void TsdfVolume::IntegrateBlock(VoxelBlock &block, const float *worldToCamera, const uint16_t *depthData)
+{
+	const float *m = worldToCamera;
+	const float inverseTruncation = 1.0f / truncationDistance;
+
+	for (int k = 0; k < BlockSize; k++)
+	{
+		float wz = (block.z * BlockSize + k + 0.5f) * voxelSize;
+		for (int j = 0; j < BlockSize; j++)
+		{
+			float wy = (block.y * BlockSize + j + 0.5f) * voxelSize;
+			for (int i = 0; i < BlockSize; i++)
+			{
+				float wx = (block.x * BlockSize + i + 0.5f) * voxelSize;
+				float cz = m[8] * wx + m[9] * wy + m[10] * wz + m[11];
+				if (cz <= 0.0f)
+				{
+					continue;
+				}
+
+				float cx = m[0] * wx + m[1] * wy + m[2] * wz + m[3];
+				float cy = m[4] * wx + m[5] * wy + m[6] * wz + m[7];
+				int u = static_cast<int>(floorf(pinhole.fx * cx / cz + pinhole.px + 0.5f));
+				int v = static_cast<int>(floorf(pinhole.fy * cy / cz + pinhole.py + 0.5f));
+				if (u < 0 || u >= pinhole.width || v < 0 || v >= pinhole.height)
+				{
+					continue;
+				}
+
+				uint16_t depth = depthData[v * pinhole.width + u];
+				if (depth == 0)
+				{
+					continue;
+				}
+
+				float sdf = depth - cz;
+				if (sdf < -truncationDistance)
+				{
+					continue;
+				}
+
+				Voxel &voxel = block.voxels[(k * BlockSize + j) * BlockSize + i];
+				float tsdf = min(1.0f, sdf * inverseTruncation);
+				voxel.tsdf = (voxel.tsdf * voxel.weight + tsdf) / (voxel.weight + 1.0f);
+				voxel.weight = min(voxel.weight + 1.0f, maxWeight);
+			}
+		}
+	}
+}
+
+const TsdfVolume::VoxelBlock *TsdfVolume::FindBlock(int x, int y, int z) const
+{
+	auto existing = blockLookup.find(GetBlockKey(x, y, z));
+	return existing != blockLookup.end() ? blocks[existing->second].get() : nullptr;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+// Truncated signed distance volume stored as sparse 8x8x8 voxel blocks in a hash map. Depth frames
+// are first remapped onto a pinhole camera with UndistortHelper so voxels project with a single
+// divide, then every block near the observed surface is integrated in parallel on the CPU.
+// Distances and poses are in millimeters, poses are row-major camera to world transforms.
+class TsdfVolume
+{
+public:
+	struct Stats
+	{
+		int frameCount;
+		int blockCount;
+		int integratedBlockCount;
+		float allocationMilliseconds;
+		float integrationMilliseconds;
+		float raycastMilliseconds;
+	};
+
+	TsdfVolume(const k4a_calibration_t &calibration, float voxelSize, float truncationDistance);
+	~TsdfVolume();
+
+	int GetWidth() const
+	{
+		return pinhole.width;
+	}
+
+	int GetHeight() const
+	{
+		return pinhole.height;
+	}
+
+	// Swaps the projection after a depth mode change, the integrated blocks are kept since they live in world space
+	void SetCalibration(const k4a_calibration_t &calibration);
+	// False when the depth image does not have the calibration's size, as after a depth mode change
+	bool Integrate(const uint16_t *depthData, int width, int height, const float *cameraToWorld);
+	int Raycast(const float *cameraToWorld, float *points, int pointCapacity);
+	Stats GetStats();
+
+private:
+	static const int BlockSize = 8;
+	static const int BlockVoxelCount = BlockSize * BlockSize * BlockSize;
+
+	struct Voxel
+	{
+		float tsdf;
+		float weight;
+	};
+
+	struct VoxelBlock
+	{
+		int x;
+		int y;
+		int z;
+		int lastIntegratedFrame;
+		Voxel voxels[BlockVoxelCount];
+	};
+
+	static uint64_t GetBlockKey(int x, int y, int z)
+	{
+		return (static_cast<uint64_t>(x + (1 << 20)) & 0x1FFFFF) |
+			((static_cast<uint64_t>(y + (1 << 20)) & 0x1FFFFF) << 21) |
+			((static_cast<uint64_t>(z + (1 << 20)) & 0x1FFFFF) << 42);
+	}
+
+	void AllocateBlock(int x, int y, int z);
+	void IntegrateBlock(VoxelBlock &block, const float *worldToCamera, const uint16_t *depthData);
+	const VoxelBlock *FindBlock(int x, int y, int z) const;
+
+	k4a_calibration_t calibration;
+	pinhole_t pinhole;
+	k4a_image_t undistortionLut;
+	k4a_image_t undistortedDepthImage;
+	float voxelSize;
+	float truncationDistance;
+	float maxWeight;
+	int frameIndex;
+	int boundsMin[3];
+	int boundsMax[3];
+
+	std::unordered_map<uint64_t, int> blockLookup;
+	std::vector<std::unique_ptr<VoxelBlock>> blocks;
+	std::vector<int> visibleBlocks;
+
+	Stats stats;
+	CRITICAL_SECTION volumeCritSec;
+};
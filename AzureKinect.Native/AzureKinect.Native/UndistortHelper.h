@@ -2,8 +2,8 @@
 
 #include "k4a/k4a.h"
 #include <math.h>
-
-#define INVALID INT32_MIN
+#include "SimdHelper.h"
+#include "ThreadPool.h"
 
 typedef struct _pinhole_t
 {
@@ -16,12 +16,17 @@ typedef struct _pinhole_t
 	int height;
 } pinhole_t;
 
-typedef struct _coordinate_t
+// One lookup entry per destination pixel. offset is the linear index of the source pixel, the top left
+// neighbor for bilinear entries, or -1 when the ray does not land on the image. The weights of the four
+// neighbors are fixed point and always sum to exactly 1 << LUT_WEIGHT_BITS.
+typedef struct _lut_entry_t
 {
-	int x;
-	int y;
-	float weight[4];
-} coordinate_t;
+	int32_t offset;
+	uint16_t weight[4];
+} lut_entry_t;
+
+#define LUT_WEIGHT_BITS 14
+#define LUT_WEIGHT_ONE (1 << LUT_WEIGHT_BITS)
 
 typedef enum
 {
@@ -31,6 +36,66 @@ typedef enum
 												 data with value 0 */
 } interpolation_t;
 
+// Images a device can stream remapped onto its pinhole camera
+enum UndistortedStream
+{
+	UndistortedStreamDepth = 0,
+	UndistortedStreamIR = 1
+};
+
+// Walks from the image center along one axis towards limit and returns the unit plane ray of the last
+// valid pixel. Validity only flips once along the way, so the boundary is found by bisection.
+static bool search_valid_ray(const k4a_calibration_t *calibration,
+	const k4a_calibration_type_t camera,
+	const float center_u,
+	const float center_v,
+	const int axis,
+	const float limit,
+	k4a_float3_t &ray)
+{
+	// Well below the quarter pixel steps this used to take
+	const float tolerance = 1.f / 64.f;
+
+	int valid;
+	k4a_float2_t p;
+	p.xy.x = center_u;
+	p.xy.y = center_v;
+	k4a_calibration_2d_to_3d(calibration, &p, 1.f, camera, camera, &ray, &valid);
+	if (!valid)
+	{
+		return false;
+	}
+
+	k4a_float3_t limit_ray;
+	p.v[axis] = limit;
+	k4a_calibration_2d_to_3d(calibration, &p, 1.f, camera, camera, &limit_ray, &valid);
+	if (valid)
+	{
+		ray = limit_ray;
+		return true;
+	}
+
+	float inside = axis == 0 ? center_u : center_v;
+	float outside = limit;
+	while (fabsf(outside - inside) > tolerance)
+	{
+		k4a_float3_t mid_ray;
+		p.v[axis] = 0.5f * (inside + outside);
+		k4a_calibration_2d_to_3d(calibration, &p, 1.f, camera, camera, &mid_ray, &valid);
+		if (valid)
+		{
+			inside = p.v[axis];
+			ray = mid_ray;
+		}
+		else
+		{
+			outside = p.v[axis];
+		}
+	}
+
+	return true;
+}
+
 // Compute a conservative bounding box on the unit plane in which all the points have valid projections
 static void compute_xy_range(const k4a_calibration_t *calibration,
 	const k4a_calibration_type_t camera,
@@ -41,73 +106,24 @@ static void compute_xy_range(const k4a_calibration_t *calibration,
 	float &y_min,
 	float &y_max)
 {
-	// Step outward from the centre point until we find the bounds of valid projection
-	const float step_u = 0.25f;
-	const float step_v = 0.25f;
-	const float min_u = 0;
-	const float min_v = 0;
-	const float max_u = (float)width - 1;
-	const float max_v = (float)height - 1;
 	const float center_u = 0.5f * width;
 	const float center_v = 0.5f * height;
 
-	int valid;
-	k4a_float2_t p;
 	k4a_float3_t ray;
-
-	// search x_min
-	for (float uv[2] = { center_u, center_v }; uv[0] >= min_u; uv[0] -= step_u)
+	if (search_valid_ray(calibration, camera, center_u, center_v, 0, 0.f, ray))
 	{
-		p.xy.x = uv[0];
-		p.xy.y = uv[1];
-		k4a_calibration_2d_to_3d(calibration, &p, 1.f, camera, camera, &ray, &valid);
-
-		if (!valid)
-		{
-			break;
-		}
 		x_min = ray.xyz.x;
 	}
-
-	// search x_max
-	for (float uv[2] = { center_u, center_v }; uv[0] <= max_u; uv[0] += step_u)
+	if (search_valid_ray(calibration, camera, center_u, center_v, 0, (float)width - 1, ray))
 	{
-		p.xy.x = uv[0];
-		p.xy.y = uv[1];
-		k4a_calibration_2d_to_3d(calibration, &p, 1.f, camera, camera, &ray, &valid);
-
-		if (!valid)
-		{
-			break;
-		}
 		x_max = ray.xyz.x;
 	}
-
-	// search y_min
-	for (float uv[2] = { center_u, center_v }; uv[1] >= min_v; uv[1] -= step_v)
+	if (search_valid_ray(calibration, camera, center_u, center_v, 1, 0.f, ray))
 	{
-		p.xy.x = uv[0];
-		p.xy.y = uv[1];
-		k4a_calibration_2d_to_3d(calibration, &p, 1.f, camera, camera, &ray, &valid);
-
-		if (!valid)
-		{
-			break;
-		}
 		y_min = ray.xyz.y;
 	}
-
-	// search y_max
-	for (float uv[2] = { center_u, center_v }; uv[1] <= max_v; uv[1] += step_v)
+	if (search_valid_ray(calibration, camera, center_u, center_v, 1, (float)height - 1, ray))
 	{
-		p.xy.x = uv[0];
-		p.xy.y = uv[1];
-		k4a_calibration_2d_to_3d(calibration, &p, 1.f, camera, camera, &ray, &valid);
-
-		if (!valid)
-		{
-			break;
-		}
 		y_max = ray.xyz.y;
 	}
 }
@@ -142,16 +158,14 @@ static pinhole_t create_pinhole_from_xy_range(const k4a_calibration_t *calibrati
 	return pinhole;
 }
 
+// Rows are filled in parallel, the sdk projection is a pure function of the calibration
 static void create_undistortion_lut(const k4a_calibration_t *calibration,
 	const k4a_calibration_type_t camera,
 	const pinhole_t *pinhole,
 	k4a_image_t lut,
 	interpolation_t type)
 {
-	coordinate_t *lut_data = (coordinate_t *)(void *)k4a_image_get_buffer(lut);
-
-	k4a_float3_t ray;
-	ray.xyz.z = 1.f;
+	lut_entry_t *lut_data = (lut_entry_t *)(void *)k4a_image_get_buffer(lut);
 
 	int src_width = calibration->depth_camera_calibration.resolution_width;
 	int src_height = calibration->depth_camera_calibration.resolution_height;
@@ -161,11 +175,25 @@ static void create_undistortion_lut(const k4a_calibration_t *calibration,
 		src_height = calibration->color_camera_calibration.resolution_height;
 	}
 
-	for (int y = 0, idx = 0; y < pinhole->height; y++)
+	if (type != INTERPOLATION_NEARESTNEIGHBOR && type != INTERPOLATION_BILINEAR && type != INTERPOLATION_BILINEAR_DEPTH)
 	{
+		OutputDebugString(L"Unexpected interpolation type!\n");
+		return;
+	}
+
+	// Bilinear entries read the right and lower neighbors as well, so they stop one pixel short
+	const bool bilinear = type != INTERPOLATION_NEARESTNEIGHBOR;
+	const int max_x = bilinear ? src_width - 1 : src_width;
+	const int max_y = bilinear ? src_height - 1 : src_height;
+
+	ThreadPool::GetShared().ParallelFor(pinhole->height, [&](int y)
+	{
+		k4a_float3_t ray;
+		ray.xyz.z = 1.f;
 		ray.xyz.y = ((float)y - pinhole->py) / pinhole->fy;
 
-		for (int x = 0; x < pinhole->width; x++, idx++)
+		lut_entry_t *row = lut_data + (size_t)y * pinhole->width;
+		for (int x = 0; x < pinhole->width; x++)
 		{
 			ray.xyz.x = ((float)x - pinhole->px) / pinhole->fx;
 
@@ -173,128 +201,226 @@ static void create_undistortion_lut(const k4a_calibration_t *calibration,
 			int valid;
 			k4a_calibration_3d_to_2d(calibration, &ray, camera, camera, &distorted, &valid);
 
-			coordinate_t src;
-			if (type == INTERPOLATION_NEARESTNEIGHBOR)
-			{
-				// Remapping via nearest neighbor interpolation
-				src.x = (int)floorf(distorted.xy.x + 0.5f);
-				src.y = (int)floorf(distorted.xy.y + 0.5f);
-			}
-			else if (type == INTERPOLATION_BILINEAR || type == INTERPOLATION_BILINEAR_DEPTH)
-			{
-				// Remapping via bilinear interpolation
-				src.x = (int)floorf(distorted.xy.x);
-				src.y = (int)floorf(distorted.xy.y);
-			}
-			else
-			{
-				OutputDebugString(L"Unexpected interpolation type!\n");
-				return;
-			}
+			// Nearest neighbor rounds, bilinear takes the upper left neighbor
+			int src_x = bilinear ? (int)floorf(distorted.xy.x) : (int)floorf(distorted.xy.x + 0.5f);
+			int src_y = bilinear ? (int)floorf(distorted.xy.y) : (int)floorf(distorted.xy.y + 0.5f);
 
-			if (valid && src.x >= 0 && src.x < src_width && src.y >= 0 && src.y < src_height)
+			lut_entry_t &entry = row[x];
+			if (!valid || src_x < 0 || src_x >= max_x || src_y < 0 || src_y >= max_y)
 			{
-				lut_data[idx] = src;
-
-				if (type == INTERPOLATION_BILINEAR || type == INTERPOLATION_BILINEAR_DEPTH)
-				{
-					// Compute the floating point weights, using the distance from projected point src to the
-					// image coordinate of the upper left neighbor
-					float w_x = distorted.xy.x - src.x;
-					float w_y = distorted.xy.y - src.y;
-					float w0 = (1.f - w_x) * (1.f - w_y);
-					float w1 = w_x * (1.f - w_y);
-					float w2 = (1.f - w_x) * w_y;
-					float w3 = w_x * w_y;
-
-					// Fill into lut
-					lut_data[idx].weight[0] = w0;
-					lut_data[idx].weight[1] = w1;
-					lut_data[idx].weight[2] = w2;
-					lut_data[idx].weight[3] = w3;
-				}
+				entry.offset = -1;
+				entry.weight[0] = entry.weight[1] = entry.weight[2] = entry.weight[3] = 0;
+				continue;
 			}
-			else
+
+			entry.offset = src_y * src_width + src_x;
+			if (!bilinear)
 			{
-				lut_data[idx].x = INVALID;
-				lut_data[idx].y = INVALID;
+				entry.weight[0] = LUT_WEIGHT_ONE;
+				entry.weight[1] = entry.weight[2] = entry.weight[3] = 0;
+				continue;
 			}
+
+			// Each axis is quantized to half the weight bits, so the products sum to exactly one
+			const int axis_one = 1 << (LUT_WEIGHT_BITS / 2);
+			int w_x = (int)((distorted.xy.x - src_x) * axis_one + 0.5f);
+			int w_y = (int)((distorted.xy.y - src_y) * axis_one + 0.5f);
+			w_x = min(max(w_x, 0), axis_one);
+			w_y = min(max(w_y, 0), axis_one);
+			entry.weight[0] = (uint16_t)((axis_one - w_x) * (axis_one - w_y));
+			entry.weight[1] = (uint16_t)(w_x * (axis_one - w_y));
+			entry.weight[2] = (uint16_t)((axis_one - w_x) * w_y);
+			entry.weight[3] = (uint16_t)(w_x * w_y);
+		}
+	});
+}
+
+// Skip interpolation at large depth discontinuities without disrupting slanted surfaces. The threshold is
+// estimated as follows:
+// - angle between two pixels is: theta = 0.234375 degree (120 degree / 512) in binning resolution mode
+// - distance between two pixels at same depth approximately is: A ~= sin(theta) * depth
+// - distance between two pixels at highly slanted surface (e.g. alpha = 85 degree) is: B = A / cos(alpha)
+// - skip_interpolation_ratio ~= sin(theta) / cos(alpha) = 0.04693441759
+// This is a conservative threshold, in reality, given distortion, distance and resolution difference, B
+// can be smaller. The ratio is kept in 1/65536ths so the scalar and simd paths agree exactly.
+#define SKIP_INTERPOLATION_RATIO_Q16 3076
+
+static inline uint16_t remap_bilinear(const uint16_t *src_data, int src_width, const lut_entry_t &entry, interpolation_t type)
+{
+	const uint16_t *top = src_data + entry.offset;
+	const uint16_t neighbors[4]{ top[0], top[1], top[src_width], top[src_width + 1] };
+
+	if (type == INTERPOLATION_BILINEAR_DEPTH)
+	{
+		// If one of the neighbors contains invalid data, e.g. depth value 0, the pixel is left invalid to
+		// avoid introducing noise on the edge. Color and ir images should use INTERPOLATION_BILINEAR.
+		uint32_t depth_min = min(min(neighbors[0], neighbors[1]), min(neighbors[2], neighbors[3]));
+		uint32_t depth_max = max(max(neighbors[0], neighbors[1]), max(neighbors[2], neighbors[3]));
+		if (depth_min == 0 ||
+			((depth_max - depth_min) << 16) > depth_min * SKIP_INTERPOLATION_RATIO_Q16)
+		{
+			return 0;
 		}
 	}
+
+	uint32_t sum = (uint32_t)neighbors[0] * entry.weight[0] + (uint32_t)neighbors[1] * entry.weight[1] +
+		(uint32_t)neighbors[2] * entry.weight[2] + (uint32_t)neighbors[3] * entry.weight[3];
+	return (uint16_t)((sum + (LUT_WEIGHT_ONE >> 1)) >> LUT_WEIGHT_BITS);
 }
 
-static void remap(const k4a_image_t src, const k4a_image_t lut, k4a_image_t dst, interpolation_t type)
+#ifdef AZUREKINECT_SSE2
+// Full 32 bit products of unsigned 16 bit lanes, the low four lanes in lo and the high four in hi
+static inline void multiply_epu16(__m128i a, __m128i b, __m128i &lo, __m128i &hi)
+{
+	__m128i low_bits = _mm_mullo_epi16(a, b);
+	__m128i high_bits = _mm_mulhi_epu16(a, b);
+	lo = _mm_unpacklo_epi16(low_bits, high_bits);
+	hi = _mm_unpackhi_epi16(low_bits, high_bits);
+}
+
+// Unsigned 32 bit compare, sse2 only compares signed
+static inline __m128i compare_gt_epu32(__m128i a, __m128i b)
+{
+	const __m128i sign = _mm_set1_epi32(INT32_MIN);
+	return _mm_cmpgt_epi32(_mm_xor_si128(a, sign), _mm_xor_si128(b, sign));
+}
+
+// Eight bilinear pixels at once. Sources are scattered so the neighbors are gathered one by one, the
+// weighting, the discontinuity test and the rounding run on all eight.
+static inline void remap_bilinear_8(const uint16_t *src_data, int src_width, const lut_entry_t *entries, uint16_t *dst, interpolation_t type)
 {
-	int src_width = k4a_image_get_width_pixels(src);
-	int dst_width = k4a_image_get_width_pixels(dst);
-	int dst_height = k4a_image_get_height_pixels(dst);
+	alignas(16) uint16_t neighbors[4][8];
+	alignas(16) uint16_t weights[4][8];
+	for (int k = 0; k < 8; k++)
+	{
+		const lut_entry_t &entry = entries[k];
+		if (entry.offset < 0)
+		{
+			// Zero weights give zero, and a zero neighbor also fails the depth test
+			neighbors[0][k] = neighbors[1][k] = neighbors[2][k] = neighbors[3][k] = 0;
+			weights[0][k] = weights[1][k] = weights[2][k] = weights[3][k] = 0;
+			continue;
+		}
+
+		const uint16_t *top = src_data + entry.offset;
+		neighbors[0][k] = top[0];
+		neighbors[1][k] = top[1];
+		neighbors[2][k] = top[src_width];
+		neighbors[3][k] = top[src_width + 1];
+		weights[0][k] = entry.weight[0];
+		weights[1][k] = entry.weight[1];
+		weights[2][k] = entry.weight[2];
+		weights[3][k] = entry.weight[3];
+	}
+
+	__m128i sum_lo = _mm_setzero_si128();
+	__m128i sum_hi = _mm_setzero_si128();
+	for (int j = 0; j < 4; j++)
+	{
+		__m128i lo, hi;
+		multiply_epu16(_mm_load_si128((const __m128i*)neighbors[j]), _mm_load_si128((const __m128i*)weights[j]), lo, hi);
+		sum_lo = _mm_add_epi32(sum_lo, lo);
+		sum_hi = _mm_add_epi32(sum_hi, hi);
+	}
 
-	uint16_t *src_data = (uint16_t *)(void *)k4a_image_get_buffer(src);
-	uint16_t *dst_data = (uint16_t *)(void *)k4a_image_get_buffer(dst);
-	coordinate_t *lut_data = (coordinate_t *)(void *)k4a_image_get_buffer(lut);
+	const __m128i round = _mm_set1_epi32(LUT_WEIGHT_ONE >> 1);
+	sum_lo = _mm_srli_epi32(_mm_add_epi32(sum_lo, round), LUT_WEIGHT_BITS);
+	sum_hi = _mm_srli_epi32(_mm_add_epi32(sum_hi, round), LUT_WEIGHT_BITS);
 
-	memset(dst_data, 0, (size_t)dst_width * (size_t)dst_height * sizeof(uint16_t));
+	// Results fit 16 bits unsigned, shifted into signed range for the saturating pack and back
+	const __m128i bias32 = _mm_set1_epi32(32768);
+	const __m128i sign16 = _mm_set1_epi16((short)0x8000);
+	__m128i result = _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(sum_lo, bias32), _mm_sub_epi32(sum_hi, bias32)), sign16);
+
+	if (type == INTERPOLATION_BILINEAR_DEPTH)
+	{
+		// Unsigned min and max through the signed ops with the sign bit flipped
+		__m128i n0 = _mm_xor_si128(_mm_load_si128((const __m128i*)neighbors[0]), sign16);
+		__m128i n1 = _mm_xor_si128(_mm_load_si128((const __m128i*)neighbors[1]), sign16);
+		__m128i n2 = _mm_xor_si128(_mm_load_si128((const __m128i*)neighbors[2]), sign16);
+		__m128i n3 = _mm_xor_si128(_mm_load_si128((const __m128i*)neighbors[3]), sign16);
+		__m128i depth_min = _mm_xor_si128(_mm_min_epi16(_mm_min_epi16(n0, n1), _mm_min_epi16(n2, n3)), sign16);
+		__m128i depth_max = _mm_xor_si128(_mm_max_epi16(_mm_max_epi16(n0, n1), _mm_max_epi16(n2, n3)), sign16);
+		__m128i depth_delta = _mm_sub_epi16(depth_max, depth_min);
+
+		// delta << 16 against min * ratio, both as unsigned 32 bit
+		const __m128i zero = _mm_setzero_si128();
+		__m128i threshold_lo, threshold_hi;
+		multiply_epu16(depth_min, _mm_set1_epi16(SKIP_INTERPOLATION_RATIO_Q16), threshold_lo, threshold_hi);
+		__m128i skip = _mm_packs_epi32(
+			compare_gt_epu32(_mm_unpacklo_epi16(zero, depth_delta), threshold_lo),
+			compare_gt_epu32(_mm_unpackhi_epi16(zero, depth_delta), threshold_hi));
+		skip = _mm_or_si128(skip, _mm_cmpeq_epi16(depth_min, zero));
+		result = _mm_andnot_si128(skip, result);
+	}
+
+	_mm_storeu_si128((__m128i*)dst, result);
+}
+#endif
 
-	for (int i = 0; i < dst_width * dst_height; i++)
+static void remap_row(const uint16_t *src_data, int src_width, const lut_entry_t *lut_row, uint16_t *dst_row, int dst_width, interpolation_t type)
+{
+	int x = 0;
+	if (type == INTERPOLATION_NEARESTNEIGHBOR)
 	{
-		if (lut_data[i].x != INVALID && lut_data[i].y != INVALID)
+		for (; x < dst_width; x++)
 		{
-			if (type == INTERPOLATION_NEARESTNEIGHBOR)
-			{
-				dst_data[i] = src_data[lut_data[i].y * src_width + lut_data[i].x];
-			}
-			else if (type == INTERPOLATION_BILINEAR || type == INTERPOLATION_BILINEAR_DEPTH)
-			{
-				const uint16_t neighbors[4]{ src_data[lut_data[i].y * src_width + lut_data[i].x],
-											 src_data[lut_data[i].y * src_width + lut_data[i].x + 1],
-											 src_data[(lut_data[i].y + 1) * src_width + lut_data[i].x],
-											 src_data[(lut_data[i].y + 1) * src_width + lut_data[i].x + 1] };
-
-				if (type == INTERPOLATION_BILINEAR_DEPTH)
-				{
-					// If the image contains invalid data, e.g. depth image contains value 0, ignore the bilinear
-					// interpolation for current target pixel if one of the neighbors contains invalid data to avoid
-					// introduce noise on the edge. If the image is color or ir images, user should use
-					// INTERPOLATION_BILINEAR
-					if (neighbors[0] == 0 || neighbors[1] == 0 || neighbors[2] == 0 || neighbors[3] == 0)
-					{
-						continue;
-					}
-
-					// Ignore interpolation at large depth discontinuity without disrupting slanted surface
-					// Skip interpolation threshold is estimated based on the following logic:
-					// - angle between two pixels is: theta = 0.234375 degree (120 degree / 512) in binning resolution
-					// mode
-					// - distance between two pixels at same depth approximately is: A ~= sin(theta) * depth
-					// - distance between two pixels at highly slanted surface (e.g. alpha = 85 degree) is: B = A /
-					// cos(alpha)
-					// - skip_interpolation_ratio ~= sin(theta) / cos(alpha)
-					// We use B as the threshold that to skip interpolation if the depth difference in the triangle is
-					// larger than B. This is a conservative threshold to estimate largest distance on a highly slanted
-					// surface at given depth, in reality, given distortion, distance, resolution difference, B can be
-					// smaller
-					const float skip_interpolation_ratio = 0.04693441759f;
-					float depth_min = min(min(neighbors[0], neighbors[1]),
-						min(neighbors[2], neighbors[3]));
-					float depth_max = max(max(neighbors[0], neighbors[1]),
-						max(neighbors[2], neighbors[3]));
-					float depth_delta = depth_max - depth_min;
-					float skip_interpolation_threshold = skip_interpolation_ratio * depth_min;
-					if (depth_delta > skip_interpolation_threshold)
-					{
-						continue;
-					}
-				}
-
-				dst_data[i] = (uint16_t)(neighbors[0] * lut_data[i].weight[0] + neighbors[1] * lut_data[i].weight[1] +
-					neighbors[2] * lut_data[i].weight[2] + neighbors[3] * lut_data[i].weight[3] +
-					0.5f);
-			}
-			else
-			{
-				OutputDebugString(L"Unexpected interpolation type!\n");
-				return;
-			}
+			dst_row[x] = lut_row[x].offset >= 0 ? src_data[lut_row[x].offset] : 0;
 		}
+		return;
+	}
+
+#ifdef AZUREKINECT_SSE2
+	for (; x + 8 <= dst_width; x += 8)
+	{
+		remap_bilinear_8(src_data, src_width, lut_row + x, dst_row + x, type);
+	}
+#endif
+
+	for (; x < dst_width; x++)
+	{
+		dst_row[x] = lut_row[x].offset >= 0 ? remap_bilinear(src_data, src_width, lut_row[x], type) : 0;
+	}
+}
+
+// Bands of rows are spread over the shared thread pool
+static void remap(const uint16_t *src_data,
+	int src_width,
+	const lut_entry_t *lut_data,
+	uint16_t *dst_data,
+	int dst_width,
+	int dst_height,
+	interpolation_t type)
+{
+	if (type != INTERPOLATION_NEARESTNEIGHBOR && type != INTERPOLATION_BILINEAR && type != INTERPOLATION_BILINEAR_DEPTH)
+	{
+		OutputDebugString(L"Unexpected interpolation type!\n");
+		return;
 	}
-}
\ No newline at end of file
+
+	const int rows_per_band = 16;
+	ThreadPool::GetShared().ParallelFor((dst_height + rows_per_band - 1) / rows_per_band, [&](int band)
+	{
+		int row_end = min((band + 1) * rows_per_band, dst_height);
+		for (int y = band * rows_per_band; y < row_end; y++)
+		{
+			remap_row(src_data,
+				src_width,
+				lut_data + (size_t)y * dst_width,
+				dst_data + (size_t)y * dst_width,
+				dst_width,
+				type);
+		}
+	});
+}
+
+static void remap(const k4a_image_t src, const k4a_image_t lut, k4a_image_t dst, interpolation_t type)
+{
+	remap((const uint16_t *)(void *)k4a_image_get_buffer(src),
+		k4a_image_get_width_pixels(src),
+		(const lut_entry_t *)(void *)k4a_image_get_buffer(lut),
+		(uint16_t *)(void *)k4a_image_get_buffer(dst),
+		k4a_image_get_width_pixels(dst),
+		k4a_image_get_height_pixels(dst),
+		type);
+}
@@ -3,12 +3,44 @@
 
 #include "framework.h"
 #include <k4a/k4a.h>
+#include <k4arecord/playback.h>
+#include <algorithm>
+#include <array>
+#include <float.h>
 #include <memory>
 #include <map>
 #include <vector>
 #include <string>
+#include <unordered_map>
+#ifdef _WIN32
 #include "DirectXHelper.h"
+#endif
 #include "UndistortHelper.h"
 #include "PointCloudHelper.h"
+#include "SimdHelper.h"
+#include "TimingHelper.h"
+#include "ToneMapHelper.h"
+#include "RegionOfInterestHelper.h"
+#include "PyramidHelper.h"
+#include "ChangeMaskHelper.h"
+#include "ColorUvHelper.h"
+#include "OutlierFilterHelper.h"
+#include "ThreadPool.h"
+#include "ImagePool.h"
+#include "PointCloudSpatialIndex.h"
+#include "PointCloudFusion.h"
+#include "PointCloudExporter.h"
+#include "TsdfVolume.h"
+#include "ImuStream.h"
+#include "ClockMapper.h"
+#include "CaptureQueue.h"
+#include "DeviceTable.h"
+#include "SharedFrameRing.h"
+#include "RgbdCodec.h"
+#include "FrameStream.h"
+#ifdef _WIN32
+#include "FrameDescriptor.h"
+#include "TextureUploadQueue.h"
+#endif
 
 #endif
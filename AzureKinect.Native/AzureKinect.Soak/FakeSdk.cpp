@@ -0,0 +1,782 @@
+#include "pch.h"
+#include "FakeSdk.h"
+
+struct FakeImage
+{
+	k4a_image_format_t format;
+	int width;
+	int height;
+	int stride;
+	uint8_t *buffer;
+	size_t size;
+	std::atomic<int> referenceCount;
+	k4a_memory_destroy_cb_t *releaseCallback;
+	void *releaseContext;
+	uint64_t deviceTimestampUsec;
+	uint64_t systemTimestampNsec;
+};
+
+struct FakeCapture
+{
+	std::atomic<int> referenceCount;
+	k4a_image_t colorImage;
+	k4a_image_t depthImage;
+	k4a_image_t irImage;
+};
+
+struct FakeDevice
+{
+	bool open;
+	bool started;
+	k4a_device_configuration_t configuration;
+	uint64_t frameCount;
+	int64_t nextFrameMicroseconds;
+};
+
+struct FakeTransformation
+{
+	k4a_calibration_t calibration;
+};
+
+static std::mutex sdkMutex;
+static FakeDevice devices[FakeSdk::MaxDevices] = {};
+static int installedDeviceCount = 1;
+static int frameSpeedup = 1;
+static k4a_memory_allocate_cb_t *allocateCallback = nullptr;
+static k4a_memory_destroy_cb_t *freeCallback = nullptr;
+
+static std::atomic<int> liveCaptureCount{ 0 };
+static std::atomic<int> liveImageCount{ 0 };
+static std::atomic<int> liveTransformationCount{ 0 };
+static std::atomic<uint64_t> liveImageBytes{ 0 };
+static std::atomic<uint64_t> capturedCount{ 0 };
+
+void FakeSdk::Configure(int deviceCount, int speedup)
+{
+	std::lock_guard<std::mutex> lock(sdkMutex);
+	installedDeviceCount = min(max(deviceCount, 1), static_cast<int>(MaxDevices));
+	frameSpeedup = max(speedup, 1);
+}
+
+FakeSdk::Stats FakeSdk::GetStats()
+{
+	std::lock_guard<std::mutex> lock(sdkMutex);
+	Stats stats = {};
+	for (const auto &device : devices)
+	{
+		stats.openDeviceCount += device.open ? 1 : 0;
+	}
+	stats.liveCaptureCount = liveCaptureCount.load();
+	stats.liveImageCount = liveImageCount.load();
+	stats.liveTransformationCount = liveTransformationCount.load();
+	stats.liveImageBytes = liveImageBytes.load();
+	stats.capturedCount = capturedCount.load();
+	return stats;
+}
+
+static FakeImage *to_image(k4a_image_t image)
+{
+	return reinterpret_cast<FakeImage *>(image);
+}
+
+static FakeCapture *to_capture(k4a_capture_t capture)
+{
+	return reinterpret_cast<FakeCapture *>(capture);
+}
+
+static void free_unpooled_buffer(void *buffer, void *context)
+{
+	delete[] static_cast<uint8_t *>(buffer);
+}
+
+static k4a_image_t wrap_buffer(k4a_image_format_t format,
+	int width,
+	int height,
+	int stride,
+	uint8_t *buffer,
+	size_t size,
+	k4a_memory_destroy_cb_t *releaseCallback,
+	void *releaseContext)
+{
+	FakeImage *image = new FakeImage();
+	image->format = format;
+	image->width = width;
+	image->height = height;
+	image->stride = stride;
+	image->buffer = buffer;
+	image->size = size;
+	image->referenceCount.store(1);
+	image->releaseCallback = releaseCallback;
+	image->releaseContext = releaseContext;
+	image->deviceTimestampUsec = 0;
+	image->systemTimestampNsec = 0;
+
+	liveImageCount++;
+	liveImageBytes += size;
+	return reinterpret_cast<k4a_image_t>(image);
+}
+
+// Like the sdk's own images, these come from the installed allocator when there is one
+static k4a_image_t create_image(k4a_image_format_t format, int width, int height, int stride)
+{
+	const size_t size = static_cast<size_t>(stride) * height;
+	k4a_memory_allocate_cb_t *allocate;
+	k4a_memory_destroy_cb_t *release;
+	{
+		std::lock_guard<std::mutex> lock(sdkMutex);
+		allocate = allocateCallback;
+		release = freeCallback;
+	}
+
+	if (allocate == nullptr)
+	{
+		return wrap_buffer(format, width, height, stride, new uint8_t[size], size, &free_unpooled_buffer, nullptr);
+	}
+
+	void *context = nullptr;
+	uint8_t *buffer = allocate(static_cast<int>(size), &context);
+	if (buffer == nullptr)
+	{
+		return nullptr;
+	}
+	return wrap_buffer(format, width, height, stride, buffer, size, release, context);
+}
+
+static void get_depth_size(k4a_depth_mode_t depthMode, int &width, int &height)
+{
+	switch (depthMode)
+	{
+	case K4A_DEPTH_MODE_NFOV_2X2BINNED:
+		width = 320;
+		height = 288;
+		break;
+	case K4A_DEPTH_MODE_NFOV_UNBINNED:
+		width = 640;
+		height = 576;
+		break;
+	case K4A_DEPTH_MODE_WFOV_2X2BINNED:
+		width = 512;
+		height = 512;
+		break;
+	case K4A_DEPTH_MODE_WFOV_UNBINNED:
+	case K4A_DEPTH_MODE_PASSIVE_IR:
+		width = 1024;
+		height = 1024;
+		break;
+	default:
+		width = 0;
+		height = 0;
+		break;
+	}
+}
+
+static void get_color_size(k4a_color_resolution_t colorResolution, int &width, int &height)
+{
+	switch (colorResolution)
+	{
+	case K4A_COLOR_RESOLUTION_720P:
+		width = 1280;
+		height = 720;
+		break;
+	case K4A_COLOR_RESOLUTION_1080P:
+		width = 1920;
+		height = 1080;
+		break;
+	case K4A_COLOR_RESOLUTION_1440P:
+		width = 2560;
+		height = 1440;
+		break;
+	case K4A_COLOR_RESOLUTION_1536P:
+		width = 2048;
+		height = 1536;
+		break;
+	case K4A_COLOR_RESOLUTION_2160P:
+		width = 3840;
+		height = 2160;
+		break;
+	case K4A_COLOR_RESOLUTION_3072P:
+		width = 4096;
+		height = 3072;
+		break;
+	default:
+		width = 0;
+		height = 0;
+		break;
+	}
+}
+
+static int64_t get_frame_period_usec(k4a_fps_t fps)
+{
+	switch (fps)
+	{
+	case K4A_FRAMES_PER_SECOND_5:
+		return 1000000 / 5;
+	case K4A_FRAMES_PER_SECOND_15:
+		return 1000000 / 15;
+	default:
+		return 1000000 / 30;
+	}
+}
+
+// Distortion free pinhole cameras sharing one origin, so every extrinsic is the identity
+static k4a_calibration_camera_t make_camera(int width, int height, float focalScale)
+{
+	k4a_calibration_camera_t camera = {};
+	camera.resolution_width = width;
+	camera.resolution_height = height;
+	camera.metric_radius = 1.7f;
+	camera.intrinsics.type = K4A_CALIBRATION_LENS_DISTORTION_MODEL_BROWN_CONRADY;
+	camera.intrinsics.parameter_count = 14;
+	camera.intrinsics.parameters.param.cx = width * 0.5f;
+	camera.intrinsics.parameters.param.cy = height * 0.5f;
+	camera.intrinsics.parameters.param.fx = width * focalScale;
+	camera.intrinsics.parameters.param.fy = width * focalScale;
+	camera.intrinsics.parameters.param.metric_radius = 1.7f;
+	camera.extrinsics.rotation[0] = 1.0f;
+	camera.extrinsics.rotation[4] = 1.0f;
+	camera.extrinsics.rotation[8] = 1.0f;
+	return camera;
+}
+
+static const k4a_calibration_camera_t &get_camera(const k4a_calibration_t *calibration, k4a_calibration_type_t type)
+{
+	return type == K4A_CALIBRATION_TYPE_COLOR ? calibration->color_camera_calibration : calibration->depth_camera_calibration;
+}
+
+// A ball moving in front of a tilted wall with an invalid band along the edges, like the Stream tool's scene
+static void draw_depth(uint16_t *depth, uint16_t *ir, int width, int height, uint64_t frameIndex)
+{
+	float phase = frameIndex * 0.05f;
+	float ballX = width * (0.5f + 0.3f * cosf(phase));
+	float ballY = height * (0.5f + 0.2f * sinf(phase * 1.3f));
+	float radius = height * 0.15f;
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			size_t i = static_cast<size_t>(y) * width + x;
+			float dx = x - ballX;
+			float dy = y - ballY;
+			float inside = radius * radius - dx * dx - dy * dy;
+			bool border = x < width / 16 || x >= width - width / 16;
+			uint16_t value = static_cast<uint16_t>(2000 + x + y / 2);
+			if (inside > 0.0f)
+			{
+				value = static_cast<uint16_t>(1200 - sqrtf(inside));
+			}
+
+			depth[i] = border ? 0 : value;
+			ir[i] = border ? 0 : static_cast<uint16_t>(4000000 / value);
+		}
+	}
+}
+
+static void draw_color(uint8_t *color, int width, int height, uint64_t frameIndex)
+{
+	for (int y = 0; y < height; y++)
+	{
+		uint8_t *pixel = color + static_cast<size_t>(y) * width * 4;
+		for (int x = 0; x < width; x++, pixel += 4)
+		{
+			pixel[0] = static_cast<uint8_t>(x + frameIndex * 4);
+			pixel[1] = static_cast<uint8_t>(y * 255 / height);
+			pixel[2] = static_cast<uint8_t>(x * 255 / width);
+			pixel[3] = 255;
+		}
+	}
+}
+
+static k4a_image_t get_capture_image(k4a_image_t image)
+{
+	if (image != nullptr)
+	{
+		to_image(image)->referenceCount++;
+	}
+	return image;
+}
+
+extern "C"
+{
+
+k4a_result_t k4a_set_allocator(k4a_memory_allocate_cb_t allocate, k4a_memory_destroy_cb_t release)
+{
+	// The sdk refuses as long as any of its images are alive
+	std::lock_guard<std::mutex> lock(sdkMutex);
+	if (liveImageCount.load() > 0)
+	{
+		return K4A_RESULT_FAILED;
+	}
+
+	allocateCallback = allocate;
+	freeCallback = release;
+	return K4A_RESULT_SUCCEEDED;
+}
+
+uint32_t k4a_device_get_installed_count(void)
+{
+	std::lock_guard<std::mutex> lock(sdkMutex);
+	return static_cast<uint32_t>(installedDeviceCount);
+}
+
+k4a_result_t k4a_device_open(uint32_t index, k4a_device_t *device_handle)
+{
+	std::lock_guard<std::mutex> lock(sdkMutex);
+	if (index >= static_cast<uint32_t>(installedDeviceCount) ||
+		devices[index].open)
+	{
+		return K4A_RESULT_FAILED;
+	}
+
+	devices[index] = {};
+	devices[index].open = true;
+	*device_handle = reinterpret_cast<k4a_device_t>(&devices[index]);
+	return K4A_RESULT_SUCCEEDED;
+}
+
+void k4a_device_close(k4a_device_t device_handle)
+{
+	std::lock_guard<std::mutex> lock(sdkMutex);
+	FakeDevice *device = reinterpret_cast<FakeDevice *>(device_handle);
+	device->started = false;
+	device->open = false;
+}
+
+k4a_buffer_result_t k4a_device_get_serialnum(k4a_device_t device_handle, char *serial_number, size_t *serial_number_size)
+{
+	char serial[32];
+	snprintf(serial, sizeof(serial), "FAKE%08d", static_cast<int>(reinterpret_cast<FakeDevice *>(device_handle) - devices));
+	size_t size = strlen(serial) + 1;
+	if (serial_number == nullptr ||
+		*serial_number_size < size)
+	{
+		*serial_number_size = size;
+		return K4A_BUFFER_RESULT_TOO_SMALL;
+	}
+
+	memcpy(serial_number, serial, size);
+	*serial_number_size = size;
+	return K4A_BUFFER_RESULT_SUCCEEDED;
+}
+
+k4a_result_t k4a_device_get_version(k4a_device_t device_handle, k4a_hardware_version_t *version)
+{
+	*version = {};
+	version->rgb.major = 1;
+	version->rgb.minor = 6;
+	version->depth.major = 1;
+	version->depth.minor = 6;
+	return K4A_RESULT_SUCCEEDED;
+}
+
+k4a_buffer_result_t k4a_device_get_raw_calibration(k4a_device_t device_handle, uint8_t *data, size_t *data_size)
+{
+	static const char raw[] = "{\"CalibrationInformation\":{\"Cameras\":[]}}";
+	if (data == nullptr ||
+		*data_size < sizeof(raw))
+	{
+		*data_size = sizeof(raw);
+		return K4A_BUFFER_RESULT_TOO_SMALL;
+	}
+
+	memcpy(data, raw, sizeof(raw));
+	*data_size = sizeof(raw);
+	return K4A_BUFFER_RESULT_SUCCEEDED;
+}
+
+k4a_result_t k4a_device_get_calibration(k4a_device_t device_handle,
+	const k4a_depth_mode_t depth_mode,
+	const k4a_color_resolution_t color_resolution,
+	k4a_calibration_t *calibration)
+{
+	int depthWidth, depthHeight, colorWidth, colorHeight;
+	get_depth_size(depth_mode, depthWidth, depthHeight);
+	get_color_size(color_resolution, colorWidth, colorHeight);
+
+	bool wide = depth_mode == K4A_DEPTH_MODE_WFOV_2X2BINNED ||
+		depth_mode == K4A_DEPTH_MODE_WFOV_UNBINNED;
+	*calibration = {};
+	calibration->depth_camera_calibration = make_camera(depthWidth, depthHeight, wide ? 0.49f : 0.79f);
+	calibration->color_camera_calibration = make_camera(colorWidth, colorHeight, 0.47f);
+	for (int source = 0; source < K4A_CALIBRATION_TYPE_NUM; source++)
+	{
+		for (int target = 0; target < K4A_CALIBRATION_TYPE_NUM; target++)
+		{
+			calibration->extrinsics[source][target] = calibration->depth_camera_calibration.extrinsics;
+		}
+	}
+	calibration->depth_mode = depth_mode;
+	calibration->color_resolution = color_resolution;
+	return K4A_RESULT_SUCCEEDED;
+}
+
+k4a_result_t k4a_device_start_cameras(k4a_device_t device_handle, const k4a_device_configuration_t *config)
+{
+	if (config->color_resolution != K4A_COLOR_RESOLUTION_OFF &&
+		config->color_format != K4A_IMAGE_FORMAT_COLOR_BGRA32)
+	{
+		return K4A_RESULT_FAILED;
+	}
+
+	std::lock_guard<std::mutex> lock(sdkMutex);
+	FakeDevice *device = reinterpret_cast<FakeDevice *>(device_handle);
+	if (device->started)
+	{
+		return K4A_RESULT_FAILED;
+	}
+
+	device->started = true;
+	device->configuration = *config;
+	device->frameCount = 0;
+	device->nextFrameMicroseconds = TimingHelper::GetTimestampMicroseconds();
+	return K4A_RESULT_SUCCEEDED;
+}
+
+void k4a_device_stop_cameras(k4a_device_t device_handle)
+{
+	std::lock_guard<std::mutex> lock(sdkMutex);
+	reinterpret_cast<FakeDevice *>(device_handle)->started = false;
+}
+
+k4a_result_t k4a_device_start_imu(k4a_device_t device_handle)
+{
+	return K4A_RESULT_FAILED;
+}
+
+void k4a_device_stop_imu(k4a_device_t device_handle)
+{
+}
+
+k4a_wait_result_t k4a_device_get_imu_sample(k4a_device_t device_handle, k4a_imu_sample_t *imu_sample, int32_t timeout_in_ms)
+{
+	return K4A_WAIT_RESULT_FAILED;
+}
+
+k4a_wait_result_t k4a_device_get_capture(k4a_device_t device_handle, k4a_capture_t *capture_handle, int32_t timeout_in_ms)
+{
+	FakeDevice *device = reinterpret_cast<FakeDevice *>(device_handle);
+	int64_t due;
+	{
+		std::lock_guard<std::mutex> lock(sdkMutex);
+		if (!device->started)
+		{
+			return K4A_WAIT_RESULT_FAILED;
+		}
+		due = device->nextFrameMicroseconds;
+	}
+
+	int64_t now = TimingHelper::GetTimestampMicroseconds();
+	if (due > now)
+	{
+		if (timeout_in_ms != K4A_WAIT_INFINITE &&
+			due - now > static_cast<int64_t>(timeout_in_ms) * 1000)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(timeout_in_ms));
+			return K4A_WAIT_RESULT_TIMEOUT;
+		}
+		std::this_thread::sleep_for(std::chrono::microseconds(due - now));
+	}
+
+	k4a_device_configuration_t configuration;
+	uint64_t frameIndex;
+	int64_t periodUsec;
+	{
+		std::lock_guard<std::mutex> lock(sdkMutex);
+		if (!device->started)
+		{
+			return K4A_WAIT_RESULT_FAILED;
+		}
+
+		configuration = device->configuration;
+		frameIndex = device->frameCount++;
+		periodUsec = get_frame_period_usec(configuration.camera_fps);
+
+		// A reader that fell behind gets the next frame a period from now rather than a burst of late ones
+		now = TimingHelper::GetTimestampMicroseconds();
+		device->nextFrameMicroseconds = max(device->nextFrameMicroseconds, now - periodUsec / frameSpeedup) + periodUsec / frameSpeedup;
+	}
+
+	int depthWidth, depthHeight, colorWidth, colorHeight;
+	get_depth_size(configuration.depth_mode, depthWidth, depthHeight);
+	get_color_size(configuration.color_resolution, colorWidth, colorHeight);
+
+	FakeCapture *capture = new FakeCapture();
+	capture->referenceCount.store(1);
+	capture->colorImage = nullptr;
+	capture->depthImage = nullptr;
+	capture->irImage = nullptr;
+	liveCaptureCount++;
+
+	uint64_t deviceTimestampUsec = (frameIndex + 1) * periodUsec;
+	uint64_t systemTimestampNsec = TimingHelper::GetTimestampNanoseconds();
+	if (depthWidth > 0)
+	{
+		capture->irImage = create_image(K4A_IMAGE_FORMAT_IR16, depthWidth, depthHeight, depthWidth * 2);
+		if (configuration.depth_mode != K4A_DEPTH_MODE_PASSIVE_IR)
+		{
+			capture->depthImage = create_image(K4A_IMAGE_FORMAT_DEPTH16, depthWidth, depthHeight, depthWidth * 2);
+		}
+	}
+	if (colorWidth > 0)
+	{
+		capture->colorImage = create_image(K4A_IMAGE_FORMAT_COLOR_BGRA32, colorWidth, colorHeight, colorWidth * 4);
+	}
+
+	if (capture->depthImage != nullptr &&
+		capture->irImage != nullptr)
+	{
+		draw_depth(reinterpret_cast<uint16_t *>(to_image(capture->depthImage)->buffer),
+			reinterpret_cast<uint16_t *>(to_image(capture->irImage)->buffer),
+			depthWidth,
+			depthHeight,
+			frameIndex);
+	}
+	if (capture->colorImage != nullptr)
+	{
+		draw_color(to_image(capture->colorImage)->buffer, colorWidth, colorHeight, frameIndex);
+	}
+
+	for (k4a_image_t image : { capture->colorImage, capture->depthImage, capture->irImage })
+	{
+		if (image != nullptr)
+		{
+			to_image(image)->deviceTimestampUsec = deviceTimestampUsec;
+			to_image(image)->systemTimestampNsec = systemTimestampNsec;
+		}
+	}
+
+	capturedCount++;
+	*capture_handle = reinterpret_cast<k4a_capture_t>(capture);
+	return K4A_WAIT_RESULT_SUCCEEDED;
+}
+
+void k4a_capture_reference(k4a_capture_t capture_handle)
+{
+	to_capture(capture_handle)->referenceCount++;
+}
+
+void k4a_capture_release(k4a_capture_t capture_handle)
+{
+	FakeCapture *capture = to_capture(capture_handle);
+	if (capture == nullptr ||
+		--capture->referenceCount > 0)
+	{
+		return;
+	}
+
+	for (k4a_image_t image : { capture->colorImage, capture->depthImage, capture->irImage })
+	{
+		if (image != nullptr)
+		{
+			k4a_image_release(image);
+		}
+	}
+	delete capture;
+	liveCaptureCount--;
+}
+
+k4a_image_t k4a_capture_get_color_image(k4a_capture_t capture_handle)
+{
+	return get_capture_image(to_capture(capture_handle)->colorImage);
+}
+
+k4a_image_t k4a_capture_get_depth_image(k4a_capture_t capture_handle)
+{
+	return get_capture_image(to_capture(capture_handle)->depthImage);
+}
+
+k4a_image_t k4a_capture_get_ir_image(k4a_capture_t capture_handle)
+{
+	return get_capture_image(to_capture(capture_handle)->irImage);
+}
+
+k4a_result_t k4a_image_create(k4a_image_format_t format, int width_pixels, int height_pixels, int stride_bytes, k4a_image_t *image_handle)
+{
+	*image_handle = create_image(format, width_pixels, height_pixels, stride_bytes);
+	return *image_handle != nullptr ? K4A_RESULT_SUCCEEDED : K4A_RESULT_FAILED;
+}
+
+k4a_result_t k4a_image_create_from_buffer(k4a_image_format_t format,
+	int width_pixels,
+	int height_pixels,
+	int stride_bytes,
+	uint8_t *buffer,
+	size_t buffer_size,
+	k4a_memory_destroy_cb_t *buffer_release_cb,
+	void *buffer_release_cb_context,
+	k4a_image_t *image_handle)
+{
+	*image_handle = wrap_buffer(format, width_pixels, height_pixels, stride_bytes, buffer, buffer_size, buffer_release_cb, buffer_release_cb_context);
+	return K4A_RESULT_SUCCEEDED;
+}
+
+uint8_t *k4a_image_get_buffer(k4a_image_t image_handle)
+{
+	return image_handle != nullptr ? to_image(image_handle)->buffer : nullptr;
+}
+
+size_t k4a_image_get_size(k4a_image_t image_handle)
+{
+	return image_handle != nullptr ? to_image(image_handle)->size : 0;
+}
+
+k4a_image_format_t k4a_image_get_format(k4a_image_t image_handle)
+{
+	return to_image(image_handle)->format;
+}
+
+int k4a_image_get_width_pixels(k4a_image_t image_handle)
+{
+	return image_handle != nullptr ? to_image(image_handle)->width : 0;
+}
+
+int k4a_image_get_height_pixels(k4a_image_t image_handle)
+{
+	return image_handle != nullptr ? to_image(image_handle)->height : 0;
+}
+
+int k4a_image_get_stride_bytes(k4a_image_t image_handle)
+{
+	return image_handle != nullptr ? to_image(image_handle)->stride : 0;
+}
+
+uint64_t k4a_image_get_device_timestamp_usec(k4a_image_t image_handle)
+{
+	return image_handle != nullptr ? to_image(image_handle)->deviceTimestampUsec : 0;
+}
+
+uint64_t k4a_image_get_system_timestamp_nsec(k4a_image_t image_handle)
+{
+	return image_handle != nullptr ? to_image(image_handle)->systemTimestampNsec : 0;
+}
+
+void k4a_image_reference(k4a_image_t image_handle)
+{
+	to_image(image_handle)->referenceCount++;
+}
+
+void k4a_image_release(k4a_image_t image_handle)
+{
+	FakeImage *image = to_image(image_handle);
+	if (image == nullptr ||
+		--image->referenceCount > 0)
+	{
+		return;
+	}
+
+	if (image->releaseCallback != nullptr)
+	{
+		image->releaseCallback(image->buffer, image->releaseContext);
+	}
+	liveImageBytes -= image->size;
+	liveImageCount--;
+	delete image;
+}
+
+k4a_result_t k4a_calibration_2d_to_3d(const k4a_calibration_t *calibration,
+	const k4a_float2_t *source_point2d,
+	const float source_depth_mm,
+	const k4a_calibration_type_t source_camera,
+	const k4a_calibration_type_t target_camera,
+	k4a_float3_t *target_point3d_mm,
+	int *valid)
+{
+	const auto &param = get_camera(calibration, source_camera).intrinsics.parameters.param;
+	target_point3d_mm->xyz.x = (source_point2d->xy.x - param.cx) / param.fx * source_depth_mm;
+	target_point3d_mm->xyz.y = (source_point2d->xy.y - param.cy) / param.fy * source_depth_mm;
+	target_point3d_mm->xyz.z = source_depth_mm;
+	*valid = 1;
+	return K4A_RESULT_SUCCEEDED;
+}
+
+k4a_result_t k4a_calibration_3d_to_2d(const k4a_calibration_t *calibration,
+	const k4a_float3_t *source_point3d_mm,
+	const k4a_calibration_type_t source_camera,
+	const k4a_calibration_type_t target_camera,
+	k4a_float2_t *target_point2d,
+	int *valid)
+{
+	const auto &param = get_camera(calibration, target_camera).intrinsics.parameters.param;
+	*valid = source_point3d_mm->xyz.z > 0.0f ? 1 : 0;
+	if (*valid)
+	{
+		target_point2d->xy.x = param.fx * source_point3d_mm->xyz.x / source_point3d_mm->xyz.z + param.cx;
+		target_point2d->xy.y = param.fy * source_point3d_mm->xyz.y / source_point3d_mm->xyz.z + param.cy;
+	}
+	return K4A_RESULT_SUCCEEDED;
+}
+
+k4a_transformation_t k4a_transformation_create(const k4a_calibration_t *calibration)
+{
+	liveTransformationCount++;
+	return reinterpret_cast<k4a_transformation_t>(new FakeTransformation{ *calibration });
+}
+
+void k4a_transformation_destroy(k4a_transformation_t transformation_handle)
+{
+	if (transformation_handle != nullptr)
+	{
+		delete reinterpret_cast<FakeTransformation *>(transformation_handle);
+		liveTransformationCount--;
+	}
+}
+
+// Nearest color pixel for every valid depth pixel, the rest stays black
+k4a_result_t k4a_transformation_color_image_to_depth_camera(k4a_transformation_t transformation_handle,
+	const k4a_image_t depth_image,
+	const k4a_image_t color_image,
+	k4a_image_t transformed_color_image)
+{
+	const k4a_calibration_t &calibration = reinterpret_cast<FakeTransformation *>(transformation_handle)->calibration;
+	const auto &depthParam = calibration.depth_camera_calibration.intrinsics.parameters.param;
+	const auto &colorParam = calibration.color_camera_calibration.intrinsics.parameters.param;
+	const FakeImage *depth = to_image(depth_image);
+	const FakeImage *color = to_image(color_image);
+	FakeImage *transformed = to_image(transformed_color_image);
+	if (transformed->width != depth->width ||
+		transformed->height != depth->height)
+	{
+		return K4A_RESULT_FAILED;
+	}
+
+	const uint16_t *depthData = reinterpret_cast<const uint16_t *>(depth->buffer);
+	const uint32_t *colorData = reinterpret_cast<const uint32_t *>(color->buffer);
+	uint32_t *transformedData = reinterpret_cast<uint32_t *>(transformed->buffer);
+	for (int y = 0; y < depth->height; y++)
+	{
+		for (int x = 0; x < depth->width; x++)
+		{
+			size_t i = static_cast<size_t>(y) * depth->width + x;
+			int colorX = static_cast<int>((x - depthParam.cx) / depthParam.fx * colorParam.fx + colorParam.cx);
+			int colorY = static_cast<int>((y - depthParam.cy) / depthParam.fy * colorParam.fy + colorParam.cy);
+			bool inside = colorX >= 0 && colorX < color->width && colorY >= 0 && colorY < color->height;
+			transformedData[i] = depthData[i] != 0 && inside ? colorData[static_cast<size_t>(colorY) * color->width + colorX] : 0;
+		}
+	}
+	return K4A_RESULT_SUCCEEDED;
+}
+
+k4a_result_t k4a_playback_open(const char *path, k4a_playback_t *playback_handle)
+{
+	return K4A_RESULT_FAILED;
+}
+
+void k4a_playback_close(k4a_playback_t playback_handle)
+{
+}
+
+k4a_result_t k4a_playback_get_calibration(k4a_playback_t playback_handle, k4a_calibration_t *calibration)
+{
+	return K4A_RESULT_FAILED;
+}
+
+k4a_stream_result_t k4a_playback_get_next_capture(k4a_playback_t playback_handle, k4a_capture_t *capture_handle)
+{
+	return K4A_STREAM_RESULT_FAILED;
+}
+
+k4a_result_t k4a_playback_set_color_conversion(k4a_playback_t playback_handle, k4a_image_format_t target_format)
+{
+	return K4A_RESULT_FAILED;
+}
+
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+// Stands in for the Azure Kinect sdk in the soak test. Devices stream a synthetic scene at their configured
+// frame rate, or faster when sped up, with device timestamps as if they ran in real time. Images come from
+// the allocator installed through k4a_set_allocator like the sdk's own, so the pool sees every capture.
+// Only BGRA32 color is produced and there is no imu or playback.
+class FakeSdk
+{
+public:
+	struct Stats
+	{
+		int openDeviceCount;
+		int liveCaptureCount;
+		int liveImageCount;
+		int liveTransformationCount;
+		uint64_t liveImageBytes;
+		uint64_t capturedCount;
+	};
+
+	static const int MaxDevices = 8;
+
+	// Call before the wrapper is created, speedup divides the time between frames and not their timestamps
+	static void Configure(int deviceCount, int speedup);
+	static Stats GetStats();
+};
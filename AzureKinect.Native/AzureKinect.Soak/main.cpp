@@ -0,0 +1,356 @@
+#include "pch.h"
+#include "AzureKinectWrapper.h"
+#include "FakeSdk.h"
+
+#include <d3d11.h>
+#pragma comment(lib, "d3d11.lib")
+
+static void print_usage()
+{
+	fprintf(stderr,
+		"Usage: AzureKinectSoak [options]\n"
+		"\n"
+		"Starts, reconfigures and stops fake devices through the plugin's wrapper over and over, and fails as\n"
+		"soon as memory that belongs to a stopped device is still around or a running device holds more than\n"
+		"it did the first time in the same mode. Needs neither a device nor Unity, textures come from a WARP\n"
+		"device and uploads are only counted.\n"
+		"\n"
+		"  -c, --cycles <count>      Start, reconfigure and stop cycles, defaults to 2000\n"
+		"  -d, --devices <count>     Devices cycled together, defaults to 1\n"
+		"  -f, --frames <count>      Frames published before and after each reconfigure, defaults to 3\n"
+		"      --speedup <factor>    Frames arrive this many times faster than their rate, defaults to 10\n"
+		"      --warmup <count>      Cycles before the pool's outstanding bytes are taken as the baseline,\n"
+		"                            defaults to 2\n");
+}
+
+static bool try_parse_count(const char *text, int &value)
+{
+	char *end = nullptr;
+	long parsed = strtol(text, &end, 10);
+	if (end == text || *end != '\0' || parsed < 0 || parsed > INT_MAX)
+	{
+		return false;
+	}
+
+	value = static_cast<int>(parsed);
+	return true;
+}
+
+// Each cycle starts in the first mode and reconfigures to the second, which differs in depth size so
+// the calibration and every texture are rebuilt. The pairs take turns so every size is also started cold.
+struct CycleModes
+{
+	k4a_depth_mode_t startDepthMode;
+	k4a_fps_t startFps;
+	k4a_depth_mode_t reconfiguredDepthMode;
+	k4a_fps_t reconfiguredFps;
+};
+
+static const CycleModes cycleModes[] = {
+	{ K4A_DEPTH_MODE_NFOV_UNBINNED, K4A_FRAMES_PER_SECOND_30, K4A_DEPTH_MODE_WFOV_2X2BINNED, K4A_FRAMES_PER_SECOND_15 },
+	{ K4A_DEPTH_MODE_WFOV_2X2BINNED, K4A_FRAMES_PER_SECOND_30, K4A_DEPTH_MODE_NFOV_2X2BINNED, K4A_FRAMES_PER_SECOND_30 },
+	{ K4A_DEPTH_MODE_NFOV_2X2BINNED, K4A_FRAMES_PER_SECOND_15, K4A_DEPTH_MODE_NFOV_UNBINNED, K4A_FRAMES_PER_SECOND_30 },
+};
+
+class SoakTest
+{
+public:
+	SoakTest(ID3D11Device *d3dDevice, int deviceCount, int framesPerPhase) :
+		deviceCount(deviceCount),
+		framesPerPhase(framesPerPhase)
+	{
+		auto backend = std::make_unique<CountingUploadBackend>();
+		uploadBackend = backend.get();
+		wrapper = std::make_unique<AzureKinectWrapper>(d3dDevice, std::move(backend));
+	}
+
+	~SoakTest()
+	{
+		// Joins every reader and releases what the devices still hold, so nothing outlives the fake sdk
+		wrapper = nullptr;
+	}
+
+	bool TryRunCycle(int cycle, int warmupCycles)
+	{
+		const CycleModes &modes = cycleModes[cycle % (sizeof(cycleModes) / sizeof(cycleModes[0]))];
+		for (int index = 0; index < deviceCount; index++)
+		{
+			if (!wrapper->TryStartStreams(index, K4A_IMAGE_FORMAT_COLOR_BGRA32, K4A_COLOR_RESOLUTION_720P, modes.startDepthMode, modes.startFps))
+			{
+				fprintf(stderr, "Cycle %d: device %d did not start\n", cycle, index);
+				return false;
+			}
+
+			// Everything that allocates per device while streaming, the stop has to undo all of it
+			wrapper->SubscribeIR(index);
+			wrapper->SubscribePyramidLevel(index, 2);
+			wrapper->SubscribeUndistortedStream(index, UndistortedStreamDepth);
+			wrapper->SubscribeColorUvMap(index);
+			wrapper->TrySetOutlierFilter(index, true, 5, 2.0f, OutlierFilterMask);
+		}
+
+		if (!TryPublishFrames(cycle) ||
+			!TryCheckRunning(cycle, modes.startDepthMode))
+		{
+			return false;
+		}
+
+		for (int index = 0; index < deviceCount; index++)
+		{
+			if (!wrapper->TryReconfigureStreams(index, K4A_IMAGE_FORMAT_COLOR_BGRA32, K4A_COLOR_RESOLUTION_720P, modes.reconfiguredDepthMode, modes.reconfiguredFps, nullptr))
+			{
+				fprintf(stderr, "Cycle %d: device %d did not reconfigure\n", cycle, index);
+				return false;
+			}
+		}
+
+		if (!TryPublishFrames(cycle) ||
+			!TryCheckRunning(cycle, modes.reconfiguredDepthMode))
+		{
+			return false;
+		}
+
+		for (int index = 0; index < deviceCount; index++)
+		{
+			wrapper->StopStreaming(index);
+		}
+
+		return TryCheckStopped(cycle, warmupCycles);
+	}
+
+	void PrintProgress(int cycle)
+	{
+		uint64_t acquireCount, heapAllocationCount, heapAllocatedBytes, outstandingCount, outstandingBytes, pooledBytes;
+		wrapper->TryGetAllocationStats(&acquireCount, &heapAllocationCount, &heapAllocatedBytes, &outstandingCount, &outstandingBytes, &pooledBytes);
+		FakeSdk::Stats sdkStats = FakeSdk::GetStats();
+		printf("%6d cycles  %8.1f MB peak per device  %6.1f MB outstanding  %6.1f MB pooled  %llu captures  %llu uploads\n",
+			cycle,
+			peakDeviceBytes / (1024.0 * 1024.0),
+			outstandingBytes / (1024.0 * 1024.0),
+			pooledBytes / (1024.0 * 1024.0),
+			static_cast<unsigned long long>(sdkStats.capturedCount),
+			static_cast<unsigned long long>(uploadBackend->uploadCount.load()));
+	}
+
+private:
+	// Every device has to publish this many new frames, uploads are drained like the render thread would
+	bool TryPublishFrames(int cycle)
+	{
+		uint64_t targets[FakeSdk::MaxDevices] = {};
+		for (int index = 0; index < deviceCount; index++)
+		{
+			wrapper->TryGetFrameSequence(index, &targets[index]);
+			targets[index] += framesPerPhase;
+		}
+
+		int64_t deadline = TimingHelper::GetTimestampMicroseconds() + 5000000;
+		while (TimingHelper::GetTimestampMicroseconds() < deadline)
+		{
+			wrapper->TryUpdate();
+			wrapper->DrainUploads();
+
+			bool published = true;
+			for (int index = 0; index < deviceCount; index++)
+			{
+				uint64_t sequence = 0;
+				wrapper->TryGetFrameSequence(index, &sequence);
+				published = published && sequence >= targets[index];
+			}
+			if (published)
+			{
+				return true;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+
+		fprintf(stderr, "Cycle %d: devices stopped publishing frames\n", cycle);
+		return false;
+	}
+
+	// The same mode has to come back to the same footprint, whatever ran before it
+	bool TryCheckRunning(int cycle, k4a_depth_mode_t depthMode)
+	{
+		for (int index = 0; index < deviceCount; index++)
+		{
+			DeviceMemoryStats stats = {};
+			if (!wrapper->TryGetDeviceMemoryStats(index, &stats))
+			{
+				fprintf(stderr, "Cycle %d: no memory stats for device %d\n", cycle, index);
+				return false;
+			}
+
+			uint64_t &expected = runningBytes[index][depthMode];
+			if (expected == 0)
+			{
+				expected = stats.totalBytes;
+			}
+			else if (stats.totalBytes > expected)
+			{
+				fprintf(stderr, "Cycle %d: device %d holds %llu bytes in depth mode %d, %llu the first time\n",
+					cycle,
+					index,
+					static_cast<unsigned long long>(stats.totalBytes),
+					static_cast<int>(depthMode),
+					static_cast<unsigned long long>(expected));
+				return false;
+			}
+			peakDeviceBytes = max(peakDeviceBytes, stats.totalBytes);
+		}
+		return true;
+	}
+
+	bool TryCheckStopped(int cycle, int warmupCycles)
+	{
+		for (int index = 0; index < deviceCount; index++)
+		{
+			DeviceMemoryStats stats = {};
+			wrapper->TryGetDeviceMemoryStats(index, &stats);
+			if (stats.totalBytes != 0)
+			{
+				fprintf(stderr, "Cycle %d: stopped device %d still holds %llu bytes in %d images, %d buffers, %d tables, %d textures and %d upload targets\n",
+					cycle,
+					index,
+					static_cast<unsigned long long>(stats.totalBytes),
+					stats.imageCount,
+					stats.bufferCount,
+					stats.lutCount,
+					stats.textureCount,
+					stats.uploadTargetCount);
+				return false;
+			}
+		}
+
+		FakeSdk::Stats sdkStats = FakeSdk::GetStats();
+		if (sdkStats.openDeviceCount != 0 ||
+			sdkStats.liveCaptureCount != 0 ||
+			sdkStats.liveImageCount != 0 ||
+			sdkStats.liveTransformationCount != 0)
+		{
+			fprintf(stderr, "Cycle %d: %d devices, %d captures, %d images (%llu bytes) and %d transformations outlived the stop\n",
+				cycle,
+				sdkStats.openDeviceCount,
+				sdkStats.liveCaptureCount,
+				sdkStats.liveImageCount,
+				static_cast<unsigned long long>(sdkStats.liveImageBytes),
+				sdkStats.liveTransformationCount);
+			return false;
+		}
+
+		// Pooled buffers are kept for reuse, only buffers still handed out would be a leak
+		uint64_t acquireCount, heapAllocationCount, heapAllocatedBytes, outstandingCount, outstandingBytes, pooledBytes;
+		wrapper->TryGetAllocationStats(&acquireCount, &heapAllocationCount, &heapAllocatedBytes, &outstandingCount, &outstandingBytes, &pooledBytes);
+		if (cycle + 1 == warmupCycles)
+		{
+			baselineOutstandingBytes = outstandingBytes;
+		}
+		else if (cycle + 1 > warmupCycles &&
+			outstandingBytes > baselineOutstandingBytes)
+		{
+			fprintf(stderr, "Cycle %d: %llu bytes outstanding in the pool, %llu after warming up\n",
+				cycle,
+				static_cast<unsigned long long>(outstandingBytes),
+				static_cast<unsigned long long>(baselineOutstandingBytes));
+			return false;
+		}
+		return true;
+	}
+
+	std::unique_ptr<AzureKinectWrapper> wrapper;
+	CountingUploadBackend *uploadBackend = nullptr;
+	int deviceCount;
+	int framesPerPhase;
+	std::map<k4a_depth_mode_t, uint64_t> runningBytes[FakeSdk::MaxDevices];
+	uint64_t peakDeviceBytes = 0;
+	uint64_t baselineOutstandingBytes = 0;
+};
+
+int main(int argc, char **argv)
+{
+	int cycleCount = 2000;
+	int deviceCount = 1;
+	int framesPerPhase = 3;
+	int speedup = 10;
+	int warmupCycles = 2;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		bool result = true;
+
+		if (arg == "-c" || arg == "--cycles")
+		{
+			result = hasValue && try_parse_count(argv[++i], cycleCount);
+		}
+		else if (arg == "-d" || arg == "--devices")
+		{
+			result = hasValue && try_parse_count(argv[++i], deviceCount) && deviceCount >= 1 && deviceCount <= FakeSdk::MaxDevices;
+		}
+		else if (arg == "-f" || arg == "--frames")
+		{
+			result = hasValue && try_parse_count(argv[++i], framesPerPhase) && framesPerPhase >= 1;
+		}
+		else if (arg == "--speedup")
+		{
+			result = hasValue && try_parse_count(argv[++i], speedup) && speedup >= 1;
+		}
+		else if (arg == "--warmup")
+		{
+			result = hasValue && try_parse_count(argv[++i], warmupCycles) && warmupCycles >= 1;
+		}
+		else if (arg == "-h" || arg == "--help")
+		{
+			print_usage();
+			return 0;
+		}
+		else
+		{
+			result = false;
+		}
+
+		if (!result)
+		{
+			fprintf(stderr, "Invalid argument: %s\n\n", arg.c_str());
+			print_usage();
+			return 1;
+		}
+	}
+
+	// Textures are created for real, WARP needs no graphics hardware
+	ID3D11Device *d3dDevice = nullptr;
+	if (FAILED(D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_WARP, nullptr, 0, nullptr, 0, D3D11_SDK_VERSION, &d3dDevice, nullptr, nullptr)))
+	{
+		fprintf(stderr, "Failed to create a WARP device\n");
+		return 1;
+	}
+
+	FakeSdk::Configure(deviceCount, speedup);
+	int failedCycle = -1;
+	{
+		SoakTest test(d3dDevice, deviceCount, framesPerPhase);
+		for (int cycle = 0; cycle < cycleCount; cycle++)
+		{
+			if (!test.TryRunCycle(cycle, warmupCycles))
+			{
+				failedCycle = cycle;
+				break;
+			}
+
+			if ((cycle + 1) % 100 == 0 ||
+				cycle + 1 == cycleCount)
+			{
+				test.PrintProgress(cycle + 1);
+			}
+		}
+	}
+	d3dDevice->Release();
+
+	if (failedCycle >= 0)
+	{
+		printf("Failed in cycle %d\n", failedCycle);
+		return 1;
+	}
+
+	printf("Memory stayed flat over %d cycles\n", cycleCount);
+	return 0;
+}
@@ -0,0 +1,524 @@
+#include "pch.h"
+
+#include <cmath>
+
+static void print_usage()
+{
+	fprintf(stderr,
+		"Usage: AzureKinectStream serve [options]\n"
+		"       AzureKinectStream view [options] <host> <port>\n"
+		"       AzureKinectStream loopback [options]\n"
+		"\n"
+		"serve streams registered color and depth from a recording, or a synthetic scene without one, to\n"
+		"every client that connects. view follows a server and loopback runs both ends in this process over\n"
+		"127.0.0.1. Each prints per-stage latency and bandwidth once a second. Latency needs the server on\n"
+		"the same machine.\n"
+		"\n"
+		"  -p, --port <port>         Port to serve on, defaults to 7600 and to any free one for loopback\n"
+		"  -r, --recording <file>    Stream this recording in a loop at its own frame rate\n"
+		"  -q, --quality <1-100>     Color quality, defaults to 75\n"
+		"  -e, --depth-error <mm>    Largest depth error, defaults to 0 for lossless depth\n"
+		"      --fps <rate>          Most frames sent per second, defaults to every frame\n"
+		"  -s, --seconds <count>     Stop after this many seconds, defaults to 10\n");
+}
+
+static bool try_parse_count(const char *text, int &value)
+{
+	char *end = nullptr;
+	long parsed = strtol(text, &end, 10);
+	if (end == text || *end != '\0' || parsed < 0 || parsed > INT_MAX)
+	{
+		return false;
+	}
+
+	value = static_cast<int>(parsed);
+	return true;
+}
+
+static bool try_parse_rate(const char *text, float &value)
+{
+	char *end = nullptr;
+	double parsed = strtod(text, &end);
+	if (end == text || *end != '\0' || !(parsed >= 0.0) || parsed > 1000.0)
+	{
+		return false;
+	}
+
+	value = static_cast<float>(parsed);
+	return true;
+}
+
+// Frames to serve, a recording played back in a loop at its own rate or a synthetic scene at 30 frames
+// per second. Registered color comes out at the depth camera's size like the plugin publishes it.
+class FrameSource
+{
+public:
+	~FrameSource()
+	{
+		if (transformation != nullptr)
+		{
+			k4a_transformation_destroy(transformation);
+		}
+		if (transformedColorImage != nullptr)
+		{
+			k4a_image_release(transformedColorImage);
+		}
+		if (playback != nullptr)
+		{
+			k4a_playback_close(playback);
+		}
+	}
+
+	bool TryOpenRecording(const std::string &path)
+	{
+		k4a_calibration_t calibration;
+		k4a_record_configuration_t configuration;
+		if (K4A_RESULT_SUCCEEDED != k4a_playback_open(path.c_str(), &playback) ||
+			K4A_RESULT_SUCCEEDED != k4a_playback_get_calibration(playback, &calibration) ||
+			K4A_RESULT_SUCCEEDED != k4a_playback_get_record_configuration(playback, &configuration) ||
+			!configuration.depth_track_enabled)
+		{
+			return false;
+		}
+
+		size_t calibrationSize = 0;
+		k4a_playback_get_raw_calibration(playback, nullptr, &calibrationSize);
+		rawCalibration.resize(calibrationSize);
+		if (K4A_BUFFER_RESULT_SUCCEEDED != k4a_playback_get_raw_calibration(playback, rawCalibration.data(), &calibrationSize))
+		{
+			rawCalibration.clear();
+		}
+		depthMode = configuration.depth_mode;
+		colorResolution = configuration.color_resolution;
+
+		width = calibration.depth_camera_calibration.resolution_width;
+		height = calibration.depth_camera_calibration.resolution_height;
+		depth.resize(static_cast<size_t>(width) * height);
+
+		// Depth only recordings stream depth alone
+		if (configuration.color_track_enabled &&
+			K4A_RESULT_SUCCEEDED == k4a_playback_set_color_conversion(playback, K4A_IMAGE_FORMAT_COLOR_BGRA32) &&
+			K4A_RESULT_SUCCEEDED == k4a_image_create(K4A_IMAGE_FORMAT_COLOR_BGRA32, width, height, width * 4, &transformedColorImage))
+		{
+			transformation = k4a_transformation_create(&calibration);
+		}
+		return true;
+	}
+
+	void OpenSynthetic(int width, int height)
+	{
+		this->width = width;
+		this->height = height;
+		depth.resize(static_cast<size_t>(width) * height);
+		color.resize(static_cast<size_t>(width) * height * 4);
+	}
+
+	const std::vector<uint8_t> &GetRawCalibration() const { return rawCalibration; }
+	int GetDepthMode() const { return depthMode; }
+	int GetColorResolution() const { return colorResolution; }
+
+	// Waits until the next frame is due, either image comes back null when the frame has none
+	bool TryGetNextFrame(FrameStreamFrameInfo &info, const uint16_t *&depthData, const uint8_t *&colorData)
+	{
+		uint64_t deviceTimestampUsec = 0;
+		bool hasColor = false;
+		if (playback != nullptr)
+		{
+			if (!TryReadRecordingFrame(deviceTimestampUsec, hasColor))
+			{
+				return false;
+			}
+		}
+		else
+		{
+			deviceTimestampUsec = frameCount * 33333;
+			DrawSyntheticFrame();
+			hasColor = true;
+		}
+
+		// Frames go out at the rate they were captured, measured from the first one of each loop
+		int64_t now = TimingHelper::GetTimestampMicroseconds();
+		if (frameCount == 0 ||
+			deviceTimestampUsec < firstDeviceTimestampUsec)
+		{
+			firstDeviceTimestampUsec = deviceTimestampUsec;
+			startMicroseconds = now;
+		}
+		int64_t due = startMicroseconds + static_cast<int64_t>(deviceTimestampUsec - firstDeviceTimestampUsec);
+		if (due > now)
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(due - now));
+		}
+
+		info = {};
+		info.frameSequence = ++frameCount;
+		info.width = static_cast<uint32_t>(width);
+		info.height = static_cast<uint32_t>(height);
+		info.calibrationVersion = 1;
+		info.depthDeviceTimestampUsec = deviceTimestampUsec;
+		info.depthHostTimestampNsec = TimingHelper::GetTimestampNanoseconds();
+		depthData = depth.data();
+		colorData = hasColor ? (playback != nullptr ? k4a_image_get_buffer(transformedColorImage) : color.data()) : nullptr;
+		return true;
+	}
+
+private:
+	bool TryReadRecordingFrame(uint64_t &deviceTimestampUsec, bool &hasColor)
+	{
+		for (int attempt = 0; attempt < 1000; attempt++)
+		{
+			k4a_capture_t capture = nullptr;
+			k4a_stream_result_t result = k4a_playback_get_next_capture(playback, &capture);
+			if (result == K4A_STREAM_RESULT_EOF)
+			{
+				if (K4A_RESULT_SUCCEEDED != k4a_playback_seek_timestamp(playback, 0, K4A_PLAYBACK_SEEK_BEGIN))
+				{
+					return false;
+				}
+				continue;
+			}
+			else if (result != K4A_STREAM_RESULT_SUCCEEDED)
+			{
+				return false;
+			}
+
+			k4a_image_t depthImage = k4a_capture_get_depth_image(capture);
+			k4a_image_t colorImage = transformation != nullptr ? k4a_capture_get_color_image(capture) : nullptr;
+			if (depthImage != nullptr)
+			{
+				memcpy(depth.data(), k4a_image_get_buffer(depthImage), depth.size() * sizeof(uint16_t));
+				deviceTimestampUsec = k4a_image_get_device_timestamp_usec(depthImage);
+				hasColor = colorImage != nullptr &&
+					K4A_RESULT_SUCCEEDED == k4a_transformation_color_image_to_depth_camera(transformation,
+						depthImage,
+						colorImage,
+						transformedColorImage);
+			}
+
+			if (colorImage != nullptr)
+			{
+				k4a_image_release(colorImage);
+			}
+			if (depthImage != nullptr)
+			{
+				k4a_image_release(depthImage);
+			}
+			k4a_capture_release(capture);
+
+			if (depthImage != nullptr)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// A ball moving in front of a tilted wall, with a band of invalid depth along the edges like the wide
+	// field of view leaves, and colored stripes that move with the ball
+	void DrawSyntheticFrame()
+	{
+		float phase = frameCount * 0.05f;
+		float ballX = width * (0.5f + 0.3f * cosf(phase));
+		float ballY = height * (0.5f + 0.2f * sinf(phase * 1.3f));
+		float radius = height * 0.15f;
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				size_t i = static_cast<size_t>(y) * width + x;
+				float dx = x - ballX;
+				float dy = y - ballY;
+				float inside = radius * radius - dx * dx - dy * dy;
+				bool border = x < width / 16 || x >= width - width / 16;
+				uint16_t value = static_cast<uint16_t>(2000 + x + y / 2);
+				if (inside > 0.0f)
+				{
+					value = static_cast<uint16_t>(1200 - sqrtf(inside));
+				}
+
+				depth[i] = border ? 0 : value;
+				uint8_t *pixel = &color[i * 4];
+				pixel[0] = static_cast<uint8_t>(128 + 100 * sinf((x + frameCount * 4) * 0.05f));
+				pixel[1] = static_cast<uint8_t>(inside > 0.0f ? 220 : y * 255 / height);
+				pixel[2] = static_cast<uint8_t>(x * 255 / width);
+				pixel[3] = 255;
+				if (border)
+				{
+					memset(pixel, 0, 4);
+				}
+			}
+		}
+	}
+
+	k4a_playback_t playback = nullptr;
+	k4a_transformation_t transformation = nullptr;
+	k4a_image_t transformedColorImage = nullptr;
+	std::vector<uint8_t> rawCalibration;
+	int depthMode = K4A_DEPTH_MODE_NFOV_UNBINNED;
+	int colorResolution = K4A_COLOR_RESOLUTION_720P;
+	int width = 0;
+	int height = 0;
+	std::vector<uint16_t> depth;
+	std::vector<uint8_t> color;
+	uint64_t frameCount = 0;
+	uint64_t firstDeviceTimestampUsec = 0;
+	int64_t startMicroseconds = 0;
+};
+
+static void print_server_header()
+{
+	printf("%6s %7s %7s %7s %7s %7s %8s %8s %7s %8s\n",
+		"second", "clients", "frames", "skipped", "dropped", "ratio", "color ms", "depth ms", "send ms", "Mbit/s");
+}
+
+static void print_server_row(int second, const FrameStreamServer::Stats &stats, const FrameStreamServer::Stats &reported)
+{
+	printf("%6d %7d %7llu %7llu %7llu %7.1f %8.2f %8.2f %7.2f %8.2f\n",
+		second,
+		stats.clientCount,
+		static_cast<unsigned long long>(stats.encodedCount - reported.encodedCount),
+		static_cast<unsigned long long>(stats.skippedCount - reported.skippedCount),
+		static_cast<unsigned long long>(stats.droppedCount - reported.droppedCount),
+		stats.compressionRatio,
+		stats.lastColorEncodeMilliseconds,
+		stats.lastDepthEncodeMilliseconds,
+		stats.lastSendMilliseconds,
+		stats.megabitsPerSecond);
+}
+
+static void print_client_header()
+{
+	printf("%6s %7s %7s %7s %8s %8s %10s %9s %8s\n",
+		"second", "frames", "missed", "failed", "recv ms", "dec ms", "latency ms", "jitter ms", "Mbit/s");
+}
+
+static void print_client_row(int second, const FrameStreamClient::Stats &stats, const FrameStreamClient::Stats &reported)
+{
+	printf("%6d %7llu %7llu %7llu %8.2f %8.2f %10.2f %9.2f %8.2f\n",
+		second,
+		static_cast<unsigned long long>(stats.receivedCount - reported.receivedCount),
+		static_cast<unsigned long long>(stats.missedCount - reported.missedCount),
+		static_cast<unsigned long long>(stats.failedCount - reported.failedCount),
+		stats.lastReceiveMilliseconds,
+		stats.lastDecodeMilliseconds,
+		stats.lastLatencyMilliseconds,
+		stats.intervalJitterMilliseconds,
+		stats.megabitsPerSecond);
+}
+
+// Both ends in one row, encode through decode in the order a frame passes them
+static void print_loopback_header()
+{
+	printf("%6s %7s %7s %7s %8s %8s %7s %8s %8s %10s %9s %8s\n",
+		"second", "frames", "skipped", "ratio", "color ms", "depth ms", "send ms", "recv ms", "dec ms", "latency ms", "jitter ms", "Mbit/s");
+}
+
+static void print_loopback_row(
+	int second,
+	const FrameStreamServer::Stats &serverStats,
+	const FrameStreamServer::Stats &reportedServer,
+	const FrameStreamClient::Stats &clientStats,
+	const FrameStreamClient::Stats &reportedClient)
+{
+	printf("%6d %7llu %7llu %7.1f %8.2f %8.2f %7.2f %8.2f %8.2f %10.2f %9.2f %8.2f\n",
+		second,
+		static_cast<unsigned long long>(clientStats.receivedCount - reportedClient.receivedCount),
+		static_cast<unsigned long long>(serverStats.skippedCount - reportedServer.skippedCount),
+		serverStats.compressionRatio,
+		serverStats.lastColorEncodeMilliseconds,
+		serverStats.lastDepthEncodeMilliseconds,
+		serverStats.lastSendMilliseconds,
+		clientStats.lastReceiveMilliseconds,
+		clientStats.lastDecodeMilliseconds,
+		clientStats.lastLatencyMilliseconds,
+		clientStats.intervalJitterMilliseconds,
+		clientStats.megabitsPerSecond);
+}
+
+int main(int argc, char **argv)
+{
+	std::string mode;
+	std::vector<std::string> positional;
+	std::string recordingPath;
+	FrameStreamServer::Options options = FrameStreamServer::GetDefaultOptions();
+	options.port = -1;
+	int seconds = 10;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		bool result = true;
+
+		if (arg == "-p" || arg == "--port")
+		{
+			result = hasValue && try_parse_count(argv[++i], options.port) && options.port <= 65535;
+		}
+		else if (arg == "-r" || arg == "--recording")
+		{
+			result = hasValue;
+			recordingPath = hasValue ? argv[++i] : "";
+		}
+		else if (arg == "-q" || arg == "--quality")
+		{
+			result = hasValue && try_parse_count(argv[++i], options.colorQuality) &&
+				options.colorQuality >= 1 &&
+				options.colorQuality <= 100;
+		}
+		else if (arg == "-e" || arg == "--depth-error")
+		{
+			result = hasValue && try_parse_count(argv[++i], options.depthErrorMillimeters) && options.depthErrorMillimeters <= 1000;
+		}
+		else if (arg == "--fps")
+		{
+			result = hasValue && try_parse_rate(argv[++i], options.maxFramesPerSecond);
+		}
+		else if (arg == "-s" || arg == "--seconds")
+		{
+			result = hasValue && try_parse_count(argv[++i], seconds);
+		}
+		else if (arg == "-h" || arg == "--help")
+		{
+			print_usage();
+			return 0;
+		}
+		else if (!arg.empty() && arg[0] == '-')
+		{
+			result = false;
+		}
+		else if (mode.empty())
+		{
+			mode = arg;
+			result = mode == "serve" || mode == "view" || mode == "loopback";
+		}
+		else
+		{
+			positional.push_back(arg);
+		}
+
+		if (!result)
+		{
+			fprintf(stderr, "Invalid argument %s\n\n", arg.c_str());
+			print_usage();
+			return 2;
+		}
+	}
+
+	if (mode.empty() ||
+		positional.size() != (mode == "view" ? 2u : 0u))
+	{
+		print_usage();
+		return 2;
+	}
+
+	if (mode == "view")
+	{
+		int port = 0;
+		FrameStreamClient client;
+		if (!try_parse_count(positional[1].c_str(), port) ||
+			!client.TryConnect(positional[0], port))
+		{
+			fprintf(stderr, "Can not connect to %s:%s\n", positional[0].c_str(), positional[1].c_str());
+			return 1;
+		}
+
+		print_client_header();
+		FrameStreamClient::Stats reported = {};
+		for (int second = 1; second <= seconds; second++)
+		{
+			std::this_thread::sleep_for(std::chrono::seconds(1));
+			FrameStreamClient::Stats stats = client.GetStats();
+			print_client_row(second, stats, reported);
+			fflush(stdout);
+			reported = stats;
+		}
+		return 0;
+	}
+
+	FrameSource source;
+	if (recordingPath.empty())
+	{
+		source.OpenSynthetic(640, 576);
+	}
+	else if (!source.TryOpenRecording(recordingPath))
+	{
+		fprintf(stderr, "Can not read %s\n", recordingPath.c_str());
+		return 1;
+	}
+
+	if (options.port < 0)
+	{
+		options.port = mode == "loopback" ? 0 : 7600;
+	}
+
+	FrameStreamServer server;
+	if (!server.TryStart(options))
+	{
+		fprintf(stderr, "Can not listen on port %d\n", options.port);
+		return 1;
+	}
+	server.SetCalibration(source.GetRawCalibration().data(),
+		source.GetRawCalibration().size(),
+		source.GetDepthMode(),
+		source.GetColorResolution(),
+		1);
+
+	FrameStreamClient client;
+	if (mode == "loopback" &&
+		!client.TryConnect("127.0.0.1", server.GetPort()))
+	{
+		fprintf(stderr, "Can not connect to port %d\n", server.GetPort());
+		return 1;
+	}
+
+	printf("Serving on port %d\n", server.GetPort());
+	if (mode == "loopback")
+	{
+		print_loopback_header();
+	}
+	else
+	{
+		print_server_header();
+	}
+
+	auto reportTime = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+	FrameStreamServer::Stats reportedServer = {};
+	FrameStreamClient::Stats reportedClient = {};
+	for (int second = 1; second <= seconds;)
+	{
+		FrameStreamFrameInfo info;
+		const uint16_t *depthData = nullptr;
+		const uint8_t *colorData = nullptr;
+		if (!source.TryGetNextFrame(info, depthData, colorData))
+		{
+			fprintf(stderr, "Can not read the next frame\n");
+			return 1;
+		}
+		server.Submit(info, depthData, colorData);
+
+		if (std::chrono::steady_clock::now() < reportTime)
+		{
+			continue;
+		}
+
+		FrameStreamServer::Stats serverStats = server.GetStats();
+		if (mode == "loopback")
+		{
+			FrameStreamClient::Stats clientStats = client.GetStats();
+			print_loopback_row(second, serverStats, reportedServer, clientStats, reportedClient);
+			reportedClient = clientStats;
+		}
+		else
+		{
+			print_server_row(second, serverStats, reportedServer);
+		}
+		reportedServer = serverStats;
+		fflush(stdout);
+
+		reportTime += std::chrono::seconds(1);
+		second++;
+	}
+
+	return 0;
+}
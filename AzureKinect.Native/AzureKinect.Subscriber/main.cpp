@@ -0,0 +1,166 @@
+#include "SharedFrameRing.h"
+
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+static void print_usage()
+{
+	fprintf(stderr,
+		"Usage: AzureKinectSubscribe [options] <name>\n"
+		"\n"
+		"Follows the frames a device publishes to shared memory under <name> and prints once a second\n"
+		"how many arrived, how many were skipped or torn and how long after publishing they were read.\n"
+		"\n"
+		"  -s, --seconds <count>     Stop after this many seconds, defaults to 10\n"
+		"      --touch               Read every depth pixel of each frame before checking it\n");
+}
+
+static bool try_parse_count(const char *text, int &value)
+{
+	char *end = nullptr;
+	long parsed = strtol(text, &end, 10);
+	if (end == text || *end != '\0' || parsed < 0 || parsed > INT_MAX)
+	{
+		return false;
+	}
+
+	value = static_cast<int>(parsed);
+	return true;
+}
+
+static uint64_t get_host_timestamp_nsec()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char **argv)
+{
+	std::string name;
+	int seconds = 10;
+	bool touch = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		bool result = true;
+
+		if (arg == "-s" || arg == "--seconds")
+		{
+			result = hasValue && try_parse_count(argv[++i], seconds);
+		}
+		else if (arg == "--touch")
+		{
+			touch = true;
+		}
+		else if (arg == "-h" || arg == "--help")
+		{
+			print_usage();
+			return 0;
+		}
+		else if (!arg.empty() && arg[0] == '-')
+		{
+			result = false;
+		}
+		else
+		{
+			result = name.empty();
+			name = arg;
+		}
+
+		if (!result)
+		{
+			fprintf(stderr, "Invalid argument %s\n\n", arg.c_str());
+			print_usage();
+			return 2;
+		}
+	}
+
+	if (name.empty())
+	{
+		print_usage();
+		return 2;
+	}
+
+	SharedFrameReader reader;
+	if (!reader.TryOpen(name))
+	{
+		fprintf(stderr, "Nothing is published as %s\n", name.c_str());
+		return 1;
+	}
+
+	printf("%8s %8s %8s %8s %8s %12s %12s\n", "second", "frames", "skipped", "torn", "retries", "latency ms", "max ms");
+
+	auto start = std::chrono::steady_clock::now();
+	auto reportTime = start + std::chrono::seconds(1);
+	SharedFrameReader::Stats reported = {};
+	uint64_t lastSequence = 0;
+	double latencyMilliseconds = 0.0;
+	double maxLatencyMilliseconds = 0.0;
+	uint64_t checksum = 0;
+	for (int second = 1; second <= seconds;)
+	{
+		if (reader.TryWaitForFrame(lastSequence, 100))
+		{
+			SharedFrame frame;
+			if (reader.TryAcquireLatest(frame))
+			{
+				lastSequence = frame.sequence;
+				if (touch &&
+					frame.depthData != nullptr)
+				{
+					for (size_t i = 0; i < (size_t)frame.width * frame.height; i++)
+					{
+						checksum += frame.depthData[i];
+					}
+				}
+
+				if (reader.IsValid(frame))
+				{
+					double latency = (int64_t)(get_host_timestamp_nsec() - frame.publishHostTimestampNsec) / 1000000.0;
+					latencyMilliseconds += latency;
+					maxLatencyMilliseconds = latency > maxLatencyMilliseconds ? latency : maxLatencyMilliseconds;
+				}
+			}
+		}
+		else if (reader.IsClosed())
+		{
+			fprintf(stderr, "The publisher of %s stopped\n", name.c_str());
+			return 1;
+		}
+
+		if (std::chrono::steady_clock::now() < reportTime)
+		{
+			continue;
+		}
+
+		SharedFrameReader::Stats stats = reader.GetStats();
+		uint64_t frames = stats.acquiredCount - reported.acquiredCount;
+		printf("%8d %8llu %8llu %8llu %8llu %12.3f %12.3f\n",
+			second,
+			static_cast<unsigned long long>(frames),
+			static_cast<unsigned long long>(stats.skippedCount - reported.skippedCount),
+			static_cast<unsigned long long>(stats.tornCount - reported.tornCount),
+			static_cast<unsigned long long>(stats.retryCount - reported.retryCount),
+			frames > 0 ? latencyMilliseconds / frames : 0.0,
+			maxLatencyMilliseconds);
+		fflush(stdout);
+
+		reported = stats;
+		latencyMilliseconds = 0.0;
+		maxLatencyMilliseconds = 0.0;
+		reportTime += std::chrono::seconds(1);
+		second++;
+	}
+
+	if (touch)
+	{
+		printf("depth checksum %llu\n", static_cast<unsigned long long>(checksum));
+	}
+
+	return 0;
+}
@@ -69,6 +69,11 @@ public class AzureKinectHelper : MonoBehaviour
         return AzureKinectUnityAPI.Instance(deviceIndex).TryGetImageBuffers(out transformedColorImageBuffer, out depthImageBuffer, out pointCloudImageBuffer);
     }
 
+    public bool TryExportPointCloud(string path, PointCloudFileFormat format, bool includeNormals, out int pointCount)
+    {
+        return AzureKinectUnityAPI.Instance(deviceIndex).TryExportPointCloud(path, format, includeNormals, out pointCount);
+    }
+
     public Texture2D GetRGBTexture()
     {
         return AzureKinectUnityAPI.Instance(deviceIndex).RGBTexture;
@@ -0,0 +1,124 @@
+﻿using UnityEngine;
+
+// Cycles one device through start, reconfigure and stop and checks that nothing it allocated outlives it.
+// After every stop the device has to report no live memory and the shared pool's outstanding bytes have to
+// be back where they were after the first cycle, growth is logged as an error. Meant for a soak scene on a
+// test rig, nothing else should use the device while it runs. AzureKinect.Native/AzureKinect.Soak runs the
+// same cycles headless against a fake device and fails on growth.
+public class AzureKinectSoakTest : MonoBehaviour
+{
+    [SerializeField]
+    uint deviceIndex = 0;
+
+    [SerializeField]
+    private int cycleCount = 1000;
+
+    // Updates spent streaming before and after the reconfigure of each cycle
+    [SerializeField]
+    private int updatesPerPhase = 10;
+
+    [SerializeField]
+    private k4a_image_format_t colorFormat = k4a_image_format_t.K4A_IMAGE_FORMAT_COLOR_BGRA32;
+
+    [SerializeField]
+    private k4a_color_resolution_t colorResolution = k4a_color_resolution_t.K4A_COLOR_RESOLUTION_720P;
+
+    [SerializeField]
+    private k4a_depth_mode_t depthMode = k4a_depth_mode_t.K4A_DEPTH_MODE_NFOV_UNBINNED;
+
+    // Differs in size from depthMode, so every cycle recreates the textures as well
+    [SerializeField]
+    private k4a_depth_mode_t reconfiguredDepthMode = k4a_depth_mode_t.K4A_DEPTH_MODE_WFOV_2X2BINNED;
+
+    [SerializeField]
+    private k4a_fps_t fps = k4a_fps_t.K4A_FRAMES_PER_SECOND_15;
+
+    private int cycle = 0;
+    private int updateCount = 0;
+    private bool reconfigured = false;
+    private ulong baselineOutstandingBytes = 0;
+    private ulong peakDeviceBytes = 0;
+    private int failureCount = 0;
+
+    protected void Awake()
+    {
+        AzureKinectUnityAPI.Instance(deviceIndex).SetConfiguration(colorFormat, colorResolution, depthMode, fps);
+    }
+
+    protected void OnDestroy()
+    {
+        AzureKinectUnityAPI.Instance(deviceIndex).Stop();
+    }
+
+    protected void Update()
+    {
+        if (cycle >= cycleCount)
+        {
+            return;
+        }
+
+        // Starts the device again whenever the last cycle stopped it
+        var api = AzureKinectUnityAPI.Instance(deviceIndex);
+        api.Update();
+        if (++updateCount < updatesPerPhase)
+        {
+            return;
+        }
+
+        updateCount = 0;
+        if (api.TryGetMemoryStats(out var stats))
+        {
+            peakDeviceBytes = System.Math.Max(peakDeviceBytes, stats.totalBytes);
+        }
+
+        if (!reconfigured)
+        {
+            if (!api.Reconfigure(colorFormat, colorResolution, reconfiguredDepthMode, fps))
+            {
+                failureCount++;
+                Debug.LogError($"Soak cycle {cycle}: reconfigure failed");
+            }
+
+            reconfigured = true;
+            return;
+        }
+
+        api.Stop();
+        api.SetConfiguration(colorFormat, colorResolution, depthMode, fps);
+        reconfigured = false;
+        CheckMemory();
+
+        cycle++;
+        if (cycle == cycleCount)
+        {
+            Debug.Log($"Soak finished {cycleCount} cycles with {failureCount} failures, peak device memory {peakDeviceBytes} bytes");
+        }
+    }
+
+    private void CheckMemory()
+    {
+        if (AzureKinectUnityAPI.Instance(deviceIndex).TryGetMemoryStats(out var stats) &&
+            stats.totalBytes != 0)
+        {
+            failureCount++;
+            Debug.LogError($"Soak cycle {cycle}: device still holds {stats.totalBytes} bytes after stopping, " +
+                $"images {stats.imageBytes}, buffers {stats.bufferBytes}, luts {stats.lutBytes}, textures {stats.textureBytes}, uploads {stats.uploadBytes}");
+        }
+
+        if (!AzureKinectUnityAPI.TryGetAllocationStats(out var heapAllocationCount, out var heapAllocatedBytes, out var outstandingBytes, out var pooledBytes))
+        {
+            return;
+        }
+
+        // Whatever the sdk keeps for itself is settled by the end of the first cycle
+        if (cycle == 0)
+        {
+            baselineOutstandingBytes = outstandingBytes;
+        }
+        else if (outstandingBytes > baselineOutstandingBytes)
+        {
+            failureCount++;
+            Debug.LogError($"Soak cycle {cycle}: outstanding pool memory grew from {baselineOutstandingBytes} to {outstandingBytes} bytes");
+        }
+    }
+}
@@ -1,6 +1,7 @@
 ﻿using System;
 using System.Collections.Generic;
 using System.Runtime.InteropServices;
+using System.Text;
 using UnityEngine;
 
 [Serializable]
@@ -48,15 +49,571 @@ public enum k4a_fps_t : int
     K4A_FRAMES_PER_SECOND_30,    /**< 30 FPS */
 }
 
+// Matches DeliveryPolicy in CaptureQueue.h
+[Serializable]
+public enum DeliveryPolicy : int
+{
+    LatestOnly = 0,    /**< Minimum latency, older captures are dropped */
+    BoundedQueue,      /**< Buffers up to the queue capacity, dropping the oldest */
+    EveryFrame,        /**< Stalls the capture reader instead of dropping, frames the sdk drops meanwhile are still counted */
+}
+
+// Matches DeviceStartState in AzureKinectWrapper.h
+[Serializable]
+public enum DeviceStartState : int
+{
+    Idle = 0,
+    Starting,
+    Started,
+    Failed,
+}
+
+// Matches PointCloudFileFormat in PointCloudExporter.h
+[Serializable]
+public enum PointCloudFileFormat : int
+{
+    Ply = 0,    /**< Binary little endian PLY */
+    Pcd,        /**< Binary PCD v0.7 */
+}
+
+public struct PointCloudExportStats
+{
+    public int frameCount;
+    public int pointCount;
+    public ulong writtenBytes;
+    public float encodeMilliseconds;
+    public float writeMilliseconds;
+    public float megabytesPerSecond;
+}
+
+// Matches PyramidDepthFilter in PyramidHelper.h
+[Serializable]
+public enum PyramidDepthFilter : int
+{
+    Min = 0,    /**< Nearest valid depth of each 2x2 block */
+    Median,     /**< Lower median of the valid depths of each 2x2 block */
+}
+
+// Matches OutlierFilterMode in OutlierFilterHelper.h
+[Serializable]
+public enum OutlierFilterMode : int
+{
+    Mask = 0,   /**< Depth is left alone, TryGetOutlierMask marks the pixels that passed */
+    InPlace,    /**< Rejected pixels are zeroed in the depth image */
+}
+
+// Matches interpolation_t in UndistortHelper.h
+[Serializable]
+public enum UndistortInterpolation : int
+{
+    NearestNeighbor = 0,
+    Bilinear,
+    BilinearDepth,      /**< Leaves pixels next to invalid depth or across depth edges invalid, ir uses Bilinear */
+}
+
+// Matches UndistortedStream in UndistortHelper.h
+public enum UndistortedStream : int
+{
+    Depth = 0,
+    IR,
+}
+
+// Intrinsics of the pinhole camera the undistorted streams are remapped onto, in pixels
+public struct UndistortedPinhole
+{
+    public float fx;
+    public float fy;
+    public float px;
+    public float py;
+    public int width;
+    public int height;
+}
+
+public struct UndistortStats
+{
+    public UndistortInterpolation interpolation;
+    public ulong lutBytes;
+    public float lutMilliseconds;
+    public float depthRemapMilliseconds;
+    public float irRemapMilliseconds;
+}
+
+// Matches ColorUvFormat in ColorUvHelper.h
+public enum ColorUvFormat : int
+{
+    RG16 = 0,           /**< Unorm 16 bit channels, a RG32 texture */
+    RG32F,              /**< Float channels, a RGFloat texture */
+}
+
+// Values of ColorUvFlagsTexture read as unorm: 0 valid, about 0.5 occluded, 1 invalid
+public enum ColorUvFlag : byte
+{
+    Valid = 0,
+    Occluded = 128,
+    Invalid = 255,
+}
+
+// Registration is the sdk warping color onto the depth camera, measured on the same frames as the uv map
+public struct ColorUvStats
+{
+    public int validPixelCount;
+    public int occludedPixelCount;
+    public float projectMilliseconds;
+    public ulong uploadBytes;
+    public float registrationMilliseconds;
+    public ulong registrationUploadBytes;
+}
+
+// Average remap time of one depth frame per interpolation mode
+public struct UndistortBenchmark
+{
+    public float nearestNeighborMilliseconds;
+    public float bilinearMilliseconds;
+    public float bilinearDepthMilliseconds;
+}
+
+public struct RegionOfInterestStats
+{
+    public int processedPixelCount;
+    public int keptPixelCount;      /**< -1 without a region of interest */
+    public ulong copiedBytes;
+    public float processMilliseconds;
+}
+
+public struct DeliveryStats
+{
+    public DeliveryPolicy policy;
+    public int queueCapacity;
+    public int queueDepth;
+    public int maxQueueDepth;
+    public ulong deliveredCount;
+    public ulong droppedCount;
+    public float lastAgeMilliseconds;
+    public float maxAgeMilliseconds;
+    public float averageAgeMilliseconds;
+}
+
+// Matches FrameDescriptorFlags in FrameDescriptor.h
+[Flags]
+public enum FrameDescriptorFlags : uint
+{
+    Updated = 1 << 0,
+    ResourcesReady = 1 << 1,
+    IRReady = 1 << 2,
+    BuffersReady = 1 << 3,
+    Unchanged = 1 << 4,     /**< Change detection found no changed tile, buffers and textures were left as they were */
+    ClockMapped = 1 << 5,   /**< The host timestamp is mapped from the device clock, otherwise it is the depth system timestamp */
+}
+
+// Matches FrameDescriptor, blittable so an array of them is pinned rather than copied
+[StructLayout(LayoutKind.Sequential)]
+public struct FrameDescriptor
+{
+    public uint index;
+    public FrameDescriptorFlags flags;
+    public ulong sequence;
+    public ulong depthTimestampUsec;
+    public ulong colorTimestampUsec;
+    public uint calibrationVersion;
+    public int queueDepth;
+    public IntPtr rgbSrv;
+    public IntPtr depthSrv;
+    public IntPtr pointCloudTemplateSrv;
+    public IntPtr irSrv;
+    public IntPtr transformedColorBuffer;
+    public IntPtr depthBuffer;
+    public uint rgbWidth;
+    public uint rgbHeight;
+    public uint depthWidth;
+    public uint depthHeight;
+    public uint pointCloudTemplateWidth;
+    public uint pointCloudTemplateHeight;
+    public uint irWidth;
+    public uint irHeight;
+    public ulong deliveredCount;
+    public ulong droppedCount;
+    public float lastAgeMilliseconds;
+    public float averageAgeMilliseconds;
+    public ulong depthHostTimestampNsec;
+    public float captureToPublishMilliseconds;
+    public int changedX;
+    public int changedY;
+    public int changedWidth;
+    public int changedHeight;
+}
+
+// Matches FrameTimestamps in FrameDescriptor.h. Device timestamps are microseconds on the device clock,
+// system and host timestamps are nanoseconds on the host monotonic clock.
+[StructLayout(LayoutKind.Sequential)]
+public struct FrameTimestamps
+{
+    public ulong sequence;
+    public ulong colorDeviceTimestampUsec;
+    public ulong colorSystemTimestampNsec;
+    public ulong depthDeviceTimestampUsec;
+    public ulong depthSystemTimestampNsec;
+    public ulong irDeviceTimestampUsec;
+    public ulong irSystemTimestampNsec;
+    public ulong depthHostTimestampNsec;
+    public ulong publishHostTimestampNsec;
+    public float captureToPublishMilliseconds;
+}
+
+public struct ClockMapping
+{
+    public bool hasFit;
+    public int sampleCount;
+    public int inlierCount;
+    public long offsetMicroseconds;
+    public double driftPpm;
+    public float residualMicroseconds;
+}
+
+public struct LatencyStats
+{
+    public ulong frameCount;
+    public float lastMilliseconds;
+    public float averageMilliseconds;
+    public float maxMilliseconds;
+}
+
+// Matches DeviceInfo in FrameDescriptor.h, versions are major, minor and iteration
+[StructLayout(LayoutKind.Sequential, CharSet = CharSet.Ansi)]
+public struct DeviceInfo
+{
+    public uint index;
+    [MarshalAs(UnmanagedType.ByValTStr, SizeConst = 32)]
+    public string serialNumber;
+    [MarshalAs(UnmanagedType.ByValArray, SizeConst = 3)]
+    public uint[] colorFirmwareVersion;
+    [MarshalAs(UnmanagedType.ByValArray, SizeConst = 3)]
+    public uint[] depthFirmwareVersion;
+    [MarshalAs(UnmanagedType.ByValArray, SizeConst = 3)]
+    public uint[] audioFirmwareVersion;
+    [MarshalAs(UnmanagedType.ByValArray, SizeConst = 3)]
+    public uint[] depthSensorVersion;
+    public int firmwareBuild;
+    public int firmwareSignature;
+    public uint rawCalibrationSize;
+}
+
+// Matches DeviceMemoryStats in FrameDescriptor.h, live bytes per category, all zero once the device stopped
+[StructLayout(LayoutKind.Sequential)]
+public struct DeviceMemoryStats
+{
+    public uint index;
+    public int imageCount;
+    public int bufferCount;
+    public int lutCount;
+    public int textureCount;
+    public int uploadTargetCount;
+    public ulong imageBytes;
+    public ulong bufferBytes;
+    public ulong lutBytes;
+    public ulong textureBytes;
+    public ulong uploadBytes;
+    public ulong totalBytes;
+}
+
+// Matches ChangeDetectionStats in FrameDescriptor.h. Counts and bytes add up from when change detection
+// was enabled, 1 - copiedBytes / fullFrameBytes is the share of copying and uploading it saved.
+[StructLayout(LayoutKind.Sequential)]
+public struct ChangeDetectionStats
+{
+    public ulong frameCount;
+    public ulong unchangedFrameCount;
+    public ulong keyframeCount;
+    public ulong copiedBytes;
+    public ulong fullFrameBytes;
+    public int tileColumns;
+    public int tileRows;
+    public int changedTileCount;
+    public float detectMilliseconds;
+}
+
+// Matches OutlierFilterStats in FrameDescriptor.h. The frame and rejected totals add up from when the filter
+// was enabled, the rest is the last frame's. Ratios are a pixel's rms distance to its neighbors over its depth.
+[StructLayout(LayoutKind.Sequential)]
+public struct OutlierFilterStats
+{
+    public ulong frameCount;
+    public ulong rejectedTotal;
+    public int width;
+    public int height;
+    public int validPixelCount;
+    public int rejectedPixelCount;
+    public float meanRatio;
+    public float ratioDeviation;
+    public float thresholdRatio;
+    public float filterMilliseconds;
+}
+
+// Matches SharedFrameStats in FrameDescriptor.h. Counts and bytes add up from when the ring was created,
+// publish times are for copying one frame into shared memory, the last frame's and the slowest one's.
+[StructLayout(LayoutKind.Sequential)]
+public struct SharedFrameStats
+{
+    public ulong publishedCount;
+    public ulong publishedBytes;
+    public ulong mappingBytes;
+    public int slotCount;
+    public float lastPublishMilliseconds;
+    public float maxPublishMilliseconds;
+}
+
+// Matches FrameServerStats in FrameDescriptor.h. Counts and bytes add up from when the server started,
+// bandwidth covers every client over the last second.
+[StructLayout(LayoutKind.Sequential)]
+public struct FrameServerStats
+{
+    public int port;
+    public int clientCount;
+    public ulong submittedCount;
+    public ulong skippedCount;
+    public ulong encodedCount;
+    public ulong sentCount;
+    public ulong droppedCount;
+    public ulong rawBytes;
+    public ulong encodedBytes;
+    public ulong sentBytes;
+    public float lastColorEncodeMilliseconds;
+    public float lastDepthEncodeMilliseconds;
+    public float averageEncodeMilliseconds;
+    public float lastSendMilliseconds;
+    public float maxSendMilliseconds;
+    public float compressionRatio;
+    public float megabitsPerSecond;
+}
+
+// Matches FrameClientFrameInfo in FrameDescriptor.h, sequence counts the frames the client decoded
+[StructLayout(LayoutKind.Sequential)]
+public struct FrameClientFrameInfo
+{
+    public ulong sequence;
+    public ulong frameSequence;
+    public ulong depthDeviceTimestampUsec;
+    public ulong depthHostTimestampNsec;
+    public int width;
+    public int height;
+    public int hasDepth;
+    public int hasColor;
+}
+
+// Matches FrameClientStats in FrameDescriptor.h. Latency is only meaningful with the server on the same machine.
+[StructLayout(LayoutKind.Sequential)]
+public struct FrameClientStats
+{
+    public int connected;
+    public int width;
+    public int height;
+    public ulong connectCount;
+    public ulong receivedCount;
+    public ulong receivedBytes;
+    public ulong missedCount;
+    public ulong failedCount;
+    public float lastEncodeMilliseconds;
+    public float lastReceiveMilliseconds;
+    public float lastDecodeMilliseconds;
+    public float averageDecodeMilliseconds;
+    public float lastLatencyMilliseconds;
+    public float averageLatencyMilliseconds;
+    public float averageIntervalMilliseconds;
+    public float intervalJitterMilliseconds;
+    public float megabitsPerSecond;
+}
+
+// The asynchronous starts launched together, summed is roughly what starting them one by one costs
+public struct StartupStats
+{
+    public int deviceCount;
+    public int failedCount;
+    public int pendingCount;
+    public float wallMilliseconds;
+    public float summedMilliseconds;
+}
+
+// The last Reconfigure, camera time is stopping and restarting the sensors and rebuild time is the
+// calibration dependent state that had to be replaced
+public struct ReconfigureStats
+{
+    public ulong reconfigureCount;
+    public float lastMilliseconds;
+    public float cameraMilliseconds;
+    public float rebuildMilliseconds;
+    public bool calibrationChanged;
+    public bool resourcesRecreated;
+}
+
+// Matches CalibrationBlobCamera
+[StructLayout(LayoutKind.Sequential)]
+public struct CalibrationBlobCamera
+{
+    public int width;
+    public int height;
+    public int intrinsicsType;
+    public int intrinsicsCount;
+    [MarshalAs(UnmanagedType.ByValArray, SizeConst = 15)]
+    public float[] intrinsics;
+    public float metricRadius;
+    [MarshalAs(UnmanagedType.ByValArray, SizeConst = 9)]
+    public float[] rotation;
+    [MarshalAs(UnmanagedType.ByValArray, SizeConst = 3)]
+    public float[] translation;
+}
+
+// Matches CalibrationBlob, fetched only when FrameDescriptor.calibrationVersion changes
+[StructLayout(LayoutKind.Sequential)]
+public struct CalibrationBlob
+{
+    public const uint Magic = 0x42434b41;
+    public const uint LayoutVersion = 1;
+
+    public uint magic;
+    public uint layoutVersion;
+    public uint size;
+    public uint calibrationVersion;
+    public int depthMode;
+    public int colorResolution;
+    public CalibrationBlobCamera depth;
+    public CalibrationBlobCamera color;
+    [MarshalAs(UnmanagedType.ByValArray, SizeConst = 9)]
+    public float[] depthToColorRotation;
+    [MarshalAs(UnmanagedType.ByValArray, SizeConst = 3)]
+    public float[] depthToColorTranslation;
+}
+
+// Matches k4a_imu_sample_t
+[StructLayout(LayoutKind.Sequential)]
+public struct k4a_imu_sample_t
+{
+    public float temperature;
+    public float acc_x;
+    public float acc_y;
+    public float acc_z;
+    public ulong acc_timestamp_usec;
+    public float gyro_x;
+    public float gyro_y;
+    public float gyro_z;
+    public ulong gyro_timestamp_usec;
+}
+
+// Matches FrameCallback in AzureKinectWrapper.h, invoked on the thread calling TryUpdate
+[UnmanagedFunctionPointer(CallingConvention.StdCall)]
+public delegate void FrameCallback(uint index, ulong sequence, IntPtr context);
+
 public class AzureKinectUnityAPI
 {
     private const string AzureKinectPluginDll = "AzureKinect.Unity";
 
+    [DllImport(AzureKinectPluginDll, EntryPoint = "GetRenderEventFunc")]
+    internal static extern IntPtr GetRenderEventFuncNative();
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "SetRenderThreadUploads")]
+    internal static extern void SetRenderThreadUploadsNative(bool enabled);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetUploadStats")]
+    internal static extern bool TryGetUploadStatsNative(
+        out int targetCount,
+        out ulong submittedCount,
+        out ulong uploadedCount,
+        out ulong coalescedCount,
+        out ulong uploadedBytes);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetFrameSequence")]
+    internal static extern bool TryGetFrameSequenceNative(uint index, out ulong sequence);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryWaitForFrame")]
+    internal static extern bool TryWaitForFrameNative(uint index, ulong afterSequence, uint timeoutMilliseconds, out ulong sequence);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TrySetFrameCallback")]
+    internal static extern bool TrySetFrameCallbackNative(uint index, FrameCallback callback, IntPtr context);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetFrameTimestamps")]
+    internal static extern bool TryGetFrameTimestampsNative(uint index, out FrameTimestamps timestamps);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetClockMapping")]
+    internal static extern bool TryGetClockMappingNative(
+        uint index,
+        [MarshalAs(UnmanagedType.U1)] out bool hasFit,
+        out int sampleCount,
+        out int inlierCount,
+        out long offsetMicroseconds,
+        out double driftPpm,
+        out float residualMicroseconds);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryMapDeviceTimestamp")]
+    internal static extern bool TryMapDeviceTimestampNative(uint index, ulong deviceTimestampUsec, out ulong hostTimestampNsec);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetLatencyStats")]
+    internal static extern bool TryGetLatencyStatsNative(
+        uint index,
+        out ulong frameCount,
+        out float lastMilliseconds,
+        out float averageMilliseconds,
+        out float maxMilliseconds);
+
     [DllImport(AzureKinectPluginDll, EntryPoint = "GetDeviceCount")]
     internal static extern uint GetDeviceCountNative();
 
     [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetDeviceSerialNumber")]
-    internal static extern bool TryGetDeviceSerialNumberNative(uint index, char[] serialNum, uint serialNumSize);
+    internal static extern bool TryGetDeviceSerialNumberNative(uint index, StringBuilder serialNum, uint serialNumSize);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetDeviceInfo")]
+    internal static extern bool TryGetDeviceInfoNative(uint index, out DeviceInfo info);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetDeviceRawCalibration")]
+    internal static extern bool TryGetDeviceRawCalibrationNative(uint index, byte[] data, int capacity, out int size);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "FindDeviceBySerialNumber")]
+    internal static extern int FindDeviceBySerialNumberNative(string serialNumber);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryRefreshDeviceTable")]
+    internal static extern bool TryRefreshDeviceTableNative(out int deviceCount, out float refreshMilliseconds);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryStartStreamsAsync")]
+    internal static extern bool TryStartStreamsAsyncNative(
+        uint index,
+        int colorFormat,
+        int colorResolution,
+        int depthMode,
+        int fps);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryReconfigureStreams")]
+    internal static extern bool TryReconfigureStreamsNative(
+        uint index,
+        int colorFormat,
+        int colorResolution,
+        int depthMode,
+        int fps,
+        out float reconfigureMilliseconds);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetReconfigureStats")]
+    internal static extern bool TryGetReconfigureStatsNative(
+        uint index,
+        out ulong reconfigureCount,
+        out float lastMilliseconds,
+        out float cameraMilliseconds,
+        out float rebuildMilliseconds,
+        [MarshalAs(UnmanagedType.U1)] out bool calibrationChanged,
+        [MarshalAs(UnmanagedType.U1)] out bool resourcesRecreated);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetDeviceStartState")]
+    internal static extern bool TryGetDeviceStartStateNative(
+        uint index,
+        out int state,
+        out float openMilliseconds,
+        out float startMilliseconds);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryWaitForDeviceStarts")]
+    internal static extern bool TryWaitForDeviceStartsNative(uint timeoutMilliseconds);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetStartupStats")]
+    internal static extern bool TryGetStartupStatsNative(
+        out int deviceCount,
+        out int failedCount,
+        out int pendingCount,
+        out float wallMilliseconds,
+        out float summedMilliseconds);
 
     [DllImport(AzureKinectPluginDll, EntryPoint = "Initialize")]
     internal static extern bool InitializeNative();
@@ -119,238 +676,1663 @@ public class AzureKinectUnityAPI
     [DllImport(AzureKinectPluginDll, EntryPoint = "StopStreaming")]
     internal static extern void StopStreamingNative(uint index);
 
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryEnableSpatialIndex")]
+    internal static extern bool TryEnableSpatialIndexNative(uint index, float cellSize, bool benchmark);
 
-    public static AzureKinectUnityAPI Instance(uint deviceIndex)
-    {
-        if (!apiDictionary.TryGetValue(deviceIndex, out AzureKinectUnityAPI api))
-        {
-            api = new AzureKinectUnityAPI(deviceIndex);
-            apiDictionary.Add(deviceIndex, api);
-        }
+    [DllImport(AzureKinectPluginDll, EntryPoint = "DisableSpatialIndex")]
+    internal static extern void DisableSpatialIndexNative(uint index);
 
-        return api;
-    }
-    private static Dictionary<uint, AzureKinectUnityAPI> apiDictionary = new Dictionary<uint, AzureKinectUnityAPI>();
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryRaycastPointCloud")]
+    internal static extern bool TryRaycastPointCloudNative(
+        uint index,
+        float[] origin,
+        float[] direction,
+        float maxDistance,
+        float pickRadius,
+        float[] hitPoint,
+        out int hitPixelIndex);
 
-    // Note these textures are flipped vertically
-    public Texture2D RGBTexture { get; private set; }
-    public Texture2D DepthTexture { get; private set; }
-    public Texture2D PointCloudTemplateTexture { get; private set; }
-    public string SerialNumber { get; private set; }
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetNearestPoints")]
+    internal static extern bool TryGetNearestPointsNative(
+        uint index,
+        float[] point,
+        int k,
+        int[] pixelIndices,
+        float[] distances,
+        out int count);
 
-    public bool DebugLogging
-    {
-        get
-        {
-            return debugLogging;
-        }
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetPointsInRadius")]
+    internal static extern bool TryGetPointsInRadiusNative(
+        uint index,
+        float[] point,
+        float radius,
+        int[] pixelIndices,
+        int capacity,
+        out int count);
 
-        set
-        {
-            debugLogging = value;
-        }
-    }
-    private bool debugLogging = true;
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetSpatialIndexStats")]
+    internal static extern bool TryGetSpatialIndexStatsNative(
+        uint index,
+        out int pointCount,
+        out float cellSize,
+        out float buildMilliseconds,
+        out float queryMilliseconds,
+        out float bruteForceMilliseconds);
 
-    public Matrix4x4 PointTransform
-    {
-        get
-        {
-            return pointTransform;
-        }
-        set
-        {
-            pointTransform = value;
-        }
-    }
-    private Matrix4x4 pointTransform = Matrix4x4.identity;
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TrySetWorldTransform")]
+    internal static extern bool TrySetWorldTransformNative(uint index, float[] worldTransform);
 
-    private bool initialized = false;
-    private bool streaming = false;
-    private uint deviceIndex = 0;
-    private float lastUpdate = 0.0f;
-    private k4a_image_format_t colorFormat = k4a_image_format_t.K4A_IMAGE_FORMAT_COLOR_BGRA32;
-    private k4a_color_resolution_t colorResolution = k4a_color_resolution_t.K4A_COLOR_RESOLUTION_1080P;
-    private k4a_depth_mode_t depthMode = k4a_depth_mode_t.K4A_DEPTH_MODE_NFOV_UNBINNED;
-    private k4a_fps_t fps = k4a_fps_t.K4A_FRAMES_PER_SECOND_30;
+    [DllImport(AzureKinectPluginDll, EntryPoint = "ClearWorldTransform")]
+    internal static extern void ClearWorldTransformNative(uint index);
 
-    private AzureKinectUnityAPI(
-        uint deviceIndex)
-    {
-        this.deviceIndex = deviceIndex;
-    }
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TrySetRegionOfInterest")]
+    internal static extern bool TrySetRegionOfInterestNative(
+        uint index,
+        int x,
+        int y,
+        int width,
+        int height,
+        ushort minDepth,
+        ushort maxDepth,
+        float[] boxMin,
+        float[] boxMax);
 
-    public void SetConfiguration(
-        k4a_image_format_t colorFormat,
-        k4a_color_resolution_t colorResolution,
-        k4a_depth_mode_t depthMode,
-        k4a_fps_t fps)
-    {
-        this.colorFormat = colorFormat;
-        this.colorResolution = colorResolution;
-        this.depthMode = depthMode;
-        this.fps = fps;
-    }
+    [DllImport(AzureKinectPluginDll, EntryPoint = "ClearRegionOfInterest")]
+    internal static extern void ClearRegionOfInterestNative(uint index);
 
-    public void Start()
-    {
-        if (streaming)
-        {
-            return; 
-        }
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetRegionOfInterestStats")]
+    internal static extern bool TryGetRegionOfInterestStatsNative(
+        uint index,
+        out int processedPixelCount,
+        out int keptPixelCount,
+        out ulong copiedBytes,
+        out float processMilliseconds);
 
-        Initialize();
-        if (initialized)
-        {
-            uint deviceCount = GetDeviceCountNative();
-            DebugLog($"Devices Found: {deviceCount}");
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TrySetChangeDetection")]
+    internal static extern bool TrySetChangeDetectionNative(
+        uint index,
+        bool enabled,
+        int depthNoiseThreshold,
+        int irNoiseThreshold,
+        uint tileThreshold,
+        int keyframeInterval);
 
-            if (TryStartStreamsNative(
-                deviceIndex,
-                (int)colorFormat,
-                (int)colorResolution,
-                (int)depthMode,
-                (int)fps))
-            {
-                char[] serialNumber = new char[256];
-                if(TryGetDeviceSerialNumberNative(deviceIndex, serialNumber, (uint) serialNumber.Length))
-                {
-                    SerialNumber = new string(serialNumber);
-                }
-                else
-                {
-                    DebugLog($"Failed to obtain device serial number: {deviceIndex}");
-                }
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetChangeMask")]
+    internal static extern bool TryGetChangeMaskNative(
+        uint index,
+        [Out] byte[] maskData,
+        int maskSize,
+        out int columns,
+        out int rows);
 
-                streaming = true;
-            }
-            else
-            {
-                DebugLog($"Failed to start device streaming: {deviceIndex}");
-            }
-        }
-    }
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetChangeDetectionStats")]
+    internal static extern bool TryGetChangeDetectionStatsNative(uint index, out ChangeDetectionStats stats);
 
-    public void Update()
-    {
-        if (lastUpdate == Time.time)
-        {
-            return;
-        }
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TrySetOutlierFilter")]
+    internal static extern bool TrySetOutlierFilterNative(
+        uint index,
+        bool enabled,
+        int windowSize,
+        float sigma,
+        int mode);
 
-        lastUpdate = Time.time;
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetOutlierMask")]
+    internal static extern bool TryGetOutlierMaskNative(
+        uint index,
+        [Out] byte[] maskData,
+        int maskSize,
+        out int width,
+        out int height);
 
-        if (!streaming)
-        {
-            Start();
-        }
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetOutlierFilterStats")]
+    internal static extern bool TryGetOutlierFilterStatsNative(uint index, out OutlierFilterStats stats);
 
-        if (streaming &&
-            TryUpdateNative() &&
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryStartSharedFrames")]
+    internal static extern bool TryStartSharedFramesNative(uint index, string name, int slotCount, bool includeIR);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "StopSharedFrames")]
+    internal static extern void StopSharedFramesNative(uint index);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetSharedFrameName")]
+    internal static extern bool TryGetSharedFrameNameNative(uint index, StringBuilder name, uint nameSize);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetSharedFrameStats")]
+    internal static extern bool TryGetSharedFrameStatsNative(uint index, out SharedFrameStats stats);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryStartFrameServer")]
+    internal static extern bool TryStartFrameServerNative(
+        uint index,
+        int port,
+        int colorQuality,
+        int depthErrorMillimeters,
+        float maxFramesPerSecond,
+        out int boundPort);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "StopFrameServer")]
+    internal static extern void StopFrameServerNative(uint index);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetFrameServerStats")]
+    internal static extern bool TryGetFrameServerStatsNative(uint index, out FrameServerStats stats);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryConnectFrameClient")]
+    internal static extern bool TryConnectFrameClientNative(string host, int port, out ulong clientId);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "DisconnectFrameClient")]
+    internal static extern void DisconnectFrameClientNative(ulong clientId);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetFrameClientFrame")]
+    internal static extern bool TryGetFrameClientFrameNative(
+        ulong clientId,
+        ref ulong sequence,
+        out FrameClientFrameInfo info,
+        [Out] ushort[] depthData,
+        [Out] byte[] colorData,
+        int pixelCapacity);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetFrameClientStats")]
+    internal static extern bool TryGetFrameClientStatsNative(ulong clientId, out FrameClientStats stats);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryFusePointClouds")]
+    internal static extern bool TryFusePointCloudsNative(
+        float voxelSize,
+        float[] positions,
+        uint[] colors,
+        int capacity,
+        out int count);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetFusionStats")]
+    internal static extern bool TryGetFusionStatsNative(
+        out int deviceCount,
+        out int inputPointCount,
+        out int fusedPointCount,
+        out float transformMilliseconds,
+        out float mergeMilliseconds);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryExportPointCloud")]
+    internal static extern bool TryExportPointCloudNative(
+        uint index,
+        string path,
+        int format,
+        bool includeNormals,
+        out int pointCount);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryConvertRecording")]
+    internal static extern bool TryConvertRecordingNative(
+        string recordingPath,
+        string outputDirectory,
+        int format,
+        bool includeNormals,
+        out int frameCount);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetExportStats")]
+    internal static extern bool TryGetExportStatsNative(
+        out int frameCount,
+        out int pointCount,
+        out ulong writtenBytes,
+        out float encodeMilliseconds,
+        out float writeMilliseconds,
+        out float megabytesPerSecond);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryCreateTsdfVolume")]
+    internal static extern bool TryCreateTsdfVolumeNative(uint index, float voxelSize, float truncationDistance);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "DestroyTsdfVolume")]
+    internal static extern void DestroyTsdfVolumeNative(uint index);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryIntegrateTsdfVolume")]
+    internal static extern bool TryIntegrateTsdfVolumeNative(uint index, float[] cameraToWorld);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryRaycastTsdfVolume")]
+    internal static extern bool TryRaycastTsdfVolumeNative(
+        uint index,
+        float[] cameraToWorld,
+        float[] points,
+        int pointCapacity,
+        out int width,
+        out int height,
+        out int hitCount);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetTsdfVolumeStats")]
+    internal static extern bool TryGetTsdfVolumeStatsNative(
+        uint index,
+        out int frameCount,
+        out int blockCount,
+        out int integratedBlockCount,
+        out float allocationMilliseconds,
+        out float integrationMilliseconds,
+        out float raycastMilliseconds);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryStartImu")]
+    internal static extern bool TryStartImuNative(uint index);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "StopImu")]
+    internal static extern void StopImuNative(uint index);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetImuSamples")]
+    internal static extern bool TryGetImuSamplesNative(
+        uint index,
+        ulong cursor,
+        [Out] k4a_imu_sample_t[] samples,
+        int capacity,
+        out int count,
+        out ulong nextCursor,
+        out ulong depthTimestampUsec);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "SubscribeIR")]
+    internal static extern void SubscribeIRNative(uint index);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "UnsubscribeIR")]
+    internal static extern void UnsubscribeIRNative(uint index);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetIRShaderResourceView")]
+    internal static extern bool TryGetIRShaderResourceViewNative(
+        uint index,
+        out IntPtr irSrv,
+        out uint irWidth,
+        out uint irHeight,
+        out uint irBpp);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "SubscribePyramidLevel")]
+    internal static extern void SubscribePyramidLevelNative(uint index, int level);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "UnsubscribePyramidLevel")]
+    internal static extern void UnsubscribePyramidLevelNative(uint index, int level);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TrySetPyramidDepthFilter")]
+    internal static extern bool TrySetPyramidDepthFilterNative(uint index, int filter);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetPyramidShaderResourceViews")]
+    internal static extern bool TryGetPyramidShaderResourceViewsNative(
+        uint index,
+        int level,
+        out IntPtr rgbSrv,
+        out uint rgbWidth,
+        out uint rgbHeight,
+        out IntPtr depthSrv,
+        out uint depthWidth,
+        out uint depthHeight);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetPyramidImageBuffers")]
+    internal static extern bool TryGetPyramidImageBuffersNative(
+        uint index,
+        int level,
+        byte[] colorImageData,
+        int colorImageSize,
+        byte[] depthImageData,
+        int depthImageSize);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "SubscribeUndistortedStream")]
+    internal static extern void SubscribeUndistortedStreamNative(uint index, int stream);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "UnsubscribeUndistortedStream")]
+    internal static extern void UnsubscribeUndistortedStreamNative(uint index, int stream);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TrySetUndistortInterpolation")]
+    internal static extern bool TrySetUndistortInterpolationNative(uint index, int interpolation);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetUndistortedPinhole")]
+    internal static extern bool TryGetUndistortedPinholeNative(
+        uint index,
+        out float fx,
+        out float fy,
+        out float px,
+        out float py,
+        out int width,
+        out int height);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetUndistortedShaderResourceViews")]
+    internal static extern bool TryGetUndistortedShaderResourceViewsNative(
+        uint index,
+        out IntPtr depthSrv,
+        out uint depthWidth,
+        out uint depthHeight,
+        out IntPtr irSrv,
+        out uint irWidth,
+        out uint irHeight);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetUndistortedImageBuffers")]
+    internal static extern bool TryGetUndistortedImageBuffersNative(
+        uint index,
+        byte[] depthImageData,
+        int depthImageSize,
+        byte[] irImageData,
+        int irImageSize);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetUndistortStats")]
+    internal static extern bool TryGetUndistortStatsNative(
+        uint index,
+        out int interpolation,
+        out ulong lutBytes,
+        out float lutMilliseconds,
+        out float depthRemapMilliseconds,
+        out float irRemapMilliseconds);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryBenchmarkUndistort")]
+    internal static extern bool TryBenchmarkUndistortNative(
+        uint index,
+        int iterations,
+        out float nearestNeighborMilliseconds,
+        out float bilinearMilliseconds,
+        out float bilinearDepthMilliseconds);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "SubscribeColorUvMap")]
+    internal static extern void SubscribeColorUvMapNative(uint index);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "UnsubscribeColorUvMap")]
+    internal static extern void UnsubscribeColorUvMapNative(uint index);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TrySetColorUvFormat")]
+    internal static extern bool TrySetColorUvFormatNative(uint index, int format, float occlusionTolerance);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TrySetRegistrationEnabled")]
+    internal static extern bool TrySetRegistrationEnabledNative(uint index, bool enabled);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetColorUvShaderResourceViews")]
+    internal static extern bool TryGetColorUvShaderResourceViewsNative(
+        uint index,
+        out IntPtr colorSrv,
+        out uint colorWidth,
+        out uint colorHeight,
+        out IntPtr uvSrv,
+        out IntPtr flagsSrv,
+        out uint uvWidth,
+        out uint uvHeight);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetColorUvImageBuffers")]
+    internal static extern bool TryGetColorUvImageBuffersNative(
+        uint index,
+        byte[] uvImageData,
+        int uvImageSize,
+        byte[] flagsImageData,
+        int flagsImageSize);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetColorUvStats")]
+    internal static extern bool TryGetColorUvStatsNative(
+        uint index,
+        out int validPixelCount,
+        out int occludedPixelCount,
+        out float projectMilliseconds,
+        out ulong uploadBytes,
+        out float registrationMilliseconds,
+        out ulong registrationUploadBytes);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetIRImageBuffer")]
+    internal static extern bool TryGetIRImageBufferNative(
+        uint index,
+        [Out] byte[] irImageData,
+        int irImageSize);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetToneMappedIRImage")]
+    internal static extern bool TryGetToneMappedIRImageNative(
+        uint index,
+        [Out] byte[] toneMappedImageData,
+        int toneMappedImageSize,
+        int minValue,
+        int maxValue);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryLeaseIRImage")]
+    internal static extern bool TryLeaseIRImageNative(
+        uint index,
+        out IntPtr irImageData,
+        out int width,
+        out int height,
+        out int stride,
+        out ulong leaseId);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "ReleaseIRImageLease")]
+    internal static extern void ReleaseIRImageLeaseNative(ulong leaseId);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TrySetDeliveryPolicy")]
+    internal static extern bool TrySetDeliveryPolicyNative(uint index, int policy, int queueCapacity);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetDeliveryStats")]
+    internal static extern bool TryGetDeliveryStatsNative(
+        uint index,
+        out int policy,
+        out int queueCapacity,
+        out int queueDepth,
+        out int maxQueueDepth,
+        out ulong deliveredCount,
+        out ulong droppedCount,
+        out float lastAgeMilliseconds,
+        out float maxAgeMilliseconds,
+        out float averageAgeMilliseconds);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetAllocationStats")]
+    internal static extern bool TryGetAllocationStatsNative(
+        out ulong acquireCount,
+        out ulong heapAllocationCount,
+        out ulong heapAllocatedBytes,
+        out ulong outstandingCount,
+        out ulong outstandingBytes,
+        out ulong pooledBytes);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetDeviceMemoryStats")]
+    internal static extern bool TryGetDeviceMemoryStatsNative(uint index, out DeviceMemoryStats stats);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TrimMemory")]
+    internal static extern ulong TrimMemoryNative();
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "UpdateAndGetFrameDescriptors")]
+    internal static extern int UpdateAndGetFrameDescriptorsNative(
+        [In, Out] FrameDescriptor[] descriptors,
+        int capacity,
+        int descriptorSize);
+
+    [DllImport(AzureKinectPluginDll, EntryPoint = "TryGetCalibrationBlob")]
+    internal static extern bool TryGetCalibrationBlobNative(
+        uint index,
+        out CalibrationBlob blob);
+
+
+    public static AzureKinectUnityAPI Instance(uint deviceIndex)
+    {
+        if (!apiDictionary.TryGetValue(deviceIndex, out AzureKinectUnityAPI api))
+        {
+            api = new AzureKinectUnityAPI(deviceIndex);
+            apiDictionary.Add(deviceIndex, api);
+        }
+
+        return api;
+    }
+    private static Dictionary<uint, AzureKinectUnityAPI> apiDictionary = new Dictionary<uint, AzureKinectUnityAPI>();
+
+    // Note these textures are flipped vertically
+    public Texture2D RGBTexture { get; private set; }
+    public Texture2D DepthTexture { get; private set; }
+    public Texture2D PointCloudTemplateTexture { get; private set; }
+    public Texture2D IRTexture { get; private set; }
+    public string SerialNumber { get; private set; }
+
+    public bool DebugLogging
+    {
+        get
+        {
+            return debugLogging;
+        }
+
+        set
+        {
+            debugLogging = value;
+        }
+    }
+    private bool debugLogging = true;
+
+    public Matrix4x4 PointTransform
+    {
+        get
+        {
+            return pointTransform;
+        }
+        set
+        {
+            pointTransform = value;
+        }
+    }
+    private Matrix4x4 pointTransform = Matrix4x4.identity;
+
+    private bool initialized = false;
+    private bool streaming = false;
+    private bool starting = false;
+    private uint deviceIndex = 0;
+    private float lastUpdate = 0.0f;
+    private k4a_image_format_t colorFormat = k4a_image_format_t.K4A_IMAGE_FORMAT_COLOR_BGRA32;
+    private k4a_color_resolution_t colorResolution = k4a_color_resolution_t.K4A_COLOR_RESOLUTION_1080P;
+    private k4a_depth_mode_t depthMode = k4a_depth_mode_t.K4A_DEPTH_MODE_NFOV_UNBINNED;
+    private k4a_fps_t fps = k4a_fps_t.K4A_FRAMES_PER_SECOND_30;
+    private DeliveryPolicy deliveryPolicy = DeliveryPolicy.LatestOnly;
+    private int deliveryQueueCapacity = 1;
+
+    private AzureKinectUnityAPI(
+        uint deviceIndex)
+    {
+        this.deviceIndex = deviceIndex;
+    }
+
+    public void SetConfiguration(
+        k4a_image_format_t colorFormat,
+        k4a_color_resolution_t colorResolution,
+        k4a_depth_mode_t depthMode,
+        k4a_fps_t fps)
+    {
+        this.colorFormat = colorFormat;
+        this.colorResolution = colorResolution;
+        this.depthMode = depthMode;
+        this.fps = fps;
+    }
+
+    // Takes effect the next time the device is started
+    public void SetDeliveryPolicy(DeliveryPolicy policy, int queueCapacity = 1)
+    {
+        deliveryPolicy = policy;
+        deliveryQueueCapacity = queueCapacity;
+    }
+
+    public void Start()
+    {
+        if (streaming)
+        {
+            return; 
+        }
+
+        Initialize();
+        if (initialized)
+        {
+            uint deviceCount = GetDeviceCountNative();
+            DebugLog($"Devices Found: {deviceCount}");
+
+            if (!TrySetDeliveryPolicyNative(deviceIndex, (int)deliveryPolicy, deliveryQueueCapacity))
+            {
+                DebugLog($"Failed to set delivery policy: {deliveryPolicy}");
+            }
+
+            if (TryStartStreamsNative(
+                deviceIndex,
+                (int)colorFormat,
+                (int)colorResolution,
+                (int)depthMode,
+                (int)fps))
+            {
+                OnStarted();
+            }
+            else
+            {
+                DebugLog($"Failed to start device streaming: {deviceIndex}");
+            }
+        }
+    }
+
+    // Opens the device and starts its cameras on a native thread and returns right away. Devices
+    // started this way come up in parallel, Update picks each one up once it is streaming.
+    public void StartAsync()
+    {
+        if (streaming || starting)
+        {
+            return;
+        }
+
+        Initialize();
+        if (initialized)
+        {
+            if (!TrySetDeliveryPolicyNative(deviceIndex, (int)deliveryPolicy, deliveryQueueCapacity))
+            {
+                DebugLog($"Failed to set delivery policy: {deliveryPolicy}");
+            }
+
+            starting = TryStartStreamsAsyncNative(
+                deviceIndex,
+                (int)colorFormat,
+                (int)colorResolution,
+                (int)depthMode,
+                (int)fps);
+            if (!starting)
+            {
+                DebugLog($"Failed to start device streaming: {deviceIndex}");
+            }
+        }
+    }
+
+    // Switches a streaming device to new modes by restarting only its cameras, the device stays open and
+    // buffers that kept their size are reused. Textures that had to be recreated are fetched again by the
+    // next Update. A device that is not streaming just picks the modes up when it starts.
+    public bool Reconfigure(
+        k4a_image_format_t colorFormat,
+        k4a_color_resolution_t colorResolution,
+        k4a_depth_mode_t depthMode,
+        k4a_fps_t fps)
+    {
+        if (!streaming && !starting)
+        {
+            SetConfiguration(colorFormat, colorResolution, depthMode, fps);
+            return true;
+        }
+
+        TryGetReconfigureStats(out var previousStats);
+        bool succeeded = TryReconfigureStreamsNative(
+            deviceIndex,
+            (int)colorFormat,
+            (int)colorResolution,
+            (int)depthMode,
+            (int)fps,
+            out float milliseconds);
+        DebugLog($"Reconfigured device {deviceIndex} in {milliseconds} ms: {succeeded}");
+
+        if (TryGetReconfigureStats(out var stats) &&
+            stats.reconfigureCount != previousStats.reconfigureCount &&
+            stats.resourcesRecreated)
+        {
+            ReleaseTextures();
+        }
+
+        if (succeeded)
+        {
+            SetConfiguration(colorFormat, colorResolution, depthMode, fps);
+        }
+        else if (!TryGetStartState(out var state, out _, out _) ||
+            state != DeviceStartState.Started)
+        {
+            // Not even the previous modes came back up, the device was closed
+            DebugLog($"Device {deviceIndex} stopped after a failed reconfigure");
+            ReleaseTextures();
+            Stop();
+        }
+
+        return succeeded;
+    }
+
+    public bool TryGetReconfigureStats(out ReconfigureStats stats)
+    {
+        stats = new ReconfigureStats();
+        return TryGetReconfigureStatsNative(
+            deviceIndex,
+            out stats.reconfigureCount,
+            out stats.lastMilliseconds,
+            out stats.cameraMilliseconds,
+            out stats.rebuildMilliseconds,
+            out stats.calibrationChanged,
+            out stats.resourcesRecreated);
+    }
+
+    // The native views behind these are gone, Update creates new textures from the replacements
+    private void ReleaseTextures()
+    {
+        RGBTexture = null;
+        DepthTexture = null;
+        PointCloudTemplateTexture = null;
+        IRTexture = null;
+        Array.Clear(pyramidRGBTextures, 0, pyramidRGBTextures.Length);
+        Array.Clear(pyramidDepthTextures, 0, pyramidDepthTextures.Length);
+        UndistortedDepthTexture = null;
+        UndistortedIRTexture = null;
+        ColorTexture = null;
+        ColorUvTexture = null;
+        ColorUvFlagsTexture = null;
+    }
+
+    public bool TryGetStartState(out DeviceStartState state, out float openMilliseconds, out float startMilliseconds)
+    {
+        bool succeeded = TryGetDeviceStartStateNative(deviceIndex, out int nativeState, out openMilliseconds, out startMilliseconds);
+        state = (DeviceStartState)nativeState;
+        return succeeded;
+    }
+
+    private void PollStart()
+    {
+        if (!TryGetStartState(out var state, out var openMilliseconds, out var startMilliseconds) ||
+            state == DeviceStartState.Starting)
+        {
+            return;
+        }
+
+        starting = false;
+        if (state == DeviceStartState.Started)
+        {
+            DebugLog($"Device {deviceIndex} started in {startMilliseconds} ms");
+            OnStarted();
+        }
+        else
+        {
+            DebugLog($"Failed to start device streaming: {deviceIndex}");
+        }
+    }
+
+    private void OnStarted()
+    {
+        StringBuilder serialNumber = new StringBuilder(256);
+        if (TryGetDeviceSerialNumberNative(deviceIndex, serialNumber, (uint)serialNumber.Capacity))
+        {
+            SerialNumber = serialNumber.ToString();
+        }
+        else
+        {
+            DebugLog($"Failed to obtain device serial number: {deviceIndex}");
+        }
+
+        streaming = true;
+    }
+
+    public void Update()
+    {
+        if (lastUpdate == Time.time)
+        {
+            return;
+        }
+
+        lastUpdate = Time.time;
+
+        if (!streaming)
+        {
+            if (starting)
+            {
+                PollStart();
+            }
+            else
+            {
+                Start();
+            }
+        }
+
+        bool updated = streaming && TryUpdateNative();
+        if (streaming)
+        {
+            // Frames were only queued, the render thread uploads the newest one per texture
+            GL.IssuePluginEvent(GetRenderEventFuncNative(), 0);
+        }
+
+        if (updated &&
             (RGBTexture == null || DepthTexture == null || PointCloudTemplateTexture == null))
         {
-            bool succeeded = TryGetShaderResourceViewsNative(
+            bool succeeded = TryGetShaderResourceViewsNative(
+                deviceIndex,
+                out var rgbSrv,
+                out var rgbWidth,
+                out var rgbHeight,
+                out var rgbBpp,
+                out var depthSrv,
+                out var depthWidth,
+                out var depthHeight,
+                out var depthBpp,
+                out var pointCloudSrv,
+                out var pointCloudWidth,
+                out var pointCloudHeight,
+                out var pointCloudBpp);
+            DebugLog($"Succeeded obtaining shader resource views: {succeeded}");
+
+            if (succeeded &
+                RGBTexture == null &&
+                rgbSrv != null &&
+                rgbWidth > 0 &&
+                rgbHeight > 0)
+            {
+                DebugLog($"Creating RGBTexture: {rgbWidth}x{rgbHeight}");
+                RGBTexture = Texture2D.CreateExternalTexture((int)rgbWidth, (int)rgbHeight, TextureFormat.BGRA32, false, false, rgbSrv);
+            }
+
+            if (succeeded &&
+                DepthTexture == null &&
+                depthSrv != null &&
+                depthWidth > 0 &&
+                depthHeight > 0)
+            {
+                DebugLog($"Creating DepthTexture: {depthWidth}x{depthHeight}");
+                DepthTexture = Texture2D.CreateExternalTexture((int)depthWidth, (int)depthHeight, TextureFormat.R16, false, false, depthSrv);
+            }
+
+            if (succeeded &&
+                PointCloudTemplateTexture == null &&
+                pointCloudSrv != null &&
+                pointCloudWidth > 0 &&
+                pointCloudHeight > 0)
+            {
+                DebugLog($"Creating PointCloudTemplateTexture: {pointCloudWidth}x{pointCloudHeight}");
+                PointCloudTemplateTexture = Texture2D.CreateExternalTexture((int)pointCloudWidth, (int)pointCloudHeight, TextureFormat.RGBAFloat, false, false, pointCloudSrv);
+            }
+        }
+
+        if (streaming &&
+            irSubscribed &&
+            IRTexture == null &&
+            TryGetIRShaderResourceViewNative(deviceIndex, out var irSrv, out var irWidth, out var irHeight, out var irBpp) &&
+            irWidth > 0 &&
+            irHeight > 0)
+        {
+            DebugLog($"Creating IRTexture: {irWidth}x{irHeight}");
+            IRTexture = Texture2D.CreateExternalTexture((int)irWidth, (int)irHeight, TextureFormat.R16, false, false, irSrv);
+        }
+
+        for (int level = 0; streaming && level < PyramidLevelCount; level++)
+        {
+            if (pyramidSubscribed[level] &&
+                (pyramidRGBTextures[level] == null || pyramidDepthTextures[level] == null) &&
+                TryGetPyramidShaderResourceViewsNative(
+                    deviceIndex,
+                    level + 1,
+                    out var levelRgbSrv,
+                    out var levelRgbWidth,
+                    out var levelRgbHeight,
+                    out var levelDepthSrv,
+                    out var levelDepthWidth,
+                    out var levelDepthHeight))
+            {
+                if (pyramidDepthTextures[level] == null)
+                {
+                    DebugLog($"Creating pyramid level {level + 1} DepthTexture: {levelDepthWidth}x{levelDepthHeight}");
+                    pyramidDepthTextures[level] = Texture2D.CreateExternalTexture((int)levelDepthWidth, (int)levelDepthHeight, TextureFormat.R16, false, false, levelDepthSrv);
+                }
+
+                if (pyramidRGBTextures[level] == null &&
+                    levelRgbSrv != IntPtr.Zero)
+                {
+                    DebugLog($"Creating pyramid level {level + 1} RGBTexture: {levelRgbWidth}x{levelRgbHeight}");
+                    pyramidRGBTextures[level] = Texture2D.CreateExternalTexture((int)levelRgbWidth, (int)levelRgbHeight, TextureFormat.BGRA32, false, false, levelRgbSrv);
+                }
+            }
+        }
+
+        if (streaming &&
+            ((undistortedDepthSubscribed && UndistortedDepthTexture == null) || (undistortedIRSubscribed && UndistortedIRTexture == null)) &&
+            TryGetUndistortedShaderResourceViewsNative(
+                deviceIndex,
+                out var undistortedDepthSrv,
+                out var undistortedDepthWidth,
+                out var undistortedDepthHeight,
+                out var undistortedIRSrv,
+                out var undistortedIRWidth,
+                out var undistortedIRHeight))
+        {
+            if (UndistortedDepthTexture == null &&
+                undistortedDepthSrv != IntPtr.Zero)
+            {
+                DebugLog($"Creating UndistortedDepthTexture: {undistortedDepthWidth}x{undistortedDepthHeight}");
+                UndistortedDepthTexture = Texture2D.CreateExternalTexture((int)undistortedDepthWidth, (int)undistortedDepthHeight, TextureFormat.R16, false, false, undistortedDepthSrv);
+            }
+
+            if (UndistortedIRTexture == null &&
+                undistortedIRSrv != IntPtr.Zero)
+            {
+                DebugLog($"Creating UndistortedIRTexture: {undistortedIRWidth}x{undistortedIRHeight}");
+                UndistortedIRTexture = Texture2D.CreateExternalTexture((int)undistortedIRWidth, (int)undistortedIRHeight, TextureFormat.R16, false, false, undistortedIRSrv);
+            }
+        }
+
+        if (streaming &&
+            colorUvSubscribed &&
+            (ColorUvTexture == null || ColorTexture == null) &&
+            TryGetColorUvShaderResourceViewsNative(
+                deviceIndex,
+                out var colorSrv,
+                out var colorWidth,
+                out var colorHeight,
+                out var colorUvSrv,
+                out var colorUvFlagsSrv,
+                out var colorUvWidth,
+                out var colorUvHeight))
+        {
+            if (ColorUvTexture == null)
+            {
+                DebugLog($"Creating ColorUvTexture: {colorUvWidth}x{colorUvHeight} {colorUvFormat}");
+                TextureFormat uvFormat = colorUvFormat == ColorUvFormat.RG16 ? TextureFormat.RG32 : TextureFormat.RGFloat;
+                ColorUvTexture = Texture2D.CreateExternalTexture((int)colorUvWidth, (int)colorUvHeight, uvFormat, false, true, colorUvSrv);
+                ColorUvFlagsTexture = Texture2D.CreateExternalTexture((int)colorUvWidth, (int)colorUvHeight, TextureFormat.R8, false, true, colorUvFlagsSrv);
+            }
+
+            if (ColorTexture == null &&
+                colorSrv != IntPtr.Zero)
+            {
+                DebugLog($"Creating ColorTexture: {colorWidth}x{colorHeight}");
+                ColorTexture = Texture2D.CreateExternalTexture((int)colorWidth, (int)colorHeight, TextureFormat.BGRA32, false, false, colorSrv);
+            }
+        }
+    }
+
+    private Quaternion CalculateUnityRotation(float[] azureRotation)
+    {
+        Matrix4x4 rotationMatrix = new Matrix4x4(
+            new Vector4(azureRotation[0], azureRotation[1], azureRotation[2], 1.0f),
+            new Vector4(azureRotation[3], azureRotation[4], azureRotation[5], 1.0f),
+            new Vector4(azureRotation[6], azureRotation[7], azureRotation[8], 1.0f),
+            Vector4.one);
+        Quaternion rotationQuat = rotationMatrix.rotation;
+        return rotationQuat;
+    }
+
+    private Vector3 CalculateUnityTranslation(float[] azureTranslation)
+    {
+        // Convert mm to m
+        return new Vector3(azureTranslation[0] / 1000.0f, azureTranslation[1] / 1000.0f, azureTranslation[2] / 1000.0f);
+    }
+
+    public void Stop()
+    {
+        if (starting)
+        {
+            StopStreamingNative(deviceIndex);
+            starting = false;
+        }
+
+        if (streaming)
+        {
+            StopStreamingNative(deviceIndex);
+            streaming = false;
+            irSubscribed = false;
+            Array.Clear(pyramidSubscribed, 0, pyramidSubscribed.Length);
+            undistortedDepthSubscribed = false;
+            undistortedIRSubscribed = false;
+            colorUvSubscribed = false;
+        }
+    }
+
+    public bool TryGetImageBuffers(out byte[] transformedColorImageBuffer, out byte[] depthImageBuffer, out byte[] pointCloudImageBuffer)
+    {
+        transformedColorImageBuffer = null;
+        depthImageBuffer = null;
+        pointCloudImageBuffer = null;
+
+        if (RGBTexture != null &&
+            DepthTexture != null &&
+            PointCloudTemplateTexture != null)
+        {
+            // BGRA32
+            transformedColorImageBuffer = new byte[RGBTexture.width * RGBTexture.height * 4 * sizeof(byte)];
+            // R16
+            depthImageBuffer = new byte[DepthTexture.width * DepthTexture.height * sizeof(ushort)];
+            // RGBAFloat
+            pointCloudImageBuffer = new byte[PointCloudTemplateTexture.width * PointCloudTemplateTexture.height * 4 * sizeof(float)];
+
+            return TryGetImageBuffersNative(
+                (int)deviceIndex,
+                transformedColorImageBuffer,
+                transformedColorImageBuffer.Length,
+                depthImageBuffer,
+                depthImageBuffer.Length,
+                pointCloudImageBuffer,
+                pointCloudImageBuffer.Length);
+        }
+
+        return false;
+    }
+
+    // Spatial index queries use millimeters in depth camera space
+    public bool TryEnableSpatialIndex(float cellSize = 20.0f, bool benchmark = false)
+    {
+        return streaming && TryEnableSpatialIndexNative(deviceIndex, cellSize, benchmark);
+    }
+
+    public bool TryRaycastPointCloud(Vector3 origin, Vector3 direction, float maxDistance, float pickRadius, out Vector3 hitPoint, out int hitPixelIndex)
+    {
+        float[] hit = new float[3];
+        bool succeeded = TryRaycastPointCloudNative(
+            deviceIndex,
+            new float[] { origin.x, origin.y, origin.z },
+            new float[] { direction.x, direction.y, direction.z },
+            maxDistance,
+            pickRadius,
+            hit,
+            out hitPixelIndex);
+        hitPoint = new Vector3(hit[0], hit[1], hit[2]);
+        return succeeded;
+    }
+
+    // Native fusion works in millimeters, so the transform is expected to map depth camera millimeters to the world frame
+    public bool TrySetWorldTransform(Matrix4x4 worldTransform)
+    {
+        float[] rowMajor = new float[16];
+        for (int row = 0; row < 4; row++)
+        {
+            for (int column = 0; column < 4; column++)
+            {
+                rowMajor[4 * row + column] = worldTransform[row, column];
+            }
+        }
+
+        return TrySetWorldTransformNative(deviceIndex, rowMajor);
+    }
+
+    // Writes the latest frame natively, invalid pixels are skipped and positions are in millimeters
+    public bool TryExportPointCloud(string path, PointCloudFileFormat format, bool includeNormals, out int pointCount)
+    {
+        pointCount = 0;
+        return streaming && TryExportPointCloudNative(deviceIndex, path, (int)format, includeNormals, out pointCount);
+    }
+
+    // Writes every frame of an mkv recording into outputDirectory as frame_000000.ply and so on, blocks until done
+    public static bool TryConvertRecording(string recordingPath, string outputDirectory, PointCloudFileFormat format, bool includeNormals, out int frameCount)
+    {
+        return TryConvertRecordingNative(recordingPath, outputDirectory, (int)format, includeNormals, out frameCount);
+    }
+
+    // Describes the last export or conversion
+    public static bool TryGetExportStats(out PointCloudExportStats stats)
+    {
+        stats = new PointCloudExportStats();
+        return TryGetExportStatsNative(
+            out stats.frameCount,
+            out stats.pointCount,
+            out stats.writtenBytes,
+            out stats.encodeMilliseconds,
+            out stats.writeMilliseconds,
+            out stats.megabytesPerSecond);
+    }
+
+    // Crops frames natively before the color transform, copies and uploads. The rect is in depth pixels, depths
+    // are millimeters with a maxDepth of 0 meaning unbounded, and the optional box is in depth camera millimeters.
+    public bool TrySetRegionOfInterest(RectInt rect, ushort minDepth, ushort maxDepth, Bounds? box = null)
+    {
+        float[] boxMin = null;
+        float[] boxMax = null;
+        if (box.HasValue)
+        {
+            boxMin = new float[] { box.Value.min.x, box.Value.min.y, box.Value.min.z };
+            boxMax = new float[] { box.Value.max.x, box.Value.max.y, box.Value.max.z };
+        }
+
+        return TrySetRegionOfInterestNative(deviceIndex, rect.x, rect.y, rect.width, rect.height, minDepth, maxDepth, boxMin, boxMax);
+    }
+
+    public void ClearRegionOfInterest()
+    {
+        ClearRegionOfInterestNative(deviceIndex);
+    }
+
+    public bool TryGetRegionOfInterestStats(out RegionOfInterestStats stats)
+    {
+        stats = new RegionOfInterestStats();
+        return TryGetRegionOfInterestStatsNative(
+            deviceIndex,
+            out stats.processedPixelCount,
+            out stats.keptPixelCount,
+            out stats.copiedBytes,
+            out stats.processMilliseconds);
+    }
+
+    // Compares each frame's depth, and ir unless irNoiseThreshold is negative, against the last frame every
+    // 32x32 tile changed in. Differences up to the noise thresholds are ignored, a tile changed once what is
+    // left adds up past tileThreshold. Frames with no changed tile skip the color transform, copies and
+    // uploads, others only copy and upload the rect around the changed tiles. Every keyframeInterval frames
+    // one goes through whole, which bounds how long color changes on static geometry can go unseen.
+    public bool TrySetChangeDetection(
+        bool enabled,
+        int depthNoiseThreshold = 20,
+        int irNoiseThreshold = -1,
+        uint tileThreshold = 4096,
+        int keyframeInterval = 30)
+    {
+        return TrySetChangeDetectionNative(deviceIndex, enabled, depthNoiseThreshold, irNoiseThreshold, tileThreshold, keyframeInterval);
+    }
+
+    // One byte per tile, row by row, non zero where the last frame changed. A null or mismatched buffer
+    // still reports the tile grid so it can be sized.
+    public bool TryGetChangeMask(byte[] mask, out int columns, out int rows)
+    {
+        return TryGetChangeMaskNative(deviceIndex, mask, mask != null ? mask.Length : 0, out columns, out rows);
+    }
+
+    public bool TryGetChangeDetectionStats(out ChangeDetectionStats stats)
+    {
+        return TryGetChangeDetectionStatsNative(deviceIndex, out stats);
+    }
+
+    // Rejects flying pixels natively before anything else reads the depth. Each valid pixel's rms distance to
+    // the valid pixels in the windowSize x windowSize window around it, over its depth, is compared with the
+    // frame's mean; pixels more than sigma standard deviations above it, or without any valid neighbor, are
+    // rejected. Window sums make the cost independent of windowSize, which is odd and from 3 to 31. Mask mode
+    // leaves depth alone and publishes TryGetOutlierMask, in place zeroes the rejected depth.
+    public bool TrySetOutlierFilter(
+        bool enabled,
+        int windowSize = 5,
+        float sigma = 2.0f,
+        OutlierFilterMode mode = OutlierFilterMode.Mask)
+    {
+        return TrySetOutlierFilterNative(deviceIndex, enabled, windowSize, sigma, (int)mode);
+    }
+
+    // One byte per depth pixel, row by row, 1 where the last frame's depth was valid and kept. Only kept in
+    // mask mode. A null or mismatched buffer still reports the size so it can be allocated.
+    public bool TryGetOutlierMask(byte[] mask, out int width, out int height)
+    {
+        return TryGetOutlierMaskNative(deviceIndex, mask, mask != null ? mask.Length : 0, out width, out height);
+    }
+
+    public bool TryGetOutlierFilterStats(out OutlierFilterStats stats)
+    {
+        return TryGetOutlierFilterStatsNative(deviceIndex, out stats);
+    }
+
+    // Mirrors every frame's depth, registered color and optionally ir into a shared memory ring other
+    // processes can read without copying, through the subscriber library in AzureKinect.Subscriber. A null
+    // name uses AzureKinect_<serial number>. Readers get slotCount - 1 frames to finish with one before
+    // it is overwritten, and find out if it was. The ring stays enabled across stops and restarts.
+    public bool TryStartSharedFrames(string name = null, int slotCount = 4, bool includeIR = false)
+    {
+        return TryStartSharedFramesNative(deviceIndex, name, slotCount, includeIR);
+    }
+
+    public void StopSharedFrames()
+    {
+        StopSharedFramesNative(deviceIndex);
+    }
+
+    // The name other processes open the ring by, null while nothing is published
+    public string GetSharedFrameName()
+    {
+        StringBuilder name = new StringBuilder(256);
+        return TryGetSharedFrameNameNative(deviceIndex, name, (uint)name.Capacity) ? name.ToString() : null;
+    }
+
+    public bool TryGetSharedFrameStats(out SharedFrameStats stats)
+    {
+        return TryGetSharedFrameStatsNative(deviceIndex, out stats);
+    }
+
+    // Serves registered color and depth over tcp to clients on other machines, see TryConnectFrameClient.
+    // Color is compressed lossily at colorQuality 1 to 100, depth losslessly or to within
+    // depthErrorMillimeters. Port 0 picks a free one, returned in boundPort. The server keeps running
+    // across stops and restarts, slow clients skip frames instead of holding up the device.
+    public bool TryStartFrameServer(out int boundPort, int port = 0, int colorQuality = 75, int depthErrorMillimeters = 0, float maxFramesPerSecond = 0.0f)
+    {
+        return TryStartFrameServerNative(deviceIndex, port, colorQuality, depthErrorMillimeters, maxFramesPerSecond, out boundPort);
+    }
+
+    public void StopFrameServer()
+    {
+        StopFrameServerNative(deviceIndex);
+    }
+
+    public bool TryGetFrameServerStats(out FrameServerStats stats)
+    {
+        return TryGetFrameServerStatsNative(deviceIndex, out stats);
+    }
+
+    public bool TryStartImu()
+    {
+        return streaming && TryStartImuNative(deviceIndex);
+    }
+
+    // Returns the samples published since the last call, imu and depth timestamps share the device clock
+    public bool TryGetImuSamples(k4a_imu_sample_t[] samples, out int count, out ulong depthTimestampUsec)
+    {
+        bool succeeded = TryGetImuSamplesNative(deviceIndex, imuCursor, samples, samples.Length, out count, out var nextCursor, out depthTimestampUsec);
+        if (succeeded)
+        {
+            imuCursor = nextCursor;
+        }
+
+        return succeeded;
+    }
+    private ulong imuCursor = 0;
+
+    // The ir image is only pulled from the capture and uploaded while subscribed
+    public void SubscribeIR()
+    {
+        if (streaming && !irSubscribed)
+        {
+            SubscribeIRNative(deviceIndex);
+            irSubscribed = true;
+        }
+    }
+
+    public void UnsubscribeIR()
+    {
+        if (irSubscribed)
+        {
+            UnsubscribeIRNative(deviceIndex);
+            irSubscribed = false;
+        }
+    }
+
+    public bool TryGetIRImageBuffer(byte[] irImageBuffer)
+    {
+        return irSubscribed && TryGetIRImageBufferNative(deviceIndex, irImageBuffer, irImageBuffer.Length);
+    }
+
+    // Linearly maps [minValue, maxValue] onto one byte per pixel
+    public bool TryGetToneMappedIRImage(byte[] toneMappedImageBuffer, int minValue = 0, int maxValue = 1000)
+    {
+        return irSubscribed && TryGetToneMappedIRImageNative(deviceIndex, toneMappedImageBuffer, toneMappedImageBuffer.Length, minValue, maxValue);
+    }
+    private bool irSubscribed = false;
+
+    // Level 1 is half resolution and level 2 quarter resolution, each is only computed while subscribed
+    public void SubscribePyramidLevel(int level)
+    {
+        if (streaming &&
+            level >= 1 &&
+            level <= PyramidLevelCount &&
+            !pyramidSubscribed[level - 1])
+        {
+            SubscribePyramidLevelNative(deviceIndex, level);
+            pyramidSubscribed[level - 1] = true;
+        }
+    }
+
+    public void UnsubscribePyramidLevel(int level)
+    {
+        if (level >= 1 &&
+            level <= PyramidLevelCount &&
+            pyramidSubscribed[level - 1])
+        {
+            UnsubscribePyramidLevelNative(deviceIndex, level);
+            pyramidSubscribed[level - 1] = false;
+        }
+    }
+
+    public bool TrySetPyramidDepthFilter(PyramidDepthFilter filter)
+    {
+        return TrySetPyramidDepthFilterNative(deviceIndex, (int)filter);
+    }
+
+    public Texture2D GetPyramidRGBTexture(int level)
+    {
+        return level >= 1 && level <= PyramidLevelCount ? pyramidRGBTextures[level - 1] : null;
+    }
+
+    public Texture2D GetPyramidDepthTexture(int level)
+    {
+        return level >= 1 && level <= PyramidLevelCount ? pyramidDepthTextures[level - 1] : null;
+    }
+
+    // Buffers are BGRA32 and R16 at the level's resolution
+    public bool TryGetPyramidImageBuffers(int level, byte[] colorImageBuffer, byte[] depthImageBuffer)
+    {
+        return level >= 1 &&
+            level <= PyramidLevelCount &&
+            pyramidSubscribed[level - 1] &&
+            TryGetPyramidImageBuffersNative(deviceIndex, level, colorImageBuffer, colorImageBuffer.Length, depthImageBuffer, depthImageBuffer.Length);
+    }
+
+    private const int PyramidLevelCount = 2;
+    private bool[] pyramidSubscribed = new bool[PyramidLevelCount];
+    private Texture2D[] pyramidRGBTextures = new Texture2D[PyramidLevelCount];
+    private Texture2D[] pyramidDepthTextures = new Texture2D[PyramidLevelCount];
+
+    // Depth and ir remapped onto the pinhole camera from TryGetUndistortedPinhole, each only while subscribed
+    public void SubscribeUndistortedStream(UndistortedStream stream)
+    {
+        if (streaming &&
+            !IsUndistortedStreamSubscribed(stream))
+        {
+            SubscribeUndistortedStreamNative(deviceIndex, (int)stream);
+            SetUndistortedStreamSubscribed(stream, true);
+        }
+    }
+
+    public void UnsubscribeUndistortedStream(UndistortedStream stream)
+    {
+        if (IsUndistortedStreamSubscribed(stream))
+        {
+            UnsubscribeUndistortedStreamNative(deviceIndex, (int)stream);
+            SetUndistortedStreamSubscribed(stream, false);
+        }
+    }
+
+    private bool IsUndistortedStreamSubscribed(UndistortedStream stream)
+    {
+        return stream == UndistortedStream.Depth ? undistortedDepthSubscribed : undistortedIRSubscribed;
+    }
+
+    private void SetUndistortedStreamSubscribed(UndistortedStream stream, bool subscribed)
+    {
+        if (stream == UndistortedStream.Depth)
+        {
+            undistortedDepthSubscribed = subscribed;
+        }
+        else
+        {
+            undistortedIRSubscribed = subscribed;
+        }
+    }
+
+    // Switching between nearest neighbor and bilinear rebuilds the lookup table with the next frame
+    public bool TrySetUndistortInterpolation(UndistortInterpolation interpolation)
+    {
+        return TrySetUndistortInterpolationNative(deviceIndex, (int)interpolation);
+    }
+
+    public bool TryGetUndistortedPinhole(out UndistortedPinhole pinhole)
+    {
+        pinhole = new UndistortedPinhole();
+        return TryGetUndistortedPinholeNative(
+            deviceIndex,
+            out pinhole.fx,
+            out pinhole.fy,
+            out pinhole.px,
+            out pinhole.py,
+            out pinhole.width,
+            out pinhole.height);
+    }
+
+    // Buffers are R16 at the pinhole's resolution, pass null for a stream that is not needed
+    public bool TryGetUndistortedImageBuffers(byte[] depthImageBuffer, byte[] irImageBuffer)
+    {
+        return (undistortedDepthSubscribed || undistortedIRSubscribed) &&
+            TryGetUndistortedImageBuffersNative(
                 deviceIndex,
-                out var rgbSrv,
-                out var rgbWidth,
-                out var rgbHeight,
-                out var rgbBpp,
-                out var depthSrv,
-                out var depthWidth,
-                out var depthHeight,
-                out var depthBpp,
-                out var pointCloudSrv,
-                out var pointCloudWidth,
-                out var pointCloudHeight,
-                out var pointCloudBpp);
-            DebugLog($"Succeeded obtaining shader resource views: {succeeded}");
+                undistortedDepthSubscribed ? depthImageBuffer : null,
+                depthImageBuffer != null ? depthImageBuffer.Length : 0,
+                undistortedIRSubscribed ? irImageBuffer : null,
+                irImageBuffer != null ? irImageBuffer.Length : 0);
+    }
 
-            if (succeeded &
-                RGBTexture == null &&
-                rgbSrv != null &&
-                rgbWidth > 0 &&
-                rgbHeight > 0)
-            {
-                DebugLog($"Creating RGBTexture: {rgbWidth}x{rgbHeight}");
-                RGBTexture = Texture2D.CreateExternalTexture((int)rgbWidth, (int)rgbHeight, TextureFormat.BGRA32, false, false, rgbSrv);
-            }
+    public bool TryGetUndistortStats(out UndistortStats stats)
+    {
+        stats = new UndistortStats();
+        bool succeeded = TryGetUndistortStatsNative(
+            deviceIndex,
+            out var interpolation,
+            out stats.lutBytes,
+            out stats.lutMilliseconds,
+            out stats.depthRemapMilliseconds,
+            out stats.irRemapMilliseconds);
+        stats.interpolation = (UndistortInterpolation)interpolation;
+        return succeeded;
+    }
 
-            if (succeeded &&
-                DepthTexture == null &&
-                depthSrv != null &&
-                depthWidth > 0 &&
-                depthHeight > 0)
-            {
-                DebugLog($"Creating DepthTexture: {depthWidth}x{depthHeight}");
-                DepthTexture = Texture2D.CreateExternalTexture((int)depthWidth, (int)depthHeight, TextureFormat.R16, false, false, depthSrv);
-            }
+    // Remaps the latest depth frame iterations times per mode, blocks for a while on the first call
+    public bool TryBenchmarkUndistort(int iterations, out UndistortBenchmark benchmark)
+    {
+        benchmark = new UndistortBenchmark();
+        return streaming &&
+            TryBenchmarkUndistortNative(
+                deviceIndex,
+                iterations,
+                out benchmark.nearestNeighborMilliseconds,
+                out benchmark.bilinearMilliseconds,
+                out benchmark.bilinearDepthMilliseconds);
+    }
 
-            if (succeeded &&
-                PointCloudTemplateTexture == null &&
-                pointCloudSrv != null &&
-                pointCloudWidth > 0 &&
-                pointCloudHeight > 0)
-            {
-                DebugLog($"Creating PointCloudTemplateTexture: {pointCloudWidth}x{pointCloudHeight}");
-                PointCloudTemplateTexture = Texture2D.CreateExternalTexture((int)pointCloudWidth, (int)pointCloudHeight, TextureFormat.RGBAFloat, false, false, pointCloudSrv);
-            }
+    public Texture2D UndistortedDepthTexture { get; private set; }
+    public Texture2D UndistortedIRTexture { get; private set; }
+    private bool undistortedDepthSubscribed = false;
+    private bool undistortedIRSubscribed = false;
+
+    // Per depth pixel coordinates into ColorTexture, the color image as the camera delivered it. Sampling
+    // ColorTexture at ColorUvTexture replaces the registered RGBTexture, ColorTexture stays null unless the
+    // color format is BGRA32.
+    public void SubscribeColorUvMap()
+    {
+        if (streaming &&
+            !colorUvSubscribed)
+        {
+            SubscribeColorUvMapNative(deviceIndex);
+            colorUvSubscribed = true;
         }
     }
 
-    private Quaternion CalculateUnityRotation(float[] azureRotation)
+    public void UnsubscribeColorUvMap()
     {
-        Matrix4x4 rotationMatrix = new Matrix4x4(
-            new Vector4(azureRotation[0], azureRotation[1], azureRotation[2], 1.0f),
-            new Vector4(azureRotation[3], azureRotation[4], azureRotation[5], 1.0f),
-            new Vector4(azureRotation[6], azureRotation[7], azureRotation[8], 1.0f),
-            Vector4.one);
-        Quaternion rotationQuat = rotationMatrix.rotation;
-        return rotationQuat;
+        if (colorUvSubscribed)
+        {
+            UnsubscribeColorUvMapNative(deviceIndex);
+            colorUvSubscribed = false;
+        }
     }
 
-    private Vector3 CalculateUnityTranslation(float[] azureTranslation)
+    // Pixels more than occlusionTolerance millimeters behind the nearest surface on their color pixel are
+    // flagged occluded. A new format replaces the uv texture, Update fetches it again.
+    public bool TrySetColorUvFormat(ColorUvFormat format, float occlusionTolerance = 30.0f)
     {
-        // Convert mm to m
-        return new Vector3(azureTranslation[0] / 1000.0f, azureTranslation[1] / 1000.0f, azureTranslation[2] / 1000.0f);
+        if (!TrySetColorUvFormatNative(deviceIndex, (int)format, occlusionTolerance))
+        {
+            return false;
+        }
+
+        if (format != colorUvFormat)
+        {
+            colorUvFormat = format;
+            ColorUvTexture = null;
+            ColorUvFlagsTexture = null;
+            ColorTexture = null;
+        }
+
+        return true;
     }
 
-    public void Stop()
+    // Without registration the sdk color transform is skipped and RGBTexture is no longer updated
+    public bool TrySetRegistrationEnabled(bool enabled)
     {
-        if (streaming)
+        return TrySetRegistrationEnabledNative(deviceIndex, enabled);
+    }
+
+    // The uv buffer is 4 bytes per depth pixel for RG16 and 8 for RG32F, flags are 1 byte
+    public bool TryGetColorUvImageBuffers(byte[] uvImageBuffer, byte[] flagsImageBuffer)
+    {
+        return colorUvSubscribed &&
+            TryGetColorUvImageBuffersNative(
+                deviceIndex,
+                uvImageBuffer,
+                uvImageBuffer != null ? uvImageBuffer.Length : 0,
+                flagsImageBuffer,
+                flagsImageBuffer != null ? flagsImageBuffer.Length : 0);
+    }
+
+    public bool TryGetColorUvStats(out ColorUvStats stats)
+    {
+        stats = new ColorUvStats();
+        return TryGetColorUvStatsNative(
+            deviceIndex,
+            out stats.validPixelCount,
+            out stats.occludedPixelCount,
+            out stats.projectMilliseconds,
+            out stats.uploadBytes,
+            out stats.registrationMilliseconds,
+            out stats.registrationUploadBytes);
+    }
+
+    public Texture2D ColorTexture { get; private set; }
+    public Texture2D ColorUvTexture { get; private set; }
+    public Texture2D ColorUvFlagsTexture { get; private set; }
+    private bool colorUvSubscribed = false;
+    private ColorUvFormat colorUvFormat = ColorUvFormat.RG16;
+
+    public bool TryGetDeliveryStats(out DeliveryStats stats)
+    {
+        stats = new DeliveryStats();
+        bool succeeded = TryGetDeliveryStatsNative(
+            deviceIndex,
+            out var policy,
+            out stats.queueCapacity,
+            out stats.queueDepth,
+            out stats.maxQueueDepth,
+            out stats.deliveredCount,
+            out stats.droppedCount,
+            out stats.lastAgeMilliseconds,
+            out stats.maxAgeMilliseconds,
+            out stats.averageAgeMilliseconds);
+        stats.policy = (DeliveryPolicy)policy;
+        return succeeded;
+    }
+
+    // Sequence numbers grow by one per published camera frame, compare against the last one processed
+    public bool TryGetFrameSequence(out ulong sequence)
+    {
+        sequence = 0;
+        return streaming && TryGetFrameSequenceNative(deviceIndex, out sequence);
+    }
+
+    // Blocks until a frame newer than afterSequence is published, only useful off the thread calling Update
+    public bool TryWaitForFrame(ulong afterSequence, uint timeoutMilliseconds, out ulong sequence)
+    {
+        sequence = 0;
+        return streaming && TryWaitForFrameNative(deviceIndex, afterSequence, timeoutMilliseconds, out sequence);
+    }
+
+    // The delegate is kept alive here for as long as it is registered
+    public bool TrySetFrameCallback(FrameCallback callback)
+    {
+        if (!streaming ||
+            !TrySetFrameCallbackNative(deviceIndex, callback, IntPtr.Zero))
         {
-            StopStreamingNative(deviceIndex);
-            streaming = false;
+            return false;
         }
+
+        frameCallback = callback;
+        return true;
     }
+    private FrameCallback frameCallback;
 
-    public bool TryGetImageBuffers(out byte[] transformedColorImageBuffer, out byte[] depthImageBuffer, out byte[] pointCloudImageBuffer)
+    // Color, depth and ir timestamps of the last published frame
+    public bool TryGetFrameTimestamps(out FrameTimestamps timestamps)
     {
-        transformedColorImageBuffer = null;
-        depthImageBuffer = null;
-        pointCloudImageBuffer = null;
+        timestamps = new FrameTimestamps();
+        return streaming && TryGetFrameTimestampsNative(deviceIndex, out timestamps);
+    }
 
-        if (RGBTexture != null &&
-            DepthTexture != null &&
-            PointCloudTemplateTexture != null)
+    public bool TryGetClockMapping(out ClockMapping mapping)
+    {
+        mapping = new ClockMapping();
+        return TryGetClockMappingNative(
+            deviceIndex,
+            out mapping.hasFit,
+            out mapping.sampleCount,
+            out mapping.inlierCount,
+            out mapping.offsetMicroseconds,
+            out mapping.driftPpm,
+            out mapping.residualMicroseconds);
+    }
+
+    // Lines up device timestamps, e.g. from imu samples, with other sensors on the host monotonic clock
+    public bool TryMapDeviceTimestamp(ulong deviceTimestampUsec, out ulong hostTimestampNsec)
+    {
+        hostTimestampNsec = 0;
+        return streaming && TryMapDeviceTimestampNative(deviceIndex, deviceTimestampUsec, out hostTimestampNsec);
+    }
+
+    public bool TryGetLatencyStats(out LatencyStats stats)
+    {
+        stats = new LatencyStats();
+        return TryGetLatencyStatsNative(
+            deviceIndex,
+            out stats.frameCount,
+            out stats.lastMilliseconds,
+            out stats.averageMilliseconds,
+            out stats.maxMilliseconds);
+    }
+
+    // Device lookups are served from a table the plugin reads once, so they never reopen a device.
+    // Returns -1 when no connected device has the serial number.
+    public static int FindDeviceIndex(string serialNumber)
+    {
+        return InitializeNative() ? FindDeviceBySerialNumberNative(serialNumber) : -1;
+    }
+
+    public static bool TryGetDeviceInfo(uint deviceIndex, out DeviceInfo info)
+    {
+        info = new DeviceInfo();
+        return InitializeNative() && TryGetDeviceInfoNative(deviceIndex, out info);
+    }
+
+    // The factory calibration as stored on the device, independent of the depth mode and color resolution
+    public static bool TryGetDeviceRawCalibration(uint deviceIndex, out byte[] rawCalibration)
+    {
+        rawCalibration = null;
+        if (!InitializeNative() ||
+            !TryGetDeviceInfoNative(deviceIndex, out var info))
         {
-            // BGRA32
-            transformedColorImageBuffer = new byte[RGBTexture.width * RGBTexture.height * 4 * sizeof(byte)];
-            // R16
-            depthImageBuffer = new byte[DepthTexture.width * DepthTexture.height * sizeof(ushort)];
-            // RGBAFloat
-            pointCloudImageBuffer = new byte[PointCloudTemplateTexture.width * PointCloudTemplateTexture.height * 4 * sizeof(float)];
+            return false;
+        }
 
-            return TryGetImageBuffersNative(
-                (int)deviceIndex,
-                transformedColorImageBuffer,
-                transformedColorImageBuffer.Length,
-                depthImageBuffer,
-                depthImageBuffer.Length,
-                pointCloudImageBuffer,
-                pointCloudImageBuffer.Length);
+        rawCalibration = new byte[info.rawCalibrationSize];
+        return TryGetDeviceRawCalibrationNative(deviceIndex, rawCalibration, rawCalibration.Length, out var size);
+    }
+
+    // Reads the table again, e.g. after devices were plugged in or out
+    public static bool TryRefreshDeviceTable(out int deviceCount, out float refreshMilliseconds)
+    {
+        deviceCount = 0;
+        refreshMilliseconds = 0.0f;
+        return InitializeNative() && TryRefreshDeviceTableNative(out deviceCount, out refreshMilliseconds);
+    }
+
+    // Blocks until every StartAsync finished or the timeout passed, true when none is left starting
+    public static bool TryWaitForStarts(uint timeoutMilliseconds)
+    {
+        return TryWaitForDeviceStartsNative(timeoutMilliseconds);
+    }
+
+    public static bool TryGetStartupStats(out StartupStats stats)
+    {
+        stats = new StartupStats();
+        return TryGetStartupStatsNative(
+            out stats.deviceCount,
+            out stats.failedCount,
+            out stats.pendingCount,
+            out stats.wallMilliseconds,
+            out stats.summedMilliseconds);
+    }
+
+    // Updates every streaming device and describes them all in a single call, returns how many were written
+    // or -1 when this struct no longer matches the plugin's layout
+    public static int UpdateFrameDescriptors(FrameDescriptor[] descriptors)
+    {
+        return UpdateAndGetFrameDescriptorsNative(descriptors, descriptors.Length, Marshal.SizeOf(typeof(FrameDescriptor)));
+    }
+
+    public bool TryGetCalibrationBlob(out CalibrationBlob blob)
+    {
+        return TryGetCalibrationBlobNative(deviceIndex, out blob) &&
+            blob.magic == CalibrationBlob.Magic &&
+            blob.layoutVersion == CalibrationBlob.LayoutVersion;
+    }
+
+    // Shared by every device, coalesced uploads are frames replaced before the render thread got to them
+    public static bool TryGetUploadStats(out ulong submittedCount, out ulong uploadedCount, out ulong coalescedCount)
+    {
+        return TryGetUploadStatsNative(out var targetCount, out submittedCount, out uploadedCount, out coalescedCount, out var uploadedBytes);
+    }
+
+    // Uploads limited to a region of interest show up as fewer uploaded bytes per upload
+    public static bool TryGetUploadStats(out ulong submittedCount, out ulong uploadedCount, out ulong coalescedCount, out ulong uploadedBytes)
+    {
+        return TryGetUploadStatsNative(out var targetCount, out submittedCount, out uploadedCount, out coalescedCount, out uploadedBytes);
+    }
+
+    // Shared by every device, a steady heapAllocationCount means frames are served from the pool
+    public static bool TryGetAllocationStats(out ulong heapAllocationCount, out ulong heapAllocatedBytes, out ulong outstandingBytes)
+    {
+        return TryGetAllocationStatsNative(
+            out var acquireCount,
+            out heapAllocationCount,
+            out heapAllocatedBytes,
+            out var outstandingCount,
+            out outstandingBytes,
+            out var pooledBytes);
+    }
+
+    public static bool TryGetAllocationStats(out ulong heapAllocationCount, out ulong heapAllocatedBytes, out ulong outstandingBytes, out ulong pooledBytes)
+    {
+        return TryGetAllocationStatsNative(
+            out var acquireCount,
+            out heapAllocationCount,
+            out heapAllocatedBytes,
+            out var outstandingCount,
+            out outstandingBytes,
+            out pooledBytes);
+    }
+
+    public bool TryGetMemoryStats(out DeviceMemoryStats stats)
+    {
+        return TryGetDeviceMemoryStatsNative(deviceIndex, out stats);
+    }
+
+    // Pooled buffers go back to the heap when the last device stops, this does it while devices run
+    public static ulong TrimMemory()
+    {
+        return TrimMemoryNative();
+    }
+
+    // Follows a frame server, reconnecting in the background until disconnected. False only when the
+    // host does not resolve.
+    public static bool TryConnectFrameClient(string host, int port, out ulong clientId)
+    {
+        return TryConnectFrameClientNative(host, port, out clientId);
+    }
+
+    public static void DisconnectFrameClient(ulong clientId)
+    {
+        DisconnectFrameClientNative(clientId);
+    }
+
+    // Copies the newest decoded frame when it is newer than sequence, depth as one ushort per pixel and
+    // registered color as bgra at the same size, transparent where depth is invalid. Either array can
+    // be null, the frame is only copied when it fits the ones given.
+    public static bool TryGetFrameClientFrame(ulong clientId, ref ulong sequence, out FrameClientFrameInfo info, ushort[] depthData, byte[] colorData)
+    {
+        int pixelCapacity = int.MaxValue;
+        if (depthData != null)
+        {
+            pixelCapacity = depthData.Length;
+        }
+        if (colorData != null)
+        {
+            pixelCapacity = Math.Min(pixelCapacity, colorData.Length / 4);
         }
 
-        return false;
+        return TryGetFrameClientFrameNative(clientId, ref sequence, out info, depthData, colorData, pixelCapacity);
+    }
+
+    public static bool TryGetFrameClientStats(ulong clientId, out FrameClientStats stats)
+    {
+        return TryGetFrameClientStatsNative(clientId, out stats);
     }
 
     private void Initialize()
@@ -362,6 +2344,10 @@ public class AzureKinectUnityAPI
             {
                 DebugLog("Failed to initialize AzureKinect.Unity plugin.");
             }
+            else
+            {
+                SetRenderThreadUploadsNative(true);
+            }
         }
     }
 
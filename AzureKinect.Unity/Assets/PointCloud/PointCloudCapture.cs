@@ -10,20 +10,42 @@ public class PointCloudCapture : MonoBehaviour
     [SerializeField]
     public AzureKinectHelper azureKinectHelper;
 
+    // Writes a ply or pcd file natively instead of serializing the raw buffers
+    [SerializeField]
+    public bool exportPointCloud = false;
+
+    [SerializeField]
+    public PointCloudFileFormat exportFormat = PointCloudFileFormat.Ply;
+
+    [SerializeField]
+    public bool exportNormals = false;
+
     void Update()
     {
         if (azureKinectHelper != null &&
             Input.GetKeyDown(captureKeyCode))
         {
-            var rgbTexture = azureKinectHelper.GetRGBTexture();
-            if (azureKinectHelper.TryGetImageBuffers(out var colorImageBuffer, out var depthImageBuffer, out var pointCloudImageBuffer))
+            string capturePath = Path.Combine(Environment.GetFolderPath(Environment.SpecialFolder.MyDocuments), "PointCloudCaptures");
+            if (!Directory.Exists(capturePath))
             {
-                string capturePath = Path.Combine(Environment.GetFolderPath(Environment.SpecialFolder.MyDocuments), "PointCloudCaptures");
-                if (!Directory.Exists(capturePath))
+                Directory.CreateDirectory(capturePath);
+            }
+
+            if (exportPointCloud)
+            {
+                string extension = exportFormat == PointCloudFileFormat.Ply ? "ply" : "pcd";
+                string exportPath = Path.Combine(capturePath, $"PointCloudCapture.{DateTime.Now.ToString("yyyy.MM.dd_hh.mm.ss")}.{extension}");
+                if (!azureKinectHelper.TryExportPointCloud(exportPath, exportFormat, exportNormals, out var pointCount))
                 {
-                    Directory.CreateDirectory(capturePath);
+                    Debug.LogError("Unable to export point cloud");
                 }
 
+                return;
+            }
+
+            var rgbTexture = azureKinectHelper.GetRGBTexture();
+            if (azureKinectHelper.TryGetImageBuffers(out var colorImageBuffer, out var depthImageBuffer, out var pointCloudImageBuffer))
+            {
                 string filePath = Path.Combine(capturePath, $"PointCloudCapture.{DateTime.Now.ToString("yyyy.MM.dd_hh.mm.ss")}.bin");
                 byte[] data = SerializeBuffers(rgbTexture.width, rgbTexture.height, colorImageBuffer, depthImageBuffer, pointCloudImageBuffer);
                 File.WriteAllBytes(filePath, data);
@@ -25,9 +25,14 @@ public class PointCloudHelper : MonoBehaviour
     [Range(0.01f, 10)]
     private float maxDepth = 2;
 
+    // Applies the depth range natively as well, so pixels outside of it are never transformed or uploaded
+    [SerializeField]
+    private bool cropNatively = false;
+
     private Material material = null;
     private bool deviceInitialized = false;
     private bool fileLoaded = false;
+    private Vector2 appliedDepthRange = Vector2.zero;
 
     private void Update()
     {
@@ -105,6 +110,25 @@ public class PointCloudHelper : MonoBehaviour
             deviceInitialized = true;
         }
 
+        var depthRange = cropNatively ? new Vector2(minDepth, maxDepth) : Vector2.zero;
+        if (depthRange != appliedDepthRange)
+        {
+            var depthTexture = AzureKinectUnityAPI.Instance(deviceIndex).DepthTexture;
+            if (!cropNatively)
+            {
+                AzureKinectUnityAPI.Instance(deviceIndex).ClearRegionOfInterest();
+            }
+            else if (!AzureKinectUnityAPI.Instance(deviceIndex).TrySetRegionOfInterest(
+                new RectInt(0, 0, depthTexture.width, depthTexture.height),
+                (ushort)Mathf.Clamp(minDepth * 1000.0f, 0.0f, ushort.MaxValue),
+                (ushort)Mathf.Clamp(maxDepth * 1000.0f, 0.0f, ushort.MaxValue)))
+            {
+                Debug.LogError("Failed to set the native depth range");
+            }
+
+            appliedDepthRange = depthRange;
+        }
+
         if (material == null)
         {
             material = GetComponent<MeshRenderer>().material;